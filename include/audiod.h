@@ -0,0 +1,305 @@
+/**
+ * \file audiod.h
+ * \brief Démon audio : le moteur audio dans un processus séparé de l'interface
+ * \details Comme le lecteur RFID (rfidReader), le moteur audio peut tourner dans son propre
+ * processus (piaudiod) qui garde le flux ALSA ouvert. L'interface lui envoie des copies de la
+ * musique et des commandes de transport par une file sans verrou en mémoire partagée, et
+ * relit la position jouée publiée en retour. Une attente de ncurses, du réseau ou du capteur
+ * ne peut plus affamer l'audio.
+ * Si le démon ne tourne pas, le client ouvre le moteur dans le processus de l'interface :
+ * le séquenceur utilise la même interface dans les deux cas.
+ */
+#ifndef AUDIOD_H
+#define AUDIOD_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <signal.h>
+#include "engine.h"
+#include "stepper.h"
+#include "mysyscall.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define AUDIOD_SHM_NAME "/pimusiic_audiod" /*!< Nom de la mémoire partagée du démon */
+#define AUDIOD_MAGIC 0x50694175 /*!< Signature de la mémoire partagée ("PiAu") */
+#define AUDIOD_RING_SIZE 64 /*!< Nombre de commandes en attente (puissance de 2) */
+#define AUDIOD_SONGS 2 /*!< Nombre de copies de la musique (l'une est jouée pendant que l'autre est écrite) */
+#define AUDIOD_POLL_TIME 1000 /*!< Période de lecture des commandes par le démon en microsecondes */
+#define AUDIOD_TIMEOUT 200000 /*!< Attente maximale d'une réponse du démon en microsecondes */
+#define AUDIOD_NO_SONG -1 /*!< Aucune copie de la musique n'est jouée */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \enum audiod_command_type_t
+ * \brief Commandes envoyées au démon
+ */
+typedef enum {
+    AUDIOD_CMD_PLAY = 0, /*!< Joue la copie slot à partir de tick */
+    AUDIOD_CMD_STOP,     /*!< Arrête la lecture */
+    AUDIOD_CMD_NUDGE,    /*!< Décale le tempo de value bpm */
+    AUDIOD_CMD_METRONOME, /*!< Active (value = 1) ou coupe le métronome */
+    AUDIOD_CMD_EFFECT,   /*!< Change l'effet des prochaines notes (value) */
+    AUDIOD_CMD_AUDITION, /*!< Fait entendre note au tempo value */
+    AUDIOD_CMD_LOOP,     /*!< Joue en boucle la copie slot entre tick et tickEnd (arrête la boucle si vide) */
+} audiod_command_type_t;
+
+/**
+ * \struct audiod_command_t
+ * \brief Commande de la file
+ */
+typedef struct {
+    audiod_command_type_t type; /*!< Type de commande */
+    int slot; /*!< Copie de la musique concernée */
+    long long tick; /*!< Position musicale */
+    long long tickEnd; /*!< Fin de la boucle */
+    int value; /*!< Paramètre de la commande */
+    note_t note; /*!< Note à écouter */
+} audiod_command_t;
+
+/**
+ * \struct audiod_status_t
+ * \brief État publié par le démon
+ */
+typedef struct {
+    int playing; /*!< engine_is_playing */
+    long long playTick; /*!< engine_playtick */
+    short bpm; /*!< engine_bpm */
+    int metronome; /*!< Le métronome est activé */
+    int playSlot; /*!< Copie de la musique en cours de lecture (AUDIOD_NO_SONG si aucune) */
+    long long transport; /*!< Transport du moteur : il avance tant que le démon est vivant */
+} audiod_status_t;
+
+/**
+ * \struct audiod_song_t
+ * \brief Copie à plat d'une musique dans la mémoire partagée
+ * \details Les blocs de notes d'un music_t sont alloués dans l'interface : ils ne sont pas
+ * visibles du démon. Seules les nbNotes premières lignes des nbChannels premiers channels sont
+ * écrites : les pages de la mémoire partagée jamais écrites ne sont pas allouées.
+ */
+typedef struct {
+    struct timeval date; /*!< Date de création de la musique */
+    short bpm; /*!< Tempo au début */
+    int nbTempos; /*!< Nombre de changements de tempo */
+    tempo_event_t tempos[MUSIC_MAX_TEMPOS]; /*!< Changements de tempo */
+    int nbChannels; /*!< Nombre de channels de la musique */
+    int nbNotes[MUSIC_MAX_CHANNELS]; /*!< Nombre de lignes écrites de chaque channel */
+    packed_note_t notes[MUSIC_MAX_CHANNELS][CHANNEL_MAX_NOTES]; /*!< Lignes de chaque channel */
+} audiod_song_t;
+
+/**
+ * \struct audiod_shm_t
+ * \brief Mémoire partagée entre l'interface et le démon
+ * \details L'interface est le seul producteur de la file et le démon le seul consommateur.
+ * L'état est publié avec un compteur de cohérence (impair pendant l'écriture).
+ */
+typedef struct {
+    int magic; /*!< AUDIOD_MAGIC quand le démon est prêt */
+    pid_t pid; /*!< PID du démon */
+    audiod_command_t commands[AUDIOD_RING_SIZE]; /*!< File des commandes */
+    unsigned int head; /*!< Prochaine commande écrite par l'interface */
+    unsigned int tail; /*!< Prochaine commande lue par le démon */
+    unsigned int statusSeq; /*!< Compteur de cohérence de l'état */
+    audiod_status_t status; /*!< État du moteur */
+    audio_stats_t stats; /*!< Statistiques audio du démon (verrou partagé entre processus) */
+    audiod_song_t songs[AUDIOD_SONGS]; /*!< Copies de la musique */
+} audiod_shm_t;
+
+/**
+ * \struct audiod_output_t
+ * \brief Sorties audio d'un processus : moteur et moteur pas à pas
+ */
+typedef struct {
+    engine_t engine; /*!< Moteur audio */
+    stepper_gpio_t gpio; /*!< GPIO du moteur pas à pas (simulés sur PC) */
+    stepper_t stepper; /*!< Moteur pas à pas calé sur le transport */
+} audiod_output_t;
+
+/**
+ * \struct audiod_client_t
+ * \brief Accès au moteur audio depuis l'interface
+ */
+typedef struct {
+    audiod_shm_t *shm; /*!< Mémoire du démon (NULL si le moteur tourne dans l'interface) */
+    audiod_output_t *local; /*!< Moteur ouvert dans l'interface quand le démon ne tourne pas */
+    audio_stats_t stats; /*!< Statistiques du moteur local */
+    int metronome; /*!< Le métronome est activé */
+    music_t *music; /*!< Instantané de la musique jouée (pour retrouver les lignes) */
+} audiod_client_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_audiod_output(audiod_output_t *output, audio_stats_t *stats)
+ * \brief Ouvre le moteur audio et branche le moteur pas à pas sur son transport
+ * \param output Les sorties à ouvrir
+ * \param stats Les statistiques audio à remplir
+ * \return 0 si le moteur est ouvert, -1 sinon
+ */
+int init_audiod_output(audiod_output_t *output, audio_stats_t *stats);
+
+/**
+ * \fn void end_audiod_output(audiod_output_t *output)
+ * \brief Ferme le moteur pas à pas et le moteur audio
+ * \param output Les sorties ouvertes avec init_audiod_output
+ */
+void end_audiod_output(audiod_output_t *output);
+
+/**
+ * \fn audiod_shm_t *create_audiod_shm()
+ * \brief Crée la mémoire partagée du démon
+ * \return La mémoire partagée, prête à recevoir des commandes
+ */
+audiod_shm_t *create_audiod_shm();
+
+/**
+ * \fn void destroy_audiod_shm(audiod_shm_t *shm)
+ * \brief Supprime la mémoire partagée du démon
+ * \param shm La mémoire créée avec create_audiod_shm
+ */
+void destroy_audiod_shm(audiod_shm_t *shm);
+
+/**
+ * \fn int audiod_serve(audiod_shm_t *shm, engine_t *engine)
+ * \brief Exécute les commandes en attente et publie l'état du moteur
+ * \param shm La mémoire partagée
+ * \param engine Le moteur du démon
+ * \return Le nombre de commandes exécutées
+ * \note Appelé par le démon toutes les AUDIOD_POLL_TIME microsecondes
+ */
+int audiod_serve(audiod_shm_t *shm, engine_t *engine);
+
+/**
+ * \fn int audiod_connect(audiod_client_t *client)
+ * \brief Se connecte au démon, ou ouvre le moteur dans l'interface s'il ne tourne pas
+ * \param client Le client à initialiser
+ * \return 0 si le moteur est disponible, -1 si aucun flux n'a pu être ouvert
+ */
+int audiod_connect(audiod_client_t *client);
+
+/**
+ * \fn void audiod_disconnect(audiod_client_t *client)
+ * \brief Arrête la boucle et la lecture puis se déconnecte (ou ferme le moteur local)
+ * \param client Le client
+ */
+void audiod_disconnect(audiod_client_t *client);
+
+/**
+ * \fn int audiod_play(audiod_client_t *client, music_t *music, long long tick)
+ * \brief Lance la lecture d'une musique à partir d'une position musicale
+ * \param client Le client
+ * \param music La musique à jouer (copiée pour le démon)
+ * \param tick La position de départ en doubles croches
+ * \return 0 si la lecture a commencé, -1 sinon
+ * \see engine_play
+ */
+int audiod_play(audiod_client_t *client, music_t *music, long long tick);
+
+/**
+ * \fn void audiod_stop(audiod_client_t *client)
+ * \brief Arrête la lecture en cours
+ * \param client Le client
+ */
+void audiod_stop(audiod_client_t *client);
+
+/**
+ * \fn int audiod_is_playing(audiod_client_t *client)
+ * \brief Indique si la musique est encore audible
+ * \param client Le client
+ * \return 1 tant que la dernière note n'est pas sortie du haut-parleur
+ */
+int audiod_is_playing(audiod_client_t *client);
+
+/**
+ * \fn int audiod_line(audiod_client_t *client, int channelId)
+ * \brief Ligne d'un channel actuellement audible
+ * \param client Le client
+ * \param channelId L'identifiant du channel
+ * \return La ligne jouée ou ENGINE_NO_LINE
+ */
+int audiod_line(audiod_client_t *client, int channelId);
+
+/**
+ * \fn short audiod_bpm(audiod_client_t *client)
+ * \brief Tempo courant de la lecture
+ * \param client Le client
+ * \return Le bpm joué
+ */
+short audiod_bpm(audiod_client_t *client);
+
+/**
+ * \fn void audiod_nudge(audiod_client_t *client, int delta)
+ * \brief Décale le tempo en direct pendant la lecture
+ * \param client Le client
+ * \param delta Le décalage à ajouter en bpm
+ */
+void audiod_nudge(audiod_client_t *client, int delta);
+
+/**
+ * \fn void audiod_set_metronome(audiod_client_t *client, int enabled)
+ * \brief Active ou coupe le métronome
+ * \param client Le client
+ * \param enabled 1 pour activer le métronome
+ */
+void audiod_set_metronome(audiod_client_t *client, int enabled);
+
+/**
+ * \fn int audiod_metronome(audiod_client_t *client)
+ * \brief Indique si le métronome est activé
+ * \param client Le client
+ * \return 1 si le métronome est activé
+ */
+int audiod_metronome(audiod_client_t *client);
+
+/**
+ * \fn void audiod_set_effect(audiod_client_t *client, short effect)
+ * \brief Change l'effet appliqué aux prochaines notes
+ * \param client Le client
+ * \param effect L'effet (0 : aucun, 1 : fuzz, 2 : compression)
+ */
+void audiod_set_effect(audiod_client_t *client, short effect);
+
+/**
+ * \fn void audiod_audition(audiod_client_t *client, note_t note, short bpm)
+ * \brief Fait entendre une note sur la voix d'écoute
+ * \param client Le client
+ * \param note La note à écouter
+ * \param bpm Le tempo pour la durée de la note
+ */
+void audiod_audition(audiod_client_t *client, note_t note, short bpm);
+
+/**
+ * \fn int audiod_loop(audiod_client_t *client, music_t *music, long long tickStart, long long tickEnd)
+ * \brief Joue un morceau de la musique en boucle (calculé une seule fois)
+ * \param client Le client
+ * \param music La musique
+ * \param tickStart Le début de la boucle en doubles croches
+ * \param tickEnd La fin de la boucle (tickEnd <= tickStart arrête la boucle)
+ * \return 0 si succès, -1 si la boucle n'a pas pu être calculée
+ */
+int audiod_loop(audiod_client_t *client, music_t *music, long long tickStart, long long tickEnd);
+
+/**
+ * \fn audio_stats_t *audiod_stats(audiod_client_t *client)
+ * \brief Statistiques du moteur utilisé (celui du démon ou le moteur local)
+ * \param client Le client
+ * \return Les statistiques audio
+ */
+audio_stats_t *audiod_stats(audiod_client_t *client);
+
+/**
+ * \fn void audiod_save_stats(audiod_client_t *client)
+ * \brief Sauvegarde les statistiques de la dernière lecture du moteur local
+ * \param client Le client
+ * \note Le démon sauvegarde lui-même ses statistiques à la fin de chaque lecture
+ */
+void audiod_save_stats(audiod_client_t *client);
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * \file audiostats.h
+ * \brief Instrumentation temps réel des threads audio
+ * \details Mesure du temps de rendu par rapport au budget de chaque période,
+ * suivi du délai du flux ALSA et comptage des xruns
+ */
+#ifndef AUDIO_STATS_H
+#define AUDIO_STATS_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define AUDIO_STATS_BUCKETS 11 /*!< Nombre de cases de l'histogramme (10 tranches de 10% + dépassement) */
+#define AUDIO_STATS_BUCKET_WIDTH 100 /*!< Largeur d'une case de l'histogramme en pour mille du budget */
+#define AUDIO_STATS_FILE "ressources/audiostats.log" /*!< Fichier dans lequel les statistiques sont exportées */
+#define NSEC_PER_SEC 1000000000LL /*!< Nombre de nanosecondes dans une seconde */
+#define AUDIO_STATS_QUALITY_EVENTS 16 /*!< Nombre de changements de qualité mémorisés */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct audio_quality_event_t
+ * \brief Changement de niveau de qualité décidé par le régulateur de charge
+ */
+typedef struct {
+    unsigned long period; /*!< Période à laquelle le changement a eu lieu */
+    int from; /*!< Niveau précédent (sound_quality_t) */
+    int to; /*!< Nouveau niveau */
+    int load; /*!< Charge de la période qui a déclenché le changement (pour mille) */
+} audio_quality_event_t;
+
+/**
+ * \struct audio_stats_t
+ * \brief Statistiques d'exécution des threads audio
+ * \details La charge d'une période est le rapport entre le temps de rendu et la durée
+ * de la période (le budget). Elle est exprimée en pour mille.
+ */
+typedef struct {
+    pthread_mutex_t lock; /*!< Verrou (plusieurs threads audio peuvent écrire) */
+    unsigned long periods; /*!< Nombre de périodes mesurées */
+    unsigned long histogram[AUDIO_STATS_BUCKETS]; /*!< Répartition de la charge par tranche de 10% */
+    unsigned long xruns; /*!< Nombre d'xruns (underruns) rencontrés */
+    unsigned long recovered; /*!< Nombre d'xruns récupérés avec snd_pcm_recover */
+    unsigned long failures; /*!< Nombre d'erreurs non récupérables */
+    long long renderNs; /*!< Temps de rendu cumulé en nanosecondes */
+    long long budgetNs; /*!< Budget cumulé en nanosecondes */
+    int lastLoad; /*!< Charge de la dernière période (pour mille) */
+    int maxLoad; /*!< Charge maximale observée (pour mille) */
+    long lastDelay; /*!< Dernier délai du flux (snd_pcm_delay) en échantillons */
+    long minDelay; /*!< Délai minimal observé en échantillons */
+    long maxDelay; /*!< Délai maximal observé en échantillons */
+    int quality; /*!< Niveau de qualité courant du rendu */
+    unsigned long qualityChanges; /*!< Nombre de changements de qualité */
+    audio_quality_event_t qualityEvents[AUDIO_STATS_QUALITY_EVENTS]; /*!< Derniers changements (tampon circulaire) */
+    unsigned long lateJobs; /*!< Voix que les workers n'ont pas finies à l'échéance (recalculées par le thread de mixage) */
+} audio_stats_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_audio_stats(audio_stats_t *stats)
+ * \brief Initialise (ou remet à zéro) les statistiques audio
+ * \param stats Les statistiques à initialiser
+ */
+void init_audio_stats(audio_stats_t *stats);
+
+/**
+ * \fn void reset_audio_stats(audio_stats_t *stats)
+ * \brief Remet les compteurs à zéro sans recréer le verrou
+ * \param stats Les statistiques initialisées avec init_audio_stats
+ */
+void reset_audio_stats(audio_stats_t *stats);
+
+/**
+ * \fn void destroy_audio_stats(audio_stats_t *stats)
+ * \brief Libère les ressources des statistiques audio
+ * \param stats Les statistiques à détruire
+ */
+void destroy_audio_stats(audio_stats_t *stats);
+
+/**
+ * \fn long long audio_clock_ns()
+ * \brief Horloge monotone en nanosecondes utilisée pour les mesures
+ * \return Le temps courant en nanosecondes
+ */
+long long audio_clock_ns();
+
+/**
+ * \fn void record_audio_period(audio_stats_t *stats, long long renderNs, long long budgetNs, long delay)
+ * \brief Enregistre la mesure d'une période
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param renderNs Le temps passé à calculer la période
+ * \param budgetNs La durée de la période (temps disponible pour la calculer)
+ * \param delay Le délai du flux après écriture (-1 si inconnu)
+ */
+void record_audio_period(audio_stats_t *stats, long long renderNs, long long budgetNs, long delay);
+
+/**
+ * \fn void record_audio_xrun(audio_stats_t *stats, int recovered)
+ * \brief Enregistre un xrun
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param recovered 1 si snd_pcm_recover a réussi, 0 sinon
+ */
+void record_audio_xrun(audio_stats_t *stats, int recovered);
+
+/**
+ * \fn void record_audio_quality(audio_stats_t *stats, int from, int to, int load)
+ * \brief Enregistre un changement de niveau de qualité du rendu
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param from Le niveau précédent
+ * \param to Le nouveau niveau
+ * \param load La charge de la période qui a déclenché le changement (pour mille)
+ * \note Le journal est écrit avec les statistiques (dump_audio_stats), jamais depuis le thread audio
+ */
+void record_audio_quality(audio_stats_t *stats, int from, int to, int load);
+
+/**
+ * \fn void record_audio_late_jobs(audio_stats_t *stats, int count)
+ * \brief Enregistre des voix recalculées par le thread de mixage faute d'être prêtes à l'échéance
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param count Le nombre de voix en retard dans la période
+ */
+void record_audio_late_jobs(audio_stats_t *stats, int count);
+
+/**
+ * \fn void dump_audio_stats(audio_stats_t *stats, FILE *file)
+ * \brief Écrit les statistiques dans un fichier
+ * \param stats Les statistiques à écrire
+ * \param file Le fichier de sortie
+ * \note Le format est de la forme <clé>=<valeur>, une valeur par ligne
+ */
+void dump_audio_stats(audio_stats_t *stats, FILE *file);
+
+/**
+ * \fn void save_audio_stats(audio_stats_t *stats)
+ * \brief Ajoute les statistiques à la fin du fichier AUDIO_STATS_FILE
+ * \param stats Les statistiques à sauvegarder
+ */
+void save_audio_stats(audio_stats_t *stats);
+
+/**
+ * \fn void audio_stats2str(audio_stats_t *stats, char *str, int line)
+ * \brief Convertit une ligne du résumé des statistiques en chaine de caractère
+ * \param stats Les statistiques
+ * \param str La chaine qui va contenir la ligne (au moins 64 caractères)
+ * \param line La ligne du résumé à produire (0 à 3)
+ * \note Utilisé par l'overlay du séquenceur
+ */
+void audio_stats2str(audio_stats_t *stats, char *str, int line);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * \file detmath.h
+ * \brief Calcul en virgule fixe du rendu déterministe
+ * \details Le sinus et la tangente hyperbolique viennent de tables remplies une fois par
+ * des séries entières évaluées en entiers 64 bits : aucune fonction transcendante de la libm
+ * n'intervient et les tables sont identiques sur toutes les machines. Une note est une phase
+ * sur 32 bits qui avance d'un incrément entier par échantillon : l'échantillon n d'une note
+ * ne dépend que de n, pas de l'ordre de calcul des morceaux.
+ * Les seules opérations flottantes (calcul d'un incrément à partir d'une fréquence) sont des
+ * multiplications et divisions IEEE 754 arrondies au plus près, exactes à l'identique sur ARM
+ * comme sur x86 (SSE2).
+ */
+#ifndef DETMATH_H
+#define DETMATH_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include "sound.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define DETMATH_ONE 32768 /*!< 1.0 en Q15 (valeurs des tables) */
+#define DETMATH_SINE_BITS 10 /*!< Taille de la table du sinus : 2^DETMATH_SINE_BITS points par période */
+#define DETMATH_TANH_SIZE 32769 /*!< Table du fuzz : une entrée par valeur absolue d'échantillon */
+#define DETMATH_FUZZ_GAIN 4 /*!< Gain avant saturation du fuzz */
+#define DETMATH_FNV_OFFSET 0xcbf29ce484222325ULL /*!< Base de l'empreinte FNV-1a 64 bits */
+#define DETMATH_FNV_PRIME 0x100000001b3ULL /*!< Multiplicateur de l'empreinte FNV-1a 64 bits */
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_detmath()
+ * \brief Remplit les tables (une seule fois, quel que soit le nombre d'appels et de threads)
+ */
+void init_detmath();
+
+/**
+ * \fn unsigned int det_phase(double cycles)
+ * \brief Convertit une fraction de période en phase sur 32 bits
+ * \param cycles Le nombre de périodes (seule la partie fractionnaire est gardée)
+ * \return La phase en 1/2^32 de période
+ * \note det_phase(freq / SAMPLE_RATE) est l'incrément par échantillon d'une note
+ */
+unsigned int det_phase(double cycles);
+
+/**
+ * \fn int det_sin(unsigned int phase)
+ * \brief Sinus d'une phase (table interpolée linéairement)
+ * \param phase La phase en 1/2^32 de période
+ * \return Le sinus en Q15 (entre -DETMATH_ONE et DETMATH_ONE)
+ * \warning init_detmath doit avoir été appelé
+ */
+int det_sin(unsigned int phase);
+
+/**
+ * \fn int det_fuzz(int sample)
+ * \brief Distorsion du fuzz : BASE_AMPLITUDE * tanh(DETMATH_FUZZ_GAIN * sample / BASE_AMPLITUDE)
+ * \param sample L'échantillon (short)
+ * \return L'échantillon distordu
+ * \warning init_detmath doit avoir été appelé
+ */
+int det_fuzz(int sample);
+
+/**
+ * \fn unsigned long long det_hash(const short *buffer, size_t frames)
+ * \brief Empreinte FNV-1a 64 bits des échantillons (petit boutiste, indépendante de la machine)
+ * \param buffer Les échantillons
+ * \param frames Le nombre d'échantillons
+ * \return L'empreinte
+ * \note Deux rendus déterministes de la même musique ont la même empreinte sur toutes les
+ * machines : elle peut servir de clé à un cache de rendus partagé
+ */
+unsigned long long det_hash(const short *buffer, size_t frames);
+
+#endif
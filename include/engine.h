@@ -0,0 +1,311 @@
+/**
+ * \file engine.h
+ * \brief Moteur audio : mixage des channels sur un flux unique
+ * \details Un seul thread de mixage calcule toutes les voix période par période
+ * et les écrit dans un seul flux ALSA. Les voix d'une période sont calculées en parallèle
+ * par un pool de workers (voir workers.h) : le thread de mixage découpe la période, publie
+ * une tâche par voix, puis additionne les voix dans l'ordre des channels. Le transport compte les échantillons écrits :
+ * toutes les voix, la tête de lecture de l'interface et les effets du capteur sont
+ * calés sur cette horloge commune.
+ */
+#ifndef ENGINE_H
+#define ENGINE_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "note.h"
+#include "sound.h"
+#include "audiostats.h"
+#include "render.h"
+#include "stepper.h"
+#include "governor.h"
+#include "workers.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define ENGINE_PERIOD_FRAMES 240 /*!< Nombre d'échantillons calculés à chaque période (5 ms) */
+#define ENGINE_PERIODS 3 /*!< Nombre de périodes dans le tampon ALSA */
+#define ENGINE_MARKS 8 /*!< Nombre de périodes mémorisées pour retrouver la position audible */
+#define ENGINE_NO_LINE -1 /*!< Pas de ligne jouée */
+#define ENGINE_NO_TICK -1 /*!< Pas de position musicale audible */
+#define ENGINE_AUDITION_MAX_FRAMES (SAMPLE_RATE / 2) /*!< Durée maximale d'une note écoutée pendant l'édition */
+#define ENGINE_CLICK_FRAMES (SAMPLE_RATE / 50) /*!< Durée d'un clic du métronome (20 ms) */
+#define ENGINE_CLICK_FREQ 1000.0 /*!< Fréquence du clic d'un temps */
+#define ENGINE_CLICK_ACCENT_FREQ 1500.0 /*!< Fréquence du clic du premier temps de la mesure */
+#define ENGINE_CLICK_BEAT_PHASE (TIME_NOIRE * SOUND_TICK_PHASE) /*!< Phase d'un temps */
+#define ENGINE_CLICK_BEATS_PER_BAR (TIME_RONDE / TIME_NOIRE) /*!< Nombre de temps dans une mesure */
+#ifndef ENGINE_WORKERS
+#define ENGINE_WORKERS 3 /*!< Workers qui calculent les voix avec le thread de mixage (0 : calcul sur le seul thread de mixage) */
+#endif
+#define ENGINE_JOB_DEADLINE 600 /*!< Échéance des voix calculées par les workers (pour mille de la période) */
+#define ENGINE_VOICE_SEGMENTS 4 /*!< Morceaux de notes d'une voix dans une période (une note dure au moins 2400 échantillons à MUSIC_MAX_BPM) */
+#ifndef ENGINE_RESAMPLE_QUALITY
+#define ENGINE_RESAMPLE_QUALITY RESAMPLE_SINC_FAST /*!< Conversion de la sortie si le périphérique refuse SAMPLE_RATE */
+#endif
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct voice_t
+ * \brief Voix associée à un channel de la musique
+ * \details Les bornes de la note sont des positions musicales cumulées : la note se termine
+ * quand la phase du transport atteint tickEnd. Sa durée en échantillons n'est jamais
+ * calculée à l'avance, elle dépend du tempo au moment où elle est jouée.
+ */
+typedef struct {
+    int active; /*!< Il reste des notes à jouer sur la voix */
+    int index; /*!< Indice de la note jouée dans le channel */
+    long long tickStart; /*!< Position musicale du début de la note (en doubles croches) */
+    long long tickEnd; /*!< Position musicale de la fin de la note (en doubles croches) */
+    long long offset; /*!< Nombre d'échantillons de la note déjà calculés */
+    long long frames; /*!< Durée en échantillons (voix d'écoute uniquement) */
+    note_t note; /*!< Note jouée */
+    short effect; /*!< Effet appliqué à la note (lu au début de la note) */
+    int start; /*!< Aucun morceau de la note n'est encore calculé (note_on des plugins) */
+    plugin_voices_t plugins; /*!< Voix des plugins : note jouée et fin de la note précédente */
+} voice_t;
+
+/**
+ * \struct voice_segment_t
+ * \brief Morceau de note d'une voix à calculer dans la période
+ */
+typedef struct {
+    note_t note; /*!< Note jouée */
+    long long offset; /*!< Position du premier échantillon depuis le début de la note */
+    short effect; /*!< Effet appliqué à la note */
+    int start; /*!< Premier morceau calculé de la note */
+    int pos; /*!< Indice dans la période du premier échantillon */
+    int frames; /*!< Nombre d'échantillons */
+} voice_segment_t;
+
+/**
+ * \struct voice_job_t
+ * \brief Tâche de calcul d'une voix sur une période
+ * \details Le thread de mixage remplit les morceaux en découpant la période : la tâche ne
+ * lit ni les voix ni la musique et peut être calculée par n'importe quel thread. Elle
+ * travaille sur une copie des voix des plugins, rendue à la voix quand elle est terminée
+ * à temps : une tâche en retard ne modifie pas l'état que le thread de mixage reprend
+ */
+typedef struct {
+    voice_segment_t segments[ENGINE_VOICE_SEGMENTS]; /*!< Morceaux de la voix, dans l'ordre */
+    int nbSegments; /*!< Nombre de morceaux */
+    plugin_voices_t plugins; /*!< Copie des voix des plugins du channel */
+    sound_quality_t quality; /*!< Qualité du rendu de la période */
+    short buffer[ENGINE_PERIOD_FRAMES]; /*!< Voix calculée (seuls les échantillons des morceaux sont écrits) */
+} voice_job_t;
+
+/**
+ * \struct engine_mark_t
+ * \brief Position musicale d'une période calculée
+ */
+typedef struct {
+    long long frame; /*!< Position du transport du début de la période */
+    long long phase; /*!< Phase au début de la période */
+    long long endPhase; /*!< Phase à la fin de la période */
+} engine_mark_t;
+
+/**
+ * \struct engine_t
+ * \brief Moteur audio
+ * \details Le transport compte les échantillons. La position musicale est une phase en
+ * 1/SOUND_TICK_PHASE de double croche qui avance de bpm à chaque échantillon : un
+ * changement de tempo ne modifie que la vitesse de la phase, rien n'est recalculé.
+ */
+typedef struct {
+    snd_pcm_t *pcm; /*!< Flux de sortie unique */
+    unsigned int deviceRate; /*!< Fréquence du flux (SAMPLE_RATE si le périphérique l'accepte) */
+    resampler_t resampler; /*!< Conversion des périodes à la fréquence du flux */
+    short *deviceBuffer; /*!< Période convertie (NULL si le flux est à SAMPLE_RATE) */
+    governor_t governor; /*!< Régulateur de la qualité du rendu selon la charge du thread de mixage */
+    worker_pool_t workers; /*!< Workers qui calculent les voix de chaque période */
+    job_t jobs[MUSIC_MAX_CHANNELS]; /*!< Tâches de la période (une par voix active) */
+    voice_job_t voiceJobs[MUSIC_MAX_CHANNELS]; /*!< Morceaux et résultat de chaque voix */
+    pthread_t thread; /*!< Thread de mixage */
+    pthread_mutex_t lock; /*!< Protège les voix pendant le calcul d'une période */
+    audio_stats_t *stats; /*!< Statistiques audio (peut être NULL) */
+    stepper_t *stepper; /*!< Moteur pas à pas qui joue les notes INSTRUMENT_STEPMOTOR (peut être NULL) */
+    music_t *music; /*!< Musique jouée */
+    voice_t voices[MUSIC_MAX_CHANNELS]; /*!< Une voix par channel */
+    voice_t audition; /*!< Voix d'écoute des notes modifiées dans le séquenceur */
+    long long transport; /*!< Transport : nombre d'échantillons calculés depuis l'ouverture */
+    long long playhead; /*!< Position du transport sortie du haut-parleur (transport moins délai du flux) */
+    long long phase; /*!< Position musicale du prochain échantillon à calculer */
+    long long playTick; /*!< Position musicale sortie du haut-parleur (ENGINE_NO_TICK si aucune) */
+    engine_mark_t marks[ENGINE_MARKS]; /*!< Dernières périodes jouées */
+    int nbMarks; /*!< Nombre de périodes mémorisées depuis le début de la lecture */
+    int tempoIndex; /*!< Prochain changement de tempo de la musique */
+    short bpm; /*!< Tempo courant (changements de tempo et décalage en direct compris) */
+    int nudge; /*!< Décalage de tempo demandé en direct pendant la lecture */
+    long long songEnd; /*!< Position du transport à la fin de la dernière note */
+    long long seekStart; /*!< Position du transport à laquelle la lecture a commencé */
+    int running; /*!< Le thread de mixage tourne */
+    int playing; /*!< Une musique est en cours de lecture */
+    short effect; /*!< Effet demandé par le capteur, appliqué à la prochaine note */
+    int metronome; /*!< Le métronome est activé */
+    long long nextBeat; /*!< Phase du prochain temps de la musique */
+    long long clickFrame; /*!< Position du transport du dernier clic */
+    int clickAccent; /*!< Le dernier clic est celui du premier temps de la mesure */
+    short clicks[2][ENGINE_CLICK_FRAMES]; /*!< Clics pré-calculés (temps, premier temps de la mesure) */
+    short *loopBuffer; /*!< Boucle pré-calculée jouée en continu (NULL si aucune) */
+    long long loopFrames; /*!< Nombre d'échantillons de la boucle */
+    long long loopStart; /*!< Position du transport du début de la boucle */
+    int mix[ENGINE_PERIOD_FRAMES]; /*!< Accumulateur de mixage */
+    short voiceBuffer[ENGINE_PERIOD_FRAMES]; /*!< Buffer de calcul d'une voix */
+    short buffer[ENGINE_PERIOD_FRAMES]; /*!< Période prête à être écrite */
+} engine_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_engine(engine_t *engine, audio_stats_t *stats)
+ * \brief Ouvre le flux et démarre le thread de mixage
+ * \param engine Le moteur à initialiser
+ * \param stats Les statistiques audio à remplir (peut être NULL)
+ * \return 0 si le moteur est démarré, -1 si le flux n'a pas pu être ouvert
+ * \note Si le périphérique refuse SAMPLE_RATE, le flux est ouvert à la fréquence la plus
+ * proche et chaque période est convertie (ENGINE_RESAMPLE_QUALITY) : le transport et
+ * toutes les voix restent à SAMPLE_RATE. La qualité du rendu baisse quand le calcul des
+ * périodes approche de leur durée (voir governor.h). ENGINE_WORKERS workers temps réel
+ * (au plus un par cœur libre) calculent les voix avec le thread de mixage ; une voix qu'ils n'ont pas finie à
+ * ENGINE_JOB_DEADLINE de la période est recalculée par le thread de mixage
+ */
+int init_engine(engine_t *engine, audio_stats_t *stats);
+
+/**
+ * \fn void end_engine(engine_t *engine)
+ * \brief Arrête le thread de mixage et ferme le flux
+ * \param engine Le moteur à arrêter
+ */
+void end_engine(engine_t *engine);
+
+/**
+ * \fn void engine_play(engine_t *engine, music_t *music, long long tick)
+ * \brief Lance la lecture d'une musique à partir d'une position musicale
+ * \param engine Le moteur
+ * \param music La musique à jouer
+ * \param tick La position de départ en doubles croches (0 pour le début)
+ * \note La lecture commence à la prochaine période. La note en cours de chaque channel
+ * est retrouvée en O(log n) et jouée à partir de son milieu : tous les channels
+ * restent calés sur le même échantillon
+ */
+void engine_play(engine_t *engine, music_t *music, long long tick);
+
+/**
+ * \fn void engine_stop(engine_t *engine)
+ * \brief Arrête la lecture en cours
+ * \param engine Le moteur
+ */
+void engine_stop(engine_t *engine);
+
+/**
+ * \fn int engine_is_playing(engine_t *engine)
+ * \brief Indique si la musique est encore audible
+ * \param engine Le moteur
+ * \return 1 tant que la dernière note n'est pas sortie du haut-parleur
+ */
+int engine_is_playing(engine_t *engine);
+
+/**
+ * \fn long long engine_playhead(engine_t *engine)
+ * \brief Position du transport actuellement audible
+ * \param engine Le moteur
+ * \return Le nombre d'échantillons sortis du haut-parleur depuis l'ouverture
+ * \note C'est le transport moins le délai du flux (snd_pcm_delay)
+ */
+long long engine_playhead(engine_t *engine);
+
+/**
+ * \fn long long engine_playtick(engine_t *engine)
+ * \brief Position musicale actuellement audible
+ * \param engine Le moteur
+ * \return La position en doubles croches ou ENGINE_NO_TICK avant le début de la lecture
+ */
+long long engine_playtick(engine_t *engine);
+
+/**
+ * \fn int engine_line(engine_t *engine, int channelId)
+ * \brief Ligne d'un channel actuellement audible
+ * \param engine Le moteur
+ * \param channelId L'identifiant du channel
+ * \return La ligne jouée ou ENGINE_NO_LINE
+ */
+int engine_line(engine_t *engine, int channelId);
+
+/**
+ * \fn short engine_bpm(engine_t *engine)
+ * \brief Tempo courant de la lecture
+ * \param engine Le moteur
+ * \return Le bpm (changements de tempo de la musique et décalage en direct compris)
+ */
+short engine_bpm(engine_t *engine);
+
+/**
+ * \fn void engine_nudge(engine_t *engine, int delta)
+ * \brief Décale le tempo en direct pendant la lecture
+ * \param engine Le moteur
+ * \param delta Le décalage à ajouter en bpm
+ * \note Le décalage s'applique à partir de la prochaine période et n'est pas enregistré
+ * dans la musique. Il est remis à zéro à chaque lecture.
+ */
+void engine_nudge(engine_t *engine, int delta);
+
+/**
+ * \fn void engine_audition(engine_t *engine, note_t note, short bpm)
+ * \brief Fait entendre une note sur la voix d'écoute
+ * \param engine Le moteur
+ * \param note La note à écouter (une non note coupe la voix d'écoute)
+ * \param bpm Le bpm de la musique pour la durée de la note
+ * \note La note démarre à la prochaine période calculée, sans ouvrir de flux ni créer de thread.
+ * Elle remplace la note écoutée précédemment et dure au plus ENGINE_AUDITION_MAX_FRAMES.
+ */
+void engine_audition(engine_t *engine, note_t note, short bpm);
+
+/**
+ * \fn short *engine_loop(engine_t *engine, short *buffer, long long frames)
+ * \brief Joue un buffer en boucle indéfiniment
+ * \param engine Le moteur
+ * \param buffer Le buffer à jouer (NULL pour arrêter la boucle)
+ * \param frames Le nombre d'échantillons du buffer
+ * \return Le buffer joué précédemment, que l'appelant peut libérer
+ * \note Si une boucle est déjà jouée, le nouveau buffer la remplace à la même position
+ * (modulo sa nouvelle longueur) : une boucle modifiée continue sans coupure
+ */
+short *engine_loop(engine_t *engine, short *buffer, long long frames);
+
+/**
+ * \fn void engine_set_stepper(engine_t *engine, stepper_t *stepper)
+ * \brief Branche le moteur pas à pas sur le transport
+ * \param engine Le moteur
+ * \param stepper Le moteur pas à pas démarré avec init_stepper (NULL pour le débrancher)
+ * \note Le moteur pas à pas est monophonique : il joue la note INSTRUMENT_STEPMOTOR
+ * du premier channel qui en a une
+ */
+void engine_set_stepper(engine_t *engine, stepper_t *stepper);
+
+/**
+ * \fn void engine_set_metronome(engine_t *engine, int enabled)
+ * \brief Active ou coupe le métronome
+ * \param engine Le moteur
+ * \param enabled 1 pour entendre un clic à chaque temps de la musique jouée
+ * \note Peut être appelé pendant la lecture : le prochain temps est cliqué ou non
+ */
+void engine_set_metronome(engine_t *engine, int enabled);
+
+/**
+ * \fn void engine_set_effect(engine_t *engine, short effect)
+ * \brief Change l'effet appliqué aux prochaines notes
+ * \param engine Le moteur
+ * \param effect L'effet (0 : aucun, 1 : fuzz, 2 : compression)
+ */
+void engine_set_effect(engine_t *engine, short effect);
+
+#endif
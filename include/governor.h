@@ -0,0 +1,73 @@
+/**
+ * \file governor.h
+ * \brief Régulation de la qualité du rendu en fonction de la charge
+ * \details Le thread de mixage donne au régulateur le temps de calcul de chaque période.
+ * Quand la charge lissée approche du budget (ou qu'une période le dépasse), la qualité baisse
+ * d'un niveau : partiels les plus faibles supprimés, puis interpolation linéaire en sortie,
+ * puis effets coupés. L'interpolation linéaire n'allège que la conversion de fréquence : sans
+ * conversion, ce niveau est sauté. Elle remonte d'un niveau après une longue période de marge. Une
+ * rechute juste après une remontée double le temps d'attente de la remontée suivante, pour
+ * ne pas osciller entre deux niveaux.
+ */
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <string.h>
+#include "sound.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define GOVERNOR_HIGH_LOAD 700 /*!< Charge lissée (pour mille du budget) à partir de laquelle la qualité baisse */
+#define GOVERNOR_LOW_LOAD 350 /*!< Charge lissée en dessous de laquelle la qualité peut remonter */
+#define GOVERNOR_SMOOTHING 8 /*!< Lissage exponentiel de la charge (poids 1/GOVERNOR_SMOOTHING) */
+#define GOVERNOR_DOWN_PERIODS 4 /*!< Périodes consécutives au-dessus du seuil avant de baisser */
+#define GOVERNOR_UP_PERIODS 400 /*!< Périodes consécutives sous le seuil avant de remonter (2 s) */
+#define GOVERNOR_MAX_UP_PERIODS 12800 /*!< Attente maximale avant de remonter (64 s) */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct governor_t
+ * \brief État du régulateur
+ */
+typedef struct {
+    sound_quality_t quality; /*!< Qualité courante */
+    int load; /*!< Charge lissée en pour mille du budget */
+    int lastLoad; /*!< Charge de la dernière période */
+    int over; /*!< Périodes consécutives au-dessus de GOVERNOR_HIGH_LOAD */
+    int under; /*!< Périodes consécutives sous GOVERNOR_LOW_LOAD */
+    int upPeriods; /*!< Attente actuelle avant de remonter */
+    long long sinceUp; /*!< Périodes depuis la dernière remontée (-1 si aucune) */
+    int stable; /*!< Périodes depuis le dernier changement de qualité */
+    int resampling; /*!< Le flux de sortie est converti (sinon SOUND_QUALITY_LINEAR est sauté) */
+} governor_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_governor(governor_t *governor, int resampling)
+ * \brief Initialise le régulateur à la qualité maximale
+ * \param governor Le régulateur
+ * \param resampling 1 si le flux de sortie est converti à la fréquence du périphérique
+ */
+void init_governor(governor_t *governor, int resampling);
+
+/**
+ * \fn int update_governor(governor_t *governor, long long renderNs, long long budgetNs)
+ * \brief Prend en compte le temps de calcul d'une période
+ * \param governor Le régulateur
+ * \param renderNs Le temps passé à calculer la période
+ * \param budgetNs La durée de la période
+ * \return 1 si la qualité a changé, 0 sinon
+ */
+int update_governor(governor_t *governor, long long renderNs, long long budgetNs);
+
+#endif
@@ -15,6 +15,8 @@
 #include "request.h"
 #include "mysyscall.h"
 #include "sound.h"
+#include "audiod.h"
+#include "journal.h"
 #include <time.h>   
 
 #define RPI_COLS 106 /*!< Nombre de colonnes de la fenêtre sur le RPI */
@@ -26,6 +28,9 @@
 
 #define NAVIGATION_MODE 0 /*!< Mode de navigation */
 #define EDIT_MODE 1       /*!< Mode d'édition */
+#define SEQUENCER_PLAY_POLL_TIME 20000 /*!< Période de rafraîchissement de la tête de lecture en microsecondes */
+#define SEQUENCER_NO_LOOP -1 /*!< Borne de boucle non définie */
+#define SEQUENCER_NO_BLOCK -1 /*!< Borne de bloc non définie */
 // X : Colonne Y : Ligne
 
 // Constantes pour le l'entête d'information du séquenceur
@@ -44,10 +49,10 @@
 #define SEQUENCER_BODY_LINES 24 /*!< Largeur du body */
 #define SEQUENCER_BODY_COLS 106 /*!< Hauteur du body */
 
-#define SEQUENCER_CH1_X0 7    /*!< Position X du channel 1 */
-#define SEQUENCER_CH2_X0 37   /*!< Position X du channel 2 */
-#define SEQUENCER_CH3_X0 67   /*!< Position X du channel 3 */
-#define SEQUENCER_CH_Y0 7     /*!< Position Y du channel 1, 2 et 3 */
+#define SEQUENCER_CH_X0 7     /*!< Position X du premier channel affiché */
+#define SEQUENCER_CH_STRIDE 30 /*!< Écart en X entre deux channels affichés */
+#define SEQUENCER_CH_VISIBLE 3 /*!< Nombre de channels affichés (la vue défile horizontalement au delà) */
+#define SEQUENCER_CH_Y0 7     /*!< Position Y des channels affichés */
 #define SEQUENCER_CH_LINES 22 /*!< Largeur des channels */
 #define SEQUENCER_CH_COLS 26  /*!< Hauteur des channels */
 
@@ -57,6 +62,24 @@
 #define KEY_BUTTON_CH1NSAVE 'z'
 #define KEY_BUTTON_LINEDOWN 'c'
 #define KEY_BUTTON_LINEUP 'v'
+#define KEY_BUTTON_STATS 'i' /*!< Affiche/masque l'overlay des statistiques audio */
+#define KEY_BUTTON_LOOPMARK 'l' /*!< Marque le début puis la fin de la boucle, puis l'efface */
+#define KEY_BUTTON_LOOPPLAY 'o' /*!< Lance/arrête la lecture de la boucle */
+#define KEY_BUTTON_PLAYCURSOR 'p' /*!< Joue la musique à partir de la ligne sélectionnée */
+#define KEY_BUTTON_TEMPOMARK 'b' /*!< Ajoute/supprime un changement de tempo sur la ligne sélectionnée */
+#define KEY_BUTTON_TEMPOUP '+' /*!< Augmente le tempo (à la ligne sélectionnée, ou en direct pendant la lecture) */
+#define KEY_BUTTON_TEMPODOWN '-' /*!< Diminue le tempo (à la ligne sélectionnée, ou en direct pendant la lecture) */
+#define KEY_BUTTON_METRONOME 'm' /*!< Active/coupe le métronome (aussi pendant la lecture) */
+#define KEY_BUTTON_CLEARLINE 'x' /*!< Vide la ligne sélectionnée */
+#define KEY_BUTTON_UNDO 'u' /*!< Annule la dernière modification des notes */
+#define KEY_BUTTON_REDO 'y' /*!< Rétablit la dernière modification annulée */
+#define KEY_BUTTON_ADDCHANNEL 'n' /*!< Ajoute un channel vide à la fin de la musique */
+#define KEY_BUTTON_DELCHANNEL 'd' /*!< Retire le dernier channel de la musique s'il est vide */
+#define KEY_BUTTON_BLOCKMARK 'k' /*!< Marque le début puis la fin du bloc de lignes, puis l'efface */
+#define KEY_BUTTON_COPY 'w' /*!< Copie le bloc de lignes dans le presse-papier */
+#define KEY_BUTTON_PASTE 'g' /*!< Colle le presse-papier à partir de la ligne sélectionnée */
+#define KEY_BUTTON_INSERTLINES 'a' /*!< Insère une ligne vide (ou autant que le bloc sélectionné) en décalant les suivantes */
+#define KEY_BUTTON_DELETELINES 's' /*!< Supprime la ligne (ou le bloc) sélectionnée en remontant les suivantes */
 
 
 
@@ -149,21 +172,19 @@ typedef struct
     sequencer_nav_ch_t ch;            /*!< Channel */
     int start[SEQUENCER_NAV_CH_MAX]; /*!< Position de départ [col] */
     int lines[SEQUENCER_NAV_CH_MAX];   /*!< Ligne [ch] */
+    int first;                       /*!< Premier channel affiché (défilement horizontal) */
     //int line;
     int playMode;                    /*!< Mode de lecture */
+    sequencer_nav_ch_t loopCh;       /*!< Channel sur lequel la boucle a été marquée */
+    int loopStart;                   /*!< Première ligne de la boucle (SEQUENCER_NO_LOOP si aucune) */
+    int loopEnd;                     /*!< Dernière ligne de la boucle (SEQUENCER_NO_LOOP si non marquée) */
+    sequencer_nav_ch_t blockCh;      /*!< Channel sur lequel le bloc de lignes a été marqué */
+    int blockStart;                  /*!< Première ligne du bloc (SEQUENCER_NO_BLOCK si aucun) */
+    int blockEnd;                    /*!< Dernière ligne du bloc (SEQUENCER_NO_BLOCK si non marquée) */
+    int metronome;                   /*!< Le métronome est activé */
 } sequencer_nav_t;
 
 
-// void *args[] = {&syncSem, &finishSem, &seqNav, music, i};
-typedef struct {
-    sem_t *showSem;
-    sem_t *syncSem;
-    sem_t *finishSem;
-    sequencer_nav_t *seqNav;
-    music_t *music;
-    int channel;
-} channel_thread_args_t;
-
 /**
  * \fn void init_ncurses()
  * \brief Initialisation de ncurses et de la fenêtre
@@ -249,18 +270,53 @@ void sequencer_nav_up(sequencer_nav_t *nav, int channelId);
 void sequencer_nav_down(sequencer_nav_t *nav, int channelId);
 
 /**
- * @fn void sequencer_nav_left(sequencer_nav_t *nav)
+ * @fn void sequencer_nav_left(sequencer_nav_t *nav, int nbChannels)
  * @brief La fonction qui permet de passer d'une colonne à une autre dans le séquenceur (vers la gauche)
  * @param nav la structure de navigation
+ * @param nbChannels le nombre de channels de la musique
  */
-void sequencer_nav_left(sequencer_nav_t *nav);
+void sequencer_nav_left(sequencer_nav_t *nav, int nbChannels);
 
 /**
- * @fn void sequencer_nav_right(sequencer_nav_t *nav)
+ * @fn void sequencer_nav_right(sequencer_nav_t *nav, int nbChannels)
  * @brief La fonction qui permet de passer d'une colonne à une autre dans le séquenceur (vers la droite)
  * @param nav 
+ * @param nbChannels le nombre de channels de la musique
+ */
+void sequencer_nav_right(sequencer_nav_t *nav, int nbChannels);
+
+/**
+ * @fn void sequencer_nav_channel(sequencer_nav_t *nav, int channelId, int nbChannels)
+ * @brief Sélectionne un channel en gardant la ligne sélectionnée à la même hauteur
+ * @param nav la structure de navigation
+ * @param channelId le channel (ignoré s'il n'est pas dans la musique)
+ * @param nbChannels le nombre de channels de la musique
+ */
+void sequencer_nav_channel(sequencer_nav_t *nav, int channelId, int nbChannels);
+
+/**
+ * @fn void sequencer_nav_scroll(sequencer_nav_t *nav, int nbChannels)
+ * @brief Fait défiler les channels affichés pour que le channel sélectionné soit visible
+ * @param nav la structure de navigation
+ * @param nbChannels le nombre de channels de la musique
+ */
+void sequencer_nav_scroll(sequencer_nav_t *nav, int nbChannels);
+
+/**
+ * @fn void sequencer_nav_loop(sequencer_nav_t *nav)
+ * @brief Marque la ligne courante comme début ou fin de la boucle, ou efface la boucle
+ * @param nav la structure de navigation
+ * @note Le premier appui marque le début, le second la fin, le troisième efface la boucle
+ */
+void sequencer_nav_loop(sequencer_nav_t *nav);
+
+/**
+ * @fn void sequencer_nav_block(sequencer_nav_t *nav)
+ * @brief Marque la ligne courante comme début ou fin du bloc de lignes, ou efface le bloc
+ * @param nav la structure de navigation
+ * @note Le premier appui marque le début, le second la fin, le troisième efface le bloc
  */
-void sequencer_nav_right(sequencer_nav_t *nav);
+void sequencer_nav_block(sequencer_nav_t *nav);
 
 /**
  * @fn create_sequencer_nav()
@@ -288,24 +344,19 @@ choices_t show_sequencer(music_t *music, char *connected);
 int getchr_wiringpi();
 
 /**
- * @fn void play_music(music_t *music)
+ * @fn void play_music(WINDOW **channelWin, music_t *music, audiod_client_t *audio, long long tick, int first)
  * @brief Joue la musique et affiche les lignes jouées
+ * @param channelWin Les fenêtres des channels affichés
+ * @param music La musique à jouer
+ * @param audio Le moteur audio du séquenceur (déjà connecté avec audiod_connect)
+ * @param tick La position de départ en doubles croches (0 pour jouer depuis le début)
+ * @param first Le premier channel affiché (seuls les channels affichés sont suivis)
+ * @note Toutes les voix sont calculées par le moteur audio sur un seul flux (dans le démon
+ * piaudiod s'il tourne) : l'affichage suit la position du transport réellement sortie du haut-parleur
+ * @see audiod_client_t
  */
-void play_music(WINDOW **channelWin, music_t *music);
+void play_music(WINDOW **channelWin, music_t *music, audiod_client_t *audio, long long tick, int first);
 
-/**
- * @brief play_channel(void *channelId)
- * @brief Joue un channel et modifie le navigateur pour afficher la ligne jouée
- */
-void *play_channel(void *channelId);
-
-/**
- * @brief create_channel_thread_args(sem_t *syncSem, sem_t *finishSem, sequencer_nav_t *seqNav, music_t *music, int channel)
- * @brief Crée les arguments pour le thread de channel
- * @return channel_thread_args_t 
- * @note Les arguments doivent être libérés après utilisation
- */
-channel_thread_args_t *create_channel_thread_args(sem_t *showSem, sem_t *syncSem, sem_t *finishSem, sequencer_nav_t *seqNav, music_t *music, int channel);
 
 #endif // GRAPHIC_SEQ_H
 
@@ -0,0 +1,231 @@
+/**
+ * \file journal.h
+ * \brief Journal des modifications du séquenceur (annuler / rétablir)
+ * \details Chaque modification d'une ligne est gardée sous forme d'écart : le channel, la
+ * ligne, la note avant et la note après (16 octets). Les écarts d'une même action de
+ * l'utilisateur forment une transaction, annulée ou rétablie d'un bloc. Annuler ou rétablir
+ * ne touche que les lignes de la transaction, quelle que soit la longueur de la musique
+ * et de l'historique. Les écarts appliqués sont rendus à l'appelant : ils suffisent pour
+ * savoir quelles lignes sont à réenregistrer ou à recalculer. Une modification d'un bloc de
+ * lignes (copier, insérer, transposer...) garde le channel avant et après : les deux copies
+ * partagent sa table (share_channel), seuls les blocs de notes modifiés sont dupliqués et
+ * annuler remet le channel d'un coup, sans écart par ligne.
+ */
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdlib.h>
+#include <string.h>
+#include "note.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define JOURNAL_INITIAL_EDITS 64 /*!< Taille initiale du tableau des écarts (doublée quand il est plein) */
+#define JOURNAL_INITIAL_GROUPS 16 /*!< Taille initiale du tableau des transactions (doublée quand il est plein) */
+#define JOURNAL_INITIAL_BLOCKS 8 /*!< Taille initiale du tableau des états de channel (doublée quand il est plein) */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct journal_edit_t
+ * \brief Écart d'une ligne ou d'un bloc de lignes
+ */
+typedef struct {
+    int channel; /*!< Channel de la ligne */
+    int line; /*!< Ligne modifiée (première ligne modifiée pour un bloc) */
+    packed_note_t before; /*!< Note avant la modification */
+    packed_note_t after; /*!< Note après la modification */
+    int block; /*!< État du channel dans blocks pour un bloc de lignes, -1 pour une ligne */
+} journal_edit_t;
+
+/**
+ * \struct journal_block_t
+ * \brief Channel avant et après la modification d'un bloc de lignes
+ */
+typedef struct {
+    channel_t before; /*!< Copie du channel avant la modification */
+    channel_t after; /*!< Copie du channel après la modification */
+} journal_block_t;
+
+/**
+ * \struct journal_t
+ * \brief Historique des transactions
+ * \details Les transactions [0, cursor[ sont appliquées à la musique, les suivantes ont été
+ * annulées et peuvent être rétablies. Une nouvelle transaction efface celles qui suivent
+ * le curseur.
+ */
+typedef struct {
+    journal_edit_t *edits; /*!< Écarts de toutes les transactions, dans l'ordre */
+    int nbEdits; /*!< Nombre d'écarts */
+    int maxEdits; /*!< Taille du tableau des écarts */
+    int *groups; /*!< Premier écart de chaque transaction */
+    int nbGroups; /*!< Nombre de transactions */
+    int maxGroups; /*!< Taille du tableau des transactions */
+    journal_block_t *blocks; /*!< États de channel des écarts de blocs, dans l'ordre */
+    int nbBlocks; /*!< Nombre d'états */
+    int maxBlocks; /*!< Taille du tableau des états */
+    int cursor; /*!< Nombre de transactions appliquées */
+    int open; /*!< Une transaction est ouverte (journal_begin) */
+} journal_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_journal(journal_t *journal)
+ * \brief Initialise un journal vide
+ * \param journal Le journal
+ */
+void init_journal(journal_t *journal);
+
+/**
+ * \fn void free_journal(journal_t *journal)
+ * \brief Libère l'historique d'un journal
+ * \param journal Le journal (vide après l'appel)
+ */
+void free_journal(journal_t *journal);
+
+/**
+ * \fn void journal_begin(journal_t *journal)
+ * \brief Ouvre une transaction : les écarts suivants seront annulés ensemble
+ * \param journal Le journal
+ * \note Les transactions annulées sont oubliées dès qu'une ligne est modifiée
+ */
+void journal_begin(journal_t *journal);
+
+/**
+ * \fn void journal_commit(journal_t *journal)
+ * \brief Ferme la transaction ouverte (une transaction sans écart est oubliée)
+ * \param journal Le journal
+ */
+void journal_commit(journal_t *journal);
+
+/**
+ * \fn int journal_set_note(journal_t *journal, music_t *music, int channelId, int line, note_t note)
+ * \brief Modifie une ligne de la musique et garde l'écart dans la transaction ouverte
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne
+ * \param note La nouvelle note
+ * \return 1 si la ligne a changé, 0 si elle était déjà égale, -1 en cas d'erreur d'allocation
+ * (la ligne n'est alors pas modifiée)
+ * \note nbNotes et l'index des durées du channel sont mis à jour
+ * \warning Une transaction doit être ouverte (journal_begin)
+ */
+int journal_set_note(journal_t *journal, music_t *music, int channelId, int line, note_t note);
+
+/**
+ * \fn int journal_clear_line(journal_t *journal, music_t *music, int channelId, int line)
+ * \brief Vide une ligne (note d'un channel neuf) et garde l'écart dans la transaction ouverte
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne
+ * \return 1 si la ligne a changé, 0 si elle était déjà vide, -1 en cas d'erreur d'allocation
+ * \warning Une transaction doit être ouverte (journal_begin)
+ */
+int journal_clear_line(journal_t *journal, music_t *music, int channelId, int line);
+
+/**
+ * \fn int journal_copy_lines(journal_t *journal, music_t *music, int channelId, int line, const channel_t *src, int from, int count)
+ * \brief Copie des lignes d'un channel (un presse-papier par exemple) sur celles de la musique
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel écrit
+ * \param line La première ligne écrite
+ * \param src Le channel lu (qui n'est pas un channel de la musique)
+ * \param from La première ligne lue
+ * \param count Le nombre de lignes
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation (le channel n'est
+ * alors pas modifié)
+ * \warning Une transaction doit être ouverte (journal_begin)
+ */
+int journal_copy_lines(journal_t *journal, music_t *music, int channelId, int line, const channel_t *src, int from, int count);
+
+/**
+ * \fn int journal_insert_lines(journal_t *journal, music_t *music, int channelId, int line, int count)
+ * \brief Insère des lignes vides en décalant les suivantes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne où insérer
+ * \param count Le nombre de lignes
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation (le channel n'est
+ * alors pas modifié)
+ * \warning Une transaction doit être ouverte (journal_begin)
+ */
+int journal_insert_lines(journal_t *journal, music_t *music, int channelId, int line, int count);
+
+/**
+ * \fn int journal_delete_lines(journal_t *journal, music_t *music, int channelId, int line, int count)
+ * \brief Supprime des lignes en remontant les suivantes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La première ligne supprimée
+ * \param count Le nombre de lignes
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation (le channel n'est
+ * alors pas modifié)
+ * \warning Une transaction doit être ouverte (journal_begin)
+ */
+int journal_delete_lines(journal_t *journal, music_t *music, int channelId, int line, int count);
+
+/**
+ * \fn int journal_transpose_lines(journal_t *journal, music_t *music, int channelId, int line, int count, int semitones)
+ * \brief Transpose les notes d'une suite de lignes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La première ligne
+ * \param count Le nombre de lignes
+ * \param semitones Le nombre de demi-tons (négatif pour descendre)
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation (le channel n'est
+ * alors pas modifié)
+ * \warning Une transaction doit être ouverte (journal_begin)
+ */
+int journal_transpose_lines(journal_t *journal, music_t *music, int channelId, int line, int count, int semitones);
+
+/**
+ * \fn int journal_replace_instrument(journal_t *journal, music_t *music, int channelId, int line, int count, instrument_t instrument)
+ * \brief Change l'instrument des notes d'une suite de lignes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La première ligne
+ * \param count Le nombre de lignes
+ * \param instrument Le nouvel instrument
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation (le channel n'est
+ * alors pas modifié)
+ * \warning Une transaction doit être ouverte (journal_begin)
+ */
+int journal_replace_instrument(journal_t *journal, music_t *music, int channelId, int line, int count, instrument_t instrument);
+
+/**
+ * \fn int journal_undo(journal_t *journal, music_t *music, const journal_edit_t **edits)
+ * \brief Annule la dernière transaction appliquée
+ * \param journal Le journal
+ * \param music La musique
+ * \param edits Rempli avec les écarts de la transaction (peut être NULL)
+ * \return Le nombre d'écarts annulés, 0 s'il n'y a rien à annuler ou si un channel de la transaction a été retiré
+ */
+int journal_undo(journal_t *journal, music_t *music, const journal_edit_t **edits);
+
+/**
+ * \fn int journal_redo(journal_t *journal, music_t *music, const journal_edit_t **edits)
+ * \brief Rétablit la dernière transaction annulée
+ * \param journal Le journal
+ * \param music La musique
+ * \param edits Rempli avec les écarts de la transaction (peut être NULL)
+ * \return Le nombre d'écarts rétablis, 0 s'il n'y a rien à rétablir ou si un channel de la transaction a été retiré
+ */
+int journal_redo(journal_t *journal, music_t *music, const journal_edit_t **edits);
+
+#endif
@@ -7,10 +7,12 @@
 #ifndef MPP_H
 #define MPP_H
 
+#include <stdarg.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include "note.h"
+#include "pattern.h"
 #include "data.h"
 
 // TODO : DOIT ÊTRE DEFINI DANS WIRINGPISEQ H
@@ -144,6 +146,7 @@ void print_mpp_response(mpp_response_t *response);
  * <music>
  * @param request 
  * @param buffer 
+ * @note Une musique qui ne tient pas dans le buffer n'est pas envoyée : le serveur refuse la requête
  */
 void serialize_mpp_request(mpp_request_t *request, buffer_t buffer);
 
@@ -165,6 +168,7 @@ void deserialize_mpp_request(buffer_t buffer, mpp_request_t *request);
  * <music> (même format que pour la requête)
  * @param response La réponse MPP
  * @param buffer Le buffer dans lequel sérialiser la réponse
+ * @note Une musique qui ne tient pas dans le buffer n'est pas envoyée : la réponse devient NOK
  */
 void serialize_mpp_response(mpp_response_t *response, buffer_t buffer);
 
@@ -243,7 +247,8 @@ void get_music_list_from_db(musicId_list_t *list, char *rfidId);
  * @brief Ajoute une musique à la base de données
  * @param music La musique à ajouter
  * @param rfidId L'identifiant RFID de l'utilisateur
- * @return int 
+ * @return 0 si succès, -1 si la musique n'a pas pu être écrite (l'ancienne sauvegarde est conservée)
+ * @note Une musique qui ne tient pas dans un buffer_t n'est pas écrite plutôt que d'être tronquée
  */
 int add_music_to_db(music_t *music, char *rfidId);
 
@@ -256,6 +261,15 @@ int add_music_to_db(music_t *music, char *rfidId);
  */
 void get_music_from_db(music_t *music, time_t musicId, char *rfidId);
 
+/**
+ * @fn int load_music_file(music_t *music, char *filename);
+ * @brief Charge une musique depuis un fichier .mipi (hors base de données)
+ * @param music La musique à remplir (initialisée par la fonction)
+ * @param filename Le chemin du fichier
+ * @return 0 si succès, -1 si le fichier n'a pas pu être lu
+ */
+int load_music_file(music_t *music, char *filename);
+
 
 /**
  * @fn void delete_music_from_db(time_t musicId, char *rfidId);
@@ -312,7 +326,8 @@ void list_music_handler(socket_t *sd, mpp_request_t *request, mpp_response_t *re
  * @param request requête MPP reçue
  * @param response reponse MPP à envoyer
  * @note Un fichier est crée pour chaque musique dans le dossier de l'utilisateur
- * @warning Si l'utilisateur n'existe pas, une reponse BAD_REQUEST est envoyée
+ * @warning Si l'utilisateur n'existe pas ou si la requête n'a pas de musique, une reponse BAD_REQUEST est envoyée
+ * @warning Si la musique n'a pas pu être écrite, une réponse NOK est envoyée
  */
 void add_music_handler(socket_t *sd, mpp_request_t *request, mpp_response_t *response);
 
@@ -202,4 +202,40 @@ void wait_sem(sem_t *sem);
  */
 void post_sem(sem_t *sem);
 
+/* SECTION : SHM */
+
+/**
+ * @fn void *create_shm(char *name, size_t size);
+ * @brief Fonction qui crée (ou recrée) une mémoire partagée nommée et la projette
+ * @param name Nom de la mémoire partagée
+ * @param size Taille de la mémoire partagée
+ * @return L'adresse de la projection, mise à zéro
+ */
+void *create_shm(char *name, size_t size);
+
+/**
+ * @fn void *open_shm(char *name, size_t size);
+ * @brief Fonction qui projette une mémoire partagée nommée existante
+ * @param name Nom de la mémoire partagée
+ * @param size Taille de la mémoire partagée
+ * @return L'adresse de la projection ou NULL si elle n'existe pas
+ * @details contrairement à open_named_sem, l'absence de la mémoire n'est pas une erreur fatale
+ */
+void *open_shm(char *name, size_t size);
+
+/**
+ * @fn void close_shm(void *addr, size_t size);
+ * @brief Fonction qui supprime la projection d'une mémoire partagée
+ * @param addr L'adresse de la projection
+ * @param size Taille de la mémoire partagée
+ */
+void close_shm(void *addr, size_t size);
+
+/**
+ * @fn void unlink_shm(char *name);
+ * @brief Fonction qui supprime une mémoire partagée nommée
+ * @param name Nom de la mémoire partagée
+ */
+void unlink_shm(char *name);
+
 #endif
@@ -13,11 +13,25 @@
 /* ------------------------------------------------------------------------ */
 /*              C O N S T A N T E S     S Y M B O L I Q U E S               */
 /* ------------------------------------------------------------------------ */
-#define CHANNEL_MAX_NOTES 4096 /*!< Nombre de notes maximum dans un channel doit tenir sur n symboles hexadécimaux */
-#define MUSIC_MAX_CHANNELS 3 /*!< Nombre de channels maximum dans une musique */
+#define CHANNEL_MAX_NOTES 65536 /*!< Nombre de lignes maximum d'un channel (numéros affichés sur 4 symboles hexadécimaux) */
+#define CHANNEL_CHUNK_BITS 8 /*!< Un bloc de notes couvre 2^CHANNEL_CHUNK_BITS lignes */
+#define CHANNEL_CHUNK_NOTES (1 << CHANNEL_CHUNK_BITS) /*!< Nombre de lignes d'un bloc de notes */
+#define CHANNEL_MAX_CHUNKS (CHANNEL_MAX_NOTES / CHANNEL_CHUNK_NOTES) /*!< Nombre de blocs d'un channel */
+#define CHANNEL_EMPTY_TICKS TIME_NOIRE /*!< Durée d'une ligne jamais écrite */
+#define CHANNEL_WORD_BITS 64 /*!< Nombre de bits d'un mot des tables d'occupation */
+#define CHANNEL_CHUNK_WORDS (CHANNEL_CHUNK_NOTES / CHANNEL_WORD_BITS) /*!< Mots d'occupation d'un bloc (un bit par ligne) */
+#define CHANNEL_SUMMARY_WORDS (CHANNEL_MAX_CHUNKS / CHANNEL_WORD_BITS) /*!< Mots d'occupation d'un channel (un bit par bloc) */
+#define MUSIC_MIN_CHANNELS 1 /*!< Nombre de channels minimum dans une musique */
+#define MUSIC_MAX_CHANNELS 16 /*!< Nombre de channels maximum dans une musique */
+#define MUSIC_DEFAULT_CHANNELS 3 /*!< Nombre de channels d'une musique neuve (et des anciennes musiques) */
+#define MUSIC_MAX_TEMPOS 64 /*!< Nombre maximum de changements de tempo dans une musique */
+#define MUSIC_MIN_BPM 1 /*!< Tempo minimal */
+#define MUSIC_MAX_BPM 300 /*!< Tempo maximal */
+#define NOTE_TICKS(note) ((note).time > 0 ? (int) (note).time : 0) /*!< Durée d'une note en doubles croches (0 si invalide) */
 
 //Fréquences des notes
 #define REF_OCTAVE 3 /*!< Octave de référence */
+#define NOTE_MAX_OCTAVE 8 /*!< Octave la plus haute */
 #define NOTE_C_FQ 261.63 /*!< Fréquence du DO à l’octave de référence */
 #define NOTE_CS_FQ 277.18 /*!< Fréquence du DO# à l’octave de référence */
 #define NOTE_D_FQ 293.66 /*!< Fréquence du RÉ à l’octave de référence */
@@ -97,6 +111,7 @@ typedef enum {
 	INSTRUMENT_ORGAN,  /*!< Utilisation d’un orgue */
 	INSTRUMENT_PIANO,  /*!< Utilisation d’un piano */
 	INSTRUMENT_SINPHASER, /*!< Utilisation d’un signal sinusoïdale avec phaser */
+	INSTRUMENT_STEPMOTOR, /*!< Note jouée par le moteur pas à pas (muette sur la carte son) */
 	INSTRUMENT_NB /*!< Nombre d’instruments disponibles */
 }instrument_t;
 
@@ -128,6 +143,19 @@ typedef struct {
 	time_duration_t time;/*!<  Durée de la note */
 }note_t;
 
+/**
+ * \struct packed_note_t
+ * \brief Note compacte sur 4 octets (stockage des channels)
+ * \details La fréquence n'est pas stockée : elle se déduit de l'identifiant (note_frequency).
+ * Les champs hors de [0, 255] (notes vides de l'affichage) sont ramenés à 0.
+ */
+typedef struct {
+	unsigned char id; /*!< Identifiant de la note (note_id_t)*/
+	unsigned char octave; /*!< Octave de la note*/
+	unsigned char instrument; /*!< Instrument (instrument_t, plugins compris)*/
+	unsigned char time; /*!< Durée en doubles croches*/
+} packed_note_t;
+
 /**
  * \struct scale_t
  * \brief Structure representant une gamme
@@ -137,24 +165,76 @@ typedef struct {
 }scale_t;
 
 
+/**
+ * \struct note_chunk_t
+ * \brief Bloc de CHANNEL_CHUNK_NOTES lignes consécutives d'un channel
+ * \details Une colonne par champ de packed_note_t : les parcours des durées ne lisent que times
+ */
+typedef struct {
+	unsigned char ids[CHANNEL_CHUNK_NOTES];/*!< Identifiant de chaque note (note_id_t)*/
+	unsigned char octaves[CHANNEL_CHUNK_NOTES];/*!< Octave de chaque note*/
+	unsigned char instruments[CHANNEL_CHUNK_NOTES];/*!< Instrument de chaque note*/
+	unsigned char times[CHANNEL_CHUNK_NOTES];/*!< Durée de chaque note en doubles croches*/
+	unsigned long long notes[CHANNEL_CHUNK_WORDS];/*!< Lignes dont la note n'est pas NOTE_NA_ID (un bit par ligne)*/
+	unsigned long long lines[CHANNEL_CHUNK_WORDS];/*!< Lignes différentes de la ligne vide (un bit par ligne)*/
+	int refs;/*!< Nombre de channels qui partagent le bloc (copié avant d'être modifié au delà de 1)*/
+}note_chunk_t;
+
+/**
+ * \struct chunk_table_t
+ * \brief Table des blocs d'un channel et index de leurs durées
+ * \details Allouée à la première note non vide du channel : un channel vide n'a pas de table.
+ */
+typedef struct {
+	note_chunk_t *chunks[CHANNEL_MAX_CHUNKS];/*!< Blocs de notes (NULL : toutes les lignes du bloc sont vides)*/
+	int timeIndex[CHANNEL_MAX_CHUNKS + 1];/*!< Arbre de Fenwick de l'écart de durée de chaque bloc à un bloc vide (indexé à partir de 1)*/
+	int refs;/*!< Nombre de channels qui partagent la table (copiée avant d'être modifiée au delà de 1)*/
+}chunk_table_t;
+
 /**
  * \struct channel_t
  * \brief Structure pour jouer les notes dans les channels
+ * \details Les blocs ne sont alloués qu'à la première écriture d'une note non vide : la mémoire
+ * suit le contenu et un channel vide s'initialise sans écrire de note. Le channel vivant
+ * n'est lu et modifié que par l'éditeur : les éditions de blocs déplacent les lignes à
+ * l'intérieur d'un bloc, un lecteur concurrent y verrait un état intermédiaire. Les autres
+ * threads (lecture, démon) lisent un instantané pris par music_snapshot et rendu par
+ * release_music. Un bloc ou une table partagés avec un instantané sont copiés à la première
+ * écriture : l'instantané ne voit jamais la modification.
+ * L'occupation est tenue sur deux niveaux (un bit par bloc, puis un bit par ligne) : la
+ * dernière note, la ligne non vide suivante et le nombre de notes se trouvent mot par mot,
+ * sans lire les lignes vides.
  */
 typedef struct {
 	short id ; /*!< Identifiant du channel*/ 
-	note_t notes[CHANNEL_MAX_NOTES];/*!< Nombre de note (dernière note non vide)*/
-	int nbNotes;/*!< Fréquence en Hz à l’octave de référence*/
+	int nbNotes;/*!< Nombre de notes (dernière note non vide)*/
+	chunk_table_t *table;/*!< Blocs et index des durées (NULL : toutes les lignes sont vides)*/
+	unsigned long long chunkNotes[CHANNEL_SUMMARY_WORDS];/*!< Blocs contenant au moins une note (un bit par bloc)*/
+	unsigned long long chunkLines[CHANNEL_SUMMARY_WORDS];/*!< Blocs contenant au moins une ligne non vide (un bit par bloc)*/
 }channel_t;
 
+/**
+ * \struct tempo_event_t
+ * \brief Changement de tempo à une position de la musique
+ */
+typedef struct {
+	long long tick;/*!< Position du changement en doubles croches depuis le début de la musique*/
+	short bpm;/*!< Nouveau tempo*/
+}tempo_event_t;
+
 /**
  * \struct music_t
  * \brief Structure de la musique
+ * \details Seuls les nbChannels premiers channels sont joués, sérialisés et affichés
  */
 typedef struct {
 	struct timeval date;/*!< Date de création de la musique*/
+	int nbChannels;/*!< Nombre de channels de la musique (entre MUSIC_MIN_CHANNELS et MUSIC_MAX_CHANNELS)*/
 	channel_t channels [MUSIC_MAX_CHANNELS];/*!< Les canaux disponibles */
-	short bpm;/*!< Le bpm de la musique*/
+	short bpm;/*!< Le bpm de la musique (tempo au début)*/
+	int nbTempos;/*!< Nombre de changements de tempo*/
+	tempo_event_t tempos[MUSIC_MAX_TEMPOS];/*!< Changements de tempo triés par position*/
+	int refs;/*!< Nombre de détenteurs d'un instantané (0 pour une musique modifiable)*/
 }music_t;
 
 
@@ -226,23 +306,280 @@ double get_note_freq(note_t *note, scale_t *scale);
  */
 note_t *cp_note(note_t *dest, note_t src);
 
+/**
+ * \fn double note_frequency(int id)
+ * \brief Fréquence d'une note à l'octave de référence
+ * \param id l'identifiant de la note (note_id_t)
+ * \return la fréquence en Hz (NOTE_NA_FQ si l'identifiant n'est pas une note)
+ */
+double note_frequency(int id);
+
+/**
+ * \fn packed_note_t pack_note(note_t note)
+ * \brief Compacter une note sur 4 octets
+ * \param note la note
+ * \return la note compacte (sans la fréquence)
+ */
+packed_note_t pack_note(note_t note);
+
+/**
+ * \fn note_t unpack_note(packed_note_t packed)
+ * \brief Décompacter une note
+ * \param packed la note compacte
+ * \return la note, avec la fréquence de son identifiant
+ */
+note_t unpack_note(packed_note_t packed);
+
+/**
+ * \fn packed_note_t channel_packed_note(const channel_t *channel, int index)
+ * \brief Lire une note compacte d'un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \return la note compacte
+ */
+packed_note_t channel_packed_note(const channel_t *channel, int index);
+
+/**
+ * \fn note_t channel_note(const channel_t *channel, int index)
+ * \brief Lire une note d'un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \return une copie de la note
+ * \note la note se modifie par set_channel_note, suivi de update_channel_nbNotes et update_channel_index
+ */
+note_t channel_note(const channel_t *channel, int index);
+
+/**
+ * \fn int set_channel_packed_note(channel_t *channel, int index, packed_note_t packed)
+ * \brief Écrire une note compacte dans un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \param packed la note compacte
+ * \return 0 si succès, -1 si le bloc de la ligne n'a pas pu être alloué
+ */
+int set_channel_packed_note(channel_t *channel, int index, packed_note_t packed);
+
+/**
+ * \fn int set_channel_note(channel_t *channel, int index, note_t note)
+ * \brief Écrire une note dans un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \param note la note (sa fréquence n'est pas gardée)
+ * \return 0 si succès, -1 si le bloc de la ligne n'a pas pu être alloué
+ */
+int set_channel_note(channel_t *channel, int index, note_t note);
+
+/**
+ * \fn int channel_note_ticks(const channel_t *channel, int index)
+ * \brief Durée d'une note d'un channel, lue dans la seule colonne des durées
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \return la durée en doubles croches
+ */
+int channel_note_ticks(const channel_t *channel, int index);
+
+/**
+ * \fn int channel_next_note(const channel_t *channel, int line)
+ * \brief Première note (identifiant différent de NOTE_NA_ID) à partir d'une ligne
+ * \param channel le channel
+ * \param line la ligne de départ (comprise)
+ * \return la ligne de la note, -1 s'il n'y en a plus
+ */
+int channel_next_note(const channel_t *channel, int line);
+
+/**
+ * \fn int channel_next_line(const channel_t *channel, int line)
+ * \brief Première ligne non vide à partir d'une ligne
+ * \param channel le channel
+ * \param line la ligne de départ (comprise)
+ * \return la ligne, -1 s'il n'y en a plus
+ * \note une ligne vide est égale à la ligne d'un channel neuf : elle est muette et dure
+ * CHANNEL_EMPTY_TICKS. Un silence d'une autre durée n'est pas une ligne vide
+ */
+int channel_next_line(const channel_t *channel, int line);
+
+/**
+ * \fn int channel_last_note(const channel_t *channel)
+ * \brief Dernière note d'un channel
+ * \param channel le channel
+ * \return la ligne de la dernière note, -1 si le channel n'a pas de note
+ */
+int channel_last_note(const channel_t *channel);
+
+/**
+ * \fn int channel_count_notes(const channel_t *channel)
+ * \brief Nombre de notes d'un channel (lignes dont l'identifiant n'est pas NOTE_NA_ID)
+ * \param channel le channel
+ * \return le nombre de notes
+ */
+int channel_count_notes(const channel_t *channel);
+
+/**
+ * \fn long long channel_lines_ticks(const channel_t *channel, int from, int to)
+ * \brief Durée d'une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param to la ligne qui suit la dernière (from <= to <= CHANNEL_MAX_NOTES)
+ * \return la durée en doubles croches
+ * \note les lignes au delà de nbNotes sont comptées
+ */
+long long channel_lines_ticks(const channel_t *channel, int from, int to);
+
+/**
+ * \fn int copy_channel_lines(channel_t *dest, int to, const channel_t *src, int from, int count)
+ * \brief Copier une suite de lignes d'un channel dans un autre, ou ailleurs dans le même
+ * \param dest le channel écrit
+ * \param to la première ligne écrite
+ * \param src le channel lu (dest est accepté, les lignes peuvent se recouvrir)
+ * \param from la première ligne lue
+ * \param count le nombre de lignes (la copie s'arrête à la fin de dest, les lignes lues au delà
+ * de la fin de src sont vides)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué (les lignes peuvent être en partie copiées)
+ * \note Les colonnes sont copiées bloc par bloc et nbNotes et l'index des durées ne sont mis à jour
+ * qu'une fois, quel que soit le nombre de lignes
+ */
+int copy_channel_lines(channel_t *dest, int to, const channel_t *src, int from, int count);
+
+/**
+ * \fn int clear_channel_lines(channel_t *channel, int from, int count)
+ * \brief Vider une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param count le nombre de lignes (l'effacement s'arrête à la fin du channel)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être copié (les lignes peuvent être en partie vidées)
+ * \note nbNotes et l'index des durées sont mis à jour une fois
+ */
+int clear_channel_lines(channel_t *channel, int from, int count);
+
+/**
+ * \fn int insert_channel_lines(channel_t *channel, int line, int count)
+ * \brief Insérer des lignes vides en décalant les suivantes vers la fin
+ * \param channel le channel
+ * \param line la ligne où insérer
+ * \param count le nombre de lignes insérées
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué (les lignes peuvent être en partie décalées)
+ * \note Les lignes poussées au delà de CHANNEL_MAX_NOTES sont perdues. Seuls les blocs jusqu'à la
+ * dernière ligne non vide sont déplacés
+ */
+int insert_channel_lines(channel_t *channel, int line, int count);
+
+/**
+ * \fn int delete_channel_lines(channel_t *channel, int line, int count)
+ * \brief Supprimer des lignes en remontant les suivantes
+ * \param channel le channel
+ * \param line la première ligne supprimée
+ * \param count le nombre de lignes supprimées
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué (les lignes peuvent être en partie décalées)
+ * \note Les dernières lignes du channel deviennent vides
+ */
+int delete_channel_lines(channel_t *channel, int line, int count);
+
+/**
+ * \fn int transpose_channel_lines(channel_t *channel, int from, int count, int semitones)
+ * \brief Transposer les notes d'une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param count le nombre de lignes
+ * \param semitones le nombre de demi-tons (négatif pour descendre)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être copié (les notes peuvent être en partie transposées)
+ * \note Les notes sont bornées entre le DO de l'octave 0 et le SI de l'octave NOTE_MAX_OCTAVE
+ */
+int transpose_channel_lines(channel_t *channel, int from, int count, int semitones);
+
+/**
+ * \fn int replace_channel_instrument(channel_t *channel, int from, int count, instrument_t instrument)
+ * \brief Changer l'instrument des notes d'une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param count le nombre de lignes
+ * \param instrument le nouvel instrument
+ * \return 0 si succès, -1 si un bloc n'a pas pu être copié (les notes peuvent être en partie modifiées)
+ * \note Les lignes sans note gardent leur instrument
+ */
+int replace_channel_instrument(channel_t *channel, int from, int count, instrument_t instrument);
+
 /**
  * \fn void init_channel(channel_t *channel);
  * \brief Initialiser un channel avec des notes vides
  * \param channel le channel à initialiser
  * \param id l'identifiant du channel
  * \see channel_t
+ * \warning les blocs d'un channel déjà utilisé ne sont pas libérés (free_channel)
  */
 void init_channel(channel_t *channel, int id);
 
+/**
+ * \fn void free_channel(channel_t *channel)
+ * \brief Libérer les blocs de notes d'un channel
+ * \param channel le channel (initialisé par init_channel)
+ * \note le channel doit être réinitialisé avant d'être réutilisé
+ */
+void free_channel(channel_t *channel);
+
+/**
+ * \fn void share_channel(channel_t *copy, const channel_t *channel)
+ * \brief Copier un channel en partageant sa table
+ * \param copy la copie (vide ou libérée par free_channel)
+ * \param channel le channel
+ * \note La table est copiée à la première écriture dans l'un ou l'autre : la copie coûte un
+ * détenteur de plus, quel que soit le nombre de lignes. La copie est libérée par free_channel
+ */
+void share_channel(channel_t *copy, const channel_t *channel);
+
+/**
+ * \fn void free_music(music_t *music)
+ * \brief Libérer les notes d'une musique
+ * \param music la musique (initialisée par init_music)
+ * \note la musique doit être réinitialisée avant d'être réutilisée
+ */
+void free_music(music_t *music);
+
+/**
+ * \fn music_t *music_snapshot(const music_t *music)
+ * \brief Instantané d'une musique : une version figée qui partage ses blocs de notes
+ * \param music la musique
+ * \return l'instantané (un détenteur), NULL si l'allocation a échoué
+ * \note seule la structure de la musique est copiée. Les tables de blocs sont partagées et copiées
+ * par la musique à sa prochaine écriture : l'instantané peut être lu depuis un autre thread
+ * sans verrou pendant que la musique est modifiée
+ * \warning un instantané ne se modifie pas et se libère par release_music
+ */
+music_t *music_snapshot(const music_t *music);
+
+/**
+ * \fn music_t *retain_music(music_t *snapshot)
+ * \brief Ajouter un détenteur à un instantané
+ * \param snapshot l'instantané
+ * \return l'instantané
+ */
+music_t *retain_music(music_t *snapshot);
+
+/**
+ * \fn void release_music(music_t *snapshot)
+ * \brief Retirer un détenteur d'un instantané, libéré avec ses blocs après le dernier
+ * \param snapshot l'instantané (NULL est accepté)
+ */
+void release_music(music_t *snapshot);
+
 /**
  * \fn init_music(music_t *music, short bpm);
  * \brief Initialiser une musique avec des channels vides
  * \param music la musique à initialiser
  * \param bpm le bpm de la musique
+ * \warning les notes d'une musique déjà utilisée ne sont pas libérées (free_music)
 */
 void init_music(music_t *music, short bpm);
 
+/**
+ * \fn int set_music_channels(music_t *music, int nbChannels)
+ * \brief Changer le nombre de channels d'une musique
+ * \param music la musique (initialisée par init_music)
+ * \param nbChannels le nouveau nombre de channels
+ * \return 0 si succès, -1 si nbChannels n'est pas entre MUSIC_MIN_CHANNELS et MUSIC_MAX_CHANNELS
+ * \note les channels ajoutés sont vides, les notes des channels retirés sont libérées
+ */
+int set_music_channels(music_t *music, int nbChannels);
+
 /**
  * \fn void instrument2str(instrument_t instrument, char *str);
  * \brief Convertir un instrument en chaine de caractère
@@ -251,6 +588,13 @@ void init_music(music_t *music, short bpm);
  */
 void instrument2str(instrument_t instrument, char *str);
 
+/**
+ * \fn int nb_instruments()
+ * \brief Nombre d'instruments disponibles, plugins compris
+ * \return INSTRUMENT_NB plus le nombre de plugins chargés (voir plugin.h)
+ */
+int nb_instruments();
+
 /**
  * \fn note2str(note_t note, char *str);
  * \brief Convertir une note en chaine de caractère
@@ -264,8 +608,92 @@ void note2str(note_t note, char *str);
  * @param channel le channel à mettre à jour
  * @param noteIndex l'index de la note courante
  * Ce script met à jour le nombre de notes dans un channel
- * Pour cela il compare la note passée en paramètre avec la dernière note du channel
+ * Pour cela il cherche la dernière note du channel dans la table d'occupation
  */
 void update_channel_nbNotes(channel_t *channel, int noteIndex);
 
+/**
+ * @fn void build_channel_index(channel_t *channel);
+ * @brief Reconstruire l'index des durées d'un channel
+ * @param channel le channel
+ * @note A appeler après avoir modifié les durées sans passer par update_channel_index
+ * (désérialisation par exemple)
+ */
+void build_channel_index(channel_t *channel);
+
+/**
+ * @fn void update_channel_index(channel_t *channel, int noteIndex, int oldTime);
+ * @brief Mettre à jour l'index des durées après la modification d'une note
+ * @param channel le channel
+ * @param noteIndex l'index de la note modifiée
+ * @param oldTime la durée de la note avant la modification
+ * @note Complexité en O(log n)
+ */
+void update_channel_index(channel_t *channel, int noteIndex, int oldTime);
+
+/**
+ * @fn long long channel_line2tick(channel_t *channel, int line);
+ * @brief Position musicale du début d'une ligne d'un channel
+ * @param channel le channel
+ * @param line la ligne
+ * @return la position en doubles croches depuis le début de la musique
+ * @note Complexité en O(log n). Au delà de nbNotes, la position est celle de la fin du channel
+ */
+long long channel_line2tick(channel_t *channel, int line);
+
+/**
+ * @fn int channel_tick2line(channel_t *channel, long long tick);
+ * @brief Ligne d'un channel jouée à une position musicale
+ * @param channel le channel
+ * @param tick la position en doubles croches depuis le début de la musique
+ * @return la ligne jouée, ou nbNotes si le channel est terminé
+ * @note Complexité en O(log n)
+ */
+int channel_tick2line(channel_t *channel, long long tick);
+
+/**
+ * @fn long long music_end_tick(music_t *music);
+ * @brief Position de la fin de la musique
+ * @param music la musique
+ * @return la fin du channel le plus long en doubles croches
+ */
+long long music_end_tick(music_t *music);
+
+/**
+ * @fn short music_tempo_at(music_t *music, long long tick);
+ * @brief Tempo en vigueur à une position de la musique
+ * @param music la musique
+ * @param tick la position en doubles croches
+ * @return le bpm
+ */
+short music_tempo_at(music_t *music, long long tick);
+
+/**
+ * @fn int music_tempo_index(music_t *music, long long tick);
+ * @brief Nombre de changements de tempo placés avant ou sur une position
+ * @param music la musique
+ * @param tick la position en doubles croches
+ * @return l'indice du prochain changement de tempo après tick
+ */
+int music_tempo_index(music_t *music, long long tick);
+
+/**
+ * @fn int set_music_tempo(music_t *music, long long tick, short bpm);
+ * @brief Ajouter ou modifier un changement de tempo
+ * @param music la musique
+ * @param tick la position du changement en doubles croches
+ * @param bpm le nouveau tempo (borné entre MUSIC_MIN_BPM et MUSIC_MAX_BPM)
+ * @return 0 si le changement est enregistré, -1 si la liste est pleine
+ */
+int set_music_tempo(music_t *music, long long tick, short bpm);
+
+/**
+ * @fn int remove_music_tempo(music_t *music, long long tick);
+ * @brief Supprimer le changement de tempo placé sur une position
+ * @param music la musique
+ * @param tick la position du changement en doubles croches
+ * @return 1 si un changement a été supprimé, 0 sinon
+ */
+int remove_music_tempo(music_t *music, long long tick);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+/**
+ * \file pattern.h
+ * \brief Patterns et arrangement d'une musique
+ * \details Les lignes de chaque channel sont découpées en blocs de PATTERN_LINES lignes. Les
+ * blocs identiques d'un même channel ne sont gardés qu'une fois (un pattern) et l'arrangement
+ * liste, pour chaque rangée de blocs, le pattern joué par chaque channel. Une musique qui
+ * répète ses phrases se sérialise et se calcule à la taille de ses patterns et non à celle
+ * de toutes ses lignes. Le channel reste la forme jouée et modifiée : l'arrangement s'en
+ * déduit (arrange_music) et s'y déroule (unroll_arrangement).
+ */
+#ifndef PATTERN_H
+#define PATTERN_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdlib.h>
+#include <string.h>
+#include "note.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define PATTERN_LINES 64 /*!< Nombre de lignes d'un pattern */
+#define PATTERN_NONE -1 /*!< Rangée sans pattern : toutes les lignes du bloc sont vides */
+#define ARRANGEMENT_MAX_ORDERS (CHANNEL_MAX_NOTES / PATTERN_LINES) /*!< Nombre maximum de rangées d'un arrangement */
+#define ARRANGEMENT_INITIAL_PATTERNS 16 /*!< Taille initiale du tableau des patterns d'un channel (doublée quand il est plein) */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct pattern_t
+ * \brief Bloc de PATTERN_LINES lignes d'un channel
+ */
+typedef struct {
+    packed_note_t lines[PATTERN_LINES]; /*!< Les lignes (vides au delà de la dernière note du channel) */
+    unsigned long long hash; /*!< Empreinte des lignes (recherche des blocs identiques) */
+} pattern_t;
+
+/**
+ * \struct arrangement_t
+ * \brief Patterns de chaque channel et ordre dans lequel ils sont joués
+ * \details La rangée k couvre les lignes [k * PATTERN_LINES, (k + 1) * PATTERN_LINES[ de
+ * chaque channel. Les patterns sont numérotés par channel.
+ */
+typedef struct {
+    int nbChannels; /*!< Nombre de channels arrangés */
+    pattern_t *patterns[MUSIC_MAX_CHANNELS]; /*!< Patterns de chaque channel */
+    int nbPatterns[MUSIC_MAX_CHANNELS]; /*!< Nombre de patterns de chaque channel */
+    int maxPatterns[MUSIC_MAX_CHANNELS]; /*!< Taille du tableau des patterns de chaque channel */
+    int nbOrders; /*!< Nombre de rangées */
+    short orders[ARRANGEMENT_MAX_ORDERS][MUSIC_MAX_CHANNELS]; /*!< Pattern de chaque channel à chaque rangée (PATTERN_NONE si vide) */
+} arrangement_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_arrangement(arrangement_t *arrangement)
+ * \brief Initialise un arrangement sans channel, pattern ni rangée
+ * \param arrangement L'arrangement
+ */
+void init_arrangement(arrangement_t *arrangement);
+
+/**
+ * \fn void free_arrangement(arrangement_t *arrangement)
+ * \brief Libère les patterns d'un arrangement
+ * \param arrangement L'arrangement (vide après l'appel)
+ */
+void free_arrangement(arrangement_t *arrangement);
+
+/**
+ * \fn int arrangement_add_pattern(arrangement_t *arrangement, int channelId)
+ * \brief Ajoute un pattern vide à un channel
+ * \param arrangement L'arrangement
+ * \param channelId Le channel
+ * \return Le numéro du pattern, -1 si la mémoire manque
+ */
+int arrangement_add_pattern(arrangement_t *arrangement, int channelId);
+
+/**
+ * \fn int arrange_music(const music_t *music, arrangement_t *arrangement)
+ * \brief Découpe les channels d'une musique en patterns
+ * \param music La musique
+ * \param arrangement L'arrangement (initialisé, remplacé par celui de la musique)
+ * \return 0 si succès, -1 si la mémoire manque
+ * \note Seules les lignes non vides sont lues. Les lignes au delà de nbNotes ne sont pas jouées
+ * et comptent comme vides
+ */
+int arrange_music(const music_t *music, arrangement_t *arrangement);
+
+/**
+ * \fn int unroll_arrangement(const arrangement_t *arrangement, music_t *music)
+ * \brief Écrit les patterns d'un arrangement dans les channels d'une musique
+ * \param arrangement L'arrangement
+ * \param music La musique (ses lignes doivent être vides)
+ * \return 0 si succès, -1 si un bloc de notes n'a pas pu être alloué
+ * \note nbNotes et l'index des durées des channels sont mis à jour. Les channels de
+ * l'arrangement au delà de ceux de la musique sont ignorés
+ */
+int unroll_arrangement(const arrangement_t *arrangement, music_t *music);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * \file pcmcodec.h
+ * \brief Format compressé sans perte pour les rendus audio enregistrés sur disque
+ * \details Les échantillons (S16 mono) sont découpés en blocs de PCMCODEC_BLOCK_FRAMES.
+ * Chaque bloc est prédit par un des prédicteurs fixes d'ordre 0 à 3 (le meilleur est choisi
+ * par bloc) et les résidus sont codés en Rice avec un paramètre par bloc. Une table des
+ * positions des blocs suit l'en-tête : la lecture peut commencer à n'importe quel échantillon
+ * en ne décodant qu'un bloc.
+ *
+ * Format (petit boutiste) :
+ *  - en-tête : "PIMC", version (16 bits), ordre max (16 bits), fréquence (32 bits),
+ *    nombre d'échantillons (64 bits), taille des blocs (32 bits), nombre de blocs (32 bits)
+ *  - table : position de chaque bloc puis de la fin des données (32 bits, depuis la fin de la table)
+ *  - blocs : ordre (8 bits), paramètre de Rice (8 bits), puis un flux de bits contenant les
+ *    premiers échantillons bruts (16 bits) et les résidus codés, complété jusqu'à l'octet
+ */
+#ifndef PCMCODEC_H
+#define PCMCODEC_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sound.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define PCMCODEC_MAGIC "PIMC" /*!< Signature des fichiers compressés */
+#define PCMCODEC_VERSION 1 /*!< Version du format */
+#define PCMCODEC_HEADER_SIZE 28 /*!< Taille de l'en-tête en octets */
+#define PCMCODEC_BLOCK_FRAMES 4096 /*!< Nombre d'échantillons par bloc */
+#define PCMCODEC_MAX_ORDER 3 /*!< Ordre maximal des prédicteurs fixes */
+#define PCMCODEC_MAX_RICE 24 /*!< Paramètre de Rice maximal */
+#define PCMCODEC_ESCAPE 32 /*!< Quotient à partir duquel un résidu est écrit en clair sur 32 bits */
+#define PCMCODEC_EXTENSION ".pimc" /*!< Extension des fichiers compressés */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct pcm_reader_t
+ * \brief Lecteur d'un flux compressé avec accès direct aux échantillons
+ */
+typedef struct {
+    unsigned char *data; /*!< Flux compressé complet */
+    size_t size; /*!< Taille du flux en octets */
+    long long frames; /*!< Nombre d'échantillons */
+    unsigned int sampleRate; /*!< Fréquence d'échantillonnage */
+    unsigned int blockFrames; /*!< Nombre d'échantillons par bloc */
+    unsigned int nbBlocks; /*!< Nombre de blocs */
+    size_t dataStart; /*!< Position du premier bloc */
+    short *block; /*!< Dernier bloc décodé */
+    long long cachedBlock; /*!< Indice du dernier bloc décodé (-1 si aucun) */
+} pcm_reader_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn unsigned char *encode_pcm(short *pcm, long long frames, size_t *size)
+ * \brief Compresse des échantillons
+ * \param pcm Les échantillons
+ * \param frames Le nombre d'échantillons
+ * \param size La taille du flux compressé
+ * \return Le flux compressé (à libérer) ou NULL si l'allocation a échoué
+ */
+unsigned char *encode_pcm(short *pcm, long long frames, size_t *size);
+
+/**
+ * \fn int save_pcm(char *path, short *pcm, long long frames)
+ * \brief Compresse des échantillons dans un fichier
+ * \param path Le chemin du fichier
+ * \param pcm Les échantillons
+ * \param frames Le nombre d'échantillons
+ * \return 0 si succès, -1 sinon
+ */
+int save_pcm(char *path, short *pcm, long long frames);
+
+/**
+ * \fn int init_pcm_reader(pcm_reader_t *reader, unsigned char *data, size_t size)
+ * \brief Prépare la lecture d'un flux compressé en mémoire
+ * \param reader Le lecteur
+ * \param data Le flux (le lecteur le libère avec end_pcm_reader)
+ * \param size La taille du flux
+ * \return 0 si succès, -1 si le flux n'est pas valide (data n'est alors pas libéré)
+ */
+int init_pcm_reader(pcm_reader_t *reader, unsigned char *data, size_t size);
+
+/**
+ * \fn int open_pcm_reader(pcm_reader_t *reader, char *path)
+ * \brief Prépare la lecture d'un fichier compressé
+ * \param reader Le lecteur
+ * \param path Le chemin du fichier
+ * \return 0 si succès, -1 si le fichier est absent ou invalide
+ */
+int open_pcm_reader(pcm_reader_t *reader, char *path);
+
+/**
+ * \fn long long read_pcm_frames(pcm_reader_t *reader, long long frame, short *buffer, long long count)
+ * \brief Décode des échantillons à partir de n'importe quelle position
+ * \param reader Le lecteur
+ * \param frame La position du premier échantillon
+ * \param buffer Le buffer à remplir
+ * \param count Le nombre d'échantillons demandés
+ * \return Le nombre d'échantillons décodés (moins que count en fin de flux), -1 si un bloc est corrompu
+ * \note Seuls les blocs couvrant la plage demandée sont décodés
+ */
+long long read_pcm_frames(pcm_reader_t *reader, long long frame, short *buffer, long long count);
+
+/**
+ * \fn void end_pcm_reader(pcm_reader_t *reader)
+ * \brief Libère le lecteur et son flux
+ * \param reader Le lecteur
+ */
+void end_pcm_reader(pcm_reader_t *reader);
+
+/**
+ * \fn short *load_pcm(char *path, long long *frames)
+ * \brief Décode un fichier compressé en entier
+ * \param path Le chemin du fichier
+ * \param frames Le nombre d'échantillons décodés
+ * \return Les échantillons (à libérer) ou NULL si le fichier est absent ou invalide
+ */
+short *load_pcm(char *path, long long *frames);
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * \file piplugin.h
+ * \brief ABI des instruments chargés dynamiquement
+ * \details Un plugin est une bibliothèque partagée (.so) qui exporte la fonction
+ * PIPLUGIN_ENTRY. Celle-ci retourne la description de l'instrument : son nom et ses
+ * fonctions, appelées une fois par bloc d'échantillons (jamais par échantillon).
+ *
+ * Contrat du rendu, pour chaque voix (voiceSize octets fournis par l'appelant) :
+ * - note_on est appelé une fois au début de la note. offset est la position du premier
+ *   échantillon qui sera calculé : non nul quand la lecture reprend au milieu de la note ;
+ * - render calcule les échantillons suivants de la voix, bloc après bloc : l'état peut garder
+ *   filtres, enveloppes ou graines d'un bloc à l'autre ;
+ * - note_off est appelé quand la note se termine ou est coupée. render est encore appelé
+ *   pour la fin de note tant qu'il retourne une valeur non nulle, au plus
+ *   PIPLUGIN_MAX_RELEASE_FRAMES échantillons, mélangée au début de la note suivante ;
+ * - l'état d'une voix est copié octet par octet d'un thread à l'autre : il ne contient pas
+ *   de pointeur vers lui-même ;
+ * - note_on, render et note_off peuvent être appelés en même temps pour des voix différentes,
+ *   depuis des threads temps réel : ni allocation, ni verrou, ni entrée/sortie ;
+ * - les effets du capteur sont appliqués par le programme après render, sauf à la fin de note.
+ *
+ * Le rendu hors temps réel (boucles, exports) recommence une voix à chaque bloc : note_on à
+ * la position du bloc, render, puis note_off sans fin de note.
+ *
+ * Ce fichier ne dépend d'aucun autre en-tête du projet : il suffit pour compiler un plugin
+ * (gcc -shared -fPIC -o mon_instrument.so mon_instrument.c -Iinclude).
+ */
+#ifndef PIPLUGIN_H
+#define PIPLUGIN_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define PIPLUGIN_ABI_VERSION 2 /*!< Version de l'ABI, incrémentée à chaque changement incompatible */
+#define PIPLUGIN_ENTRY "piplugin_entry" /*!< Nom de la fonction exportée par un plugin */
+#define PIPLUGIN_NAME_LENGTH 4 /*!< Longueur du nom affiché dans le séquenceur */
+#define PIPLUGIN_MAX_VOICE_SIZE 256 /*!< Taille maximale de l'état d'une voix (octets) */
+#define PIPLUGIN_MAX_RELEASE_FRAMES 48000 /*!< Durée maximale d'une fin de note après note_off (1 s à 48 kHz) */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct piplugin_t
+ * \brief Description d'un instrument
+ */
+typedef struct {
+    unsigned int abiVersion; /*!< PIPLUGIN_ABI_VERSION à la compilation du plugin */
+    char name[PIPLUGIN_NAME_LENGTH + 1]; /*!< Nom affiché dans le séquenceur (complété par des espaces) */
+    size_t voiceSize; /*!< Taille de l'état d'une voix (au plus PIPLUGIN_MAX_VOICE_SIZE) */
+    int (*init)(void **plugin, unsigned int sampleRate, int amplitude); /*!< Initialise l'instrument (0 si succès) : amplitude est celle d'une note des instruments internes */
+    void (*note_on)(void *plugin, void *voice, double freq, size_t offset); /*!< Initialise l'état d'une voix pour une note jouée à partir de offset */
+    int (*render)(void *plugin, void *voice, short *buffer, size_t frames); /*!< Calcule les frames échantillons suivants de la voix (après note_off : 0 quand la fin de note est terminée) */
+    void (*note_off)(void *plugin, void *voice); /*!< Termine ou coupe la note (peut être NULL : la voix s'arrête net) */
+    void (*free)(void *plugin); /*!< Libère l'instrument (peut être NULL) */
+} piplugin_t;
+
+/**
+ * \brief Signature de la fonction PIPLUGIN_ENTRY
+ */
+typedef const piplugin_t *(*piplugin_entry_t)(void);
+
+#endif
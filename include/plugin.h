@@ -0,0 +1,155 @@
+/**
+ * \file plugin.h
+ * \brief Chargement des instruments en plugins (voir piplugin.h)
+ * \details Les fichiers .so de PLUGIN_DIR sont chargés au démarrage, dans l'ordre
+ * alphabétique : le k-ième plugin chargé devient l'instrument INSTRUMENT_NB + k. Un plugin
+ * compilé pour une autre architecture ou une autre version de l'ABI est ignoré. La liste
+ * ne change plus ensuite : elle est lue sans verrou par les threads audio. Le moteur
+ * garde l'état des voix d'un channel (plugin_voices_t) de note_on à la fin de note.
+ */
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include "piplugin.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define PLUGIN_DIR "ressources/plugins" /*!< Dossier des plugins */
+#define PLUGIN_EXTENSION ".so" /*!< Extension des plugins */
+#define PLUGIN_MAX 16 /*!< Nombre maximal de plugins chargés */
+#define PLUGIN_RELEASE_BLOCK 256 /*!< Échantillons de fin de note calculés par appel à render */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct plugin_t
+ * \brief Plugin chargé
+ */
+typedef struct {
+    void *handle; /*!< Bibliothèque ouverte par dlopen */
+    const piplugin_t *abi; /*!< Description et fonctions de l'instrument */
+    void *state; /*!< État de l'instrument retourné par init */
+} plugin_t;
+
+/**
+ * \struct plugin_voice_t
+ * \brief Voix d'un plugin, de note_on à la fin de note qui suit note_off
+ */
+typedef struct {
+    const plugin_t *plugin; /*!< Plugin qui joue la voix (NULL : voix libre) */
+    int released; /*!< note_off a été appelé : la voix joue sa fin de note */
+    long long releaseFrames; /*!< Échantillons de fin de note déjà calculés */
+    long double state[PIPLUGIN_MAX_VOICE_SIZE / sizeof(long double) + 1]; /*!< État de la voix (aligné pour n'importe quel type) */
+} plugin_voice_t;
+
+/**
+ * \struct plugin_voices_t
+ * \brief Voix des plugins d'un channel
+ * \details La note courante et la fin de la note précédente, qui se mélange au début de la
+ * suivante. Comme l'état des voix, la structure se copie octet par octet.
+ */
+typedef struct {
+    plugin_voice_t slots[2]; /*!< Voix de la note courante et de la fin de note précédente */
+    int current; /*!< Indice de la voix de la note courante */
+} plugin_voices_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int load_plugins(const char *dir, unsigned int sampleRate, int amplitude)
+ * \brief Charge les plugins d'un dossier
+ * \param dir Le dossier (PLUGIN_DIR)
+ * \param sampleRate La fréquence d'échantillonnage du rendu
+ * \param amplitude L'amplitude d'une note des instruments internes
+ * \return Le nombre de plugins chargés, -1 si le dossier n'a pas pu être lu
+ * \warning À appeler avant de démarrer les threads audio
+ */
+int load_plugins(const char *dir, unsigned int sampleRate, int amplitude);
+
+/**
+ * \fn void unload_plugins()
+ * \brief Libère et ferme tous les plugins
+ * \warning Les threads audio doivent être arrêtés
+ */
+void unload_plugins();
+
+/**
+ * \fn int nb_plugins()
+ * \brief Nombre de plugins chargés
+ * \return Le nombre de plugins
+ */
+int nb_plugins();
+
+/**
+ * \fn const plugin_t *instrument_plugin(int instrument)
+ * \brief Plugin d'un instrument
+ * \param instrument L'instrument (instrument_t)
+ * \return Le plugin ou NULL si l'instrument est interne ou n'est pas chargé
+ */
+const plugin_t *instrument_plugin(int instrument);
+
+/**
+ * \fn void plugin_render(const plugin_t *plugin, short *buffer, double freq, size_t offset, size_t frames)
+ * \brief Calcule un bloc isolé d'une note jouée par un plugin (rendu hors temps réel)
+ * \param plugin Le plugin
+ * \param buffer Le buffer à remplir
+ * \param freq La fréquence de la note
+ * \param offset La position du premier échantillon depuis le début de la note
+ * \param frames Le nombre d'échantillons
+ * \note La voix est sur la pile : note_on à offset, render, puis note_off sans fin de note
+ */
+void plugin_render(const plugin_t *plugin, short *buffer, double freq, size_t offset, size_t frames);
+
+/**
+ * \fn void plugin_voices_start(plugin_voices_t *voices, const plugin_t *plugin, double freq, size_t offset)
+ * \brief Commence une note sur les voix d'un channel
+ * \param voices Les voix du channel
+ * \param plugin Le plugin de la note (NULL pour un instrument interne ou une ligne vide)
+ * \param freq La fréquence de la note
+ * \param offset La position du premier échantillon calculé depuis le début de la note
+ * \note La note courante reçoit note_off et joue sa fin de note. Une fin de note plus
+ * ancienne est coupée
+ */
+void plugin_voices_start(plugin_voices_t *voices, const plugin_t *plugin, double freq, size_t offset);
+
+/**
+ * \fn void plugin_voices_render(plugin_voices_t *voices, short *buffer, size_t frames)
+ * \brief Calcule le bloc suivant de la note courante
+ * \param voices Les voix du channel
+ * \param buffer Le buffer à remplir (silence si aucun plugin ne joue la note)
+ * \param frames Le nombre d'échantillons
+ */
+void plugin_voices_render(plugin_voices_t *voices, short *buffer, size_t frames);
+
+/**
+ * \fn void plugin_voices_mix_release(plugin_voices_t *voices, short *buffer, size_t frames)
+ * \brief Ajoute le bloc suivant de la fin de note précédente
+ * \param voices Les voix du channel
+ * \param buffer Le buffer auquel ajouter la fin de note (saturé)
+ * \param frames Le nombre d'échantillons
+ * \note La voix est libérée quand render retourne 0 ou après PIPLUGIN_MAX_RELEASE_FRAMES
+ */
+void plugin_voices_mix_release(plugin_voices_t *voices, short *buffer, size_t frames);
+
+/**
+ * \fn void plugin_voices_cut(plugin_voices_t *voices)
+ * \brief Coupe les voix d'un channel (arrêt ou déplacement de la lecture, fin du channel)
+ * \param voices Les voix du channel
+ * \note La note courante reçoit note_off, aucune fin de note n'est plus calculée
+ */
+void plugin_voices_cut(plugin_voices_t *voices);
+
+#endif
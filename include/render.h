@@ -0,0 +1,81 @@
+/**
+ * \file render.h
+ * \brief Rendu hors temps réel d'une partie de la musique
+ * \details Mélange tous les channels entre deux positions musicales dans un buffer.
+ * Les positions sont converties en échantillons depuis le début de la musique,
+ * exactement comme le fait le moteur audio : un rendu est identique à la lecture.
+ * Un pattern joué plusieurs fois au même tempo (voir pattern.h) n'est calculé qu'une fois.
+ */
+#ifndef RENDER_H
+#define RENDER_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdlib.h>
+#include <string.h>
+#include "note.h"
+#include "pattern.h"
+#include "sound.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define RENDER_BLOCK_FRAMES 4096 /*!< Nombre d'échantillons calculés à la fois pour une note */
+#define RENDER_MAX_AMPLITUDE 32767 /*!< Amplitude maximale après mixage */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct render_pattern_t
+ * \brief Audio d'un pattern gardé pendant un rendu
+ * \details Les échantillons d'une note ne dépendent que de la note et de sa position
+ * depuis le début de la note : sans changement de tempo, l'audio d'un pattern ne dépend que
+ * du tempo et de l'écart de phase entre son début et l'échantillon qui le joue.
+ */
+typedef struct {
+    short *pcm; /*!< Les échantillons du pattern (NULL s'il n'est pas calculé) */
+    long long frames; /*!< Nombre d'échantillons */
+    short bpm; /*!< Tempo du calcul */
+    long long residue; /*!< Écart de phase du premier échantillon au début du pattern */
+    int uses; /*!< Nombre de rangées du rendu qui jouent encore le pattern */
+} render_pattern_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn long long render_frames(music_t *music, long long tickStart, long long tickEnd)
+ * \brief Nombre d'échantillons entre deux positions musicales
+ * \param music La musique
+ * \param tickStart La position de début (en doubles croches)
+ * \param tickEnd La position de fin (en doubles croches)
+ * \return Le nombre d'échantillons du rendu
+ */
+long long render_frames(music_t *music, long long tickStart, long long tickEnd);
+
+/**
+ * \fn short *render_music(music_t *music, long long tickStart, long long tickEnd, long long *frames)
+ * \brief Calcule le mélange de tous les channels entre deux positions musicales
+ * \param music La musique
+ * \param tickStart La position de début (en doubles croches)
+ * \param tickEnd La position de fin (en doubles croches)
+ * \param frames Le nombre d'échantillons calculés
+ * \return Le buffer alloué (à libérer avec free) ou NULL si la partie est vide
+ * \note Aucun effet n'est appliqué
+ */
+short *render_music(music_t *music, long long tickStart, long long tickEnd, long long *frames);
+
+/**
+ * \fn void mix2pcm(int *mix, short *buffer, size_t frames)
+ * \brief Ramène un mélange dans la plage d'un short
+ * \param mix Le mélange (somme des voix)
+ * \param buffer Le buffer de sortie
+ * \param frames Le nombre d'échantillons
+ */
+void mix2pcm(int *mix, short *buffer, size_t frames);
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * \file resample.h
+ * \brief Conversion de fréquence d'échantillonnage
+ * \details Le convertisseur est polyphase : pour un rapport de fréquences réduit L/M, les L
+ * phases du filtre (sinus cardinal fenêtré par Kaiser) sont calculées à l'initialisation et
+ * chaque échantillon de sortie ne coûte qu'un produit scalaire de la taille du filtre. Le
+ * mode linéaire utilise la même structure avec un filtre de deux points.
+ * Le convertisseur garde son historique entre deux appels : il peut être placé sur un flux
+ * découpé en périodes (sortie du moteur) comme sur un fichier entier (banque de samples).
+ */
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define RESAMPLE_FAST_TAPS 16 /*!< Taille du filtre en qualité RESAMPLE_SINC_FAST */
+#define RESAMPLE_BEST_TAPS 48 /*!< Taille du filtre en qualité RESAMPLE_SINC_BEST */
+#define RESAMPLE_MAX_TAPS 256 /*!< Taille maximale du filtre (fort sous-échantillonnage) */
+#define RESAMPLE_FAST_BETA 6.0 /*!< Paramètre de la fenêtre de Kaiser en qualité RESAMPLE_SINC_FAST */
+#define RESAMPLE_BEST_BETA 9.0 /*!< Paramètre de la fenêtre de Kaiser en qualité RESAMPLE_SINC_BEST */
+#define RESAMPLE_ROLLOFF 0.92 /*!< Fréquence de coupure en fraction de la plus petite fréquence de Nyquist */
+#define RESAMPLE_MAX_PHASES 1024 /*!< Nombre maximal de phases (au-delà, la phase est arrondie) */
+#define RESAMPLE_CHUNK 1024 /*!< Nombre d'échantillons d'entrée traités à la fois */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \enum resample_quality_t
+ * \brief Qualité de conversion, de la moins coûteuse à la plus fidèle
+ */
+typedef enum {
+    RESAMPLE_LINEAR = 0, /*!< Interpolation linéaire : 2 produits par échantillon, repliement audible dans les aigus */
+    RESAMPLE_SINC_FAST, /*!< Sinus cardinal sur RESAMPLE_FAST_TAPS points */
+    RESAMPLE_SINC_BEST, /*!< Sinus cardinal sur RESAMPLE_BEST_TAPS points */
+    RESAMPLE_NB_QUALITIES /*!< Nombre de qualités */
+} resample_quality_t;
+
+/**
+ * \struct resampler_t
+ * \brief Convertisseur de fréquence d'un flux mono 16 bits
+ */
+typedef struct {
+    unsigned int inRate; /*!< Fréquence d'entrée */
+    unsigned int outRate; /*!< Fréquence de sortie */
+    resample_quality_t quality; /*!< Qualité de conversion */
+    unsigned int denominator; /*!< L : une position d'entrée est comptée en 1/L d'échantillon */
+    unsigned int stepInt; /*!< Avance en entrée par échantillon de sortie (partie entière) */
+    unsigned int stepFrac; /*!< Avance en entrée par échantillon de sortie (en 1/L) */
+    unsigned int phases; /*!< Nombre de phases du filtre */
+    int taps; /*!< Taille du filtre */
+    float *filters; /*!< Phases du filtre (phases x taps coefficients) */
+    float *work; /*!< Historique (taps - 1 échantillons) suivi des échantillons en cours */
+    long long index; /*!< Premier échantillon de work utilisé par le prochain échantillon de sortie */
+    unsigned int frac; /*!< Position du prochain échantillon de sortie entre deux entrées (en 1/L) */
+    int linear; /*!< Interpolation linéaire forcée à la place du filtre (charge trop élevée) */
+} resampler_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_resampler(resampler_t *resampler, unsigned int inRate, unsigned int outRate, resample_quality_t quality)
+ * \brief Calcule les phases du filtre d'un convertisseur
+ * \param resampler Le convertisseur
+ * \param inRate La fréquence d'entrée
+ * \param outRate La fréquence de sortie
+ * \param quality La qualité de conversion
+ * \return 0 si succès, -1 si les paramètres sont invalides ou si l'allocation a échoué
+ */
+int init_resampler(resampler_t *resampler, unsigned int inRate, unsigned int outRate, resample_quality_t quality);
+
+/**
+ * \fn void reset_resampler(resampler_t *resampler)
+ * \brief Vide l'historique du convertisseur (début d'un nouveau flux)
+ * \param resampler Le convertisseur
+ */
+void reset_resampler(resampler_t *resampler);
+
+/**
+ * \fn void end_resampler(resampler_t *resampler)
+ * \brief Libère le convertisseur
+ * \param resampler Le convertisseur
+ */
+void end_resampler(resampler_t *resampler);
+
+/**
+ * \fn void resample_set_linear(resampler_t *resampler, int linear)
+ * \brief Remplace le filtre par une interpolation linéaire (ou le rétablit)
+ * \param resampler Le convertisseur
+ * \param linear 1 pour l'interpolation linéaire
+ * \note L'historique et la position sont conservés : le changement peut se faire entre
+ * deux périodes sans décalage du flux
+ */
+void resample_set_linear(resampler_t *resampler, int linear);
+
+/**
+ * \fn size_t resample_max_frames(resampler_t *resampler, size_t frames)
+ * \brief Nombre maximal d'échantillons produits pour un nombre d'échantillons d'entrée
+ * \param resampler Le convertisseur
+ * \param frames Le nombre d'échantillons d'entrée
+ * \return La taille minimale du buffer de sortie de resample
+ */
+size_t resample_max_frames(resampler_t *resampler, size_t frames);
+
+/**
+ * \fn int resample_latency(resampler_t *resampler)
+ * \brief Retard du flux converti
+ * \param resampler Le convertisseur
+ * \return Le nombre d'échantillons d'entrée gardés avant de pouvoir produire une sortie
+ */
+int resample_latency(resampler_t *resampler);
+
+/**
+ * \fn size_t resample(resampler_t *resampler, const short *in, size_t frames, short *out)
+ * \brief Convertit un morceau du flux
+ * \param resampler Le convertisseur
+ * \param in Les échantillons d'entrée
+ * \param frames Le nombre d'échantillons d'entrée (tous sont consommés)
+ * \param out Le buffer de sortie (au moins resample_max_frames échantillons)
+ * \return Le nombre d'échantillons produits
+ * \note Ne fait aucune allocation : peut être appelé depuis le thread de mixage
+ */
+size_t resample(resampler_t *resampler, const short *in, size_t frames, short *out);
+
+/**
+ * \fn short *resample_buffer(const short *in, size_t frames, unsigned int inRate, unsigned int outRate, resample_quality_t quality, size_t *outFrames)
+ * \brief Convertit un signal entier, sans retard
+ * \param in Les échantillons d'entrée
+ * \param frames Le nombre d'échantillons d'entrée
+ * \param inRate La fréquence d'entrée
+ * \param outRate La fréquence de sortie
+ * \param quality La qualité de conversion
+ * \param outFrames Le nombre d'échantillons produits
+ * \return Les échantillons convertis (à libérer) ou NULL en cas d'erreur
+ */
+short *resample_buffer(const short *in, size_t frames, unsigned int inRate, unsigned int outRate, resample_quality_t quality, size_t *outFrames);
+
+/**
+ * \fn const char *resample_quality_name(resample_quality_t quality)
+ * \brief Nom d'une qualité de conversion (benchmarks)
+ * \param quality La qualité
+ * \return "linear", "sinc_fast" ou "sinc_best"
+ */
+const char *resample_quality_name(resample_quality_t quality);
+
+#endif
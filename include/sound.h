@@ -16,6 +16,9 @@
 #include <unistd.h> 
 #include <pthread.h>
 #include "note.h"
+#include "audiostats.h"
+#include "resample.h"
+#include "plugin.h"
 
 /* ------------------------------------------------------------------------ */
 /*              C O N S T A N T E S     S Y M B O L I Q U E S               */
@@ -23,6 +26,17 @@
 
 #define SAMPLE_RATE 48000
 #define BASE_AMPLITUDE 10000
+#define SOUND_PERIOD_TIME 100000 /*!< Durée d'une période ALSA en microsecondes */
+#define SOUND_PERIOD_FRAMES (SAMPLE_RATE / (1000000 / SOUND_PERIOD_TIME)) /*!< Nombre d'échantillons dans une période */
+#define SOUND_TICK_PHASE (SAMPLE_RATE * 15LL) /*!< Phase d'une double croche : à bpm donné, la phase avance de bpm par échantillon */
+#define SOUND_SAMPLE_QUALITY RESAMPLE_SINC_BEST /*!< Qualité de conversion des samples chargés à une autre fréquence */
+#define SOUND_ALL_PARTIALS 16 /*!< Nombre de partiels au-delà de celui de chaque instrument additif */
+#define SOUND_ORGAN_REDUCED_PARTIALS 2 /*!< Tirettes de l'orgue calculées en qualité réduite (sur 3) */
+#define SOUND_PIANO_REDUCED_PARTIALS 3 /*!< Partiels du piano calculés en qualité réduite (sur 5) */
+#define SOUND_WARM_REDUCED_PARTIALS 4 /*!< Harmoniques de la scie calculées en qualité réduite (sur 10) */
+#ifndef SOUND_DETERMINISTIC
+#define SOUND_DETERMINISTIC 0 /*!< 1 pour démarrer en rendu déterministe (voir set_sound_deterministic) */
+#endif
 
 /* ------------------------------------------------------------------------ */
 /*                    M A C R O    F O N C T I O N S                        */
@@ -32,7 +46,18 @@
 /*              D É F I N I T I O N S   D E   T Y P E S                     */
 /* ------------------------------------------------------------------------ */
 
-
+/**
+ * \enum sound_quality_t
+ * \brief Niveaux de qualité du rendu, chacun comprend les réductions du précédent
+ * \note Le rendu hors temps réel (render_note) est toujours en SOUND_QUALITY_FULL
+ */
+typedef enum {
+    SOUND_QUALITY_FULL = 0, /*!< Tous les partiels, effets appliqués */
+    SOUND_QUALITY_PARTIALS, /*!< Partiels les plus faibles de l'orgue, du piano et de la scie supprimés */
+    SOUND_QUALITY_LINEAR, /*!< Interpolation linéaire en sortie quand le flux est converti */
+    SOUND_QUALITY_NO_EFFECTS, /*!< Effets (fuzz, compression) coupés */
+    SOUND_NB_QUALITIES /*!< Nombre de niveaux */
+} sound_quality_t;
 
 /* ------------------------------------------------------------------------ */
 /*            P R O T O T Y P E S    D E    F O N C T I O N S               */
@@ -50,8 +75,21 @@ void init_sound(snd_pcm_t **pcm);
  * \brief joue une note 
  * \param bpm le bpm de la musique 
  * \param note la note à jouer 
+ * \param stats les statistiques audio à mettre à jour (peut être NULL)
  */
-void play_note(note_t note,short bpm,snd_pcm_t *pcm,short effect);
+void play_note(note_t note,short bpm,snd_pcm_t *pcm,short effect,audio_stats_t *stats);
+
+/**
+ * \fn int write_pcm(snd_pcm_t *pcm, short *buffer, size_t frames, audio_stats_t *stats)
+ * \brief écrit un buffer dans le flux en récupérant les xruns
+ * \param pcm le flux
+ * \param buffer les échantillons à écrire
+ * \param frames le nombre d'échantillons
+ * \param stats les statistiques audio à mettre à jour (peut être NULL)
+ * \return le nombre d'échantillons écrits, ou un code d'erreur ALSA négatif si le flux est perdu
+ * \note en cas d'xrun le flux est récupéré avec snd_pcm_recover et l'écriture reprend
+ */
+long write_pcm(snd_pcm_t *pcm, short *buffer, size_t frames, audio_stats_t *stats);
 
 /**
  * \fn void end_sound(snd_pcm_t *pcm);
@@ -60,9 +98,182 @@ void play_note(note_t note,short bpm,snd_pcm_t *pcm,short effect);
 void end_sound(snd_pcm_t *pcm);
 
 
+/**
+ * \fn void render_note(short *buffer, note_t note, size_t offset, size_t count, short effect)
+ * \brief calcule un morceau d'une note
+ * \param buffer le buffer à remplir
+ * \param note la note à jouer
+ * \param offset position du premier échantillon à calculer depuis le début de la note
+ * \param count nombre d'échantillons à calculer
+ * \param effect l'effet à appliquer
+ * \note permet de calculer une note période par période, sans connaître sa durée
+ */
+void render_note(short *buffer, note_t note, size_t offset, size_t count, short effect);
+
+/**
+ * \fn void render_note_quality(short *buffer, note_t note, size_t offset, size_t count, short effect, sound_quality_t quality)
+ * \brief calcule un morceau d'une note à un niveau de qualité donné
+ * \param buffer le buffer à remplir
+ * \param note la note à jouer
+ * \param offset position du premier échantillon à calculer depuis le début de la note
+ * \param count nombre d'échantillons à calculer
+ * \param effect l'effet à appliquer (ignoré à partir de SOUND_QUALITY_NO_EFFECTS)
+ * \param quality le niveau de qualité (voir governor.h)
+ */
+void render_note_quality(short *buffer, note_t note, size_t offset, size_t count, short effect, sound_quality_t quality);
+
+/**
+ * \fn void render_note_voice(short *buffer, note_t note, plugin_voices_t *voices, int start, size_t offset, size_t count, short effect, sound_quality_t quality)
+ * \brief calcule le morceau suivant de la note d'un channel, voix des plugins comprises
+ * \param buffer le buffer à remplir
+ * \param note la note à jouer
+ * \param voices les voix des plugins du channel
+ * \param start 1 si le morceau est le premier calculé de la note (note_on)
+ * \param offset position du premier échantillon à calculer depuis le début de la note
+ * \param count nombre d'échantillons à calculer
+ * \param effect l'effet à appliquer (ignoré à partir de SOUND_QUALITY_NO_EFFECTS)
+ * \param quality le niveau de qualité (voir governor.h)
+ * \note Les morceaux d'une note sont calculés dans l'ordre : un plugin reçoit note_on au début
+ * de la note et note_off au début de la suivante. La fin de la note précédente est ajoutée
+ * sans effet
+ */
+void render_note_voice(short *buffer, note_t note, plugin_voices_t *voices, int start, size_t offset, size_t count, short effect, sound_quality_t quality);
+
+/**
+ * \fn const char *sound_quality_name(sound_quality_t quality)
+ * \brief nom d'un niveau de qualité
+ * \param quality le niveau
+ * \return "full", "partials", "linear" ou "no_effects"
+ */
+const char *sound_quality_name(sound_quality_t quality);
+
+/**
+ * \fn void set_sound_deterministic(int enabled)
+ * \brief active ou coupe le rendu déterministe
+ * \param enabled 1 pour calculer les instruments internes et les effets en virgule fixe (detmath.h)
+ * \note en mode déterministe, une musique donne exactement le même PCM sur la carte et sur le PC
+ * (empreinte det_hash identique). Les plugins et les samples chargés ne sont pas concernés.
+ */
+void set_sound_deterministic(int enabled);
+
+/**
+ * \fn int sound_deterministic()
+ * \brief indique si le rendu déterministe est actif
+ * \return 1 si actif, 0 sinon
+ */
+int sound_deterministic();
+
+/**
+ * \fn  noteToFreq()
+ * \brief transforme une note en fréquence
+ * \param note_t note note à jouer
+ * \return frequence de la note en double
+ */
+double noteToFreq(note_t note);
+
+/**
+ * \fn  noteToTime()
+ * \brief transforme une note en temps
+ * \param note_t note note à jouer
+ * \param short bpm bpm de la musique
+ * \return time temps de la note en double
+ */
+size_t noteToTime(note_t note, short bpm);
+
+/**
+ * \fn  fuzz_effect()
+ * \brief applique une distorsion (tanh) sur un buffer
+ * \param buffer le buffer à modifier
+ * \param sample_count nombre d'échantillons
+ * \return le pointeur sur le buffer
+ */
+short *fuzz_effect(short *buffer,size_t sample_count);
+
+/**
+ * \fn  compression_effect()
+ * \brief compresse les échantillons au-delà de la moitié de l'amplitude
+ * \param buffer le buffer à modifier
+ * \param time nombre d'échantillons
+ * \return le pointeur sur le buffer
+ */
+short * compression_effect(short *buffer,size_t time);
+
+/**
+ * \fn long long ticksToFrames(long long ticks, short bpm)
+ * \brief transforme une position musicale en nombre d'échantillons
+ * \param ticks la position en doubles croches (unité de time_duration_t)
+ * \param bpm bpm de la musique
+ * \return le nombre d'échantillons depuis le début de la musique
+ */
+long long ticksToFrames(long long ticks, short bpm);
+
+/**
+ * \fn long long framesToTicks(long long frames, short bpm)
+ * \brief transforme un nombre d'échantillons en position musicale
+ * \param frames le nombre d'échantillons depuis le début de la musique
+ * \param bpm bpm de la musique
+ * \return la dernière double croche commencée (réciproque exacte de ticksToFrames)
+ */
+long long framesToTicks(long long frames, short bpm);
+
+/**
+ * \fn long long phaseToFrames(long long phase, long long target, short bpm)
+ * \brief nombre d'échantillons pour amener la phase du transport jusqu'à une cible
+ * \param phase la phase actuelle (en 1/SOUND_TICK_PHASE de double croche)
+ * \param target la phase à atteindre
+ * \param bpm le tempo : la phase avance de bpm à chaque échantillon
+ * \return le nombre d'échantillons (0 si la cible est déjà atteinte)
+ */
+long long phaseToFrames(long long phase, long long target, short bpm);
+
+/**
+ * \fn long long tempoTicksToFrames(music_t *music, long long ticks)
+ * \brief transforme une position musicale en nombre d'échantillons en suivant les changements de tempo
+ * \param music la musique
+ * \param ticks la position en doubles croches
+ * \return le nombre d'échantillons depuis le début de la musique
+ * \note donne exactement les mêmes échantillons que le transport du moteur audio
+ * (sans tempo modifié en direct) : un rendu hors temps réel est identique à la lecture
+ */
+long long tempoTicksToFrames(music_t *music, long long ticks);
+
+/**
+ * \fn int init_sound_period(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods)
+ * \brief initialise le flux avec une taille de période donnée
+ * \param pcm le flux à ouvrir
+ * \param periodFrames le nombre d'échantillons par période
+ * \param periods le nombre de périodes dans le tampon
+ * \return 0 si le flux est ouvert, un code d'erreur ALSA négatif sinon
+ * \note échoue si le périphérique n'accepte pas SAMPLE_RATE (voir init_sound_rate)
+ */
+int init_sound_period(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods);
+
+/**
+ * \fn int init_sound_rate(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods, unsigned int *rate)
+ * \brief initialise le flux à la fréquence la plus proche de SAMPLE_RATE acceptée par le périphérique
+ * \param pcm le flux à ouvrir
+ * \param periodFrames le nombre d'échantillons par période à SAMPLE_RATE
+ * \param periods le nombre de périodes dans le tampon
+ * \param rate la fréquence obtenue (NULL pour exiger SAMPLE_RATE)
+ * \return 0 si le flux est ouvert, un code d'erreur ALSA négatif sinon
+ * \note si la fréquence obtenue diffère de SAMPLE_RATE, les échantillons doivent être
+ * convertis (resample.h) avant d'être écrits, sinon la hauteur des notes est fausse
+ */
+int init_sound_rate(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods, unsigned int *rate);
+
+/**
+ * \fn short *load_sample(char *path, size_t *frames)
+ * \brief charge un sample et le convertit à SAMPLE_RATE
+ * \param path le fichier : WAV PCM 16 bits (mono ou stéréo, à n'importe quelle fréquence)
+ * ou échantillons bruts 16 bits mono à SAMPLE_RATE
+ * \param frames le nombre d'échantillons chargés
+ * \return les échantillons (à libérer) ou NULL si le fichier est absent ou invalide
+ */
+short *load_sample(char *path, size_t *frames);
+
 /**
  * \fn  play_sample(FILE *f,snd_pcm_t *pcm);
- * \brief joue un sample
+ * \brief joue un sample (voir load_sample)
  */
 void play_sample(char * fic,snd_pcm_t *pcm);
 
@@ -0,0 +1,214 @@
+/**
+ * \file stepper.h
+ * \brief Channel moteur pas à pas : les notes sont jouées par des trains de pas
+ * \details Le moteur audio envoie les morceaux de notes INSTRUMENT_STEPMOTOR qu'il calcule,
+ * datés en échantillons du transport. Un thread temps réel dédié convertit ces positions
+ * en temps absolu grâce à la position audible publiée par le moteur et attend chaque pas
+ * avec clock_nanosleep(TIMER_ABSTIME) : l'erreur ne s'accumule pas d'un pas à l'autre et le
+ * moteur reste calé sur le haut-parleur. Les GPIO passent par une couche d'abstraction :
+ * wiringPi sur la carte, ou une simulation qui enregistre la date de chaque pas.
+ */
+#ifndef STEPPER_H
+#define STEPPER_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include "note.h"
+#include "sound.h"
+#include "audiostats.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define STEPPER_PINS {0, 4, 5, 7} /*!< Bobines du moteur (numérotation wiringPi, broches utilisées par aucun autre périphérique) */
+#define STEPPER_NB_PINS 4 /*!< Nombre de bobines */
+#define STEPPER_SEQUENCE {0x1, 0x2, 0x4, 0x8} /*!< Séquence des bobines alimentées (pas entier) */
+#define STEPPER_SEQUENCE_LENGTH 4 /*!< Nombre de pas de la séquence */
+#define STEPPER_MIN_FREQ 50.0 /*!< Fréquence de pas minimale audible (Hz) */
+#define STEPPER_MAX_FREQ 800.0 /*!< Fréquence de pas maximale avant que le moteur ne décroche (Hz) */
+#define STEPPER_RING_SIZE 64 /*!< Nombre de morceaux de notes en attente (puissance de 2) */
+#define STEPPER_IDLE_NS 1000000LL /*!< Attente du thread quand aucun morceau n'est en attente */
+#define STEPPER_LATE_NS 2000000LL /*!< Retard au-delà duquel un pas est abandonné plutôt que joué */
+#define STEPPER_JITTER_BUCKETS 11 /*!< Nombre de cases de l'histogramme de gigue (10 tranches + dépassement) */
+#define STEPPER_JITTER_BUCKET_NS 10000 /*!< Largeur d'une case de l'histogramme de gigue (10 µs) */
+#define STEPPER_SIM_PULSES 65536 /*!< Nombre de pas enregistrés par la simulation */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct stepper_gpio_t
+ * \brief Couche d'abstraction des GPIO du moteur
+ * \details Une implémentation fournit setup, write et release. La simulation ne touche
+ * aucun GPIO : elle enregistre la date prévue et la date réelle de chaque pas.
+ */
+typedef struct stepper_gpio_s {
+    int (*setup)(struct stepper_gpio_s *gpio); /*!< Prépare les GPIO (0 si succès, -1 sinon) */
+    void (*write)(struct stepper_gpio_s *gpio, int pattern, long long targetNs); /*!< Alimente les bobines du masque pattern */
+    void (*release)(struct stepper_gpio_s *gpio); /*!< Coupe les bobines */
+    long long *targets; /*!< Dates prévues des pas (simulation) */
+    long long *pulses; /*!< Dates réelles des pas (simulation) */
+    int nbPulses; /*!< Nombre de pas enregistrés (simulation) */
+    int maxPulses; /*!< Capacité des tableaux d'enregistrement (simulation) */
+} stepper_gpio_t;
+
+/**
+ * \struct stepper_segment_t
+ * \brief Morceau de note à jouer sur le moteur
+ */
+typedef struct {
+    long long frame; /*!< Position du transport du premier échantillon */
+    long long frames; /*!< Nombre d'échantillons */
+    double freq; /*!< Fréquence des pas (Hz) */
+    int restart; /*!< Le morceau commence une nouvelle note */
+} stepper_segment_t;
+
+/**
+ * \struct stepper_t
+ * \brief Channel moteur pas à pas
+ * \details Le moteur audio est le seul producteur de la file et le thread du moteur pas à pas
+ * le seul consommateur : aucun verrou n'est pris pendant le calcul d'une période.
+ */
+typedef struct {
+    stepper_gpio_t *gpio; /*!< GPIO du moteur */
+    pthread_t thread; /*!< Thread temps réel des pas */
+    int running; /*!< Le thread tourne */
+    int claimed; /*!< GPIO préparés au premier morceau joué (0 : pas encore, -1 : échec) */
+    stepper_segment_t ring[STEPPER_RING_SIZE]; /*!< File des morceaux à jouer */
+    unsigned int head; /*!< Prochaine case écrite par le moteur audio */
+    unsigned int tail; /*!< Prochaine case lue par le thread */
+    unsigned int flush; /*!< Les cases avant celle-ci sont abandonnées par le thread (stepper_flush) */
+    unsigned int clockSeq; /*!< Compteur de cohérence de l'horloge (impair pendant une écriture) */
+    long long clockFrame; /*!< Position du transport audible à clockNs */
+    long long clockNs; /*!< Date de la dernière synchronisation */
+    double phase; /*!< Fraction du pas en cours au début du prochain morceau */
+    int step; /*!< Position dans STEPPER_SEQUENCE */
+    pthread_mutex_t lock; /*!< Protège les statistiques */
+    unsigned long steps; /*!< Nombre de pas joués */
+    unsigned long skipped; /*!< Pas abandonnés car déjà passés */
+    unsigned long overruns; /*!< Morceaux perdus car la file était pleine */
+    long long jitterNs; /*!< Gigue cumulée en nanosecondes */
+    long long maxJitterNs; /*!< Gigue maximale en nanosecondes */
+    unsigned long histogram[STEPPER_JITTER_BUCKETS]; /*!< Répartition de la gigue par tranche de 10 µs */
+} stepper_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_stepper_gpio_wiringpi(stepper_gpio_t *gpio)
+ * \brief Prépare la couche GPIO qui pilote les bobines avec wiringPi
+ * \param gpio La couche GPIO à initialiser
+ * \warning wiringPiSetup doit avoir été appelé (init_wiringpi)
+ */
+void init_stepper_gpio_wiringpi(stepper_gpio_t *gpio);
+
+/**
+ * \fn int init_stepper_gpio_sim(stepper_gpio_t *gpio, int maxPulses)
+ * \brief Prépare une couche GPIO simulée qui enregistre la date des pas
+ * \param gpio La couche GPIO à initialiser
+ * \param maxPulses Le nombre de pas à enregistrer (les suivants ne sont que comptés)
+ * \return 0 si succès, -1 si l'allocation a échoué
+ */
+int init_stepper_gpio_sim(stepper_gpio_t *gpio, int maxPulses);
+
+/**
+ * \fn void end_stepper_gpio(stepper_gpio_t *gpio)
+ * \brief Libère la couche GPIO
+ * \param gpio La couche GPIO
+ */
+void end_stepper_gpio(stepper_gpio_t *gpio);
+
+/**
+ * \fn int init_stepper(stepper_t *stepper, stepper_gpio_t *gpio)
+ * \brief Démarre le thread temps réel du moteur
+ * \param stepper Le moteur pas à pas
+ * \param gpio La couche GPIO à utiliser
+ * \return 0 si le thread est démarré, -1 sinon
+ * \note Les GPIO ne sont préparés qu'au premier morceau de note INSTRUMENT_STEPMOTOR : une
+ * musique sans moteur pas à pas ne touche pas aux broches
+ */
+int init_stepper(stepper_t *stepper, stepper_gpio_t *gpio);
+
+/**
+ * \fn void end_stepper(stepper_t *stepper)
+ * \brief Arrête le thread et coupe les bobines
+ * \param stepper Le moteur pas à pas
+ */
+void end_stepper(stepper_t *stepper);
+
+/**
+ * \fn int stepper_push(stepper_t *stepper, long long frame, long long frames, double freq, int restart)
+ * \brief Ajoute un morceau de note à jouer
+ * \param stepper Le moteur pas à pas
+ * \param frame La position du transport du premier échantillon
+ * \param frames Le nombre d'échantillons
+ * \param freq La fréquence de la note (ramenée par octaves entre STEPPER_MIN_FREQ et STEPPER_MAX_FREQ)
+ * \param restart 1 si le morceau commence une nouvelle note
+ * \return 0 si le morceau est en file, -1 si la file est pleine
+ * \note N'attend jamais : appelé par le thread de mixage
+ */
+int stepper_push(stepper_t *stepper, long long frame, long long frames, double freq, int restart);
+
+/**
+ * \fn void stepper_sync(stepper_t *stepper, long long frame, long long ns)
+ * \brief Publie la position du transport audible à une date
+ * \param stepper Le moteur pas à pas
+ * \param frame La position du transport qui sort du haut-parleur
+ * \param ns La date correspondante (audio_clock_ns)
+ * \note N'attend jamais : appelé par le thread de mixage après chaque période
+ */
+void stepper_sync(stepper_t *stepper, long long frame, long long ns);
+
+/**
+ * \fn void stepper_flush(stepper_t *stepper)
+ * \brief Abandonne les morceaux en file et le morceau en cours (arrêt ou déplacement de la lecture)
+ * \param stepper Le moteur pas à pas
+ * \note N'attend jamais. Le thread saute les morceaux abandonnés à son prochain pas
+ * \warning Le producteur ne doit pas ajouter de morceau pendant l'appel (verrou du moteur audio)
+ */
+void stepper_flush(stepper_t *stepper);
+
+/**
+ * \fn double stepperFreq(double freq)
+ * \brief Ramène une fréquence de note dans la plage jouable par le moteur
+ * \param freq La fréquence de la note
+ * \return La fréquence transposée par octaves entre STEPPER_MIN_FREQ et STEPPER_MAX_FREQ
+ */
+double stepperFreq(double freq);
+
+/**
+ * \fn void reset_stepper_stats(stepper_t *stepper)
+ * \brief Remet les compteurs de pas et de gigue à zéro
+ * \param stepper Le moteur pas à pas
+ */
+void reset_stepper_stats(stepper_t *stepper);
+
+/**
+ * \fn void dump_stepper_stats(stepper_t *stepper, FILE *file)
+ * \brief Écrit les statistiques de gigue dans un fichier
+ * \param stepper Le moteur pas à pas
+ * \param file Le fichier de sortie
+ * \note Même format que dump_audio_stats, avec le préfixe stepper_
+ */
+void dump_stepper_stats(stepper_t *stepper, FILE *file);
+
+/**
+ * \fn void save_stepper_stats(stepper_t *stepper)
+ * \brief Ajoute les statistiques de gigue à la fin du fichier AUDIO_STATS_FILE
+ * \param stepper Le moteur pas à pas
+ */
+void save_stepper_stats(stepper_t *stepper);
+
+#endif
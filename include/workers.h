@@ -0,0 +1,127 @@
+/**
+ * \file workers.h
+ * \brief Pool de threads temps réel pour calculer les voix d'une période en parallèle
+ * \details Chaque période est un fork/join : le thread de mixage publie un lot de tâches,
+ * réveille les workers et prend lui-même des tâches. Chaque thread commence par sa part du
+ * lot puis vole les tâches restantes des autres : un worker en retard ne bloque personne.
+ * Le lot doit être terminé avant une échéance. Une tâche encore en cours à l'échéance est
+ * abandonnée au worker qui la calcule et refaite par l'appelant : le résultat ne dépend
+ * jamais du thread qui a calculé une tâche.
+ */
+#ifndef WORKERS_H
+#define WORKERS_H
+
+/* ------------------------------------------------------------------------ */
+/*                   E N T Ê T E S    S T A N D A R D S                     */
+/* ------------------------------------------------------------------------ */
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "audiostats.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define WORKERS_MAX 8 /*!< Nombre maximal de workers d'un pool */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \enum job_state_t
+ * \brief État d'une tâche
+ */
+typedef enum {
+    JOB_IDLE = 0, /*!< La tâche appartient à l'appelant (en préparation ou reprise) */
+    JOB_READY, /*!< La tâche est publiée et peut être prise par n'importe quel thread */
+    JOB_RUNNING, /*!< Un thread calcule la tâche */
+    JOB_DONE /*!< Le résultat de la tâche est disponible */
+} job_state_t;
+
+/**
+ * \struct job_t
+ * \brief Tâche d'un lot
+ * \details La fonction ne doit écrire que dans les données de sa tâche : deux tâches du
+ * même lot peuvent être calculées en même temps
+ */
+typedef struct {
+    void (*run)(void *arg); /*!< Fonction de la tâche */
+    void *arg; /*!< Données de la tâche */
+    int state; /*!< État de la tâche (job_state_t, accès atomiques) */
+} job_t;
+
+struct worker_pool;
+
+/**
+ * \struct worker_t
+ * \brief Worker d'un pool
+ */
+typedef struct {
+    struct worker_pool *pool; /*!< Pool du worker */
+    int index; /*!< Rang du worker (le thread appelant a le rang 0) */
+    pthread_t thread; /*!< Thread du worker */
+} worker_t;
+
+/**
+ * \struct worker_pool_t
+ * \brief Pool de workers
+ */
+typedef struct worker_pool {
+    worker_t workers[WORKERS_MAX]; /*!< Workers */
+    int nbWorkers; /*!< Nombre de workers démarrés (0 : tout est calculé par l'appelant) */
+    pthread_mutex_t lock; /*!< Protège la publication d'un lot */
+    pthread_cond_t wake; /*!< Réveille les workers à la publication d'un lot */
+    unsigned long generation; /*!< Numéro du dernier lot publié */
+    job_t *jobs; /*!< Tâches du dernier lot publié */
+    int nbJobs; /*!< Nombre de tâches du dernier lot */
+    int running; /*!< Les workers doivent continuer */
+} worker_pool_t;
+
+/* ------------------------------------------------------------------------ */
+/*            P R O T O T Y P E S    D E    F O N C T I O N S               */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_worker_pool(worker_pool_t *pool, int nbWorkers, int priority)
+ * \brief Démarre les workers d'un pool
+ * \param pool Le pool
+ * \param nbWorkers Le nombre de workers (borné à WORKERS_MAX)
+ * \param priority La priorité SCHED_FIFO des workers (ignorée sans les droits)
+ * \return Le nombre de workers démarrés
+ * \note Un pool sans worker reste utilisable : run_jobs calcule alors tout le lot
+ */
+int init_worker_pool(worker_pool_t *pool, int nbWorkers, int priority);
+
+/**
+ * \fn void end_worker_pool(worker_pool_t *pool)
+ * \brief Arrête les workers d'un pool
+ * \param pool Le pool
+ * \warning Aucun lot ne doit être en cours de publication
+ */
+void end_worker_pool(worker_pool_t *pool);
+
+/**
+ * \fn int jobs_idle(job_t *jobs, int nbJobs)
+ * \brief Indique si les tâches d'un lot peuvent être réutilisées
+ * \param jobs Les tâches
+ * \param nbJobs Le nombre de tâches
+ * \return 1 si aucun worker ne calcule encore une de ces tâches (lot précédent abandonné)
+ */
+int jobs_idle(job_t *jobs, int nbJobs);
+
+/**
+ * \fn int run_jobs(worker_pool_t *pool, job_t *jobs, int nbJobs, long long deadline)
+ * \brief Calcule un lot de tâches avec les workers et le thread appelant
+ * \param pool Le pool
+ * \param jobs Les tâches (run et arg remplis, toutes à l'état JOB_IDLE)
+ * \param nbJobs Le nombre de tâches
+ * \param deadline La date (audio_clock_ns) après laquelle le lot n'est plus attendu
+ * \return Le nombre de tâches encore en cours à l'échéance
+ * \note Au retour, chaque tâche est JOB_DONE ou JOB_RUNNING : une tâche JOB_RUNNING
+ * est toujours calculée par un worker, ses données ne doivent pas être lues ni réutilisées
+ * avant qu'elle passe à JOB_DONE (voir jobs_idle)
+ */
+int run_jobs(worker_pool_t *pool, job_t *jobs, int nbJobs, long long deadline);
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * \file fmbell.c
+ * \brief Exemple de plugin : cloche en synthèse FM à deux opérateurs
+ * \details Le modulateur est au rapport 3.5 de la porteuse et son index décroît avec
+ * l'enveloppe : l'attaque est brillante et la fin de la note se rapproche d'un sinus.
+ * La voix garde sa position et son enveloppe d'un bloc à l'autre ; après note_off, la
+ * cloche s'éteint en FMBELL_RELEASE secondes au lieu de s'arrêter net (voir piplugin.h).
+ * Compilation : make plugins (Raspberry Pi) ou make plugins-pc
+ */
+#include <math.h>
+#include <stdlib.h>
+#include "piplugin.h"
+
+/* ------------------------------------------------------------------------ */
+/*              C O N S T A N T E S     S Y M B O L I Q U E S               */
+/* ------------------------------------------------------------------------ */
+#define FMBELL_RATIO 3.5 /*!< Rapport de fréquence modulateur / porteuse */
+#define FMBELL_INDEX 4.0 /*!< Index de modulation à l'attaque */
+#define FMBELL_DECAY 3.0 /*!< Décroissance de l'enveloppe (par seconde) */
+#define FMBELL_ATTACK 96 /*!< Durée de l'attaque en échantillons (évite le clic) */
+#define FMBELL_RELEASE 0.25 /*!< Durée de l'extinction après la fin de la note (secondes) */
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct fmbell_t
+ * \brief État de l'instrument
+ */
+typedef struct {
+    double sampleRate; /*!< Fréquence d'échantillonnage */
+    double amplitude; /*!< Amplitude d'une note */
+} fmbell_t;
+
+/**
+ * \struct fmbell_voice_t
+ * \brief État d'une voix : pulsations, position et enveloppe
+ */
+typedef struct {
+    double carrier; /*!< Pulsation de la porteuse (radians par échantillon) */
+    double modulator; /*!< Pulsation du modulateur (radians par échantillon) */
+    double decay; /*!< Facteur de l'enveloppe par échantillon */
+    double envelope; /*!< Enveloppe du prochain échantillon (avant l'attaque) */
+    size_t t; /*!< Position du prochain échantillon dans la note */
+    double release; /*!< Gain d'extinction (1 pendant la note, décroît après note_off) */
+    double releaseStep; /*!< Baisse du gain d'extinction par échantillon (0 pendant la note) */
+} fmbell_voice_t;
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+static int fmbell_init(void **plugin, unsigned int sampleRate, int amplitude) {
+    fmbell_t *bell = malloc(sizeof(fmbell_t));
+    if(bell == NULL) return -1;
+    bell->sampleRate = sampleRate;
+    bell->amplitude = amplitude;
+    *plugin = bell;
+    return 0;
+}
+
+static void fmbell_note_on(void *plugin, void *voice, double freq, size_t offset) {
+    fmbell_t *bell = (fmbell_t *) plugin;
+    fmbell_voice_t *v = (fmbell_voice_t *) voice;
+    v->carrier = 2 * M_PI * freq / bell->sampleRate;
+    v->modulator = v->carrier * FMBELL_RATIO;
+    v->decay = exp(-FMBELL_DECAY / bell->sampleRate);
+    // Reprise au milieu de la note : l'enveloppe est celle de la position de départ
+    v->envelope = exp(-FMBELL_DECAY * offset / bell->sampleRate);
+    v->t = offset;
+    v->release = 1;
+    v->releaseStep = 0;
+}
+
+static int fmbell_render(void *plugin, void *voice, short *buffer, size_t frames) {
+    fmbell_t *bell = (fmbell_t *) plugin;
+    fmbell_voice_t *v = (fmbell_voice_t *) voice;
+    double t, envelope;
+    size_t i;
+    for(i = 0; i < frames; i++) {
+        t = (double) v->t++;
+        envelope = v->envelope * v->release;
+        if(t < FMBELL_ATTACK) envelope *= t / FMBELL_ATTACK;
+        buffer[i] = (short) (bell->amplitude * envelope * sin(v->carrier * t + FMBELL_INDEX * envelope * sin(v->modulator * t)));
+        v->envelope *= v->decay;
+        v->release -= v->releaseStep;
+        if(v->release < 0) v->release = 0;
+    }
+    return v->release > 0;
+}
+
+static void fmbell_note_off(void *plugin, void *voice) {
+    fmbell_t *bell = (fmbell_t *) plugin;
+    fmbell_voice_t *v = (fmbell_voice_t *) voice;
+    v->releaseStep = 1 / (FMBELL_RELEASE * bell->sampleRate);
+}
+
+static void fmbell_free(void *plugin) {
+    free(plugin);
+}
+
+static const piplugin_t fmbell = {
+    PIPLUGIN_ABI_VERSION,
+    "FMBL",
+    sizeof(fmbell_voice_t),
+    fmbell_init,
+    fmbell_note_on,
+    fmbell_render,
+    fmbell_note_off,
+    fmbell_free
+};
+
+/**
+ * \fn const piplugin_t *piplugin_entry()
+ * \brief Point d'entrée du plugin
+ * \return La description de l'instrument
+ */
+const piplugin_t *piplugin_entry() {
+    return &fmbell;
+}
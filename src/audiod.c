@@ -0,0 +1,659 @@
+/**
+ * \file audiod.c
+ * \brief Démon audio : le moteur audio dans un processus séparé de l'interface
+ */
+#include "audiod.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void audiod_publish(audiod_shm_t *shm, engine_t *engine, int playSlot)
+ * \brief Publie l'état du moteur dans la mémoire partagée
+ * \param shm La mémoire partagée
+ * \param engine Le moteur du démon
+ * \param playSlot La copie de la musique jouée
+ */
+void audiod_publish(audiod_shm_t *shm, engine_t *engine, int playSlot);
+
+/**
+ * \fn void audiod_read_status(audiod_shm_t *shm, audiod_status_t *status)
+ * \brief Lit une copie cohérente de l'état publié par le démon
+ * \param shm La mémoire partagée
+ * \param status L'état à remplir
+ */
+void audiod_read_status(audiod_shm_t *shm, audiod_status_t *status);
+
+/**
+ * \fn int audiod_send(audiod_client_t *client, audiod_command_t *command, int wait)
+ * \brief Ajoute une commande dans la file du démon
+ * \param client Le client connecté au démon
+ * \param command La commande
+ * \param wait 1 pour attendre que le démon l'ait exécutée
+ * \return 0 si succès, -1 si le démon ne répond pas
+ */
+int audiod_send(audiod_client_t *client, audiod_command_t *command, int wait);
+
+/**
+ * \fn int audiod_wait(audiod_client_t *client)
+ * \brief Attend que le démon ait exécuté toutes les commandes de la file
+ * \param client Le client connecté au démon
+ * \return 0 si succès, -1 si le démon ne répond pas dans AUDIOD_TIMEOUT
+ */
+int audiod_wait(audiod_client_t *client);
+
+/**
+ * \fn int audiod_snapshot(audiod_client_t *client, music_t *music)
+ * \brief Copie la musique dans une copie libre de la mémoire partagée
+ * \param client Le client connecté au démon
+ * \param music La musique
+ * \return L'indice de la copie écrite, -1 si le démon ne répond pas
+ */
+int audiod_snapshot(audiod_client_t *client, music_t *music);
+
+/**
+ * \fn music_t *audiod_decode(audiod_shm_t *shm, int slot)
+ * \brief Recopie une copie de la mémoire partagée dans un instantané de musique
+ * \param shm La mémoire partagée
+ * \param slot L'indice de la copie
+ * \return L'instantané (à libérer par release_music), NULL si l'allocation a échoué
+ */
+music_t *audiod_decode(audiod_shm_t *shm, int slot);
+
+/**
+ * \fn int audiod_local_loop(engine_t *engine, music_t *music, long long tickStart, long long tickEnd)
+ * \brief Calcule une boucle et la donne au moteur
+ * \param engine Le moteur
+ * \param music La musique
+ * \param tickStart Le début de la boucle
+ * \param tickEnd La fin de la boucle (tickEnd <= tickStart arrête la boucle)
+ * \return 0 si succès, -1 si la boucle n'a pas pu être calculée
+ */
+int audiod_local_loop(engine_t *engine, music_t *music, long long tickStart, long long tickEnd);
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_audiod_output(audiod_output_t *output, audio_stats_t *stats)
+ * \brief Ouvre le moteur audio et branche le moteur pas à pas sur son transport
+ * \param output Les sorties à ouvrir
+ * \param stats Les statistiques audio à remplir
+ * \return 0 si le moteur est ouvert, -1 sinon
+ */
+int init_audiod_output(audiod_output_t *output, audio_stats_t *stats) {
+    if(init_engine(&output->engine, stats) < 0) return -1;
+#ifdef STEPPER_SIMULATED
+    init_stepper_gpio_sim(&output->gpio, STEPPER_SIM_PULSES);
+#else
+    init_stepper_gpio_wiringpi(&output->gpio);
+#endif
+    if(init_stepper(&output->stepper, &output->gpio) == 0) engine_set_stepper(&output->engine, &output->stepper);
+    return 0;
+}
+
+/**
+ * \fn void end_audiod_output(audiod_output_t *output)
+ * \brief Ferme le moteur pas à pas et le moteur audio
+ * \param output Les sorties ouvertes avec init_audiod_output
+ */
+void end_audiod_output(audiod_output_t *output) {
+    free(engine_loop(&output->engine, NULL, 0));
+    engine_set_stepper(&output->engine, NULL);
+    end_stepper(&output->stepper);
+    end_stepper_gpio(&output->gpio);
+    end_engine(&output->engine);
+}
+
+/**
+ * \fn audiod_shm_t *create_audiod_shm()
+ * \brief Crée la mémoire partagée du démon
+ * \return La mémoire partagée, prête à recevoir des commandes
+ */
+audiod_shm_t *create_audiod_shm() {
+    audiod_shm_t *shm = create_shm(AUDIOD_SHM_NAME, sizeof(audiod_shm_t));
+    pthread_mutexattr_t attr;
+    // Les statistiques sont lues par l'interface : leur verrou est partagé entre processus
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&shm->stats.lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    reset_audio_stats(&shm->stats);
+    shm->status.playSlot = AUDIOD_NO_SONG;
+    shm->status.playTick = ENGINE_NO_TICK;
+    shm->pid = getpid();
+    __atomic_store_n(&shm->magic, AUDIOD_MAGIC, __ATOMIC_RELEASE);
+    return shm;
+}
+
+/**
+ * \fn void destroy_audiod_shm(audiod_shm_t *shm)
+ * \brief Supprime la mémoire partagée du démon
+ * \param shm La mémoire créée avec create_audiod_shm
+ */
+void destroy_audiod_shm(audiod_shm_t *shm) {
+    __atomic_store_n(&shm->magic, 0, __ATOMIC_RELEASE);
+    destroy_audio_stats(&shm->stats);
+    close_shm(shm, sizeof(audiod_shm_t));
+    unlink_shm(AUDIOD_SHM_NAME);
+}
+
+/**
+ * \fn int audiod_serve(audiod_shm_t *shm, engine_t *engine)
+ * \brief Exécute les commandes en attente et publie l'état du moteur
+ * \param shm La mémoire partagée
+ * \param engine Le moteur du démon
+ * \return Le nombre de commandes exécutées
+ * \note Appelé par le démon toutes les AUDIOD_POLL_TIME microsecondes
+ */
+int audiod_serve(audiod_shm_t *shm, engine_t *engine) {
+    static int playSlot = AUDIOD_NO_SONG;
+    static music_t *played = NULL;
+    unsigned int tail = shm->tail;
+    audiod_command_t *command;
+    music_t *music;
+    int count = 0;
+
+    while(tail != __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE)) {
+        command = &(shm->commands[tail & (AUDIOD_RING_SIZE - 1)]);
+        switch(command->type) {
+            case AUDIOD_CMD_PLAY:
+                reset_audio_stats(&shm->stats);
+                if(engine->stepper != NULL) reset_stepper_stats(engine->stepper);
+                music = audiod_decode(shm, command->slot);
+                if(music == NULL) break;
+                engine_play(engine, music, command->tick);
+                // Le moteur joue le nouvel instantané : l'ancien n'est plus lu
+                release_music(played);
+                played = music;
+                playSlot = command->slot;
+                break;
+            case AUDIOD_CMD_STOP:
+                engine_stop(engine);
+                break;
+            case AUDIOD_CMD_NUDGE:
+                engine_nudge(engine, command->value);
+                break;
+            case AUDIOD_CMD_METRONOME:
+                engine_set_metronome(engine, command->value);
+                break;
+            case AUDIOD_CMD_EFFECT:
+                engine_set_effect(engine, command->value);
+                break;
+            case AUDIOD_CMD_AUDITION:
+                engine_audition(engine, command->note, command->value);
+                break;
+            case AUDIOD_CMD_LOOP:
+                // La boucle est calculée ici, hors du thread de mixage
+                music = audiod_decode(shm, command->slot);
+                if(music != NULL) audiod_local_loop(engine, music, command->tick, command->tickEnd);
+                release_music(music);
+                break;
+        }
+        count++;
+        // L'état est publié avant de libérer la commande : une fois la file vide,
+        // l'interface sait quelle copie de la musique est encore utilisée
+        if(!engine_is_playing(engine) && playSlot != AUDIOD_NO_SONG) {
+            save_audio_stats(&shm->stats);
+            if(engine->stepper != NULL) save_stepper_stats(engine->stepper);
+            playSlot = AUDIOD_NO_SONG;
+        }
+        audiod_publish(shm, engine, playSlot);
+        __atomic_store_n(&shm->tail, ++tail, __ATOMIC_RELEASE);
+    }
+    // Fin de lecture : les statistiques sont sauvegardées par le démon
+    if(!engine_is_playing(engine) && playSlot != AUDIOD_NO_SONG) {
+        save_audio_stats(&shm->stats);
+        if(engine->stepper != NULL) save_stepper_stats(engine->stepper);
+        playSlot = AUDIOD_NO_SONG;
+    }
+    audiod_publish(shm, engine, playSlot);
+    return count;
+}
+
+/**
+ * \fn int audiod_connect(audiod_client_t *client)
+ * \brief Se connecte au démon, ou ouvre le moteur dans l'interface s'il ne tourne pas
+ * \param client Le client à initialiser
+ * \return 0 si le moteur est disponible, -1 si aucun flux n'a pu être ouvert
+ */
+int audiod_connect(audiod_client_t *client) {
+    memset(client, 0, sizeof(audiod_client_t));
+    client->shm = open_shm(AUDIOD_SHM_NAME, sizeof(audiod_shm_t));
+    if(client->shm != NULL) {
+        // Une mémoire laissée par un démon arrêté brutalement ne répond plus
+        if(__atomic_load_n(&client->shm->magic, __ATOMIC_ACQUIRE) == AUDIOD_MAGIC && kill(client->shm->pid, 0) == 0) {
+            client->metronome = client->shm->status.metronome;
+            return 0;
+        }
+        close_shm(client->shm, sizeof(audiod_shm_t));
+        client->shm = NULL;
+    }
+    // Pas de démon : le moteur tourne dans l'interface, comme avant
+    init_audio_stats(&client->stats);
+    client->local = malloc(sizeof(audiod_output_t));
+    if(client->local == NULL || init_audiod_output(client->local, &client->stats) < 0) {
+        free(client->local);
+        client->local = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \fn void audiod_disconnect(audiod_client_t *client)
+ * \brief Arrête la boucle et la lecture puis se déconnecte (ou ferme le moteur local)
+ * \param client Le client
+ */
+void audiod_disconnect(audiod_client_t *client) {
+    if(client->shm != NULL) {
+        audiod_loop(client, NULL, 0, 0);
+        audiod_stop(client);
+        audiod_wait(client);
+        close_shm(client->shm, sizeof(audiod_shm_t));
+        client->shm = NULL;
+    }
+    else {
+        if(client->local != NULL) {
+            end_audiod_output(client->local);
+            free(client->local);
+            client->local = NULL;
+        }
+        destroy_audio_stats(&client->stats);
+    }
+    // Le moteur est fermé : l'instantané joué n'est plus lu
+    release_music(client->music);
+    client->music = NULL;
+}
+
+/**
+ * \fn int audiod_play(audiod_client_t *client, music_t *music, long long tick)
+ * \brief Lance la lecture d'une musique à partir d'une position musicale
+ * \param client Le client
+ * \param music La musique à jouer (un instantané est joué : elle reste modifiable)
+ * \param tick La position de départ en doubles croches
+ * \return 0 si la lecture a commencé, -1 sinon
+ * \see engine_play
+ */
+int audiod_play(audiod_client_t *client, music_t *music, long long tick) {
+    audiod_command_t command;
+    music_t *played = client->music;
+    int ret = -1;
+    // La lecture porte sur un instantané : la musique reste modifiable pendant qu'elle est jouée
+    client->music = music_snapshot(music);
+    if(client->music == NULL) {
+        client->music = played;
+        return -1;
+    }
+    if(client->shm != NULL) {
+        command.type = AUDIOD_CMD_PLAY;
+        command.slot = audiod_snapshot(client, client->music);
+        command.tick = tick;
+        // On attend le démarrage : sinon la lecture paraîtrait déjà terminée
+        if(command.slot >= 0) ret = audiod_send(client, &command, 1);
+    }
+    else if(client->local != NULL) {
+        reset_audio_stats(&client->stats);
+        if(client->local->engine.stepper != NULL) reset_stepper_stats(&client->local->stepper);
+        engine_play(&client->local->engine, client->music, tick);
+        ret = 0;
+    }
+    // Le moteur joue le nouvel instantané : l'ancien n'est plus lu
+    release_music(played);
+    return ret;
+}
+
+/**
+ * \fn void audiod_stop(audiod_client_t *client)
+ * \brief Arrête la lecture en cours
+ * \param client Le client
+ */
+void audiod_stop(audiod_client_t *client) {
+    audiod_command_t command;
+    if(client->shm != NULL) {
+        command.type = AUDIOD_CMD_STOP;
+        audiod_send(client, &command, 0);
+    }
+    else if(client->local != NULL) engine_stop(&client->local->engine);
+}
+
+/**
+ * \fn int audiod_is_playing(audiod_client_t *client)
+ * \brief Indique si la musique est encore audible
+ * \param client Le client
+ * \return 1 tant que la dernière note n'est pas sortie du haut-parleur
+ */
+int audiod_is_playing(audiod_client_t *client) {
+    audiod_status_t status;
+    if(client->shm != NULL) {
+        audiod_read_status(client->shm, &status);
+        // Un démon arrêté pendant la lecture ne doit pas bloquer l'interface
+        return status.playing && kill(client->shm->pid, 0) == 0;
+    }
+    return client->local != NULL && engine_is_playing(&client->local->engine);
+}
+
+/**
+ * \fn int audiod_line(audiod_client_t *client, int channelId)
+ * \brief Ligne d'un channel actuellement audible
+ * \param client Le client
+ * \param channelId L'identifiant du channel
+ * \return La ligne jouée ou ENGINE_NO_LINE
+ */
+int audiod_line(audiod_client_t *client, int channelId) {
+    audiod_status_t status;
+    if(client->shm != NULL) {
+        // La copie jouée par le démon est identique à la musique de l'interface
+        audiod_read_status(client->shm, &status);
+        if(status.playTick == ENGINE_NO_TICK || client->music == NULL || channelId >= client->music->nbChannels) return ENGINE_NO_LINE;
+        return channel_tick2line(&(client->music->channels[channelId]), status.playTick);
+    }
+    return client->local != NULL ? engine_line(&client->local->engine, channelId) : ENGINE_NO_LINE;
+}
+
+/**
+ * \fn short audiod_bpm(audiod_client_t *client)
+ * \brief Tempo courant de la lecture
+ * \param client Le client
+ * \return Le bpm joué
+ */
+short audiod_bpm(audiod_client_t *client) {
+    audiod_status_t status;
+    if(client->shm != NULL) {
+        audiod_read_status(client->shm, &status);
+        return status.bpm;
+    }
+    return client->local != NULL ? engine_bpm(&client->local->engine) : 0;
+}
+
+/**
+ * \fn void audiod_nudge(audiod_client_t *client, int delta)
+ * \brief Décale le tempo en direct pendant la lecture
+ * \param client Le client
+ * \param delta Le décalage à ajouter en bpm
+ */
+void audiod_nudge(audiod_client_t *client, int delta) {
+    audiod_command_t command;
+    if(client->shm != NULL) {
+        command.type = AUDIOD_CMD_NUDGE;
+        command.value = delta;
+        audiod_send(client, &command, 0);
+    }
+    else if(client->local != NULL) engine_nudge(&client->local->engine, delta);
+}
+
+/**
+ * \fn void audiod_set_metronome(audiod_client_t *client, int enabled)
+ * \brief Active ou coupe le métronome
+ * \param client Le client
+ * \param enabled 1 pour activer le métronome
+ */
+void audiod_set_metronome(audiod_client_t *client, int enabled) {
+    audiod_command_t command;
+    client->metronome = enabled;
+    if(client->shm != NULL) {
+        command.type = AUDIOD_CMD_METRONOME;
+        command.value = enabled;
+        audiod_send(client, &command, 0);
+    }
+    else if(client->local != NULL) engine_set_metronome(&client->local->engine, enabled);
+}
+
+/**
+ * \fn int audiod_metronome(audiod_client_t *client)
+ * \brief Indique si le métronome est activé
+ * \param client Le client
+ * \return 1 si le métronome est activé
+ */
+int audiod_metronome(audiod_client_t *client) {
+    return client->metronome;
+}
+
+/**
+ * \fn void audiod_set_effect(audiod_client_t *client, short effect)
+ * \brief Change l'effet appliqué aux prochaines notes
+ * \param client Le client
+ * \param effect L'effet (0 : aucun, 1 : fuzz, 2 : compression)
+ */
+void audiod_set_effect(audiod_client_t *client, short effect) {
+    static short lastEffect = -1;
+    audiod_command_t command;
+    if(client->shm != NULL) {
+        // Le capteur est lu en boucle : seuls les changements passent par la file
+        if(effect == lastEffect) return;
+        lastEffect = effect;
+        command.type = AUDIOD_CMD_EFFECT;
+        command.value = effect;
+        audiod_send(client, &command, 0);
+    }
+    else if(client->local != NULL) engine_set_effect(&client->local->engine, effect);
+}
+
+/**
+ * \fn void audiod_audition(audiod_client_t *client, note_t note, short bpm)
+ * \brief Fait entendre une note sur la voix d'écoute
+ * \param client Le client
+ * \param note La note à écouter
+ * \param bpm Le tempo pour la durée de la note
+ */
+void audiod_audition(audiod_client_t *client, note_t note, short bpm) {
+    audiod_command_t command;
+    if(client->shm != NULL) {
+        command.type = AUDIOD_CMD_AUDITION;
+        command.note = note;
+        command.value = bpm;
+        audiod_send(client, &command, 0);
+    }
+    else if(client->local != NULL) engine_audition(&client->local->engine, note, bpm);
+}
+
+/**
+ * \fn int audiod_loop(audiod_client_t *client, music_t *music, long long tickStart, long long tickEnd)
+ * \brief Joue un morceau de la musique en boucle (calculé une seule fois)
+ * \param client Le client
+ * \param music La musique
+ * \param tickStart Le début de la boucle en doubles croches
+ * \param tickEnd La fin de la boucle (tickEnd <= tickStart arrête la boucle)
+ * \return 0 si succès, -1 si la boucle n'a pas pu être calculée
+ */
+int audiod_loop(audiod_client_t *client, music_t *music, long long tickStart, long long tickEnd) {
+    audiod_command_t command;
+    if(client->shm != NULL) {
+        command.type = AUDIOD_CMD_LOOP;
+        command.slot = 0;
+        command.tick = tickStart;
+        command.tickEnd = tickEnd;
+        if(tickEnd > tickStart && (command.slot = audiod_snapshot(client, music)) < 0) return -1;
+        return audiod_send(client, &command, 0);
+    }
+    if(client->local == NULL) return -1;
+    return audiod_local_loop(&client->local->engine, music, tickStart, tickEnd);
+}
+
+/**
+ * \fn audio_stats_t *audiod_stats(audiod_client_t *client)
+ * \brief Statistiques du moteur utilisé (celui du démon ou le moteur local)
+ * \param client Le client
+ * \return Les statistiques audio
+ */
+audio_stats_t *audiod_stats(audiod_client_t *client) {
+    return client->shm != NULL ? &(client->shm->stats) : &(client->stats);
+}
+
+/**
+ * \fn void audiod_save_stats(audiod_client_t *client)
+ * \brief Sauvegarde les statistiques de la dernière lecture du moteur local
+ * \param client Le client
+ * \note Le démon sauvegarde lui-même ses statistiques à la fin de chaque lecture
+ */
+void audiod_save_stats(audiod_client_t *client) {
+    if(client->local == NULL) return;
+    save_audio_stats(&client->stats);
+    if(client->local->engine.stepper != NULL) save_stepper_stats(&client->local->stepper);
+}
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void audiod_publish(audiod_shm_t *shm, engine_t *engine, int playSlot)
+ * \brief Publie l'état du moteur dans la mémoire partagée
+ * \param shm La mémoire partagée
+ * \param engine Le moteur du démon
+ * \param playSlot La copie de la musique jouée
+ */
+void audiod_publish(audiod_shm_t *shm, engine_t *engine, int playSlot) {
+    __atomic_add_fetch(&shm->statusSeq, 1, __ATOMIC_ACQ_REL);
+    shm->status.playing = engine_is_playing(engine);
+    shm->status.playTick = engine_playtick(engine);
+    shm->status.bpm = engine_bpm(engine);
+    shm->status.metronome = __atomic_load_n(&engine->metronome, __ATOMIC_RELAXED);
+    shm->status.playSlot = playSlot;
+    shm->status.transport = __atomic_load_n(&engine->transport, __ATOMIC_ACQUIRE);
+    __atomic_add_fetch(&shm->statusSeq, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * \fn void audiod_read_status(audiod_shm_t *shm, audiod_status_t *status)
+ * \brief Lit une copie cohérente de l'état publié par le démon
+ * \param shm La mémoire partagée
+ * \param status L'état à remplir
+ */
+void audiod_read_status(audiod_shm_t *shm, audiod_status_t *status) {
+    unsigned int seq;
+    do {
+        seq = __atomic_load_n(&shm->statusSeq, __ATOMIC_ACQUIRE);
+        memcpy(status, &(shm->status), sizeof(audiod_status_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while((seq & 1) || seq != __atomic_load_n(&shm->statusSeq, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * \fn int audiod_send(audiod_client_t *client, audiod_command_t *command, int wait)
+ * \brief Ajoute une commande dans la file du démon
+ * \param client Le client connecté au démon
+ * \param command La commande
+ * \param wait 1 pour attendre que le démon l'ait exécutée
+ * \return 0 si succès, -1 si le démon ne répond pas
+ */
+int audiod_send(audiod_client_t *client, audiod_command_t *command, int wait) {
+    audiod_shm_t *shm = client->shm;
+    unsigned int head = shm->head;
+    int waited = 0;
+    // File pleine : le démon lit la file toutes les millisecondes, on lui laisse le temps
+    while(head - __atomic_load_n(&shm->tail, __ATOMIC_ACQUIRE) >= AUDIOD_RING_SIZE) {
+        if(waited >= AUDIOD_TIMEOUT) return -1;
+        usleep(AUDIOD_POLL_TIME);
+        waited += AUDIOD_POLL_TIME;
+    }
+    shm->commands[head & (AUDIOD_RING_SIZE - 1)] = *command;
+    __atomic_store_n(&shm->head, head + 1, __ATOMIC_RELEASE);
+    return wait ? audiod_wait(client) : 0;
+}
+
+/**
+ * \fn int audiod_wait(audiod_client_t *client)
+ * \brief Attend que le démon ait exécuté toutes les commandes de la file
+ * \param client Le client connecté au démon
+ * \return 0 si succès, -1 si le démon ne répond pas dans AUDIOD_TIMEOUT
+ */
+int audiod_wait(audiod_client_t *client) {
+    audiod_shm_t *shm = client->shm;
+    int waited = 0;
+    while(__atomic_load_n(&shm->tail, __ATOMIC_ACQUIRE) != shm->head) {
+        if(waited >= AUDIOD_TIMEOUT) return -1;
+        usleep(AUDIOD_POLL_TIME);
+        waited += AUDIOD_POLL_TIME;
+    }
+    return 0;
+}
+
+/**
+ * \fn int audiod_snapshot(audiod_client_t *client, music_t *music)
+ * \brief Copie la musique dans une copie libre de la mémoire partagée
+ * \param client Le client connecté au démon
+ * \param music La musique
+ * \return L'indice de la copie écrite, -1 si le démon ne répond pas
+ */
+int audiod_snapshot(audiod_client_t *client, music_t *music) {
+    audiod_status_t status;
+    audiod_song_t *song;
+    int slot, i, j;
+    // Une fois la file vide, le démon n'utilise plus que la copie en cours de lecture
+    if(audiod_wait(client) < 0) return -1;
+    audiod_read_status(client->shm, &status);
+    slot = status.playSlot == 0 ? 1 : 0;
+    song = &(client->shm->songs[slot]);
+    song->date = music->date;
+    song->bpm = music->bpm;
+    song->nbTempos = music->nbTempos;
+    memcpy(song->tempos, music->tempos, sizeof(tempo_event_t) * music->nbTempos);
+    song->nbChannels = music->nbChannels;
+    for(i = 0; i < music->nbChannels; i++) {
+        song->nbNotes[i] = music->channels[i].nbNotes;
+        for(j = 0; j < song->nbNotes[i]; j++) song->notes[i][j] = channel_packed_note(&music->channels[i], j);
+    }
+    return slot;
+}
+
+/**
+ * \fn music_t *audiod_decode(audiod_shm_t *shm, int slot)
+ * \brief Recopie une copie de la mémoire partagée dans un instantané de musique
+ * \param shm La mémoire partagée
+ * \param slot L'indice de la copie
+ * \return L'instantané (à libérer par release_music), NULL si l'allocation a échoué
+ */
+music_t *audiod_decode(audiod_shm_t *shm, int slot) {
+    static music_t work;
+    static int ready = 0;
+    audiod_song_t *song = &(shm->songs[slot]);
+    packed_note_t empty = pack_note(create_note(NOTE_NA_ID, 0, REF_OCTAVE, INSTRUMENT_NA, CHANNEL_EMPTY_TICKS));
+    int i, j, lines;
+    if(!ready) {
+        init_music(&work, 0);
+        ready = 1;
+    }
+    // Les channels retirés sont libérés ici ; ceux qui sont ajoutés sont vides
+    if(set_music_channels(&work, song->nbChannels) < 0) return NULL;
+    for(i = 0; i < work.nbChannels; i++) {
+        channel_t *channel = &work.channels[i];
+        // Les blocs encore partagés avec l'instantané joué ne sont copiés que s'ils changent
+        lines = channel->nbNotes > song->nbNotes[i] ? channel->nbNotes : song->nbNotes[i];
+        for(j = 0; j < lines; j++) {
+            if(set_channel_packed_note(channel, j, j < song->nbNotes[i] ? song->notes[i][j] : empty) < 0) return NULL;
+        }
+        channel->nbNotes = song->nbNotes[i];
+        build_channel_index(channel);
+    }
+    work.date = song->date;
+    work.bpm = song->bpm;
+    work.nbTempos = song->nbTempos;
+    memcpy(work.tempos, song->tempos, sizeof(tempo_event_t) * song->nbTempos);
+    return music_snapshot(&work);
+}
+
+/**
+ * \fn int audiod_local_loop(engine_t *engine, music_t *music, long long tickStart, long long tickEnd)
+ * \brief Calcule une boucle et la donne au moteur
+ * \param engine Le moteur
+ * \param music La musique
+ * \param tickStart Le début de la boucle
+ * \param tickEnd La fin de la boucle (tickEnd <= tickStart arrête la boucle)
+ * \return 0 si succès, -1 si la boucle n'a pas pu être calculée
+ */
+int audiod_local_loop(engine_t *engine, music_t *music, long long tickStart, long long tickEnd) {
+    short *buffer = NULL;
+    long long frames = 0;
+    if(tickEnd > tickStart) {
+        buffer = render_music(music, tickStart, tickEnd, &frames);
+        if(buffer == NULL) {
+            free(engine_loop(engine, NULL, 0));
+            return -1;
+        }
+    }
+    free(engine_loop(engine, buffer, frames));
+    return 0;
+}
@@ -0,0 +1,236 @@
+/**
+ * \file audiostats.c
+ * \brief Instrumentation temps réel des threads audio
+ */
+#include "audiostats.h"
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_audio_stats(audio_stats_t *stats)
+ * \brief Initialise (ou remet à zéro) les statistiques audio
+ * \param stats Les statistiques à initialiser
+ */
+void init_audio_stats(audio_stats_t *stats) {
+    pthread_mutex_init(&stats->lock, NULL);
+    reset_audio_stats(stats);
+}
+
+/**
+ * \fn void reset_audio_stats(audio_stats_t *stats)
+ * \brief Remet les compteurs à zéro sans recréer le verrou
+ * \param stats Les statistiques initialisées avec init_audio_stats
+ */
+void reset_audio_stats(audio_stats_t *stats) {
+    pthread_mutex_lock(&stats->lock);
+    stats->periods = 0;
+    memset(stats->histogram, 0, sizeof(stats->histogram));
+    stats->xruns = 0;
+    stats->recovered = 0;
+    stats->failures = 0;
+    stats->renderNs = 0;
+    stats->budgetNs = 0;
+    stats->lastLoad = 0;
+    stats->maxLoad = 0;
+    stats->lastDelay = -1;
+    stats->minDelay = -1;
+    stats->maxDelay = -1;
+    stats->qualityChanges = 0;
+    stats->lateJobs = 0;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/**
+ * \fn void destroy_audio_stats(audio_stats_t *stats)
+ * \brief Libère les ressources des statistiques audio
+ * \param stats Les statistiques à détruire
+ */
+void destroy_audio_stats(audio_stats_t *stats) {
+    pthread_mutex_destroy(&stats->lock);
+}
+
+/**
+ * \fn long long audio_clock_ns()
+ * \brief Horloge monotone en nanosecondes utilisée pour les mesures
+ * \return Le temps courant en nanosecondes
+ */
+long long audio_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * \fn void record_audio_period(audio_stats_t *stats, long long renderNs, long long budgetNs, long delay)
+ * \brief Enregistre la mesure d'une période
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param renderNs Le temps passé à calculer la période
+ * \param budgetNs La durée de la période (temps disponible pour la calculer)
+ * \param delay Le délai du flux après écriture (-1 si inconnu)
+ */
+void record_audio_period(audio_stats_t *stats, long long renderNs, long long budgetNs, long delay) {
+    int load, bucket;
+    if(stats == NULL || budgetNs <= 0) return;
+    // Charge en pour mille du budget
+    load = (int) (renderNs * 1000 / budgetNs);
+    bucket = load / AUDIO_STATS_BUCKET_WIDTH;
+    if(bucket >= AUDIO_STATS_BUCKETS) bucket = AUDIO_STATS_BUCKETS - 1;
+
+    pthread_mutex_lock(&stats->lock);
+    stats->periods++;
+    stats->histogram[bucket]++;
+    stats->renderNs += renderNs;
+    stats->budgetNs += budgetNs;
+    stats->lastLoad = load;
+    if(load > stats->maxLoad) stats->maxLoad = load;
+    if(delay >= 0) {
+        stats->lastDelay = delay;
+        if(stats->minDelay < 0 || delay < stats->minDelay) stats->minDelay = delay;
+        if(delay > stats->maxDelay) stats->maxDelay = delay;
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/**
+ * \fn void record_audio_xrun(audio_stats_t *stats, int recovered)
+ * \brief Enregistre un xrun
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param recovered 1 si snd_pcm_recover a réussi, 0 sinon
+ */
+void record_audio_xrun(audio_stats_t *stats, int recovered) {
+    if(stats == NULL) return;
+    pthread_mutex_lock(&stats->lock);
+    stats->xruns++;
+    if(recovered) stats->recovered++;
+    else stats->failures++;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/**
+ * \fn void record_audio_quality(audio_stats_t *stats, int from, int to, int load)
+ * \brief Enregistre un changement de niveau de qualité du rendu
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param from Le niveau précédent
+ * \param to Le nouveau niveau
+ * \param load La charge de la période qui a déclenché le changement (pour mille)
+ */
+void record_audio_quality(audio_stats_t *stats, int from, int to, int load) {
+    audio_quality_event_t *event;
+    if(stats == NULL) return;
+    pthread_mutex_lock(&stats->lock);
+    event = &stats->qualityEvents[stats->qualityChanges % AUDIO_STATS_QUALITY_EVENTS];
+    event->period = stats->periods;
+    event->from = from;
+    event->to = to;
+    event->load = load;
+    stats->quality = to;
+    stats->qualityChanges++;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/**
+ * \fn void record_audio_late_jobs(audio_stats_t *stats, int count)
+ * \brief Enregistre des voix recalculées par le thread de mixage faute d'être prêtes à l'échéance
+ * \param stats Les statistiques à mettre à jour (ignoré si NULL)
+ * \param count Le nombre de voix en retard dans la période
+ */
+void record_audio_late_jobs(audio_stats_t *stats, int count) {
+    if(stats == NULL) return;
+    pthread_mutex_lock(&stats->lock);
+    stats->lateJobs += count;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/**
+ * \fn void dump_audio_stats(audio_stats_t *stats, FILE *file)
+ * \brief Écrit les statistiques dans un fichier
+ * \param stats Les statistiques à écrire
+ * \param file Le fichier de sortie
+ * \note Le format est de la forme <clé>=<valeur>, une valeur par ligne
+ */
+void dump_audio_stats(audio_stats_t *stats, FILE *file) {
+    int i;
+    unsigned long n;
+    audio_quality_event_t *event;
+    pthread_mutex_lock(&stats->lock);
+    fprintf(file, "periods=%lu\n", stats->periods);
+    fprintf(file, "xruns=%lu\n", stats->xruns);
+    fprintf(file, "recovered=%lu\n", stats->recovered);
+    fprintf(file, "failures=%lu\n", stats->failures);
+    fprintf(file, "load_avg_permille=%lld\n", stats->budgetNs > 0 ? stats->renderNs * 1000 / stats->budgetNs : 0);
+    fprintf(file, "load_max_permille=%d\n", stats->maxLoad);
+    fprintf(file, "delay_min=%ld\n", stats->minDelay);
+    fprintf(file, "delay_max=%ld\n", stats->maxDelay);
+    for(i = 0; i < AUDIO_STATS_BUCKETS; i++) {
+        // La dernière case contient toutes les périodes qui ont dépassé leur budget
+        if(i == AUDIO_STATS_BUCKETS - 1) fprintf(file, "load_%d+=%lu\n", i * 10, stats->histogram[i]);
+        else fprintf(file, "load_%d-%d=%lu\n", i * 10, (i + 1) * 10, stats->histogram[i]);
+    }
+    fprintf(file, "quality=%d\n", stats->quality);
+    fprintf(file, "quality_changes=%lu\n", stats->qualityChanges);
+    fprintf(file, "late_jobs=%lu\n", stats->lateJobs);
+    // Seuls les AUDIO_STATS_QUALITY_EVENTS derniers changements sont gardés
+    n = stats->qualityChanges > AUDIO_STATS_QUALITY_EVENTS ? stats->qualityChanges - AUDIO_STATS_QUALITY_EVENTS : 0;
+    for(; n < stats->qualityChanges; n++) {
+        event = &stats->qualityEvents[n % AUDIO_STATS_QUALITY_EVENTS];
+        fprintf(file, "quality_change_%lu=period:%lu from:%d to:%d load:%d\n", n, event->period, event->from, event->to, event->load);
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/**
+ * \fn void save_audio_stats(audio_stats_t *stats)
+ * \brief Ajoute les statistiques à la fin du fichier AUDIO_STATS_FILE
+ * \param stats Les statistiques à sauvegarder
+ */
+void save_audio_stats(audio_stats_t *stats) {
+    time_t now = time(NULL);
+    FILE *file = fopen(AUDIO_STATS_FILE, "a");
+    if(file == NULL) return;
+    fprintf(file, "# %ld\n", (long) now);
+    dump_audio_stats(stats, file);
+    fclose(file);
+}
+
+/**
+ * \fn void audio_stats2str(audio_stats_t *stats, char *str, int line)
+ * \brief Convertit une ligne du résumé des statistiques en chaine de caractère
+ * \param stats Les statistiques
+ * \param str La chaine qui va contenir la ligne (au moins 64 caractères)
+ * \param line La ligne du résumé à produire (0 à 3)
+ * \note Utilisé par l'overlay du séquenceur
+ */
+void audio_stats2str(audio_stats_t *stats, char *str, int line) {
+    int i;
+    unsigned long maxCount = 0;
+    pthread_mutex_lock(&stats->lock);
+    switch(line) {
+        case 0:
+            sprintf(str, "Periods %-8lu Xruns %lu (%lu recovered)", stats->periods, stats->xruns, stats->recovered);
+            break;
+        case 1:
+            sprintf(str, "Load avg %3lld%% last %3d%% max %3d%% Q%d",
+                stats->budgetNs > 0 ? stats->renderNs * 100 / stats->budgetNs : 0,
+                stats->lastLoad / 10, stats->maxLoad / 10, stats->quality);
+            break;
+        case 2:
+            sprintf(str, "Delay last %-6ld min %-6ld max %-6ld", stats->lastDelay, stats->minDelay, stats->maxDelay);
+            break;
+        default:
+            // Histogramme : une colonne par tranche de 10%, hauteur de 0 à 9
+            for(i = 0; i < AUDIO_STATS_BUCKETS; i++) {
+                if(stats->histogram[i] > maxCount) maxCount = stats->histogram[i];
+            }
+            strcpy(str, "Hist 0%[");
+            for(i = 0; i < AUDIO_STATS_BUCKETS; i++) {
+                char level = '.';
+                if(stats->histogram[i] > 0) level = '0' + (int) (stats->histogram[i] * 9 / maxCount);
+                str[8 + i] = level;
+            }
+            strcpy(str + 8 + AUDIO_STATS_BUCKETS, "]100%+");
+            break;
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
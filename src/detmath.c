@@ -0,0 +1,149 @@
+/**
+ * \file detmath.c
+ * \brief Calcul en virgule fixe du rendu déterministe
+ */
+#include "detmath.h"
+
+#define DETMATH_Q30 (1LL << 30) /*!< 1.0 en Q30 (calcul des tables) */
+#define DETMATH_PI_Q30 3373259426LL /*!< Pi en Q30 */
+#define DETMATH_LN2_Q30 744261118LL /*!< ln(2) en Q30 */
+#define DETMATH_SINE_SIZE (1 << DETMATH_SINE_BITS) /*!< Nombre de points de la table du sinus */
+
+static int sineTable[DETMATH_SINE_SIZE + 1]; /*!< Une période de sinus en Q15 (le dernier point referme la période) */
+static short fuzzTable[DETMATH_TANH_SIZE]; /*!< Fuzz de chaque valeur absolue d'échantillon */
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT; /*!< Les tables ne sont remplies qu'une fois */
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn long long sin_q30(long long x)
+ * \brief Sinus par sa série entière, en entiers
+ * \param x L'angle en radians (Q30, entre 0 et pi/2)
+ * \return Le sinus en Q30
+ */
+static long long sin_q30(long long x) {
+    long long x2 = (x * x + DETMATH_Q30 / 2) >> 30, term = x, sum = x;
+    int k;
+    // Les termes décroissent : 8 termes suffisent à pi/2 pour la précision du Q30
+    for(k = 1; k <= 8 && term > 0; k++) {
+        term = ((term * x2) >> 30) / ((2 * k) * (2 * k + 1));
+        sum += k % 2 == 1 ? -term : term;
+    }
+    return sum;
+}
+
+/**
+ * \fn long long exp_neg_q30(long long y)
+ * \brief Exponentielle de -y, en entiers
+ * \param y L'exposant (Q30, positif)
+ * \return exp(-y) en Q30
+ */
+static long long exp_neg_q30(long long y) {
+    long long k = y / DETMATH_LN2_Q30, r = y - k * DETMATH_LN2_Q30, term = DETMATH_Q30, sum = DETMATH_Q30;
+    int n;
+    if(k >= 62) return 0;
+    // exp(-y) = exp(-r) / 2^k avec r < ln(2) : la série converge en quelques termes
+    for(n = 1; n <= 14 && term > 0; n++) {
+        term = ((term * r) >> 30) / n;
+        sum += n % 2 == 1 ? -term : term;
+    }
+    return sum >> k;
+}
+
+/**
+ * \fn void fill_tables()
+ * \brief Remplit les tables du sinus et du fuzz
+ */
+static void fill_tables() {
+    int i, quarter = DETMATH_SINE_SIZE / 4;
+    long long value, y, e;
+
+    // Un quart de période calculé, le reste par symétrie : la table est exactement antisymétrique
+    for(i = 0; i <= quarter; i++) {
+        value = (sin_q30((i * DETMATH_PI_Q30 + quarter) / (2 * quarter)) + (1 << 14)) >> 15;
+        if(value > DETMATH_ONE) value = DETMATH_ONE;
+        sineTable[i] = (int) value;
+        sineTable[2 * quarter - i] = (int) value;
+        sineTable[2 * quarter + i] = (int) -value;
+        sineTable[DETMATH_SINE_SIZE - i] = (int) -value;
+    }
+    sineTable[0] = 0;
+    sineTable[2 * quarter] = 0;
+    sineTable[DETMATH_SINE_SIZE] = 0;
+
+    // tanh(x) = (1 - exp(-2x)) / (1 + exp(-2x)), avec x = gain * s / BASE_AMPLITUDE
+    for(i = 0; i < DETMATH_TANH_SIZE; i++) {
+        y = (2LL * DETMATH_FUZZ_GAIN * i << 30) / BASE_AMPLITUDE;
+        e = exp_neg_q30(y);
+        value = ((DETMATH_Q30 - e) << 30) / (DETMATH_Q30 + e);
+        fuzzTable[i] = (short) ((value * BASE_AMPLITUDE) >> 30);
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_detmath()
+ * \brief Remplit les tables (une seule fois, quel que soit le nombre d'appels et de threads)
+ */
+void init_detmath() {
+    pthread_once(&tablesOnce, fill_tables);
+}
+
+/**
+ * \fn unsigned int det_phase(double cycles)
+ * \brief Convertit une fraction de période en phase sur 32 bits
+ * \param cycles Le nombre de périodes (seule la partie fractionnaire est gardée)
+ * \return La phase en 1/2^32 de période
+ */
+unsigned int det_phase(double cycles) {
+    // floor, ldexp et la soustraction de la partie entière sont exacts : le résultat ne dépend que
+    // de la valeur de cycles. Arrondi par défaut comme la partie fractionnaire des instruments flottants
+    return (unsigned int) (long long) floor(ldexp(cycles - floor(cycles), 32));
+}
+
+/**
+ * \fn int det_sin(unsigned int phase)
+ * \brief Sinus d'une phase (table interpolée linéairement)
+ * \param phase La phase en 1/2^32 de période
+ * \return Le sinus en Q15 (entre -DETMATH_ONE et DETMATH_ONE)
+ */
+int det_sin(unsigned int phase) {
+    unsigned int index = phase >> (32 - DETMATH_SINE_BITS);
+    long long frac = (phase >> (16 - DETMATH_SINE_BITS)) & 0xffff;
+    int a = sineTable[index], b = sineTable[index + 1];
+    return a + (int) (((b - a) * frac) >> 16);
+}
+
+/**
+ * \fn int det_fuzz(int sample)
+ * \brief Distorsion du fuzz : BASE_AMPLITUDE * tanh(DETMATH_FUZZ_GAIN * sample / BASE_AMPLITUDE)
+ * \param sample L'échantillon (short)
+ * \return L'échantillon distordu
+ */
+int det_fuzz(int sample) {
+    return sample < 0 ? -fuzzTable[-sample] : fuzzTable[sample];
+}
+
+/**
+ * \fn unsigned long long det_hash(const short *buffer, size_t frames)
+ * \brief Empreinte FNV-1a 64 bits des échantillons (petit boutiste, indépendante de la machine)
+ * \param buffer Les échantillons
+ * \param frames Le nombre d'échantillons
+ * \return L'empreinte
+ */
+unsigned long long det_hash(const short *buffer, size_t frames) {
+    unsigned long long hash = DETMATH_FNV_OFFSET;
+    unsigned short sample;
+    size_t i;
+    for(i = 0; i < frames; i++) {
+        sample = (unsigned short) buffer[i];
+        hash = (hash ^ (sample & 0xff)) * DETMATH_FNV_PRIME;
+        hash = (hash ^ (sample >> 8)) * DETMATH_FNV_PRIME;
+    }
+    return hash;
+}
@@ -0,0 +1,831 @@
+/**
+ * \file engine.c
+ * \brief Moteur audio : mixage des channels sur un flux unique
+ */
+#include "engine.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void *engine_thread(void *args)
+ * \brief Thread de mixage : calcule et écrit une période à la fois
+ * \param args Le moteur
+ */
+void *engine_thread(void *args);
+
+/**
+ * \fn void engine_render_period(engine_t *engine, long long start)
+ * \brief Calcule une période de toutes les voix à partir d'une position du transport
+ * \param engine Le moteur
+ * \param start La position du transport du premier échantillon de la période
+ * \warning Le verrou du moteur doit être pris
+ */
+void engine_render_period(engine_t *engine, long long start);
+
+/**
+ * \fn int engine_next_note(engine_t *engine, voice_t *voice, channel_t *channel)
+ * \brief Passe une voix à la note suivante de son channel
+ * \param engine Le moteur
+ * \param voice La voix
+ * \param channel Le channel de la voix
+ * \return 1 si une note a été chargée, 0 si le channel est terminé
+ */
+int engine_next_note(engine_t *engine, voice_t *voice, channel_t *channel);
+
+/**
+ * \fn void engine_skip_empty(voice_t *voice, channel_t *channel)
+ * \brief Prolonge une ligne vide jusqu'à la prochaine ligne non vide du channel
+ * \param voice La voix, placée sur sa ligne
+ * \param channel Le channel de la voix
+ * \note Une suite de lignes vides est jouée comme un seul silence : la voix ne repasse pas
+ * par le moteur à chaque ligne
+ */
+void engine_skip_empty(voice_t *voice, channel_t *channel);
+
+/**
+ * \fn void engine_seek_voice(engine_t *engine, voice_t *voice, channel_t *channel, long long tick)
+ * \brief Place une voix sur la note de son channel jouée à une position musicale
+ * \param engine Le moteur
+ * \param voice La voix
+ * \param channel Le channel de la voix
+ * \param tick La position en doubles croches
+ */
+void engine_seek_voice(engine_t *engine, voice_t *voice, channel_t *channel, long long tick);
+
+/**
+ * \fn void engine_mix_voice(engine_t *engine, voice_t *voice, int pos, long long frames)
+ * \brief Ajoute un morceau de la note d'une voix au mélange
+ * \param engine Le moteur
+ * \param voice La voix
+ * \param pos L'indice dans la période du premier échantillon à calculer
+ * \param frames Le nombre d'échantillons à calculer
+ */
+void engine_mix_voice(engine_t *engine, voice_t *voice, int pos, long long frames);
+
+/**
+ * \fn void engine_plan_voice(engine_t *engine, int channelId, int pos, long long frames)
+ * \brief Ajoute un morceau de la note d'une voix à sa tâche de la période
+ * \param engine Le moteur
+ * \param channelId Le channel de la voix
+ * \param pos L'indice dans la période du premier échantillon à calculer
+ * \param frames Le nombre d'échantillons à calculer
+ */
+void engine_plan_voice(engine_t *engine, int channelId, int pos, long long frames);
+
+/**
+ * \fn void engine_voice_job(void *args)
+ * \brief Tâche d'un worker : calcule les morceaux d'une voix
+ * \param args La tâche (voice_job_t)
+ */
+void engine_voice_job(void *args);
+
+/**
+ * \fn void engine_run_jobs(engine_t *engine, long long deadline)
+ * \brief Calcule les voix de la période sur les workers et les ajoute au mélange
+ * \param engine Le moteur
+ * \param deadline La date (audio_clock_ns) après laquelle une voix est recalculée ici
+ */
+void engine_run_jobs(engine_t *engine, long long deadline);
+
+/**
+ * \fn short engine_tempo(engine_t *engine)
+ * \brief Tempo de la musique à la phase courante, décalage en direct compris
+ * \param engine Le moteur
+ * \return Le bpm borné entre MUSIC_MIN_BPM et MUSIC_MAX_BPM
+ * \warning Le verrou du moteur doit être pris
+ */
+short engine_tempo(engine_t *engine);
+
+/**
+ * \fn void engine_update_playtick(engine_t *engine, long long playhead)
+ * \brief Retrouve la position musicale audible à partir des périodes mémorisées
+ * \param engine Le moteur
+ * \param playhead La position du transport sortie du haut-parleur
+ */
+void engine_update_playtick(engine_t *engine, long long playhead);
+
+/**
+ * \fn void engine_render_clicks(engine_t *engine)
+ * \brief Pré-calcule les deux clics du métronome
+ * \param engine Le moteur
+ */
+void engine_render_clicks(engine_t *engine);
+
+/**
+ * \fn void engine_mix_click(engine_t *engine, long long start)
+ * \brief Ajoute le clic en cours au mélange de la période
+ * \param engine Le moteur
+ * \param start La position du transport du début de la période
+ */
+void engine_mix_click(engine_t *engine, long long start);
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_engine(engine_t *engine, audio_stats_t *stats)
+ * \brief Ouvre le flux et démarre le thread de mixage
+ * \param engine Le moteur à initialiser
+ * \param stats Les statistiques audio à remplir (peut être NULL)
+ * \return 0 si le moteur est démarré, -1 si le flux n'a pas pu être ouvert
+ */
+int init_engine(engine_t *engine, audio_stats_t *stats) {
+    struct sched_param param;
+    long cores;
+    memset(engine, 0, sizeof(engine_t));
+    if(init_sound_rate(&engine->pcm, ENGINE_PERIOD_FRAMES, ENGINE_PERIODS, &engine->deviceRate) < 0) return -1;
+    if(engine->deviceRate != SAMPLE_RATE) {
+        if(init_resampler(&engine->resampler, SAMPLE_RATE, engine->deviceRate, ENGINE_RESAMPLE_QUALITY) < 0
+            || (engine->deviceBuffer = malloc(sizeof(short) * resample_max_frames(&engine->resampler, ENGINE_PERIOD_FRAMES))) == NULL) {
+            end_resampler(&engine->resampler);
+            end_sound(engine->pcm);
+            engine->pcm = NULL;
+            return -1;
+        }
+    }
+    engine->stats = stats;
+    init_governor(&engine->governor, engine->deviceBuffer != NULL);
+    // Un worker par cœur libre, à la même priorité que le thread de mixage : il leur cède le
+    // processeur en attendant leurs voix
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    init_worker_pool(&engine->workers, cores - 1 < ENGINE_WORKERS ? (int) cores - 1 : ENGINE_WORKERS, sched_get_priority_max(SCHED_FIFO));
+    engine->clickFrame = -ENGINE_CLICK_FRAMES;
+    engine_render_clicks(engine);
+    pthread_mutex_init(&engine->lock, NULL);
+    engine->running = 1;
+    pthread_create(&engine->thread, NULL, engine_thread, (void *) engine);
+    // Le thread de mixage est le seul thread audio : il passe avant l'interface
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    pthread_setschedparam(engine->thread, SCHED_FIFO, &param);
+    return 0;
+}
+
+/**
+ * \fn void end_engine(engine_t *engine)
+ * \brief Arrête le thread de mixage et ferme le flux
+ * \param engine Le moteur à arrêter
+ */
+void end_engine(engine_t *engine) {
+    if(engine->pcm == NULL) return;
+    __atomic_store_n(&engine->running, 0, __ATOMIC_RELEASE);
+    pthread_join(engine->thread, NULL);
+    end_worker_pool(&engine->workers);
+    end_sound(engine->pcm);
+    engine->pcm = NULL;
+    if(engine->deviceBuffer != NULL) {
+        end_resampler(&engine->resampler);
+        free(engine->deviceBuffer);
+        engine->deviceBuffer = NULL;
+    }
+    pthread_mutex_destroy(&engine->lock);
+}
+
+/**
+ * \fn void engine_play(engine_t *engine, music_t *music, long long tick)
+ * \brief Lance la lecture d'une musique à partir d'une position musicale
+ * \param engine Le moteur
+ * \param music La musique à jouer
+ * \param tick La position de départ en doubles croches (0 pour le début)
+ * \note La lecture commence à la prochaine période. La note en cours de chaque channel
+ * est retrouvée en O(log n) et jouée à partir de son milieu : tous les channels
+ * restent calés sur le même échantillon
+ */
+void engine_play(engine_t *engine, music_t *music, long long tick) {
+    int i, playing = 0;
+    if(tick < 0) tick = 0;
+    pthread_mutex_lock(&engine->lock);
+    engine->music = music;
+    // Le transport avance sous le verrou : il pointe sur la prochaine période à calculer.
+    // La phase de cette période est celle de tick, quel que soit le tempo
+    engine->seekStart = engine->transport;
+    engine->phase = tick * SOUND_TICK_PHASE;
+    engine->tempoIndex = music_tempo_index(music, tick);
+    engine->nudge = 0;
+    engine->nbMarks = 0;
+    engine->nextBeat = (engine->phase + ENGINE_CLICK_BEAT_PHASE - 1) / ENGINE_CLICK_BEAT_PHASE * ENGINE_CLICK_BEAT_PHASE;
+    __atomic_store_n(&engine->bpm, engine_tempo(engine), __ATOMIC_RELEASE);
+    // Les pas calculés pour l'ancienne position ne sont plus joués
+    if(engine->stepper != NULL) stepper_flush(engine->stepper);
+    // Les notes coupées par le déplacement n'ont pas de fin de note
+    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) plugin_voices_cut(&(engine->voices[i].plugins));
+    for(i = 0; i < music->nbChannels; i++) {
+        engine_seek_voice(engine, &(engine->voices[i]), &(music->channels[i]), tick);
+        playing |= engine->voices[i].active;
+    }
+    // Les voix au delà des channels de la musique ne sont plus parcourues : elles restent muettes
+    for(; i < MUSIC_MAX_CHANNELS; i++) engine->voices[i].active = 0;
+    // La fin n'est connue qu'en jouant : elle dépend des tempos modifiés en direct
+    __atomic_store_n(&engine->songEnd, engine->transport, __ATOMIC_RELEASE);
+    __atomic_store_n(&engine->playTick, ENGINE_NO_TICK, __ATOMIC_RELEASE);
+    __atomic_store_n(&engine->playing, playing, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * \fn void engine_stop(engine_t *engine)
+ * \brief Arrête la lecture en cours
+ * \param engine Le moteur
+ */
+void engine_stop(engine_t *engine) {
+    int i;
+    pthread_mutex_lock(&engine->lock);
+    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
+        engine->voices[i].active = 0;
+        plugin_voices_cut(&(engine->voices[i].plugins));
+    }
+    if(engine->stepper != NULL) stepper_flush(engine->stepper);
+    engine->nbMarks = 0;
+    __atomic_store_n(&engine->songEnd, engine->transport, __ATOMIC_RELEASE);
+    __atomic_store_n(&engine->playTick, ENGINE_NO_TICK, __ATOMIC_RELEASE);
+    __atomic_store_n(&engine->playing, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * \fn int engine_is_playing(engine_t *engine)
+ * \brief Indique si la musique est encore audible
+ * \param engine Le moteur
+ * \return 1 tant que la dernière note n'est pas sortie du haut-parleur
+ */
+int engine_is_playing(engine_t *engine) {
+    long long songEnd;
+    if(__atomic_load_n(&engine->playing, __ATOMIC_ACQUIRE)) return 1;
+    songEnd = __atomic_load_n(&engine->songEnd, __ATOMIC_ACQUIRE);
+    return engine_playhead(engine) < songEnd;
+}
+
+/**
+ * \fn long long engine_playhead(engine_t *engine)
+ * \brief Position du transport actuellement audible
+ * \param engine Le moteur
+ * \return Le nombre d'échantillons sortis du haut-parleur depuis l'ouverture
+ * \note C'est le transport moins le délai du flux (snd_pcm_delay)
+ */
+long long engine_playhead(engine_t *engine) {
+    return __atomic_load_n(&engine->playhead, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * \fn long long engine_playtick(engine_t *engine)
+ * \brief Position musicale actuellement audible
+ * \param engine Le moteur
+ * \return La position en doubles croches ou ENGINE_NO_TICK avant le début de la lecture
+ */
+long long engine_playtick(engine_t *engine) {
+    return __atomic_load_n(&engine->playTick, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * \fn int engine_line(engine_t *engine, int channelId)
+ * \brief Ligne d'un channel actuellement audible
+ * \param engine Le moteur
+ * \param channelId L'identifiant du channel
+ * \return La ligne jouée ou ENGINE_NO_LINE
+ */
+int engine_line(engine_t *engine, int channelId) {
+    int line = ENGINE_NO_LINE;
+    long long tick = engine_playtick(engine);
+    if(tick == ENGINE_NO_TICK) return ENGINE_NO_LINE;
+    pthread_mutex_lock(&engine->lock);
+    // La position est déjà musicale : le tempo n'intervient pas dans la recherche
+    if(engine->music != NULL && channelId < engine->music->nbChannels) line = channel_tick2line(&(engine->music->channels[channelId]), tick);
+    pthread_mutex_unlock(&engine->lock);
+    return line;
+}
+
+/**
+ * \fn short engine_bpm(engine_t *engine)
+ * \brief Tempo courant de la lecture
+ * \param engine Le moteur
+ * \return Le bpm (changements de tempo de la musique et décalage en direct compris)
+ */
+short engine_bpm(engine_t *engine) {
+    return __atomic_load_n(&engine->bpm, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * \fn void engine_nudge(engine_t *engine, int delta)
+ * \brief Décale le tempo en direct pendant la lecture
+ * \param engine Le moteur
+ * \param delta Le décalage à ajouter en bpm
+ * \note Le décalage s'applique à partir de la prochaine période et n'est pas enregistré
+ * dans la musique. Il est remis à zéro à chaque lecture.
+ */
+void engine_nudge(engine_t *engine, int delta) {
+    pthread_mutex_lock(&engine->lock);
+    engine->nudge += delta;
+    // Le décalage ne peut pas pousser le tempo hors des bornes : il reste réversible
+    if(engine->nudge > MUSIC_MAX_BPM - MUSIC_MIN_BPM) engine->nudge = MUSIC_MAX_BPM - MUSIC_MIN_BPM;
+    if(engine->nudge < MUSIC_MIN_BPM - MUSIC_MAX_BPM) engine->nudge = MUSIC_MIN_BPM - MUSIC_MAX_BPM;
+    if(engine->music != NULL) __atomic_store_n(&engine->bpm, engine_tempo(engine), __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * \fn void engine_audition(engine_t *engine, note_t note, short bpm)
+ * \brief Fait entendre une note sur la voix d'écoute
+ * \param engine Le moteur
+ * \param note La note à écouter (une non note coupe la voix d'écoute)
+ * \param bpm Le bpm de la musique pour la durée de la note
+ * \note La note démarre à la prochaine période calculée, sans ouvrir de flux ni créer de thread.
+ * Elle remplace la note écoutée précédemment et dure au plus ENGINE_AUDITION_MAX_FRAMES.
+ */
+void engine_audition(engine_t *engine, note_t note, short bpm) {
+    voice_t *voice = &(engine->audition);
+    long long frames;
+    if(engine->pcm == NULL) return;
+    frames = note.time > 0 ? ticksToFrames(note.time, bpm) : 0;
+    if(frames > ENGINE_AUDITION_MAX_FRAMES) frames = ENGINE_AUDITION_MAX_FRAMES;
+    pthread_mutex_lock(&engine->lock);
+    voice->note = note;
+    voice->index = -1;
+    voice->offset = 0;
+    voice->frames = frames;
+    voice->effect = 0;
+    voice->start = 1;
+    voice->active = note.id != NOTE_NA_ID && frames > 0;
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * \fn short *engine_loop(engine_t *engine, short *buffer, long long frames)
+ * \brief Joue un buffer en boucle indéfiniment
+ * \param engine Le moteur
+ * \param buffer Le buffer à jouer (NULL pour arrêter la boucle)
+ * \param frames Le nombre d'échantillons du buffer
+ * \return Le buffer joué précédemment, que l'appelant peut libérer
+ * \note Si une boucle est déjà jouée, le nouveau buffer la remplace à la même position
+ * (modulo sa nouvelle longueur) : une boucle modifiée continue sans coupure
+ */
+short *engine_loop(engine_t *engine, short *buffer, long long frames) {
+    short *old;
+    if(engine->pcm == NULL) return buffer;
+    if(frames <= 0) buffer = NULL;
+    pthread_mutex_lock(&engine->lock);
+    old = engine->loopBuffer;
+    if(old == NULL) engine->loopStart = engine->transport;
+    engine->loopBuffer = buffer;
+    engine->loopFrames = buffer != NULL ? frames : 0;
+    pthread_mutex_unlock(&engine->lock);
+    return old;
+}
+
+/**
+ * \fn void engine_set_stepper(engine_t *engine, stepper_t *stepper)
+ * \brief Branche le moteur pas à pas sur le transport
+ * \param engine Le moteur
+ * \param stepper Le moteur pas à pas démarré avec init_stepper (NULL pour le débrancher)
+ * \note Le moteur pas à pas est monophonique : il joue la note INSTRUMENT_STEPMOTOR
+ * du premier channel qui en a une
+ */
+void engine_set_stepper(engine_t *engine, stepper_t *stepper) {
+    pthread_mutex_lock(&engine->lock);
+    engine->stepper = stepper;
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * \fn void engine_set_metronome(engine_t *engine, int enabled)
+ * \brief Active ou coupe le métronome
+ * \param engine Le moteur
+ * \param enabled 1 pour entendre un clic à chaque temps de la musique jouée
+ * \note Peut être appelé pendant la lecture : le prochain temps est cliqué ou non
+ */
+void engine_set_metronome(engine_t *engine, int enabled) {
+    __atomic_store_n(&engine->metronome, enabled, __ATOMIC_RELAXED);
+}
+
+/**
+ * \fn void engine_set_effect(engine_t *engine, short effect)
+ * \brief Change l'effet appliqué aux prochaines notes
+ * \param engine Le moteur
+ * \param effect L'effet (0 : aucun, 1 : fuzz, 2 : compression)
+ */
+void engine_set_effect(engine_t *engine, short effect) {
+    __atomic_store_n(&engine->effect, effect, __ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void *engine_thread(void *args)
+ * \brief Thread de mixage : calcule et écrit une période à la fois
+ * \param args Le moteur
+ */
+void *engine_thread(void *args) {
+    engine_t *engine = (engine_t *) args;
+    long long start, renderNs, transport;
+    snd_pcm_sframes_t delay;
+    stepper_t *stepper;
+    size_t frames;
+    long written;
+    sound_quality_t quality;
+
+    while(__atomic_load_n(&engine->running, __ATOMIC_ACQUIRE)) {
+        start = audio_clock_ns();
+        pthread_mutex_lock(&engine->lock);
+        engine_render_period(engine, engine->transport);
+        transport = engine->transport + ENGINE_PERIOD_FRAMES;
+        __atomic_store_n(&engine->transport, transport, __ATOMIC_RELEASE);
+        stepper = engine->stepper;
+        pthread_mutex_unlock(&engine->lock);
+        renderNs = audio_clock_ns() - start;
+        quality = engine->governor.quality;
+        // La qualité choisie s'applique dès la période suivante
+        if(update_governor(&engine->governor, renderNs, (long long) ENGINE_PERIOD_FRAMES * NSEC_PER_SEC / SAMPLE_RATE)) {
+            if(engine->deviceBuffer != NULL) resample_set_linear(&engine->resampler, engine->governor.quality >= SOUND_QUALITY_LINEAR);
+            record_audio_quality(engine->stats, quality, engine->governor.quality, engine->governor.lastLoad);
+        }
+
+        // Même sans musique on écrit du silence : le transport avance en continu
+        if(engine->deviceBuffer == NULL) written = write_pcm(engine->pcm, engine->buffer, ENGINE_PERIOD_FRAMES, engine->stats);
+        else {
+            frames = resample(&engine->resampler, engine->buffer, ENGINE_PERIOD_FRAMES, engine->deviceBuffer);
+            written = write_pcm(engine->pcm, engine->deviceBuffer, frames, engine->stats);
+        }
+        if(written < 0) break;
+        if(snd_pcm_delay(engine->pcm, &delay) < 0) delay = -1;
+        // Le délai du flux est ramené en échantillons du transport, retard du filtre compris
+        else if(engine->deviceBuffer != NULL) delay = delay * SAMPLE_RATE / engine->deviceRate + resample_latency(&engine->resampler);
+        __atomic_store_n(&engine->playhead, delay < 0 ? transport : transport - delay, __ATOMIC_RELEASE);
+        engine_update_playtick(engine, delay < 0 ? transport : transport - delay);
+        // Le moteur pas à pas date ses pas sur ce qui sort réellement du haut-parleur
+        if(stepper != NULL && delay >= 0) stepper_sync(stepper, transport - delay, audio_clock_ns());
+        record_audio_period(engine->stats, renderNs, (long long) ENGINE_PERIOD_FRAMES * NSEC_PER_SEC / SAMPLE_RATE, delay);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * \fn void engine_render_period(engine_t *engine, long long start)
+ * \brief Calcule une période de toutes les voix à partir d'une position du transport
+ * \param engine Le moteur
+ * \param start La position du transport du premier échantillon de la période
+ * \warning Le verrou du moteur doit être pris
+ */
+void engine_render_period(engine_t *engine, long long start) {
+    long long n, m, unit, periodPhase = engine->phase, deadline = audio_clock_ns();
+    int i, j, pos = 0, active, stepper, wasPlaying = engine->playing, parallel;
+    short bpm;
+    music_t *music = engine->music;
+    memset(engine->mix, 0, sizeof(engine->mix));
+    // Une voix abandonnée à l'échéance précédente est encore calculée par un worker : ses
+    // données ne peuvent pas être réutilisées, cette période est calculée ici
+    parallel = engine->workers.nbWorkers > 0 && engine->playing && jobs_idle(engine->jobs, MUSIC_MAX_CHANNELS);
+    if(parallel) {
+        deadline += (long long) ENGINE_PERIOD_FRAMES * NSEC_PER_SEC / SAMPLE_RATE * ENGINE_JOB_DEADLINE / 1000;
+        for(i = 0; i < MUSIC_MAX_CHANNELS; i++) engine->voiceJobs[i].nbSegments = 0;
+    }
+    // La période est découpée aux changements de note et de tempo : entre deux, la phase
+    // avance de bpm par échantillon et toutes les voix restent calées sur elle
+    while(engine->playing && pos < ENGINE_PERIOD_FRAMES) {
+        while(engine->tempoIndex < music->nbTempos && music->tempos[engine->tempoIndex].tick * SOUND_TICK_PHASE <= engine->phase) {
+            engine->tempoIndex++;
+        }
+        bpm = engine_tempo(engine);
+        __atomic_store_n(&engine->bpm, bpm, __ATOMIC_RELEASE);
+        n = ENGINE_PERIOD_FRAMES - pos;
+        active = 0;
+        stepper = 0;
+        for(i = 0; i < music->nbChannels; i++) {
+            voice_t *voice = &(engine->voices[i]);
+            // Changement de note à l'échantillon près
+            while(voice->active && engine->phase >= voice->tickEnd * SOUND_TICK_PHASE) {
+                engine_next_note(engine, voice, &(music->channels[i]));
+            }
+            if(!voice->active) continue;
+            active = 1;
+            m = phaseToFrames(engine->phase, voice->tickEnd * SOUND_TICK_PHASE, bpm);
+            if(m < n) n = m;
+        }
+        // Fin de la musique : la dernière note se termine dans cette période
+        if(!active) {
+            __atomic_store_n(&engine->songEnd, start + pos, __ATOMIC_RELEASE);
+            __atomic_store_n(&engine->playing, 0, __ATOMIC_RELEASE);
+            break;
+        }
+        if(engine->tempoIndex < music->nbTempos) {
+            m = phaseToFrames(engine->phase, music->tempos[engine->tempoIndex].tick * SOUND_TICK_PHASE, bpm);
+            if(m < n) n = m;
+        }
+        // Les temps franchis dans le morceau déclenchent un clic : le métronome suit les changements de tempo
+        while((m = phaseToFrames(engine->phase, engine->nextBeat, bpm)) < n) {
+            if(__atomic_load_n(&engine->metronome, __ATOMIC_RELAXED)) {
+                engine->clickFrame = start + pos + m;
+                engine->clickAccent = engine->nextBeat / ENGINE_CLICK_BEAT_PHASE % ENGINE_CLICK_BEATS_PER_BAR == 0;
+            }
+            engine->nextBeat += ENGINE_CLICK_BEAT_PHASE;
+        }
+        for(i = 0; i < music->nbChannels; i++) {
+            voice_t *voice = &(engine->voices[i]);
+            if(!voice->active) continue;
+            // Les pas sont datés sur le transport : le moteur pas à pas les joue quand ils sortent du haut-parleur
+            if(engine->stepper != NULL && voice->note.instrument == INSTRUMENT_STEPMOTOR && voice->note.id != NOTE_NA_ID && !stepper) {
+                stepper_push(engine->stepper, start + pos, n, noteToFreq(voice->note), voice->offset == 0);
+                stepper = 1;
+            }
+            if(parallel) engine_plan_voice(engine, i, pos, n);
+            else engine_mix_voice(engine, voice, pos, n);
+        }
+        pos += n;
+        engine->phase += n * bpm;
+    }
+    if(parallel) engine_run_jobs(engine, deadline);
+    // Channel terminé ou lecture finie : la dernière note reçoit note_off
+    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
+        if(!engine->voices[i].active) plugin_voices_cut(&(engine->voices[i].plugins));
+    }
+    if(wasPlaying) {
+        // Mémorise la phase de la période pour retrouver plus tard la position audible
+        engine_mark_t *mark = &(engine->marks[engine->nbMarks % ENGINE_MARKS]);
+        mark->frame = start;
+        mark->phase = periodPhase;
+        mark->endPhase = engine->phase;
+        engine->nbMarks++;
+    }
+    engine_mix_click(engine, start);
+    // La voix d'écoute se superpose à la musique
+    if(engine->audition.active) {
+        n = engine->audition.frames - engine->audition.offset;
+        if(n > ENGINE_PERIOD_FRAMES) n = ENGINE_PERIOD_FRAMES;
+        engine_mix_voice(engine, &(engine->audition), 0, n);
+        if(engine->audition.offset >= engine->audition.frames) engine->audition.active = 0;
+    }
+    if(!engine->audition.active) plugin_voices_cut(&(engine->audition.plugins));
+    // La boucle est déjà calculée : on la recopie sans synthèse
+    if(engine->loopBuffer != NULL) {
+        unit = (start - engine->loopStart) % engine->loopFrames;
+        for(j = 0; j < ENGINE_PERIOD_FRAMES; j++) {
+            engine->mix[j] += engine->loopBuffer[unit];
+            if(++unit == engine->loopFrames) unit = 0;
+        }
+    }
+    mix2pcm(engine->mix, engine->buffer, ENGINE_PERIOD_FRAMES);
+}
+
+/**
+ * \fn void engine_skip_empty(voice_t *voice, channel_t *channel)
+ * \brief Prolonge une ligne vide jusqu'à la prochaine ligne non vide du channel
+ * \param voice La voix, placée sur sa ligne
+ * \param channel Le channel de la voix
+ * \note Une suite de lignes vides est jouée comme un seul silence : la voix ne repasse pas
+ * par le moteur à chaque ligne
+ */
+void engine_skip_empty(voice_t *voice, channel_t *channel) {
+    int next = channel_next_line(channel, voice->index);
+    if(next == voice->index) return;
+    if(next < 0 || next > channel->nbNotes) next = channel->nbNotes;
+    voice->tickEnd = voice->tickStart + channel_lines_ticks(channel, voice->index, next);
+    voice->index = next - 1;
+}
+
+/**
+ * \fn void engine_seek_voice(engine_t *engine, voice_t *voice, channel_t *channel, long long tick)
+ * \brief Place une voix sur la note de son channel jouée à une position musicale
+ * \param engine Le moteur
+ * \param voice La voix
+ * \param channel Le channel de la voix
+ * \param tick La position en doubles croches
+ */
+void engine_seek_voice(engine_t *engine, voice_t *voice, channel_t *channel, long long tick) {
+    voice->index = channel_tick2line(channel, tick);
+    voice->tickStart = channel_line2tick(channel, voice->index);
+    voice->active = voice->index < channel->nbNotes;
+    voice->note = channel_note(channel, voice->index < CHANNEL_MAX_NOTES ? voice->index : CHANNEL_MAX_NOTES - 1);
+    if(!voice->active) voice->note.time = 0;
+    voice->tickEnd = voice->tickStart + NOTE_TICKS(voice->note);
+    if(voice->active) engine_skip_empty(voice, channel);
+    // La note coupée reprend au même échantillon qu'une lecture depuis le début
+    voice->offset = tempoTicksToFrames(engine->music, tick) - tempoTicksToFrames(engine->music, voice->tickStart);
+    // La note coupée par le déplacement garde l'effet courant du capteur
+    voice->effect = __atomic_load_n(&engine->effect, __ATOMIC_RELAXED);
+    voice->start = 1;
+}
+
+/**
+ * \fn int engine_next_note(engine_t *engine, voice_t *voice, channel_t *channel)
+ * \brief Passe une voix à la note suivante de son channel
+ * \param engine Le moteur
+ * \param voice La voix
+ * \param channel Le channel de la voix
+ * \return 1 si une note a été chargée, 0 si le channel est terminé
+ */
+int engine_next_note(engine_t *engine, voice_t *voice, channel_t *channel) {
+    voice->tickStart = voice->tickEnd;
+    voice->index++;
+    if(voice->index >= channel->nbNotes) {
+        voice->active = 0;
+        return 0;
+    }
+    voice->note = channel_note(channel, voice->index);
+    // Les bornes viennent de la position cumulée : pas de dérive entre les channels
+    voice->tickEnd = voice->tickStart + NOTE_TICKS(voice->note);
+    engine_skip_empty(voice, channel);
+    voice->offset = 0;
+    voice->start = 1;
+    // Le capteur est lu au début de chaque note, comme avant
+    voice->effect = __atomic_load_n(&engine->effect, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/**
+ * \fn void engine_mix_voice(engine_t *engine, voice_t *voice, int pos, long long frames)
+ * \brief Ajoute un morceau de la note d'une voix au mélange
+ * \param engine Le moteur
+ * \param voice La voix
+ * \param pos L'indice dans la période du premier échantillon à calculer
+ * \param frames Le nombre d'échantillons à calculer
+ */
+void engine_mix_voice(engine_t *engine, voice_t *voice, int pos, long long frames) {
+    int j;
+    if(frames <= 0) return;
+    render_note_voice(engine->voiceBuffer, voice->note, &(voice->plugins), voice->start, voice->offset, frames, voice->effect, engine->governor.quality);
+    for(j = 0; j < frames; j++) engine->mix[pos + j] += engine->voiceBuffer[j];
+    voice->offset += frames;
+    voice->start = 0;
+}
+
+/**
+ * \fn void engine_plan_voice(engine_t *engine, int channelId, int pos, long long frames)
+ * \brief Ajoute un morceau de la note d'une voix à sa tâche de la période
+ * \param engine Le moteur
+ * \param channelId Le channel de la voix
+ * \param pos L'indice dans la période du premier échantillon à calculer
+ * \param frames Le nombre d'échantillons à calculer
+ */
+void engine_plan_voice(engine_t *engine, int channelId, int pos, long long frames) {
+    voice_t *voice = &(engine->voices[channelId]);
+    voice_job_t *job = &(engine->voiceJobs[channelId]);
+    voice_segment_t *segment = job->nbSegments > 0 ? &(job->segments[job->nbSegments - 1]) : NULL;
+    int k, j;
+    if(frames <= 0) return;
+    // Un changement de tempo ne coupe pas la note : le morceau précédent est prolongé
+    if(segment != NULL && !voice->start && segment->pos + segment->frames == pos && segment->offset + segment->frames == voice->offset) {
+        segment->frames += frames;
+        voice->offset += frames;
+        return;
+    }
+    if(job->nbSegments == ENGINE_VOICE_SEGMENTS) {
+        // Plus de place dans la tâche : ses morceaux sont calculés tout de suite, dans l'ordre
+        // pour que les plugins voient la note comme si la tâche était complète
+        engine_voice_job(job);
+        for(k = 0; k < job->nbSegments; k++) {
+            segment = &(job->segments[k]);
+            for(j = segment->pos; j < segment->pos + segment->frames; j++) engine->mix[j] += job->buffer[j];
+        }
+        voice->plugins = job->plugins;
+        job->nbSegments = 0;
+    }
+    // La tâche travaille sur une copie des voix des plugins (voir voice_job_t)
+    if(job->nbSegments == 0) job->plugins = voice->plugins;
+    segment = &(job->segments[job->nbSegments++]);
+    segment->note = voice->note;
+    segment->offset = voice->offset;
+    segment->effect = voice->effect;
+    segment->start = voice->start;
+    segment->pos = pos;
+    segment->frames = frames;
+    voice->offset += frames;
+    voice->start = 0;
+}
+
+/**
+ * \fn void engine_voice_job(void *args)
+ * \brief Tâche d'un worker : calcule les morceaux d'une voix
+ * \param args La tâche (voice_job_t)
+ */
+void engine_voice_job(void *args) {
+    voice_job_t *job = (voice_job_t *) args;
+    voice_segment_t *segment;
+    int k;
+    for(k = 0; k < job->nbSegments; k++) {
+        segment = &(job->segments[k]);
+        render_note_voice(job->buffer + segment->pos, segment->note, &(job->plugins), segment->start, segment->offset, segment->frames, segment->effect, job->quality);
+    }
+}
+
+/**
+ * \fn void engine_run_jobs(engine_t *engine, long long deadline)
+ * \brief Calcule les voix de la période sur les workers et les ajoute au mélange
+ * \param engine Le moteur
+ * \param deadline La date (audio_clock_ns) après laquelle une voix est recalculée ici
+ */
+void engine_run_jobs(engine_t *engine, long long deadline) {
+    int i, j, k, nbJobs = 0, late;
+    voice_job_t *job;
+    voice_segment_t *segment;
+    voice_t *voice;
+    short *buffer;
+
+    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
+        if(engine->voiceJobs[i].nbSegments == 0) continue;
+        engine->voiceJobs[i].quality = engine->governor.quality;
+        engine->jobs[nbJobs].run = engine_voice_job;
+        engine->jobs[nbJobs].arg = &(engine->voiceJobs[i]);
+        __atomic_store_n(&(engine->jobs[nbJobs].state), JOB_IDLE, __ATOMIC_RELAXED);
+        nbJobs++;
+    }
+    late = run_jobs(&engine->workers, engine->jobs, nbJobs, deadline);
+    if(late > 0) record_audio_late_jobs(engine->stats, late);
+    // Les voix sont additionnées dans l'ordre des channels, quel que soit le thread qui les a calculées
+    for(i = 0; i < nbJobs; i++) {
+        job = (voice_job_t *) engine->jobs[i].arg;
+        voice = &(engine->voices[job - engine->voiceJobs]);
+        buffer = job->buffer;
+        if(__atomic_load_n(&(engine->jobs[i].state), __ATOMIC_ACQUIRE) != JOB_DONE) {
+            // Voix en retard : le worker la termine pour rien sur sa copie, le thread de mixage
+            // la refait à partir des voix des plugins du channel, restées intactes
+            buffer = engine->voiceBuffer;
+            for(k = 0; k < job->nbSegments; k++) {
+                segment = &(job->segments[k]);
+                render_note_voice(buffer + segment->pos, segment->note, &(voice->plugins), segment->start, segment->offset, segment->frames, segment->effect, job->quality);
+            }
+        }
+        else voice->plugins = job->plugins;
+        for(k = 0; k < job->nbSegments; k++) {
+            segment = &(job->segments[k]);
+            for(j = segment->pos; j < segment->pos + segment->frames; j++) engine->mix[j] += buffer[j];
+        }
+    }
+}
+
+/**
+ * \fn short engine_tempo(engine_t *engine)
+ * \brief Tempo de la musique à la phase courante, décalage en direct compris
+ * \param engine Le moteur
+ * \return Le bpm borné entre MUSIC_MIN_BPM et MUSIC_MAX_BPM
+ * \warning Le verrou du moteur doit être pris
+ */
+short engine_tempo(engine_t *engine) {
+    music_t *music = engine->music;
+    int bpm = engine->tempoIndex > 0 ? music->tempos[engine->tempoIndex - 1].bpm : music->bpm;
+    bpm += engine->nudge;
+    if(bpm < MUSIC_MIN_BPM) bpm = MUSIC_MIN_BPM;
+    if(bpm > MUSIC_MAX_BPM) bpm = MUSIC_MAX_BPM;
+    return (short) bpm;
+}
+
+/**
+ * \fn void engine_update_playtick(engine_t *engine, long long playhead)
+ * \brief Retrouve la position musicale audible à partir des périodes mémorisées
+ * \param engine Le moteur
+ * \param playhead La position du transport sortie du haut-parleur
+ */
+void engine_update_playtick(engine_t *engine, long long playhead) {
+    long long tick = ENGINE_NO_TICK;
+    engine_mark_t *mark;
+    int i, count;
+    pthread_mutex_lock(&engine->lock);
+    count = engine->nbMarks < ENGINE_MARKS ? engine->nbMarks : ENGINE_MARKS;
+    if(count > 0 && playhead >= engine->seekStart) {
+        // On part de la période la plus récente : le délai du flux ne dépasse pas quelques périodes
+        for(i = 1; i <= count; i++) {
+            mark = &(engine->marks[(engine->nbMarks - i) % ENGINE_MARKS]);
+            if(playhead >= mark->frame || i == count) break;
+        }
+        if(playhead < mark->frame) tick = mark->phase;
+        else if(playhead >= mark->frame + ENGINE_PERIOD_FRAMES) tick = mark->endPhase;
+        else tick = mark->phase + (mark->endPhase - mark->phase) * (playhead - mark->frame) / ENGINE_PERIOD_FRAMES;
+        tick /= SOUND_TICK_PHASE;
+    }
+    __atomic_store_n(&engine->playTick, tick, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * \fn void engine_render_clicks(engine_t *engine)
+ * \brief Pré-calcule les deux clics du métronome
+ * \param engine Le moteur
+ */
+void engine_render_clicks(engine_t *engine) {
+    int i;
+    double envelope;
+    for(i = 0; i < ENGINE_CLICK_FRAMES; i++) {
+        // Sinus amorti : un clic court et sans craquement à la fin
+        envelope = exp(-5.0 * i / ENGINE_CLICK_FRAMES) * (ENGINE_CLICK_FRAMES - i) / ENGINE_CLICK_FRAMES;
+        engine->clicks[0][i] = (short) (BASE_AMPLITUDE / 2 * envelope * sin(2 * M_PI * ENGINE_CLICK_FREQ * i / SAMPLE_RATE));
+        engine->clicks[1][i] = (short) (BASE_AMPLITUDE * envelope * sin(2 * M_PI * ENGINE_CLICK_ACCENT_FREQ * i / SAMPLE_RATE));
+    }
+}
+
+/**
+ * \fn void engine_mix_click(engine_t *engine, long long start)
+ * \brief Ajoute le clic en cours au mélange de la période
+ * \param engine Le moteur
+ * \param start La position du transport du début de la période
+ */
+void engine_mix_click(engine_t *engine, long long start) {
+    short *click = engine->clicks[engine->clickAccent];
+    long long j = engine->clickFrame - start, k = 0;
+    // Un clic déjà calculé n'est qu'une copie : rien n'est synthétisé à chaque temps
+    if(j < 0) {
+        k = -j;
+        j = 0;
+    }
+    for(; j < ENGINE_PERIOD_FRAMES && k < ENGINE_CLICK_FRAMES; j++, k++) engine->mix[j] += click[k];
+}
@@ -0,0 +1,78 @@
+/**
+ * \file governor.c
+ * \brief Régulation de la qualité du rendu en fonction de la charge
+ */
+#include "governor.h"
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_governor(governor_t *governor, int resampling)
+ * \brief Initialise le régulateur à la qualité maximale
+ * \param governor Le régulateur
+ * \param resampling 1 si le flux de sortie est converti à la fréquence du périphérique
+ */
+void init_governor(governor_t *governor, int resampling) {
+    memset(governor, 0, sizeof(governor_t));
+    governor->resampling = resampling;
+    governor->quality = SOUND_QUALITY_FULL;
+    governor->upPeriods = GOVERNOR_UP_PERIODS;
+    governor->sinceUp = -1;
+}
+
+/**
+ * \fn int update_governor(governor_t *governor, long long renderNs, long long budgetNs)
+ * \brief Prend en compte le temps de calcul d'une période
+ * \param governor Le régulateur
+ * \param renderNs Le temps passé à calculer la période
+ * \param budgetNs La durée de la période
+ * \return 1 si la qualité a changé, 0 sinon
+ */
+int update_governor(governor_t *governor, long long renderNs, long long budgetNs) {
+    int load, missed;
+    if(budgetNs <= 0) return 0;
+    load = (int) (renderNs * 1000 / budgetNs);
+    governor->lastLoad = load;
+    governor->load += (load - governor->load) / GOVERNOR_SMOOTHING;
+    if(governor->sinceUp >= 0) governor->sinceUp++;
+    // Qualité tenue assez longtemps : les rechutes passées ne pénalisent plus les remontées
+    if(governor->stable < GOVERNOR_MAX_UP_PERIODS && ++governor->stable == GOVERNOR_MAX_UP_PERIODS)
+        governor->upPeriods = GOVERNOR_UP_PERIODS;
+
+    // Une période calculée en plus de temps qu'elle n'en dure est une échéance manquée
+    missed = load > 1000;
+    if(missed || governor->load > GOVERNOR_HIGH_LOAD) governor->over++;
+    else governor->over = 0;
+    if(governor->load < GOVERNOR_LOW_LOAD) governor->under++;
+    else governor->under = 0;
+
+    if(governor->quality < SOUND_NB_QUALITIES - 1 && (missed || governor->over >= GOVERNOR_DOWN_PERIODS)) {
+        // Rechute juste après une remontée : la remontée suivante attendra deux fois plus
+        if(governor->sinceUp >= 0 && governor->sinceUp < governor->upPeriods) {
+            governor->upPeriods *= 2;
+            if(governor->upPeriods > GOVERNOR_MAX_UP_PERIODS) governor->upPeriods = GOVERNOR_MAX_UP_PERIODS;
+        }
+        governor->quality++;
+        // Sans conversion, l'interpolation linéaire ne gagne rien : on passe directement au niveau suivant
+        if(governor->quality == SOUND_QUALITY_LINEAR && !governor->resampling) governor->quality++;
+        governor->sinceUp = -1;
+        governor->stable = 0;
+        governor->under = 0;
+        // La charge lissée met quelques périodes à refléter le nouveau niveau : on lui
+        // laisse ce temps avant de baisser encore, sauf si une échéance est manquée
+        governor->over = -2 * GOVERNOR_SMOOTHING;
+        return 1;
+    }
+    if(governor->quality > SOUND_QUALITY_FULL && governor->under >= governor->upPeriods) {
+        governor->quality--;
+        if(governor->quality == SOUND_QUALITY_LINEAR && !governor->resampling) governor->quality--;
+        governor->sinceUp = 0;
+        governor->stable = 0;
+        governor->under = 0;
+        governor->over = 0;
+        return 1;
+    }
+    return 0;
+}
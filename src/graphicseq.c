@@ -11,8 +11,8 @@
 /**********************************************************************************************************************/
 /**
  * @fn show_sequencer_channels(WINDOW **channelWin, music_t *music, sequencer_nav_t *seqNav)
- * @brief Affichage des channels du séquenceur
- * @param channelWin Les fenêtres des channels
+ * @brief Affichage des channels du séquenceur (à partir du premier channel affiché)
+ * @param channelWin Les fenêtres des channels affichés
  * @param music La musique à afficher
  * @param seqNav La structure de navigation dans le séquenceur
  * @warning Les fenêtres doivent être initialisées avec init_sequencer_channels
@@ -82,8 +82,56 @@ choices_t create_menu(const char *title, const char *text, char **choices, int n
  * \param music La musique à afficher
  * \param mode Le mode des boutons (0 pour le mode NAVIGATION, 1 pour le mode EDITION)
  * \param need2save Indication visuelle si la musique doit être sauvegardée
+ * \param seqNav La structure de navigation (pour afficher la boucle et le métronome)
  */
-void show_sequencer_info(WINDOW *win, music_t *music, int mode, char need2save);
+void show_sequencer_info(WINDOW *win, music_t *music, int mode, char need2save, sequencer_nav_t *seqNav);
+
+/**
+ * \fn int sequencer_loop_ticks(music_t *music, sequencer_nav_t *seqNav, long long *tickStart, long long *tickEnd)
+ * \brief Calcule les bornes de la boucle marquée dans le séquenceur
+ * \param music La musique
+ * \param seqNav La structure de navigation contenant la boucle
+ * \param tickStart Le début de la boucle en doubles croches
+ * \param tickEnd La fin de la boucle en doubles croches
+ * \return 0 si succès, -1 si la boucle n'est pas marquée
+ */
+int sequencer_loop_ticks(music_t *music, sequencer_nav_t *seqNav, long long *tickStart, long long *tickEnd);
+
+/**
+ * \fn int is_in_sequencer_loop(music_t *music, sequencer_nav_t *seqNav, int ch, int line)
+ * \brief Indique si la modification d'une note change le contenu de la boucle
+ * \param music La musique
+ * \param seqNav La structure de navigation contenant la boucle
+ * \param ch Le channel de la note modifiée
+ * \param line La ligne de la note modifiée
+ * \return 1 si la boucle doit être recalculée
+ * \note Une note placée avant la boucle peut décaler ses bornes (durée modifiée)
+ */
+int is_in_sequencer_loop(music_t *music, sequencer_nav_t *seqNav, int ch, int line);
+
+/**
+ * \fn int is_in_sequencer_block(sequencer_nav_t *seqNav, int ch, int line)
+ * \brief Indique si une ligne fait partie du bloc de lignes marqué
+ * \param seqNav La structure de navigation contenant le bloc
+ * \param ch Le channel de la ligne
+ * \param line La ligne
+ * \return 1 si le bloc est marqué (début et fin) et contient la ligne
+ */
+int is_in_sequencer_block(sequencer_nav_t *seqNav, int ch, int line);
+
+/**
+ * \fn int change_sequencer_block(journal_t *journal, music_t *music, sequencer_nav_t *seqNav, scale_t scale, int isUp)
+ * \brief Modification de toutes les notes du bloc marqué en fonction de la colonne actuelle
+ * \param journal Le journal des modifications
+ * \param music La musique
+ * \param seqNav La structure de navigation contenant le bloc
+ * \param scale La gamme des notes
+ * \param isUp La direction de la modification (0 pour le bas, 1 pour le haut)
+ * \return 1 si le bloc a changé, 0 sinon, -1 en cas d'erreur d'allocation
+ * \note La colonne des notes transpose d'un demi-ton, celle des octaves d'une octave et celle des
+ * instruments donne à tout le bloc l'instrument suivant (ou précédent) de la note sélectionnée
+ */
+int change_sequencer_block(journal_t *journal, music_t *music, sequencer_nav_t *seqNav, scale_t scale, int isUp);
 
 /**
  * \fn void show_sequencer_help(WINDOW *win)
@@ -93,13 +141,21 @@ void show_sequencer_info(WINDOW *win, music_t *music, int mode, char need2save);
  */
 void show_sequencer_help(WINDOW *win);
 
+/**
+ * \fn void show_sequencer_stats(WINDOW *win, audio_stats_t *stats)
+ * \brief Affichage de l'overlay des statistiques audio à la place de l'aide
+ * \param win La fenêtre où afficher les statistiques
+ * \param stats Les statistiques audio
+ */
+void show_sequencer_stats(WINDOW *win, audio_stats_t *stats);
+
 /**
  * \fn void init_sequencer_channels(WINDOW **channels, music_t *music)
  * \brief Initialisation des channels du séquenceur
  * \details Cette fonction initialise les channels du séquenceur
- * \param channels Les fenêtres des channels
+ * \param channels Les fenêtres des channels affichés
  * \param music La musique à afficher
- * \warning Il doit y avoir MUSIC_MAX_CHANNELS channels
+ * \warning Il doit y avoir SEQUENCER_CH_VISIBLE fenêtres
 */
 void init_sequencer_channels(WINDOW **channels, music_t *music);
 
@@ -336,6 +392,8 @@ choices_t show_list_music(char *rfid, music_t *music) {
                 // On récupère la musique
                 response = client_request_handler(MPP_GET_MUSIC, rfid, music, musicIds->musicIds[current]);
                 if(response.code == MPP_RESPONSE_OK) {
+                    // Les blocs de notes de la réponse passent à la musique
+                    free_music(music);
                     *music = *response.music;
 
                 } else {
@@ -374,6 +432,7 @@ void show_date(time_t timestamp, char *chaine) {
  */
 choices_t show_create_music_menu(music_t *music, char *rfid) {
     init_menu("Create music", "", 1);
+    free_music(music);
     init_music(music, 120);
     music->bpm = 120;
     char date[20];
@@ -468,18 +527,20 @@ void sequencer_nav_down(sequencer_nav_t *nav, int channelId) {
 }
 
 /**
- * @fn void sequencer_nav_left(sequencer_nav_t *nav)
+ * @fn void sequencer_nav_left(sequencer_nav_t *nav, int nbChannels)
  * @brief La fonction qui permet de passer d'une colonne à une autre dans le séquenceur (vers la gauche)
  * @param nav la structure de navigation
+ * @param nbChannels le nombre de channels de la musique
  */
-void sequencer_nav_left(sequencer_nav_t *nav) {
+void sequencer_nav_left(sequencer_nav_t *nav, int nbChannels) {
     if (nav->col == SEQUENCER_NAV_COL_LINE) {
         // on change de channel
-        int newChannel = (nav->ch - 1) != -1 ? nav->ch-1 : SEQUENCER_NAV_CH_MAX - 1;
+        int newChannel = nav->ch > SEQUENCER_NAV_CH1 ? (int) nav->ch - 1 : nbChannels - 1;
         nav->start[newChannel] = nav->start[nav->ch];
         nav->lines[newChannel] = nav->lines[nav->ch];
         nav->ch = newChannel;
         nav->col = SEQUENCER_NAV_COL_TIME; // on revient à la colonne de la durée
+        sequencer_nav_scroll(nav, nbChannels);
         return ;
     }
     // Sinon on change de colonne
@@ -487,23 +548,104 @@ void sequencer_nav_left(sequencer_nav_t *nav) {
 }
 
 /**
- * @fn void sequencer_nav_right(sequencer_nav_t *nav)
+ * @fn void sequencer_nav_right(sequencer_nav_t *nav, int nbChannels)
  * @brief La fonction qui permet de passer d'une colonne à une autre dans le séquenceur (vers la droite)
  * @param nav 
+ * @param nbChannels le nombre de channels de la musique
  */
-void sequencer_nav_right(sequencer_nav_t *nav) {
+void sequencer_nav_right(sequencer_nav_t *nav, int nbChannels) {
     if (nav->col == SEQUENCER_NAV_COL_TIME) {
         // on change de channel
-        int newChannel = (nav->ch + 1) % SEQUENCER_NAV_CH_MAX;
+        int newChannel = (nav->ch + 1) % nbChannels;
         nav->start[newChannel] = nav->start[nav->ch]; // on switch de channel mais on garde la ligne à la même position
         nav->lines[newChannel] = nav->lines[nav->ch];
         nav->ch = newChannel;
         nav->col = SEQUENCER_NAV_COL_LINE; // on revient à la colonne de la ligne
+        sequencer_nav_scroll(nav, nbChannels);
         return ;
     }
     if (nav->col < SEQUENCER_NAV_COL_MAX - 1) nav->col++;
 }
 
+/**
+ * @fn void sequencer_nav_channel(sequencer_nav_t *nav, int channelId, int nbChannels)
+ * @brief Sélectionne un channel en gardant la ligne sélectionnée à la même hauteur
+ * @param nav la structure de navigation
+ * @param channelId le channel (ignoré s'il n'est pas dans la musique)
+ * @param nbChannels le nombre de channels de la musique
+ */
+void sequencer_nav_channel(sequencer_nav_t *nav, int channelId, int nbChannels) {
+    if (channelId < 0 || channelId >= nbChannels) return;
+    nav->lines[channelId] = nav->start[channelId] + nav->lines[nav->ch] - nav->start[nav->ch]; // On garde la même ligne (pas forcément le même start)
+    nav->ch = channelId;
+    sequencer_nav_scroll(nav, nbChannels);
+}
+
+/**
+ * @fn void sequencer_nav_scroll(sequencer_nav_t *nav, int nbChannels)
+ * @brief Fait défiler les channels affichés pour que le channel sélectionné soit visible
+ * @param nav la structure de navigation
+ * @param nbChannels le nombre de channels de la musique
+ */
+void sequencer_nav_scroll(sequencer_nav_t *nav, int nbChannels) {
+    if ((int) nav->ch < nav->first) nav->first = nav->ch;
+    if ((int) nav->ch >= nav->first + SEQUENCER_CH_VISIBLE) nav->first = (int) nav->ch - SEQUENCER_CH_VISIBLE + 1;
+    // Pas de fenêtre vide à droite tant que la musique a assez de channels
+    if (nav->first > nbChannels - SEQUENCER_CH_VISIBLE) nav->first = nbChannels > SEQUENCER_CH_VISIBLE ? nbChannels - SEQUENCER_CH_VISIBLE : 0;
+}
+
+/**
+ * @fn void sequencer_nav_loop(sequencer_nav_t *nav)
+ * @brief Marque la ligne courante comme début ou fin de la boucle, ou efface la boucle
+ * @param nav la structure de navigation
+ * @note Le premier appui marque le début, le second la fin, le troisième efface la boucle
+ */
+void sequencer_nav_loop(sequencer_nav_t *nav) {
+    int line = nav->lines[nav->ch];
+    if(nav->loopStart == SEQUENCER_NO_LOOP) {
+        nav->loopCh = nav->ch;
+        nav->loopStart = line;
+        return;
+    }
+    if(nav->loopEnd == SEQUENCER_NO_LOOP) {
+        // La boucle reste définie sur les lignes du channel où elle a été commencée
+        if(line < nav->loopStart) {
+            nav->loopEnd = nav->loopStart;
+            nav->loopStart = line;
+        }
+        else nav->loopEnd = line;
+        return;
+    }
+    nav->loopStart = SEQUENCER_NO_LOOP;
+    nav->loopEnd = SEQUENCER_NO_LOOP;
+}
+
+/**
+ * @fn void sequencer_nav_block(sequencer_nav_t *nav)
+ * @brief Marque la ligne courante comme début ou fin du bloc de lignes, ou efface le bloc
+ * @param nav la structure de navigation
+ * @note Le premier appui marque le début, le second la fin, le troisième efface le bloc
+ */
+void sequencer_nav_block(sequencer_nav_t *nav) {
+    int line = nav->lines[nav->ch];
+    if(nav->blockStart == SEQUENCER_NO_BLOCK) {
+        nav->blockCh = nav->ch;
+        nav->blockStart = line;
+        return;
+    }
+    if(nav->blockEnd == SEQUENCER_NO_BLOCK) {
+        // Comme la boucle, le bloc reste sur le channel où il a été commencé
+        if(line < nav->blockStart) {
+            nav->blockEnd = nav->blockStart;
+            nav->blockStart = line;
+        }
+        else nav->blockEnd = line;
+        return;
+    }
+    nav->blockStart = SEQUENCER_NO_BLOCK;
+    nav->blockEnd = SEQUENCER_NO_BLOCK;
+}
+
 /**
  * @fn create_sequencer_nav()
  * @brief Création de la structure de navigation du séquenceur
@@ -518,7 +660,15 @@ sequencer_nav_t create_sequencer_nav(int playMode) {
         nav.start[i] = 0;
         nav.lines[i] = 0;
     }
+    nav.first = 0;
     nav.playMode = playMode;
+    nav.loopCh = SEQUENCER_NAV_CH1;
+    nav.loopStart = SEQUENCER_NO_LOOP;
+    nav.loopEnd = SEQUENCER_NO_LOOP;
+    nav.blockCh = SEQUENCER_NAV_CH1;
+    nav.blockStart = SEQUENCER_NO_BLOCK;
+    nav.blockEnd = SEQUENCER_NO_BLOCK;
+    nav.metronome = 0;
     //nav.line = 0;
     return nav;
 }
@@ -535,23 +685,40 @@ sequencer_nav_t create_sequencer_nav(int playMode) {
 choices_t show_sequencer(music_t *music, char *rfid) {
     mpp_response_t reponse;
     choices_t choice = -1;
-    note_t *note;
+    note_t note;
     int i;
+    long long tick;
     char need2save = 0;
     int btnMode = NAVIGATION_MODE;
+    int showStats = 0; // Affichage de l'overlay des statistiques audio
+    audiod_client_t audio; // Moteur audio (démon piaudiod, ou ouvert dans l'interface)
+    int audioReady; // Un flux audio est disponible
+    long long loopStart, loopEnd; // Bornes de la boucle en doubles croches
+    int looping = 0, loopDirty = 0; // Lecture de la boucle et boucle à recalculer
+    journal_t journal; // Modifications de la session, pour annuler et rétablir
+    const journal_edit_t *edits;
+    int nbEdits;
+    channel_t clipboard; // Lignes copiées (un channel : seuls ses blocs non vides sont alloués)
+    int clipLines = 0; // Nombre de lignes copiées
+    int first, count, inBlock, status; // Lignes visées par une insertion ou une suppression
     int c = ERR; // la touche pressée
     clear(); // on nettoie l'écran
     bkgd(COLOR_PAIR(COLOR_PAIR_SEQ)); // on change la couleur du background
     WINDOW *seqInfo = newwin(SEQUENCER_INFO_LINES, SEQUENCER_INFO_COLS, SEQUENCER_INFO_Y0, SEQUENCER_INFO_X0);
     WINDOW *seqHelp = newwin(SEQUENCER_HELP_LINES, SEQUENCER_HELP_COLS, SEQUENCER_HELP_Y0, SEQUENCER_HELP_X0);
     WINDOW *seqBody = newwin(SEQUENCER_BODY_LINES, SEQUENCER_BODY_COLS, SEQUENCER_BODY_Y0, SEQUENCER_BODY_X0);
-    WINDOW *channelWin[MUSIC_MAX_CHANNELS];
+    WINDOW *channelWin[SEQUENCER_CH_VISIBLE]; // Fenêtres des channels affichés
 
     // Des variables pour la navigation dans le séquenceur
     sequencer_nav_t seqNav = create_sequencer_nav(0);
     scale_t scale = init_scale(); // Initialisation de la gammes
+    init_journal(&journal);
+    init_channel(&clipboard, 0);
+    // Le flux reste ouvert : les notes modifiées sont jouées sans attendre l'ouverture du pcm
+    audioReady = audiod_connect(&audio) == 0;
+    seqNav.metronome = audiod_metronome(&audio);
     // On dessine chaque fenêtre
-    show_sequencer_info(seqInfo, music, 0, need2save);
+    show_sequencer_info(seqInfo, music, 0, need2save, &seqNav);
     show_sequencer_help(seqHelp);
     box(seqBody, 0, 0);
     mvwprintw(seqBody, 0, 1, "%s", "SEQUENCER");
@@ -569,9 +736,20 @@ choices_t show_sequencer(music_t *music, char *rfid) {
                     sequencer_nav_up(&seqNav, -1);
                     break;
                 }
-                note = &(music->channels[seqNav.ch].notes[seqNav.lines[seqNav.ch]]);
-                change_sequencer_note(note, seqNav.col, scale, 1);
-                update_channel_nbNotes(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch]);
+                if(seqNav.col != SEQUENCER_NAV_COL_TIME && is_in_sequencer_block(&seqNav, seqNav.ch, seqNav.lines[seqNav.ch])) {
+                    if(change_sequencer_block(&journal, music, &seqNav, scale, 1) > 0) {
+                        if(is_in_sequencer_loop(music, &seqNav, seqNav.blockCh, seqNav.blockStart)) loopDirty = 1;
+                        need2save = 1;
+                    }
+                    break;
+                }
+                note = channel_note(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch]);
+                change_sequencer_note(&note, seqNav.col, scale, 1);
+                journal_begin(&journal);
+                journal_set_note(&journal, music, seqNav.ch, seqNav.lines[seqNav.ch], note);
+                journal_commit(&journal);
+                audiod_audition(&audio, note, music_tempo_at(music, channel_line2tick(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch])));
+                if(is_in_sequencer_loop(music, &seqNav, seqNav.ch, seqNav.lines[seqNav.ch])) loopDirty = 1;
                 need2save = 1;
                 break;
 
@@ -579,17 +757,28 @@ choices_t show_sequencer(music_t *music, char *rfid) {
                 if(seqNav.col == SEQUENCER_NAV_COL_LINE) {
                     sequencer_nav_down(&seqNav, -1);
                 }
+                else if(seqNav.col != SEQUENCER_NAV_COL_TIME && is_in_sequencer_block(&seqNav, seqNav.ch, seqNav.lines[seqNav.ch])) {
+                    if(change_sequencer_block(&journal, music, &seqNav, scale, 0) > 0) {
+                        if(is_in_sequencer_loop(music, &seqNav, seqNav.blockCh, seqNav.blockStart)) loopDirty = 1;
+                        need2save = 1;
+                    }
+                    break;
+                }
                 // Sinon modification de la note
-                note = &(music->channels[seqNav.ch].notes[seqNav.lines[seqNav.ch]]);
-                change_sequencer_note(note, seqNav.col, scale, 0);
-                update_channel_nbNotes(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch]);
+                note = channel_note(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch]);
+                change_sequencer_note(&note, seqNav.col, scale, 0);
+                journal_begin(&journal);
+                journal_set_note(&journal, music, seqNav.ch, seqNav.lines[seqNav.ch], note);
+                journal_commit(&journal);
+                if(seqNav.col != SEQUENCER_NAV_COL_LINE) audiod_audition(&audio, note, music_tempo_at(music, channel_line2tick(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch])));
+                if(is_in_sequencer_loop(music, &seqNav, seqNav.ch, seqNav.lines[seqNav.ch])) loopDirty = 1;
                 need2save = 1;
                 break;
             case KEY_LEFT:
-                sequencer_nav_left(&seqNav);
+                sequencer_nav_left(&seqNav, music->nbChannels);
                 break;
             case KEY_RIGHT:
-                sequencer_nav_right(&seqNav);
+                sequencer_nav_right(&seqNav, music->nbChannels);
                 break;
 
             case KEY_BUTTON_CHANGEMODE:
@@ -606,9 +795,8 @@ choices_t show_sequencer(music_t *music, char *rfid) {
                     }
                     break;
                 }
-                // On change de channel
-                seqNav.lines[0] = seqNav.start[0] + seqNav.lines[seqNav.ch] - seqNav.start[seqNav.ch]; // On garde la même ligne (pas forcément le même start)
-                seqNav.ch = 0;
+                // On change de channel (le premier affiché)
+                sequencer_nav_channel(&seqNav, seqNav.first, music->nbChannels);
                 break;
 
             case KEY_BUTTON_CH2NQUIT:
@@ -616,19 +804,22 @@ choices_t show_sequencer(music_t *music, char *rfid) {
                     choice = CHOICE_MAIN_MENU;
                     break;
                 }
-                // On change de channel
-                seqNav.lines[1] = seqNav.start[1] + seqNav.lines[seqNav.ch] - seqNav.start[seqNav.ch]; // On garde la même ligne (pas forcément le même start)
-                seqNav.ch = 1;
+                // On change de channel (le deuxième affiché)
+                sequencer_nav_channel(&seqNav, seqNav.first + 1, music->nbChannels);
                 break;
 
             case KEY_BUTTON_CH3NPLAY:
                 if(btnMode == EDIT_MODE) {
-                    play_music(channelWin, music);
+                    // La musique entière remplace la boucle
+                    audiod_loop(&audio, music, 0, 0);
+                    looping = 0;
+                    if(audioReady) play_music(channelWin, music, &audio, 0, seqNav.first);
+                    seqNav.metronome = audiod_metronome(&audio);
+                    audiod_save_stats(&audio);
                     break;
                 } 
-                // On change de channel
-                seqNav.lines[2] = seqNav.start[2] + seqNav.lines[seqNav.ch] - seqNav.start[seqNav.ch]; // On garde la même ligne (pas forcément le même start)
-                seqNav.ch = 2;
+                // On change de channel (le troisième affiché)
+                sequencer_nav_channel(&seqNav, seqNav.first + 2, music->nbChannels);
                 break;
 
             case KEY_BUTTON_LINEUP:
@@ -640,11 +831,163 @@ choices_t show_sequencer(music_t *music, char *rfid) {
                 sequencer_nav_down(&seqNav, -1);
             break;
 
+            case KEY_BUTTON_PLAYCURSOR:
+                // Lecture depuis la ligne sélectionnée : les autres channels sont calés sur sa position
+                audiod_loop(&audio, music, 0, 0);
+                looping = 0;
+                if(audioReady) play_music(channelWin, music, &audio, channel_line2tick(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch]), seqNav.first);
+                seqNav.metronome = audiod_metronome(&audio);
+                audiod_save_stats(&audio);
+                break;
+
+            case KEY_BUTTON_TEMPOMARK:
+                // Un changement de tempo sur la ligne est retiré, sinon on en pose un au tempo courant
+                tick = channel_line2tick(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch]);
+                if(remove_music_tempo(music, tick) < 0) set_music_tempo(music, tick, music_tempo_at(music, tick));
+                need2save = 1;
+                loopDirty = 1;
+                break;
+
+            case KEY_BUTTON_TEMPOUP:
+            case KEY_BUTTON_TEMPODOWN:
+                // On modifie le tempo en vigueur sur la ligne : le dernier changement avant elle ou le bpm de la musique
+                tick = channel_line2tick(&(music->channels[seqNav.ch]), seqNav.lines[seqNav.ch]);
+                i = music_tempo_index(music, tick);
+                if(i > 0) set_music_tempo(music, music->tempos[i - 1].tick, music->tempos[i - 1].bpm + (c == KEY_BUTTON_TEMPOUP ? 1 : -1));
+                else if(c == KEY_BUTTON_TEMPOUP && music->bpm < MUSIC_MAX_BPM) music->bpm++;
+                else if(c == KEY_BUTTON_TEMPODOWN && music->bpm > MUSIC_MIN_BPM) music->bpm--;
+                need2save = 1;
+                loopDirty = 1;
+                break;
+
+            case KEY_BUTTON_METRONOME:
+                seqNav.metronome = !seqNav.metronome;
+                audiod_set_metronome(&audio, seqNav.metronome);
+                break;
+
+            case KEY_BUTTON_LOOPMARK:
+                sequencer_nav_loop(&seqNav);
+                loopDirty = 1;
+                break;
+
+            case KEY_BUTTON_LOOPPLAY:
+                looping = !looping;
+                loopDirty = 1;
+                break;
+
+            case KEY_BUTTON_STATS:
+                showStats = !showStats;
+                if(!showStats) show_sequencer_help(seqHelp);
+                break;
+
+            case KEY_BUTTON_CLEARLINE:
+                journal_begin(&journal);
+                if(journal_clear_line(&journal, music, seqNav.ch, seqNav.lines[seqNav.ch]) > 0) {
+                    if(is_in_sequencer_loop(music, &seqNav, seqNav.ch, seqNav.lines[seqNav.ch])) loopDirty = 1;
+                    need2save = 1;
+                }
+                journal_commit(&journal);
+                break;
+
+            case KEY_BUTTON_UNDO:
+            case KEY_BUTTON_REDO:
+                nbEdits = c == KEY_BUTTON_UNDO ? journal_undo(&journal, music, &edits) : journal_redo(&journal, music, &edits);
+                // Seules les lignes de la transaction ont changé : la boucle n'est recalculée que si elle en contient une
+                for(i = 0; i < nbEdits; i++) {
+                    if(is_in_sequencer_loop(music, &seqNav, edits[i].channel, edits[i].line)) loopDirty = 1;
+                }
+                if(nbEdits > 0) need2save = 1;
+                break;
+
+            case KEY_BUTTON_ADDCHANNEL:
+                // Un channel vide ne change ni le son ni la boucle
+                if(set_music_channels(music, music->nbChannels + 1) == 0) {
+                    sequencer_nav_channel(&seqNav, music->nbChannels - 1, music->nbChannels);
+                    need2save = 1;
+                }
+                break;
+
+            case KEY_BUTTON_DELCHANNEL:
+                // Seul un dernier channel vide est retiré : aucune note n'est perdue
+                if(channel_next_line(&(music->channels[music->nbChannels - 1]), 0) >= 0 || set_music_channels(music, music->nbChannels - 1) < 0) break;
+                // Le journal n'enregistre pas les channels : ses écarts du channel retiré seraient
+                // rejoués dans un channel ajouté ensuite, l'historique est donc oublié
+                free_journal(&journal);
+                if((int) seqNav.ch >= music->nbChannels) sequencer_nav_channel(&seqNav, music->nbChannels - 1, music->nbChannels);
+                sequencer_nav_scroll(&seqNav, music->nbChannels);
+                if((int) seqNav.loopCh >= music->nbChannels) {
+                    seqNav.loopStart = SEQUENCER_NO_LOOP;
+                    seqNav.loopEnd = SEQUENCER_NO_LOOP;
+                    loopDirty = 1;
+                }
+                if((int) seqNav.blockCh >= music->nbChannels) {
+                    seqNav.blockStart = SEQUENCER_NO_BLOCK;
+                    seqNav.blockEnd = SEQUENCER_NO_BLOCK;
+                }
+                need2save = 1;
+                break;
+
+            case KEY_BUTTON_BLOCKMARK:
+                sequencer_nav_block(&seqNav);
+                break;
+
+            case KEY_BUTTON_COPY:
+                if(seqNav.blockStart == SEQUENCER_NO_BLOCK || seqNav.blockEnd == SEQUENCER_NO_BLOCK) break;
+                // Le presse-papier reçoit les colonnes du bloc, bloc de notes par bloc de notes
+                free_channel(&clipboard);
+                init_channel(&clipboard, 0);
+                clipLines = seqNav.blockEnd - seqNav.blockStart + 1;
+                if(copy_channel_lines(&clipboard, 0, &(music->channels[seqNav.blockCh]), seqNav.blockStart, clipLines) < 0) clipLines = 0;
+                break;
+
+            case KEY_BUTTON_PASTE:
+                if(clipLines == 0) break;
+                journal_begin(&journal);
+                if(journal_copy_lines(&journal, music, seqNav.ch, seqNav.lines[seqNav.ch], &clipboard, 0, clipLines) > 0) {
+                    if(is_in_sequencer_loop(music, &seqNav, seqNav.ch, seqNav.lines[seqNav.ch])) loopDirty = 1;
+                    need2save = 1;
+                }
+                journal_commit(&journal);
+                break;
+
+            case KEY_BUTTON_INSERTLINES:
+            case KEY_BUTTON_DELETELINES:
+                // Le bloc marqué si la ligne sélectionnée en fait partie, sinon la ligne seule
+                first = seqNav.lines[seqNav.ch];
+                count = 1;
+                inBlock = is_in_sequencer_block(&seqNav, seqNav.ch, first);
+                if(inBlock) {
+                    first = seqNav.blockStart;
+                    count = seqNav.blockEnd - seqNav.blockStart + 1;
+                }
+                journal_begin(&journal);
+                if(c == KEY_BUTTON_INSERTLINES) status = journal_insert_lines(&journal, music, seqNav.ch, first, count);
+                else status = journal_delete_lines(&journal, music, seqNav.ch, first, count);
+                journal_commit(&journal);
+                // Toutes les lignes qui suivent ont bougé : la boucle change si elle est après la première
+                if(status > 0) {
+                    if(is_in_sequencer_loop(music, &seqNav, seqNav.ch, first)) loopDirty = 1;
+                    need2save = 1;
+                }
+                // Les lignes d'un bloc supprimé ne sont plus là
+                if(inBlock && c == KEY_BUTTON_DELETELINES) {
+                    seqNav.blockStart = SEQUENCER_NO_BLOCK;
+                    seqNav.blockEnd = SEQUENCER_NO_BLOCK;
+                }
+                break;
+
             default:
                 break;
         }
+        // La boucle n'est recalculée que si elle a changé : sinon elle ne coûte aucune synthèse
+        if(loopDirty) {
+            if(!looping || sequencer_loop_ticks(music, &seqNav, &loopStart, &loopEnd) < 0) loopStart = loopEnd = 0;
+            if(audiod_loop(&audio, music, loopStart, loopEnd) < 0 || loopEnd <= loopStart) looping = 0;
+            loopDirty = 0;
+        }
         // On rafraichit les fenêtres
-        show_sequencer_info(seqInfo, music, btnMode, need2save);
+        show_sequencer_info(seqInfo, music, btnMode, need2save, &seqNav);
+        if(showStats) show_sequencer_stats(seqHelp, audiod_stats(&audio));
         show_sequencer_channels(channelWin, music, &seqNav);
         //mvwprintw(seqBody, 0, 1, "%d, %d, %d %d", music->channels[0].nbNotes, music->channels[1].nbNotes, music->channels[2].nbNotes, seqNav.lines[seqNav.ch]);
     }
@@ -653,9 +996,12 @@ choices_t show_sequencer(music_t *music, char *rfid) {
     delwin(seqInfo);
     delwin(seqHelp);
     delwin(seqBody);
-    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
+    for(i = 0; i < SEQUENCER_CH_VISIBLE; i++) {
         delwin(channelWin[i]);
     }
+    free_journal(&journal);
+    free_channel(&clipboard);
+    audiod_disconnect(&audio);
     // On nettoie l'écran
     clear();
     return choice;
@@ -685,107 +1031,70 @@ int getchr_wiringpi()
 }
 
 /**
- * @fn void play_music(music_t *music)
+ * @fn void play_music(WINDOW **channelWin, music_t *music, audiod_client_t *audio, long long tick, int first)
  * @brief Joue la musique et affiche les lignes jouées
+ * @param channelWin Les fenêtres des channels affichés
+ * @param music La musique à jouer
+ * @param audio Le moteur audio du séquenceur (déjà connecté avec audiod_connect)
+ * @param tick La position de départ en doubles croches (0 pour jouer depuis le début)
+ * @param first Le premier channel affiché (seuls les channels affichés sont suivis)
+ * @note Toutes les voix sont calculées par le moteur audio sur un seul flux : l'affichage suit
+ * la position musicale réellement sortie du haut-parleur. Pendant la lecture, KEY_BUTTON_TEMPOUP
+ * et KEY_BUTTON_TEMPODOWN (ou les boutons de ligne) décalent le tempo en direct et
+ * KEY_BUTTON_METRONOME active ou coupe le métronome
+ * @see audiod_client_t
  */
-void play_music(WINDOW **channelWin, music_t *music) {
-    pthread_t threads[MUSIC_MAX_CHANNELS];
-    sem_t show_sem[MUSIC_MAX_CHANNELS];
-    sem_t syncSem; // Sémaphore de synchronisation
-    sem_t finishSem; // Sémaphore de fin
+void play_music(WINDOW **channelWin, music_t *music, audiod_client_t *audio, long long tick, int first) {
     sequencer_nav_t seqNav = create_sequencer_nav(1);
-    int i, finishCount = 0;
-    // On attend que tout est en place pour jouer la musique
-    sem_init(&syncSem, 0, 0);
-    sem_init(&finishSem, 0, 0);
-    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
-        sem_init(show_sem + i , 0, 0);
-        channel_thread_args_t *args = create_channel_thread_args(show_sem + i, &syncSem, &finishSem, &seqNav, music, i);
-        pthread_create(&threads[i], NULL, play_channel, (void *) args);
-        // mettre la priorité des threads aux maximum
-        struct sched_param param;
-        param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-        pthread_setschedparam(threads[i], SCHED_FIFO, &param);
+    bitmap_t buttons, pressed, oldButtons = 0;
+    int i, line, moved, c;
+    int last = first + SEQUENCER_CH_VISIBLE < music->nbChannels ? first + SEQUENCER_CH_VISIBLE : music->nbChannels;
+    short bpm, shownBpm = -1;
+    seqNav.first = first;
+    // Chaque channel affiché commence sur la note jouée à la position de départ
+    for(i = first; i < last; i++) {
+        line = channel_tick2line(&(music->channels[i]), tick);
+        seqNav.lines[i] = line < CHANNEL_MAX_NOTES ? line : CHANNEL_MAX_NOTES - 1;
+        seqNav.start[i] = seqNav.lines[i];
     }
     show_sequencer_channels(channelWin, music, &seqNav);
-    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
-        // On débloque les threads
-        sem_post(&syncSem);
-    }
-
-    while(finishCount < MUSIC_MAX_CHANNELS) {
-        if(sem_trywait(&finishSem) == 0) finishCount++;
-
-        for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
-            if(sem_trywait(&show_sem[i]) == 0) {
-                print_sequencer_lines(channelWin[i], i, music, &seqNav);
+    init_window(channelWin[0]);
+    if(audiod_play(audio, music, tick) < 0) return;
+
+    while(audiod_is_playing(audio)) {
+        // Le capteur est lu ici : le thread de mixage ne doit jamais attendre le matériel
+        audiod_set_effect(audio, read_proximity_sensor());
+        // Décalage du tempo en direct : seul le transport change de vitesse, rien n'est recalculé
+        c = wgetch(channelWin[0]);
+        // Seul l'appui est pris en compte (sans l'attente de getchr_wiringpi qui ralentirait l'affichage)
+        buttons = is_button_pressed();
+        pressed = buttons & ~oldButtons;
+        oldButtons = buttons;
+        if(IS_BUTTON_PRESSED(pressed, BUTTON_LINEUP)) c = KEY_BUTTON_TEMPOUP;
+        if(IS_BUTTON_PRESSED(pressed, BUTTON_LINEDOWN)) c = KEY_BUTTON_TEMPODOWN;
+        if(c == KEY_BUTTON_TEMPOUP) audiod_nudge(audio, 1);
+        if(c == KEY_BUTTON_TEMPODOWN) audiod_nudge(audio, -1);
+        if(c == KEY_BUTTON_METRONOME) audiod_set_metronome(audio, !audiod_metronome(audio));
+        // Le 7 segments suit le tempo joué (changements de tempo et décalage compris)
+        bpm = audiod_bpm(audio);
+        if(bpm != shownBpm) {
+            display_bpm(bpm);
+            shownBpm = bpm;
+        }
+        // Les channels qui ne sont pas affichés ne sont pas cherchés
+        for(i = first; i < last; i++) {
+            line = audiod_line(audio, i);
+            moved = 0;
+            while(line != ENGINE_NO_LINE && seqNav.lines[i] < line && seqNav.lines[i] < CHANNEL_MAX_NOTES - 1) {
+                sequencer_nav_down(&seqNav, i);
+                moved = 1;
             }
+            if(moved) print_sequencer_lines(channelWin[i - first], i, music, &seqNav);
         }
+        usleep(SEQUENCER_PLAY_POLL_TIME);
     }
-
-    // On libère les sémaphores
-    sem_destroy(&syncSem);
-    sem_destroy(&finishSem);
-    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
-        sem_destroy(&show_sem[i]);
-    }
-
-}
-
-/**
- * @brief play_channel(void *channelId)
- * @brief Joue un channel et modifie le navigateur pour afficher la ligne jouée
- */
-void *play_channel(void *args) {
-    // On récupère les arguments
-    channel_thread_args_t *channelArgs = (channel_thread_args_t *) args;
-    int effect = 0;
-    int channelId = channelArgs->channel;
-    int i;
-    sem_t *syncSem = channelArgs->syncSem;
-    sem_t *finishSem = channelArgs->finishSem;
-    sem_t *show_sem = channelArgs->showSem;
-    sequencer_nav_t *seqNav = channelArgs->seqNav;
-    music_t *music = channelArgs->music;
-    channel_t *channel = &(music->channels[channelId]);
-    snd_pcm_t *pcm;
-    // On initialise le pcm
-    init_sound(&pcm);
-    // On attend que tout le monde soit prêt
-    sem_wait(syncSem);
-    for(i = 0; i < channel->nbNotes; i++) {
-        snd_pcm_prepare(pcm);
-        effect = read_proximity_sensor();
-        // On joue la note
-        play_note(channel->notes[i], music->bpm, pcm, effect);
-        snd_pcm_drain(pcm);
-        sequencer_nav_down(seqNav, channelId);
-        // On met à jour la fenêtre
-        sem_post(show_sem);
-    }
-    // On libère le pcm
-    end_sound(pcm);
-    // On libère le sémaphore de fin
-    sem_post(finishSem);
-    free(channelArgs);
-    pthread_exit(NULL);
-}
-
-/**
- * @brief create_channel_thread_args(sem_t *syncSem, sem_t *finishSem, sequencer_nav_t *seqNav, music_t *music, int channel)
- * @brief Crée les arguments pour le thread de channel
- * @return channel_thread_args_t 
- * @note Les arguments doivent être libérés après utilisation
- */
-channel_thread_args_t *create_channel_thread_args(sem_t *showSem, sem_t *syncSem, sem_t *finishSem, sequencer_nav_t *seqNav, music_t *music, int channel) {
-    channel_thread_args_t *args = malloc(sizeof(channel_thread_args_t));
-    args->showSem = showSem;
-    args->syncSem = syncSem;
-    args->finishSem = finishSem;
-    args->seqNav = seqNav;
-    args->music = music;
-    args->channel = channel;
-    return args;
+    audiod_set_effect(audio, 0);
+    display_bpm(music->bpm);
 }
 
 /**********************************************************************************************************************/
@@ -800,9 +1109,11 @@ channel_thread_args_t *create_channel_thread_args(sem_t *showSem, sem_t *syncSem
  * \param music La musique à afficher
  * \param mode Le mode des boutons (0 pour le mode NAVIGATION, 1 pour le mode EDITION)
  */
-void show_sequencer_info(WINDOW *win, music_t *music, int mode, char need2save) {
+void show_sequencer_info(WINDOW *win, music_t *music, int mode, char need2save, sequencer_nav_t *seqNav) {
     werase(win);
     char date[20];
+    char label[SEQUENCER_CH_VISIBLE][14]; // Channel de chaque bouton en mode navigation ("CH" et un int)
+    int i;
     show_date(music->date.tv_sec, date);
     // On crée les bordures
     box(win, 0, 0);
@@ -815,8 +1126,23 @@ void show_sequencer_info(WINDOW *win, music_t *music, int mode, char need2save)
     wattron(win, ( need2save ? COLOR_PAIR(COLOR_PAIR_SEQ_NOTSAVED) : COLOR_PAIR(COLOR_PAIR_SEQ_SAVED) )  | A_BOLD);
     mvwprintw(win, 1, 10, " %s", date);
     wattroff(win, need2save ? COLOR_PAIR(COLOR_PAIR_MENU_WARNING) : COLOR_PAIR(COLOR_PAIR_SEQ_NOTE) | A_BOLD);
+    mvwprintw(win, 1, 32, "Channels :");
+    mvwprintw(win, 3, 33, "[%c%c] Add/remove CH", KEY_BUTTON_ADDCHANNEL, KEY_BUTTON_DELCHANNEL);
     wattron(win, A_BOLD);
-    mvwprintw(win, 2, 6, " %d", music->bpm);
+    mvwprintw(win, 1, 43, "%d", music->nbChannels);
+    wattroff(win, A_BOLD);
+    wattron(win, A_BOLD);
+    mvwprintw(win, 2, 6, " %d", music_tempo_at(music, channel_line2tick(&(music->channels[seqNav->ch]), seqNav->lines[seqNav->ch])));
+    wattroff(win, A_BOLD);
+    mvwprintw(win, 2, 20, "Loop :");
+    mvwprintw(win, 3, 20, "Click :");
+    wattron(win, A_BOLD);
+    mvwprintw(win, 3, 28, "%s", seqNav->metronome ? "ON " : "OFF");
+    wattroff(win, A_BOLD);
+    wattron(win, A_BOLD);
+    if(seqNav->loopStart == SEQUENCER_NO_LOOP) mvwprintw(win, 2, 27, "%s", "----");
+    else if(seqNav->loopEnd == SEQUENCER_NO_LOOP) mvwprintw(win, 2, 27, "CH%d %04X-....", seqNav->loopCh + 1, seqNav->loopStart);
+    else mvwprintw(win, 2, 27, "CH%d %04X-%04X", seqNav->loopCh + 1, seqNav->loopStart, seqNav->loopEnd);
     wattroff(win, A_BOLD);
 
     if(mode == NAVIGATION_MODE) {
@@ -824,7 +1150,12 @@ void show_sequencer_info(WINDOW *win, music_t *music, int mode, char need2save)
         mvwprintw(win, 3, 8, "%s", "NAVIGATION");
         wattroff(win, COLOR_PAIR(COLOR_PAIR_SEQ_OCTAVE));
         wattron(win, COLOR_PAIR(COLOR_PAIR_SEQ) | A_BOLD);
-        mvwprintw(win, 4, 1, "[BTN1] CH1         [BTN2] CH2       [BTN3] CH3 ");
+        // Les boutons sélectionnent les channels affichés
+        for(i = 0; i < SEQUENCER_CH_VISIBLE; i++) {
+            if(seqNav->first + i < music->nbChannels) snprintf(label[i], sizeof(label[i]), "CH%d", seqNav->first + i + 1);
+            else snprintf(label[i], sizeof(label[i]), "%s", "--");
+        }
+        mvwprintw(win, 4, 1, "[BTN1] %-4s        [BTN2] %-4s      [BTN3] %-4s", label[0], label[1], label[2]);
         wattroff(win, COLOR_PAIR(COLOR_PAIR_SEQ) | A_BOLD);
     }
     else {
@@ -857,46 +1188,62 @@ void show_sequencer_help(WINDOW *win) {
     mvwprintw(win, 1, 1, "%s", " / : Change note/octave/instrument/shift");
     mvwaddch(win, 1, 1, ACS_DARROW);
     mvwaddch(win, 1, 3, ACS_UARROW);
+    mvwprintw(win, 1, 42, "[%c] Clear", KEY_BUTTON_CLEARLINE);
 
-    mvwprintw(win, 2, 1, "%s", " / : Change column in the channel");
+    mvwprintw(win, 2, 1, "%s", " / : Change column");
+    mvwprintw(win, 2, 20, "[%c%c] Undo/redo", KEY_BUTTON_UNDO, KEY_BUTTON_REDO);
+    mvwprintw(win, 2, 35, "[%c%c] Ins/del line", KEY_BUTTON_INSERTLINES, KEY_BUTTON_DELETELINES);
     mvwaddch(win, 2, 1, ACS_LARROW);
     mvwaddch(win, 2, 3, ACS_RARROW);
 
-    mvwprintw(win, 3, 1, "%s", "[BTN4] : Change button mode");
+    // Dans le bloc marqué, les flèches modifient toutes ses notes
+    mvwprintw(win, 3, 1, "%s", "[BTN4] Mode");
+    mvwprintw(win, 3, 13, "[%c%c%c] Block mark/copy/paste", KEY_BUTTON_BLOCKMARK, KEY_BUTTON_COPY, KEY_BUTTON_PASTE);
+    mvwprintw(win, 4, 1, "[%c%c] Loop [%c] Play line [%c%c%c] Tempo [%c] Click", KEY_BUTTON_LOOPMARK, KEY_BUTTON_LOOPPLAY, KEY_BUTTON_PLAYCURSOR, KEY_BUTTON_TEMPOMARK, KEY_BUTTON_TEMPOUP, KEY_BUTTON_TEMPODOWN, KEY_BUTTON_METRONOME);
     // On rafraichit la fenêtre
     wrefresh(win);
 }
 
+/**
+ * \fn void show_sequencer_stats(WINDOW *win, audio_stats_t *stats)
+ * \brief Affichage de l'overlay des statistiques audio à la place de l'aide
+ * \param win La fenêtre où afficher les statistiques
+ * \param stats Les statistiques audio
+ */
+void show_sequencer_stats(WINDOW *win, audio_stats_t *stats) {
+    char line[64];
+    int i;
+    werase(win);
+    box(win, 0, 0);
+    wattron(win, A_BOLD);
+    mvwprintw(win, 0, 1, "%s", "AUDIO STATS");
+    wattroff(win, A_BOLD);
+    for(i = 0; i < SEQUENCER_HELP_LINES - 2; i++) {
+        audio_stats2str(stats, line, i);
+        // On colore en rouge si des xruns ont eu lieu
+        if(i == 0 && stats->xruns > 0) wattron(win, COLOR_PAIR(COLOR_PAIR_SEQ_NOTSAVED));
+        mvwprintw(win, 1 + i, 1, "%-.*s", SEQUENCER_HELP_COLS - 2, line);
+        if(i == 0) wattroff(win, COLOR_PAIR(COLOR_PAIR_SEQ_NOTSAVED));
+    }
+    wrefresh(win);
+}
+
 /**
  * \fn void init_sequencer_channels(WINDOW **channels, music_t *music)
  * \brief Initialisation des channels du séquenceur
  * \details Cette fonction initialise les channels du séquenceur
- * \param channels Les fenêtres des channels
+ * \param channels Les fenêtres des channels affichés
  * \param music La musique à afficher
- * \warning Il doit y avoir MUSIC_MAX_CHANNELS channels
+ * \warning Il doit y avoir SEQUENCER_CH_VISIBLE fenêtres
 */
 void init_sequencer_channels(WINDOW **channelWin, music_t *music) {
     int i;
-    channelWin[0] = newwin(SEQUENCER_CH_LINES, SEQUENCER_CH_COLS, SEQUENCER_CH_Y0, SEQUENCER_CH1_X0);
-    channelWin[1] = newwin(SEQUENCER_CH_LINES, SEQUENCER_CH_COLS, SEQUENCER_CH_Y0, SEQUENCER_CH2_X0);
-    channelWin[2] = newwin(SEQUENCER_CH_LINES, SEQUENCER_CH_COLS, SEQUENCER_CH_Y0, SEQUENCER_CH3_X0);
-    
-    sequencer_nav_t seqNav = create_sequencer_nav(0);
-    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
-        WINDOW *ch = channelWin[i];
-        // On efface les fenêtres
-        werase(ch);
-        // On change les bordures
-        box(ch, 0, 0);
-        // On affiche les entêtes
-        mvwprintw(ch, 0, 1, "%s %d", "CHANNEL", i+1);
-        // On affiche l'en-tête des colonnes
-        mvwprintw(ch, 1, 1, "%s", "LINE|NOTE|OCTA|INST|SHFT");
-        // On affiche les lignes
-        print_sequencer_lines(ch, i, music, &seqNav);
-        // On rafraichit la fenêtre
-        wrefresh(ch);
+    // Les fenêtres sont celles des emplacements : le channel affiché dépend du défilement
+    for(i = 0; i < SEQUENCER_CH_VISIBLE; i++) {
+        channelWin[i] = newwin(SEQUENCER_CH_LINES, SEQUENCER_CH_COLS, SEQUENCER_CH_Y0, SEQUENCER_CH_X0 + i * SEQUENCER_CH_STRIDE);
     }
+    sequencer_nav_t seqNav = create_sequencer_nav(0);
+    show_sequencer_channels(channelWin, music, &seqNav);
 }
 
 /**
@@ -1049,9 +1396,9 @@ void print_sequencer_lines(WINDOW *win, short channelId, music_t *music, sequenc
             print_sequencer_note(win, emptyNote, channelId, i, seqNav, 0);
             continue;
         }
-        note_t note = music->channels[channelId].notes[seqNav->start[channelId] + i];
+        note_t note = channel_note(&(music->channels[channelId]), seqNav->start[channelId] + i);
         int isSelected = 0;
-        if(seqNav->ch == channelId && seqNav->lines[channelId] == seqNav->start[channelId]+i) isSelected = 1;
+        if((int) seqNav->ch == channelId && seqNav->lines[channelId] == seqNav->start[channelId]+i) isSelected = 1;
         print_sequencer_note(win, note, channelId, i, seqNav, isSelected);
     }
     // On rafraichit la fenêtre
@@ -1074,14 +1421,15 @@ void print_sequencer_note(WINDOW *win, note_t note, short ch, int line, sequence
     char instrumentName[5]; // Nom de l'instrument
     char noteName[3]; // Nom de la note
     int playModeSelected = seqNav->playMode && seqNav->lines[ch] == seqNav->start[ch] + line ? 1 : 0;
+    int inBlock = is_in_sequencer_block(seqNav, ch, seqNav->start[ch] + line); // Ligne du bloc marqué (soulignée)
     note2str(note, noteName); // On récupère le nom de la note
     instrument2str(note.instrument, instrumentName); // On récupère le nom de l'instrument
-    wattron(win, COLOR_PAIR(COLOR_PAIR_SEQ) | REVERSE_IF_COL(seqNav->col, SEQUENCER_NAV_COL_LINE, isSelected) |  REVERSE_IF_COL(seqNav->col, SEQUENCER_NAV_COL_LINE, playModeSelected));
+    wattron(win, COLOR_PAIR(COLOR_PAIR_SEQ) | REVERSE_IF_COL(seqNav->col, SEQUENCER_NAV_COL_LINE, isSelected) |  REVERSE_IF_COL(seqNav->col, SEQUENCER_NAV_COL_LINE, playModeSelected) | (inBlock ? A_UNDERLINE : 0));
     if(seqNav->start[ch] + line >= CHANNEL_MAX_NOTES) {
         mvwprintw(win, 2+line, 1, "%s", "----");
     }
     else mvwprintw(win, 2+line, 1, "%04X", seqNav->start[ch] + line);
-    wattroff(win, COLOR_PAIR(COLOR_PAIR_SEQ) | REVERSE_IFNOT_PLAYMODE(seqNav->playMode, playModeSelected));
+    wattroff(win, COLOR_PAIR(COLOR_PAIR_SEQ) | A_UNDERLINE | REVERSE_IFNOT_PLAYMODE(seqNav->playMode, playModeSelected));
     wattron(win, COLOR_PAIR(COLOR_PAIR_SEQ));
     mvwprintw(win, 2+line, 5, "|");
     mvwprintw(win, 2+line, 10, "|");
@@ -1130,12 +1478,13 @@ void change_sequencer_note(note_t *note, short col, scale_t scale, int isUp) {
             }
             break;
         case SEQUENCER_NAV_COL_OCTAVE:
-            if (isUp) note->octave = note->octave + 1 > 8 ? 8 : note->octave + 1;
-            else note->octave = note->octave - 1 < 0 ? 8 : note->octave - 1;
+            if (isUp) note->octave = note->octave + 1 > NOTE_MAX_OCTAVE ? NOTE_MAX_OCTAVE : note->octave + 1;
+            else note->octave = note->octave - 1 < 0 ? NOTE_MAX_OCTAVE : note->octave - 1;
             break;
         case SEQUENCER_NAV_COL_INSTRUMENT:
-            if (isUp) note->instrument = note->instrument + 1 == INSTRUMENT_NB ? 0 : note->instrument + 1;
-            else note->instrument = (note->instrument - 1) == -1 ? INSTRUMENT_NB - 1 : note->instrument - 1;
+            // Les plugins chargés suivent les instruments internes
+            if (isUp) note->instrument = (int) note->instrument + 1 >= nb_instruments() ? 0 : note->instrument + 1;
+            else note->instrument = note->instrument == 0 ? nb_instruments() - 1 : (int) note->instrument - 1;
             break;
         case SEQUENCER_NAV_COL_TIME:
             if(note->time < TIME_END) note->time = isUp ? note->time * 2 : note->time / 2;
@@ -1182,18 +1531,113 @@ void show_request_error(const char *message) {
 
 /**
  * @fn show_sequencer_channels(WINDOW **channelWin, music_t *music, sequencer_nav_t *seqNav)
- * @brief Affichage des channels du séquenceur
- * @param channelWin Les fenêtres des channels
+ * @brief Affichage des channels du séquenceur (à partir du premier channel affiché)
+ * @param channelWin Les fenêtres des channels affichés
  * @param music La musique à afficher
  * @param seqNav La structure de navigation dans le séquenceur
  * @warning Les fenêtres doivent être initialisées avec init_sequencer_channels
  * @see init_sequencer_channels
  */
 void show_sequencer_channels(WINDOW **channelWin, music_t *music, sequencer_nav_t *seqNav) {
-    int i;
-    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
-        print_sequencer_lines(channelWin[i], i, music, seqNav);
+    int i, channelId;
+    for(i = 0; i < SEQUENCER_CH_VISIBLE; i++) {
+        WINDOW *ch = channelWin[i];
+        channelId = seqNav->first + i;
+        // On efface les fenêtres : un emplacement sans channel reste vide
+        werase(ch);
+        if(channelId >= music->nbChannels) {
+            wrefresh(ch);
+            continue;
+        }
+        // On change les bordures
+        box(ch, 0, 0);
+        // On affiche les entêtes (le nombre de channels indique s'il y en a d'autres à faire défiler)
+        mvwprintw(ch, 0, 1, "%s %d/%d", "CHANNEL", channelId + 1, music->nbChannels);
+        // On affiche l'en-tête des colonnes
+        mvwprintw(ch, 1, 1, "%s", "LINE|NOTE|OCTA|INST|SHFT");
+        // On affiche les lignes (print_sequencer_lines rafraichit la fenêtre)
+        print_sequencer_lines(ch, channelId, music, seqNav);
     }
 }
 
+/**
+ * \fn int sequencer_loop_ticks(music_t *music, sequencer_nav_t *seqNav, long long *tickStart, long long *tickEnd)
+ * \brief Calcule les bornes de la boucle marquée dans le séquenceur
+ * \param music La musique
+ * \param seqNav La structure de navigation contenant la boucle
+ * \param tickStart Le début de la boucle en doubles croches
+ * \param tickEnd La fin de la boucle en doubles croches
+ * \return 0 si succès, -1 si la boucle n'est pas marquée
+ */
+int sequencer_loop_ticks(music_t *music, sequencer_nav_t *seqNav, long long *tickStart, long long *tickEnd) {
+    channel_t *channel = &(music->channels[seqNav->loopCh]);
+    if(seqNav->loopStart == SEQUENCER_NO_LOOP || seqNav->loopEnd == SEQUENCER_NO_LOOP) return -1;
+    *tickStart = channel_line2tick(channel, seqNav->loopStart);
+    *tickEnd = channel_line2tick(channel, seqNav->loopEnd + 1);
+    return 0;
+}
 
+/**
+ * \fn int is_in_sequencer_loop(music_t *music, sequencer_nav_t *seqNav, int ch, int line)
+ * \brief Indique si la modification d'une note change le contenu de la boucle
+ * \param music La musique
+ * \param seqNav La structure de navigation contenant la boucle
+ * \param ch Le channel de la note modifiée
+ * \param line La ligne de la note modifiée
+ * \return 1 si la boucle doit être recalculée
+ * \note Une note placée avant la boucle peut décaler ses bornes (durée modifiée)
+ */
+int is_in_sequencer_loop(music_t *music, sequencer_nav_t *seqNav, int ch, int line) {
+    if(seqNav->loopStart == SEQUENCER_NO_LOOP || seqNav->loopEnd == SEQUENCER_NO_LOOP) return 0;
+    if(ch == (int) seqNav->loopCh) return line <= seqNav->loopEnd;
+    return channel_line2tick(&(music->channels[ch]), line) < channel_line2tick(&(music->channels[seqNav->loopCh]), seqNav->loopEnd + 1);
+}
+
+/**
+ * \fn int is_in_sequencer_block(sequencer_nav_t *seqNav, int ch, int line)
+ * \brief Indique si une ligne fait partie du bloc de lignes marqué
+ * \param seqNav La structure de navigation contenant le bloc
+ * \param ch Le channel de la ligne
+ * \param line La ligne
+ * \return 1 si le bloc est marqué (début et fin) et contient la ligne
+ */
+int is_in_sequencer_block(sequencer_nav_t *seqNav, int ch, int line) {
+    if(seqNav->blockStart == SEQUENCER_NO_BLOCK || seqNav->blockEnd == SEQUENCER_NO_BLOCK) return 0;
+    return ch == (int) seqNav->blockCh && line >= seqNav->blockStart && line <= seqNav->blockEnd;
+}
+
+/**
+ * \fn int change_sequencer_block(journal_t *journal, music_t *music, sequencer_nav_t *seqNav, scale_t scale, int isUp)
+ * \brief Modification de toutes les notes du bloc marqué en fonction de la colonne actuelle
+ * \param journal Le journal des modifications
+ * \param music La musique
+ * \param seqNav La structure de navigation contenant le bloc
+ * \param scale La gamme des notes
+ * \param isUp La direction de la modification (0 pour le bas, 1 pour le haut)
+ * \return 1 si le bloc a changé, 0 sinon, -1 en cas d'erreur d'allocation
+ * \note La colonne des notes transpose d'un demi-ton, celle des octaves d'une octave et celle des
+ * instruments donne à tout le bloc l'instrument suivant (ou précédent) de la note sélectionnée
+ */
+int change_sequencer_block(journal_t *journal, music_t *music, sequencer_nav_t *seqNav, scale_t scale, int isUp) {
+    int count = seqNav->blockEnd - seqNav->blockStart + 1;
+    int status = 0;
+    note_t note;
+    journal_begin(journal);
+    switch(seqNav->col) {
+        case SEQUENCER_NAV_COL_NOTE:
+            status = journal_transpose_lines(journal, music, seqNav->blockCh, seqNav->blockStart, count, isUp ? 1 : -1);
+            break;
+        case SEQUENCER_NAV_COL_OCTAVE:
+            status = journal_transpose_lines(journal, music, seqNav->blockCh, seqNav->blockStart, count, isUp ? NB_NOTES - 1 : 1 - NB_NOTES);
+            break;
+        case SEQUENCER_NAV_COL_INSTRUMENT:
+            note = channel_note(&(music->channels[seqNav->blockCh]), seqNav->lines[seqNav->blockCh]);
+            change_sequencer_note(&note, seqNav->col, scale, isUp);
+            status = journal_replace_instrument(journal, music, seqNav->blockCh, seqNav->blockStart, count, note.instrument);
+            break;
+        default:
+            break;
+    }
+    journal_commit(journal);
+    return status;
+}
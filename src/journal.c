@@ -0,0 +1,420 @@
+/**
+ * \file journal.c
+ * \brief Journal des modifications du séquenceur (annuler / rétablir)
+ */
+#include "journal.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int apply_line(music_t *music, int channelId, int line, packed_note_t packed)
+ * \brief Écrit une ligne et met à jour nbNotes et l'index des durées de son channel
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne
+ * \param packed La note
+ * \return 0 si succès, -1 si le channel a été retiré de la musique ou si le bloc de la ligne
+ * n'a pas pu être alloué
+ */
+static int apply_line(music_t *music, int channelId, int line, packed_note_t packed) {
+    channel_t *channel;
+    int oldTime;
+    // Le channel est vérifié avant d'être lu : il a pu être retiré de la musique
+    if(channelId >= music->nbChannels) return -1;
+    channel = &(music->channels[channelId]);
+    oldTime = channel_note_ticks(channel, line);
+    if(set_channel_packed_note(channel, line, packed) < 0) return -1;
+    update_channel_nbNotes(channel, line);
+    update_channel_index(channel, line, oldTime);
+    return 0;
+}
+
+/**
+ * \fn int apply_edit(const journal_t *journal, music_t *music, const journal_edit_t *edit, int redo)
+ * \brief Remet une ligne ou un channel dans l'état d'avant ou d'après un écart
+ * \param journal Le journal
+ * \param music La musique
+ * \param edit L'écart
+ * \param redo 1 pour l'état d'après, 0 pour celui d'avant
+ * \return 0 si succès, -1 si le channel a été retiré de la musique ou si le bloc de la ligne
+ * n'a pas pu être alloué
+ */
+static int apply_edit(const journal_t *journal, music_t *music, const journal_edit_t *edit, int redo) {
+    channel_t *channel;
+    if(edit->block < 0) return apply_line(music, edit->channel, edit->line, redo ? edit->after : edit->before);
+    if(edit->channel >= music->nbChannels) return -1;
+    channel = &(music->channels[edit->channel]);
+    // Le channel reprend la copie gardée, nbNotes et l'index des durées compris
+    free_channel(channel);
+    share_channel(channel, redo ? &(journal->blocks[edit->block].after) : &(journal->blocks[edit->block].before));
+    return 0;
+}
+
+/**
+ * \fn int journal_reserve(journal_t *journal, int block)
+ * \brief Garantit la place d'un écart et d'une transaction de plus
+ * \param journal Le journal
+ * \param block 1 pour garantir aussi la place d'un état de channel
+ * \return 0 si succès, -1 si la mémoire manque
+ */
+static int journal_reserve(journal_t *journal, int block) {
+    journal_edit_t *edits;
+    journal_block_t *blocks;
+    int *groups;
+    // Les tableaux doublent : l'ajout d'un écart est en temps constant amorti
+    if(journal->nbEdits == journal->maxEdits) {
+        edits = realloc(journal->edits, sizeof(journal_edit_t) * (journal->maxEdits > 0 ? journal->maxEdits * 2 : JOURNAL_INITIAL_EDITS));
+        if(edits == NULL) return -1;
+        journal->edits = edits;
+        journal->maxEdits = journal->maxEdits > 0 ? journal->maxEdits * 2 : JOURNAL_INITIAL_EDITS;
+    }
+    if(journal->nbGroups == journal->maxGroups) {
+        groups = realloc(journal->groups, sizeof(int) * (journal->maxGroups > 0 ? journal->maxGroups * 2 : JOURNAL_INITIAL_GROUPS));
+        if(groups == NULL) return -1;
+        journal->groups = groups;
+        journal->maxGroups = journal->maxGroups > 0 ? journal->maxGroups * 2 : JOURNAL_INITIAL_GROUPS;
+    }
+    if(block && journal->nbBlocks == journal->maxBlocks) {
+        blocks = realloc(journal->blocks, sizeof(journal_block_t) * (journal->maxBlocks > 0 ? journal->maxBlocks * 2 : JOURNAL_INITIAL_BLOCKS));
+        if(blocks == NULL) return -1;
+        journal->blocks = blocks;
+        journal->maxBlocks = journal->maxBlocks > 0 ? journal->maxBlocks * 2 : JOURNAL_INITIAL_BLOCKS;
+    }
+    return 0;
+}
+
+/**
+ * \fn void journal_truncate(journal_t *journal, int nbEdits)
+ * \brief Oublie les écarts à partir d'un indice et libère leurs états de channel
+ * \param journal Le journal
+ * \param nbEdits Le nombre d'écarts gardés
+ */
+static void journal_truncate(journal_t *journal, int nbEdits) {
+    int i, block;
+    // Les états sont ajoutés dans l'ordre des écarts : ceux des écarts oubliés sont les derniers
+    for(i = nbEdits; i < journal->nbEdits; i++) {
+        block = journal->edits[i].block;
+        if(block < 0) continue;
+        free_channel(&(journal->blocks[block].before));
+        free_channel(&(journal->blocks[block].after));
+        if(block < journal->nbBlocks) journal->nbBlocks = block;
+    }
+    journal->nbEdits = nbEdits;
+}
+
+/**
+ * \fn journal_edit_t *journal_push(journal_t *journal)
+ * \brief Ajoute un écart à la transaction ouverte
+ * \param journal Le journal (la place de l'écart est réservée)
+ * \return L'écart à remplir
+ */
+static journal_edit_t *journal_push(journal_t *journal) {
+    // Premier écart de la transaction : les transactions annulées ne peuvent plus être rétablies
+    if(journal->open == 1) {
+        if(journal->cursor < journal->nbGroups) journal_truncate(journal, journal->groups[journal->cursor]);
+        journal->nbGroups = journal->cursor;
+        journal->groups[journal->nbGroups++] = journal->nbEdits;
+        journal->cursor = journal->nbGroups;
+        journal->open = 2;
+    }
+    return &(journal->edits[journal->nbEdits++]);
+}
+
+/**
+ * \fn int journal_record(journal_t *journal, music_t *music, int channelId, int line, packed_note_t after)
+ * \brief Applique une ligne et garde son écart dans la transaction ouverte
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne
+ * \param after La nouvelle note
+ * \return 1 si la ligne a changé, 0 si elle était déjà égale, -1 en cas d'erreur d'allocation
+ */
+static int journal_record(journal_t *journal, music_t *music, int channelId, int line, packed_note_t after) {
+    journal_edit_t *edit;
+    packed_note_t before = channel_packed_note(&(music->channels[channelId]), line);
+    if(memcmp(&before, &after, sizeof(packed_note_t)) == 0) return 0;
+    if(!journal->open) journal_begin(journal);
+    if(journal_reserve(journal, 0) < 0 || apply_line(music, channelId, line, after) < 0) return -1;
+    edit = journal_push(journal);
+    edit->channel = channelId;
+    edit->line = line;
+    edit->before = before;
+    edit->after = after;
+    edit->block = -1;
+    return 1;
+}
+
+/**
+ * \fn int journal_record_block(journal_t *journal, music_t *music, int channelId, int line, channel_t *before, int status)
+ * \brief Garde l'écart d'un bloc de lignes déjà modifié, ou remet le channel si la modification a échoué
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La première ligne modifiée
+ * \param before Copie du channel avant la modification (share_channel), reprise par le journal ou libérée
+ * \param status Résultat de la modification (0 si succès, -1 en cas d'erreur d'allocation)
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation (le channel n'est
+ * alors pas modifié)
+ */
+static int journal_record_block(journal_t *journal, music_t *music, int channelId, int line, channel_t *before, int status) {
+    channel_t *channel = &(music->channels[channelId]);
+    journal_edit_t *edit;
+    journal_block_t *block;
+    // La copie partage la table : toute écriture dans le channel l'a copiée
+    if(status == 0 && channel->table == before->table) {
+        free_channel(before);
+        return 0;
+    }
+    if(!journal->open) journal_begin(journal);
+    if(status < 0 || journal_reserve(journal, 1) < 0) {
+        free_channel(channel);
+        memcpy(channel, before, sizeof(channel_t));
+        return -1;
+    }
+    edit = journal_push(journal);
+    edit->channel = channelId;
+    edit->line = line;
+    edit->before = channel_packed_note(before, line);
+    edit->after = channel_packed_note(channel, line);
+    edit->block = journal->nbBlocks;
+    block = &(journal->blocks[journal->nbBlocks++]);
+    memcpy(&(block->before), before, sizeof(channel_t));
+    share_channel(&(block->after), channel);
+    return 1;
+}
+
+/**
+ * \fn int group_end(journal_t *journal, int group)
+ * \brief Indice qui suit le dernier écart d'une transaction
+ * \param journal Le journal
+ * \param group La transaction
+ * \return L'indice
+ */
+static int group_end(journal_t *journal, int group) {
+    return group + 1 < journal->nbGroups ? journal->groups[group + 1] : journal->nbEdits;
+}
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_journal(journal_t *journal)
+ * \brief Initialise un journal vide
+ * \param journal Le journal
+ */
+void init_journal(journal_t *journal) {
+    memset(journal, 0, sizeof(journal_t));
+}
+
+/**
+ * \fn void free_journal(journal_t *journal)
+ * \brief Libère l'historique d'un journal
+ * \param journal Le journal (vide après l'appel)
+ */
+void free_journal(journal_t *journal) {
+    int i;
+    for(i = 0; i < journal->nbBlocks; i++) {
+        free_channel(&(journal->blocks[i].before));
+        free_channel(&(journal->blocks[i].after));
+    }
+    free(journal->blocks);
+    free(journal->edits);
+    free(journal->groups);
+    init_journal(journal);
+}
+
+/**
+ * \fn void journal_begin(journal_t *journal)
+ * \brief Ouvre une transaction : les écarts suivants seront annulés ensemble
+ * \param journal Le journal
+ */
+void journal_begin(journal_t *journal) {
+    // 1 : ouverte sans écart, 2 : au moins un écart (la transaction est dans groups)
+    journal->open = 1;
+}
+
+/**
+ * \fn void journal_commit(journal_t *journal)
+ * \brief Ferme la transaction ouverte (une transaction sans écart est oubliée)
+ * \param journal Le journal
+ */
+void journal_commit(journal_t *journal) {
+    journal->open = 0;
+}
+
+/**
+ * \fn int journal_set_note(journal_t *journal, music_t *music, int channelId, int line, note_t note)
+ * \brief Modifie une ligne de la musique et garde l'écart dans la transaction ouverte
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne
+ * \param note La nouvelle note
+ * \return 1 si la ligne a changé, 0 si elle était déjà égale, -1 en cas d'erreur d'allocation
+ */
+int journal_set_note(journal_t *journal, music_t *music, int channelId, int line, note_t note) {
+    return journal_record(journal, music, channelId, line, pack_note(note));
+}
+
+/**
+ * \fn int journal_clear_line(journal_t *journal, music_t *music, int channelId, int line)
+ * \brief Vide une ligne (note d'un channel neuf) et garde l'écart dans la transaction ouverte
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne
+ * \return 1 si la ligne a changé, 0 si elle était déjà vide, -1 en cas d'erreur d'allocation
+ */
+int journal_clear_line(journal_t *journal, music_t *music, int channelId, int line) {
+    return journal_set_note(journal, music, channelId, line, create_note(NOTE_NA_ID, 0, REF_OCTAVE, INSTRUMENT_NA, CHANNEL_EMPTY_TICKS));
+}
+
+/**
+ * \fn int journal_copy_lines(journal_t *journal, music_t *music, int channelId, int line, const channel_t *src, int from, int count)
+ * \brief Copie des lignes d'un channel (un presse-papier par exemple) sur celles de la musique
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel écrit
+ * \param line La première ligne écrite
+ * \param src Le channel lu (qui n'est pas un channel de la musique)
+ * \param from La première ligne lue
+ * \param count Le nombre de lignes
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation
+ */
+int journal_copy_lines(journal_t *journal, music_t *music, int channelId, int line, const channel_t *src, int from, int count) {
+    channel_t before;
+    int status;
+    share_channel(&before, &(music->channels[channelId]));
+    status = copy_channel_lines(&(music->channels[channelId]), line, src, from, count);
+    return journal_record_block(journal, music, channelId, line, &before, status);
+}
+
+/**
+ * \fn int journal_insert_lines(journal_t *journal, music_t *music, int channelId, int line, int count)
+ * \brief Insère des lignes vides en décalant les suivantes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La ligne où insérer
+ * \param count Le nombre de lignes
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation
+ */
+int journal_insert_lines(journal_t *journal, music_t *music, int channelId, int line, int count) {
+    channel_t before;
+    int status;
+    share_channel(&before, &(music->channels[channelId]));
+    status = insert_channel_lines(&(music->channels[channelId]), line, count);
+    return journal_record_block(journal, music, channelId, line, &before, status);
+}
+
+/**
+ * \fn int journal_delete_lines(journal_t *journal, music_t *music, int channelId, int line, int count)
+ * \brief Supprime des lignes en remontant les suivantes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La première ligne supprimée
+ * \param count Le nombre de lignes
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation
+ */
+int journal_delete_lines(journal_t *journal, music_t *music, int channelId, int line, int count) {
+    channel_t before;
+    int status;
+    share_channel(&before, &(music->channels[channelId]));
+    status = delete_channel_lines(&(music->channels[channelId]), line, count);
+    return journal_record_block(journal, music, channelId, line, &before, status);
+}
+
+/**
+ * \fn int journal_transpose_lines(journal_t *journal, music_t *music, int channelId, int line, int count, int semitones)
+ * \brief Transpose les notes d'une suite de lignes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La première ligne
+ * \param count Le nombre de lignes
+ * \param semitones Le nombre de demi-tons (négatif pour descendre)
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation
+ */
+int journal_transpose_lines(journal_t *journal, music_t *music, int channelId, int line, int count, int semitones) {
+    channel_t before;
+    int status;
+    share_channel(&before, &(music->channels[channelId]));
+    status = transpose_channel_lines(&(music->channels[channelId]), line, count, semitones);
+    return journal_record_block(journal, music, channelId, line, &before, status);
+}
+
+/**
+ * \fn int journal_replace_instrument(journal_t *journal, music_t *music, int channelId, int line, int count, instrument_t instrument)
+ * \brief Change l'instrument des notes d'une suite de lignes
+ * \param journal Le journal
+ * \param music La musique
+ * \param channelId Le channel
+ * \param line La première ligne
+ * \param count Le nombre de lignes
+ * \param instrument Le nouvel instrument
+ * \return 1 si le channel a changé, 0 sinon, -1 en cas d'erreur d'allocation
+ */
+int journal_replace_instrument(journal_t *journal, music_t *music, int channelId, int line, int count, instrument_t instrument) {
+    channel_t before;
+    int status;
+    share_channel(&before, &(music->channels[channelId]));
+    status = replace_channel_instrument(&(music->channels[channelId]), line, count, instrument);
+    return journal_record_block(journal, music, channelId, line, &before, status);
+}
+
+/**
+ * \fn int journal_undo(journal_t *journal, music_t *music, const journal_edit_t **edits)
+ * \brief Annule la dernière transaction appliquée
+ * \param journal Le journal
+ * \param music La musique
+ * \param edits Rempli avec les écarts de la transaction (peut être NULL)
+ * \return Le nombre d'écarts annulés, 0 s'il n'y a rien à annuler ou si un channel de la transaction a été retiré
+ */
+int journal_undo(journal_t *journal, music_t *music, const journal_edit_t **edits) {
+    int start, end, i;
+    journal_commit(journal);
+    if(journal->cursor == 0) return 0;
+    start = journal->groups[journal->cursor - 1];
+    end = group_end(journal, journal->cursor - 1);
+    // Ordre inverse : une ligne modifiée deux fois retrouve sa première valeur
+    for(i = end - 1; i >= start; i--) {
+        if(apply_edit(journal, music, &(journal->edits[i]), 0) < 0) {
+            // Channel retiré ou mémoire épuisée : on remet les lignes déjà annulées, la transaction reste appliquée
+            for(i++; i < end; i++) apply_edit(journal, music, &(journal->edits[i]), 1);
+            return 0;
+        }
+    }
+    journal->cursor--;
+    if(edits != NULL) *edits = &(journal->edits[start]);
+    return end - start;
+}
+
+/**
+ * \fn int journal_redo(journal_t *journal, music_t *music, const journal_edit_t **edits)
+ * \brief Rétablit la dernière transaction annulée
+ * \param journal Le journal
+ * \param music La musique
+ * \param edits Rempli avec les écarts de la transaction (peut être NULL)
+ * \return Le nombre d'écarts rétablis, 0 s'il n'y a rien à rétablir ou si un channel de la transaction a été retiré
+ */
+int journal_redo(journal_t *journal, music_t *music, const journal_edit_t **edits) {
+    int start, end, i;
+    journal_commit(journal);
+    if(journal->cursor == journal->nbGroups) return 0;
+    start = journal->groups[journal->cursor];
+    end = group_end(journal, journal->cursor);
+    for(i = start; i < end; i++) {
+        if(apply_edit(journal, music, &(journal->edits[i]), 1) < 0) {
+            for(i--; i >= start; i--) apply_edit(journal, music, &(journal->edits[i]), 0);
+            return 0;
+        }
+    }
+    journal->cursor++;
+    if(edits != NULL) *edits = &(journal->edits[start]);
+    return end - start;
+}
@@ -12,19 +12,21 @@
 /**********************************************************************************************************************/
 
 /**
- * @fn void write_music(music_t *music, FILE *file);
+ * @fn int write_music(music_t *music, FILE *file);
  * @param music  La musique à écrire
  * @param file   Le fichier dans lequel écrire la musique
+ * @return 0 si la musique a été écrite, -1 si elle ne tient pas dans un buffer_t (rien n'est écrit)
  */
-void write_music(music_t *music, FILE *file);
+int write_music(music_t *music, FILE *file);
 
 /**
- * @fn void read_music(music_t *music, FILE *file);
+ * @fn int read_music(music_t *music, FILE *file);
  * @brief Lit une musique depuis un fichier 
  * @param music La musique à remplir
- * @param file Le fichier depuis lequou peuvenel lire la musique
+ * @param file Le fichier depuis lequel lire la musique
+ * @return 0 si la musique a été lue, -1 si le fichier n'a pas pu être lu ou ne tient pas dans un buffer_t
  */
-void read_music(music_t *music, FILE *file);
+int read_music(music_t *music, FILE *file);
 
 /**
  * @fn void write_list_music(musicId_list_t *list, FILE *file);
@@ -47,18 +49,50 @@ void read_list_music(musicId_list_t *list, FILE *file);
  * @param music La musique à sérialiser
  * @param buffer Le buffer dans lequel sérialiser la musique
  * @note La musique est sérialisée de la manière suivante :
- * <date> <bpm>
+ * <date> <bpm> <nombre de channels>
+ * B <channel> <pattern>
  * <line> <noteid> <octave> <instrument> <time>
  * ...
- * P
- * <line> <noteid> <octave> <instrument> <time>
+ * B <channel> <pattern>
  * ...
- * P
+ * O <pattern channel 0> <pattern channel 1> ...
+ * ...
+ * T <tick> <bpm>
+ * ...
+ * Chaque pattern (voir pattern.h) est écrit une fois avec ses lignes non vides, numérotées
+ * dans le pattern. Les lignes O donnent l'arrangement, une rangée de PATTERN_LINES lignes
+ * par ligne (PATTERN_NONE pour un bloc vide, les derniers channels sans pattern sont omis) :
+ * un channel vide n'écrit rien. Les lignes T (changements de tempo) sont optionnelles
+ * @note Les anciennes musiques n'ont pas de nombre de channels (MUSIC_DEFAULT_CHANNELS) et
+ * écrivent chaque channel ligne par ligne, terminé par P :
  * <line> <noteid> <octave> <instrument> <time>
+ * ...
  * P
+ * Cette forme est toujours lue, et écrite si l'arrangement n'a pas pu être calculé
+ * @return 0 si la musique a été sérialisée, -1 si elle ne tient pas dans le buffer (elle est tronquée)
  * @warning La musique doit être initialisée avant d'appeler cette fonction
  */
-void serialize_music(music_t *music, buffer_t buffer);
+int serialize_music(music_t *music, buffer_t buffer);
+
+/**
+ * @fn int append_buffer(buffer_t buffer, size_t *offset, const char *format, ...);
+ * @brief Ajoute une ligne formatée à la fin d'un buffer
+ * @param buffer Le buffer
+ * @param offset La longueur du texte déjà écrit (avancée de la longueur de la ligne)
+ * @param format Le format de la ligne (printf)
+ * @return 0 si la ligne a été ajoutée, -1 si elle ne tient pas dans le buffer (le buffer est inchangé)
+ */
+int append_buffer(buffer_t buffer, size_t *offset, const char *format, ...);
+
+/**
+ * @fn int serialize_channels(music_t *music, buffer_t buffer, size_t *offset);
+ * @brief Écrit les channels d'une musique ligne par ligne (forme des anciennes musiques)
+ * @param music La musique
+ * @param buffer Le buffer
+ * @param offset La longueur du texte déjà écrit (avancée de la longueur écrite)
+ * @return 0 si les channels ont été écrits, -1 si le buffer est plein
+ */
+int serialize_channels(music_t *music, buffer_t buffer, size_t *offset);
 
 /**
  * @fn deserialize_music(char *token, music_t *music, char *saveptr);
@@ -157,7 +191,10 @@ void print_mpp_response(mpp_response_t *response) {
  */
 void serialize_mpp_request(mpp_request_t *request, buffer_t buffer) {
     sprintf(buffer, "%d %s %ld\n", request->code, request->rfidId, request->musicId);
-    if(request->music != NULL) serialize_music(request->music, buffer);  
+    if(request->music != NULL && serialize_music(request->music, buffer) < 0) {
+        // Une musique tronquée perdrait des notes : la requête part sans musique et est refusée
+        sprintf(buffer, "%d %s %ld\n", request->code, request->rfidId, request->musicId);
+    }
 }
 
 /**
@@ -215,7 +252,10 @@ void serialize_mpp_response(mpp_response_t *response, buffer_t buffer) {
         sprintf(buffer, "%s0\n", buffer);
     }
 
-    if(response->music != NULL) serialize_music(response->music, buffer);
+    if(response->music != NULL && serialize_music(response->music, buffer) < 0) {
+        // Une musique tronquée perdrait des notes : on répond NOK sans la musique
+        sprintf(buffer, "%d %s\n", MPP_RESPONSE_NOK, response->username);
+    }
 }
 
 /**
@@ -423,12 +463,28 @@ void get_music_list_from_db(musicId_list_t *list, char *rfidId) {
  * @brief Ajoute une musique à la base de données
  * @param music La musique à ajouter
  * @param rfidId L'identifiant RFID de l'utilisateur
- * @return int 
+ * @return 0 si succès, -1 si la musique n'a pas pu être écrite (l'ancienne sauvegarde est conservée)
  */
 int add_music_to_db(music_t *music, char *rfidId) {
-    char filename[255];
+    char filename[255], tmpname[260];
+    // On écrit d'abord la musique dans un fichier temporaire : une musique trop grande
+    // n'écrase pas l'ancienne sauvegarde et n'est pas ajoutée à la liste
+    sprintf(filename, "%s/%s/%s/%ld.mipi", MPP_DB_FOLDER, MPP_DB_MUSIC_FOLDER, rfidId, music->date.tv_sec);
+    sprintf(tmpname, "%s.tmp", filename);
+    FILE *file = fopen(tmpname, "w");
+    if(file == NULL) return -1;
+    if(write_music(music, file) < 0) {
+        fclose(file);
+        remove(tmpname);
+        return -1;
+    }
+    if(fclose(file) != 0 || rename(tmpname, filename) < 0) {
+        remove(tmpname);
+        return -1;
+    }
+
     sprintf(filename, "%s/%s/%s/%s", MPP_DB_FOLDER, MPP_DB_MUSIC_FOLDER, rfidId, MPP_DB_MUSIC_FILE);
-    FILE *file = fopen(filename, "r+");
+    file = fopen(filename, "r+");
     if(file == NULL) {
         file = fopen(filename, "w+"); // On crée le fichier s'il n'existe pas
         if(file == NULL) return -1;
@@ -442,15 +498,6 @@ int add_music_to_db(music_t *music, char *rfidId) {
     fseek(file, 0, SEEK_SET); 
     write_list_music(&list, file);
     fclose(file);
-
-    // On écrit la musique dans un fichier séparé
-    sprintf(filename, "%s/%s/%s/%ld.mipi", MPP_DB_FOLDER, MPP_DB_MUSIC_FOLDER, rfidId, music->date.tv_sec);
-    file = fopen(filename, "w");
-
-    if(file == NULL) return -1;
-
-    write_music(music, file);
-    fclose(file);
     return 0;
 }
 
@@ -473,6 +520,23 @@ void get_music_from_db(music_t *music, time_t musicId, char *rfidId) {
 
 }
 
+/**
+ * @fn int load_music_file(music_t *music, char *filename);
+ * @brief Charge une musique depuis un fichier .mipi (hors base de données)
+ * @param music La musique à remplir (initialisée par la fonction)
+ * @param filename Le chemin du fichier
+ * @return 0 si succès, -1 si le fichier n'a pas pu être lu
+ */
+int load_music_file(music_t *music, char *filename) {
+    FILE *file = fopen(filename, "rb");
+    int result;
+    if(file == NULL) return -1;
+    init_music(music, 0);
+    result = read_music(music, file);
+    fclose(file);
+    return result;
+}
+
 /**
  * @fn delete_music_from_db(time_t musicId, char *rfidId);
  * @brief Supprime une musique de la base de données
@@ -592,7 +656,8 @@ void list_music_handler(socket_t *sd, mpp_request_t *request, mpp_response_t *re
  * @param request requête MPP reçue
  * @param response reponse MPP à envoyer
  * @note Un fichier est crée pour chaque musique dans le dossier de l'utilisateur
- * @warning Si l'utilisateur n'existe pas, une reponse BAD_REQUEST est envoyée
+ * @warning Si l'utilisateur n'existe pas ou si la requête n'a pas de musique, une reponse BAD_REQUEST est envoyée
+ * @warning Si la musique n'a pas pu être écrite, une réponse NOK est envoyée
  */
 void add_music_handler(socket_t *sd, mpp_request_t *request, mpp_response_t *response) {
     // On vérifie que l'utilisateur est présent dans user.db
@@ -601,8 +666,16 @@ void add_music_handler(socket_t *sd, mpp_request_t *request, mpp_response_t *res
         CREATE_BAD_REQUEST(response);
         return;
     }
+    // Une requête sans musique (absente ou trop grande pour être envoyée) est refusée
+    if(request->music == NULL) {
+        CREATE_BAD_REQUEST(response);
+        return;
+    }
     // On ajoute la musique à la base de données
-    add_music_to_db(request->music, request->rfidId);
+    if(add_music_to_db(request->music, request->rfidId) < 0) {
+        CREATE_NOK(response);
+        return;
+    }
     response->code = MPP_RESPONSE_MUSIC_CREATED;
 }
 
@@ -622,6 +695,7 @@ void get_music_handler(socket_t *sd, mpp_request_t *request, mpp_response_t *res
     }
     // On récupère la musique de la base de données
     response->music = (music_t *)malloc(sizeof(music_t));
+    init_music(response->music, 0);
     get_music_from_db(response->music, request->musicId, request->rfidId);
     response->code = MPP_RESPONSE_OK;
 }
@@ -651,7 +725,10 @@ void delete_music_handler(socket_t *sd, mpp_request_t *request, mpp_response_t *
  * @param request Requête MPP
  */
 void free_request(mpp_request_t *request) {
-    if(request->music != NULL) free(request->music);
+    if(request->music != NULL) {
+        free_music(request->music);
+        free(request->music);
+    }
     free(request);
 }
 
@@ -661,7 +738,10 @@ void free_request(mpp_request_t *request) {
  * @param response Réponse MPP
  */
 void free_response(mpp_response_t *response) {
-    if(response->music != NULL) free(response->music);
+    if(response->music != NULL) {
+        free_music(response->music);
+        free(response->music);
+    }
     if(response->musicIds != NULL) free_music_list(response->musicIds);
     free(response);
 }
@@ -703,30 +783,117 @@ void create_user_directories() {
  * @param music La musique à sérialiser
  * @param buffer Le buffer dans lequel sérialiser la musique
  * @note La musique est sérialisée de la manière suivante :
- * <date> <bpm>
+ * <date> <bpm> <nombre de channels>
+ * B <channel> <pattern>
  * <line> <noteid> <octave> <instrument> <time>
  * ...
- * P
- * <line> <noteid> <octave> <instrument> <time>
+ * B <channel> <pattern>
  * ...
- * P
+ * O <pattern channel 0> <pattern channel 1> ...
+ * ...
+ * T <tick> <bpm>
+ * ...
+ * Chaque pattern (voir pattern.h) est écrit une fois avec ses lignes non vides, numérotées
+ * dans le pattern. Les lignes O donnent l'arrangement, une rangée de PATTERN_LINES lignes
+ * par ligne (PATTERN_NONE pour un bloc vide, les derniers channels sans pattern sont omis) :
+ * un channel vide n'écrit rien. Les lignes T (changements de tempo) sont optionnelles
+ * @note Les anciennes musiques n'ont pas de nombre de channels (MUSIC_DEFAULT_CHANNELS) et
+ * écrivent chaque channel ligne par ligne, terminé par P :
  * <line> <noteid> <octave> <instrument> <time>
+ * ...
  * P
+ * Cette forme est toujours lue, et écrite si l'arrangement n'a pas pu être calculé
+ * @return 0 si la musique a été sérialisée, -1 si elle ne tient pas dans le buffer (elle est tronquée)
  * @warning La musique doit être initialisée avant d'appeler cette fonction
  */
-void serialize_music(music_t *music, buffer_t buffer) {
-    int i, j;
-    sprintf(buffer, "%s%ld %d\n", buffer, music->date.tv_sec, music->bpm);
-    // On parcourt chaque channel et on écrit seulement les notes non vides
-    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
+int serialize_music(music_t *music, buffer_t buffer) {
+    arrangement_t arrangement;
+    packed_note_t empty = pack_note(create_note(NOTE_NA_ID, 0, REF_OCTAVE, INSTRUMENT_NA, CHANNEL_EMPTY_TICKS));
+    char row[MUSIC_MAX_CHANNELS * 8 + 2];
+    int i, j, k, length, last;
+    // On écrit à la suite du buffer sans le relire : la sérialisation reste linéaire
+    size_t offset = strlen(buffer);
+    int full = append_buffer(buffer, &offset, "%ld %d %d\n", music->date.tv_sec, music->bpm, music->nbChannels);
+    init_arrangement(&arrangement);
+    if(arrange_music(music, &arrangement) < 0) {
+        // Mémoire épuisée : les channels sont écrits ligne par ligne
+        if(!full) full = serialize_channels(music, buffer, &offset);
+    }
+    else {
+        // Un pattern répété n'est écrit qu'une fois, avec ses seules lignes non vides
+        for(i = 0; i < arrangement.nbChannels && !full; i++) {
+            for(k = 0; k < arrangement.nbPatterns[i] && !full; k++) {
+                pattern_t *pattern = &(arrangement.patterns[i][k]);
+                full = append_buffer(buffer, &offset, "B %d %d\n", i, k);
+                for(j = 0; j < PATTERN_LINES && !full; j++) {
+                    packed_note_t note = pattern->lines[j];
+                    if(memcmp(&note, &empty, sizeof(packed_note_t)) == 0) continue;
+                    full = append_buffer(buffer, &offset, "%d %d %d %d %d\n", j, note.id, note.octave, note.instrument, note.time);
+                }
+            }
+        }
+        // L'arrangement : le pattern de chaque channel, rangée par rangée
+        for(k = 0; k < arrangement.nbOrders && !full; k++) {
+            for(last = arrangement.nbChannels - 1; last > 0 && arrangement.orders[k][last] == PATTERN_NONE; last--);
+            length = sprintf(row, "O");
+            for(i = 0; i <= last; i++) length += sprintf(row + length, " %d", arrangement.orders[k][i]);
+            full = append_buffer(buffer, &offset, "%s\n", row);
+        }
+    }
+    free_arrangement(&arrangement);
+    // Les changements de tempo suivent les channels
+    for(i = 0; i < music->nbTempos && !full; i++) {
+        full = append_buffer(buffer, &offset, "T %lld %d\n", music->tempos[i].tick, music->tempos[i].bpm);
+    }
+    if(full) fprintf(stderr, "SERIALIZE_MUSIC : musique tronquée à %lu octets\n", (unsigned long) offset);
+    return full;
+}
+
+/**
+ * @fn int serialize_channels(music_t *music, buffer_t buffer, size_t *offset);
+ * @brief Écrit les channels d'une musique ligne par ligne (forme des anciennes musiques)
+ * @param music La musique
+ * @param buffer Le buffer
+ * @param offset La longueur du texte déjà écrit (avancée de la longueur écrite)
+ * @return 0 si les channels ont été écrits, -1 si le buffer est plein
+ */
+int serialize_channels(music_t *music, buffer_t buffer, size_t *offset) {
+    int i, j, full = 0;
+    // On parcourt chaque channel et on écrit seulement les lignes non vides : les autres
+    // sont celles d'une musique initialisée
+    for(i = 0; i < music->nbChannels && !full; i++) {
         channel_t *channel = &music->channels[i];
-        for(j = 0; j < channel->nbNotes; j++) {
-            note_t *note = &channel->notes[j];
-            sprintf(buffer, "%s%d %d %d %d %d\n", buffer, j, note->id, note->octave, note->instrument, note->time);
+        for(j = channel_next_line(channel, 0); j >= 0 && j < channel->nbNotes && !full; j = channel_next_line(channel, j + 1)) {
+            packed_note_t note = channel_packed_note(channel, j);
+            full = append_buffer(buffer, offset, "%d %d %d %d %d\n", j, note.id, note.octave, note.instrument, note.time);
         }
         // On marque la fin du channel
-        sprintf(buffer, "%sP\n", buffer);
+        if(!full) full = append_buffer(buffer, offset, "P\n");
+    }
+    return full;
+}
+
+/**
+ * @fn int append_buffer(buffer_t buffer, size_t *offset, const char *format, ...);
+ * @brief Ajoute une ligne formatée à la fin d'un buffer
+ * @param buffer Le buffer
+ * @param offset La longueur du texte déjà écrit (avancée de la longueur de la ligne)
+ * @param format Le format de la ligne (printf)
+ * @return 0 si la ligne a été ajoutée, -1 si elle ne tient pas dans le buffer (le buffer est inchangé)
+ */
+int append_buffer(buffer_t buffer, size_t *offset, const char *format, ...) {
+    va_list args;
+    int written;
+    va_start(args, format);
+    written = vsnprintf(buffer + *offset, MAX_BUFF - *offset, format, args);
+    va_end(args);
+    if(written < 0 || (size_t) written >= MAX_BUFF - *offset) {
+        // Une ligne coupée ne serait pas relue : on la retire
+        buffer[*offset] = '\0';
+        return -1;
     }
+    *offset += written;
+    return 0;
 }
 
 /**
@@ -737,32 +904,69 @@ void serialize_music(music_t *music, buffer_t buffer) {
  * @warning La musique doit être initialisée avant d'appeler cette fonction
  */
 void deserialize_music(char *token, music_t *music) {
-    int channelCount = 0;
+    arrangement_t arrangement;
+    int channelCount = 0, channelId = -1, patternId = -1, nbChannels = MUSIC_DEFAULT_CHANNELS, i;
     char *line = NULL;
     char *saveptr = NULL;
-    scale_t scale = init_scale();
+    char *end;
     line = strtok_r(token, "\n", &saveptr);
-    sscanf(line, "%ld %hd", &music->date.tv_sec, &music->bpm);
-
-    while (line != NULL && channelCount < MUSIC_MAX_CHANNELS) {
-        line = strtok_r(NULL, "\n", &saveptr);
-        if (line != NULL) {
-            int channelId = channelCount;
-            channel_t *channel = &music->channels[channelId];
-            while (line != NULL && *line != 'P') {
-                int index = 0;
-                // on récupère d'abord la ligne
-                sscanf(line, "%d", &index);
-                // on récupère les notes
-                note_t *note = &channel->notes[index];
-                sscanf(line, "%d %hd %hd %d %d", &index, &note->id, &note->octave, (int *)&note->instrument, (int *)&note->time);
-                note->frequency = get_note_freq(note, &scale);
-                update_channel_nbNotes(channel, index);
-                line = strtok_r(NULL, "\n", &saveptr);
-            }
+    // Les anciennes musiques n'ont pas de nombre de channels
+    sscanf(line, "%ld %hd %d", &music->date.tv_sec, &music->bpm, &nbChannels);
+    if (set_music_channels(music, nbChannels) < 0) set_music_channels(music, MUSIC_DEFAULT_CHANNELS);
+    music->nbTempos = 0;
+    init_arrangement(&arrangement);
+    arrangement.nbChannels = music->nbChannels;
+    for(line = strtok_r(NULL, "\n", &saveptr); line != NULL; line = strtok_r(NULL, "\n", &saveptr)) {
+        if (*line == 'P') {
+            // Fin d'un channel écrit ligne par ligne
             channelCount++;
         }
+        else if (*line == 'B') {
+            // Début d'un pattern : les lignes qui suivent lui appartiennent
+            channelId = patternId = -1;
+            if (sscanf(line, "B %d %d", &channelId, &patternId) != 2 || channelId < 0 || channelId >= music->nbChannels || patternId < 0 || patternId >= ARRANGEMENT_MAX_ORDERS) {
+                channelId = patternId = -1;
+                continue;
+            }
+            while (arrangement.nbPatterns[channelId] <= patternId && arrangement_add_pattern(&arrangement, channelId) >= 0);
+            if (arrangement.nbPatterns[channelId] <= patternId) channelId = patternId = -1;
+        }
+        else if (*line == 'O') {
+            // Une rangée de l'arrangement (les channels absents n'ont pas de pattern)
+            channelId = patternId = -1;
+            if (arrangement.nbOrders >= ARRANGEMENT_MAX_ORDERS) continue;
+            end = line + 1;
+            for (i = 0; i < music->nbChannels; i++) {
+                char *next;
+                long id = strtol(end, &next, 10);
+                arrangement.orders[arrangement.nbOrders][i] = next != end && id >= 0 && id < arrangement.nbPatterns[i] ? id : PATTERN_NONE;
+                end = next;
+            }
+            arrangement.nbOrders++;
+        }
+        else if (*line == 'T') {
+            // Changements de tempo (absents des anciennes musiques)
+            long long tick;
+            short bpm;
+            channelId = patternId = -1;
+            if (sscanf(line, "T %lld %hd", &tick, &bpm) == 2) set_music_tempo(music, tick, bpm);
+        }
+        else {
+            int index = 0, instrument = INSTRUMENT_NA, time = TIME_NOIRE;
+            short id = NOTE_NA_ID, octave = REF_OCTAVE;
+            // on récupère la ligne puis la note
+            sscanf(line, "%d %hd %hd %d %d", &index, &id, &octave, &instrument, &time);
+            if (patternId >= 0) {
+                if (index >= 0 && index < PATTERN_LINES) arrangement.patterns[channelId][patternId].lines[index] = pack_note(create_note(id, 0, octave, instrument, time));
+            }
+            else if (channelCount < music->nbChannels && index >= 0 && index < CHANNEL_MAX_NOTES) {
+                set_channel_note(&music->channels[channelCount], index, create_note(id, note_frequency(id), octave, instrument, time));
+            }
+        }
     }
+    // Les patterns sont déroulés dans les channels, puis nbNotes et l'index des durées sont calculés
+    unroll_arrangement(&arrangement, music);
+    free_arrangement(&arrangement);
 }
 
 /**
@@ -797,36 +1001,50 @@ void read_list_music(musicId_list_t *list, FILE *file) {
 }
 
 /**
- * @fn void write_music(music_t *music, FILE *file);
+ * @fn int write_music(music_t *music, FILE *file);
  * @param music  La musique à écrire
  * @param file   Le fichier dans lequel écrire la musique
+ * @return 0 si la musique a été écrite, -1 si elle ne tient pas dans un buffer_t (rien n'est écrit)
  */
-void write_music(music_t *music, FILE *file) {
+int write_music(music_t *music, FILE *file) {
     // On change de stragégie pour l'écriture des musiques
     // On écrit la version sérialisée de la musique dans le fichier
     // Plus légère et plus modulaire (si la structure de la musique change, on pourra toujours lire les anciennes musiques)
     //fwrite(music, sizeof(music_t), 1, file);
     char *buffer = (char *) malloc(sizeof(buffer_t));
-    serialize_music(music, buffer);
-    fprintf(file, "%s", buffer);
+    int result = -1;
+    if(buffer == NULL) return -1;
+    // serialize_music écrit à la suite du buffer
+    buffer[0] = '\0';
+    if(serialize_music(music, buffer) == 0 && fputs(buffer, file) >= 0) result = 0;
     free(buffer);
+    return result;
 }
 
 /**
- * @fn void read_music(music_t *music, FILE *file);
+ * @fn int read_music(music_t *music, FILE *file);
  * @brief Lit une musique depuis un fichier 
  * @param music La musique à remplir
  * @param file Le fichier depuis lequel lire la musique
+ * @return 0 si la musique a été lue, -1 si le fichier n'a pas pu être lu ou ne tient pas dans un buffer_t
  */
-void read_music(music_t *music, FILE *file) {
+int read_music(music_t *music, FILE *file) {
     // On change de stragégie pour la lecture des musiques
     // On lit la version sérialisée de la musique dans le fichier
     // Plus légère et plus modulaire (si la structure de la musique change, on pourra toujours lire les anciennes musiques)
-    char *buffer = (char *) malloc(sizeof(buffer_t));
-    fread(buffer, sizeof(buffer_t), 1, file);
-    fprintf(stderr, "READ_MUSIC : %s\n", buffer);
-    fflush(stderr);
+    // Le buffer est mis à zéro : le fichier est plus court que buffer_t
+    char *buffer = (char *) calloc(1, sizeof(buffer_t));
+    size_t length;
+    if(buffer == NULL) return -1;
+    length = fread(buffer, 1, sizeof(buffer_t) - 1, file);
+    // Un fichier plus grand que buffer_t ne serait lu qu'en partie : la musique est refusée
+    if(ferror(file) || (length == sizeof(buffer_t) - 1 && fgetc(file) != EOF)) {
+        fprintf(stderr, "READ_MUSIC : fichier illisible ou trop grand\n");
+        free(buffer);
+        return -1;
+    }
     deserialize_music(buffer, music);
     free(buffer);
+    return 0;
 }
 
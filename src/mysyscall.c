@@ -223,3 +223,68 @@ void wait_sem(sem_t *sem) {
 void post_sem(sem_t *sem) {
     CHECK(sem_post(sem), "SEM_POST");
 }
+
+/* SECTION : SHM */
+
+/**
+ * @fn void *create_shm(char *name, size_t size);
+ * @brief Fonction qui crée (ou recrée) une mémoire partagée nommée et la projette
+ * @param name Nom de la mémoire partagée
+ * @param size Taille de la mémoire partagée
+ * @return L'adresse de la projection, mise à zéro
+ */
+void *create_shm(char *name, size_t size) {
+    void *addr;
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0666);
+    CHECK(fd, "SHM_OPEN");
+    CHECK(ftruncate(fd, size), "FTRUNCATE");
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(addr == MAP_FAILED) {
+        perror("MMAP");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    return addr;
+}
+
+/**
+ * @fn void *open_shm(char *name, size_t size);
+ * @brief Fonction qui projette une mémoire partagée nommée existante
+ * @param name Nom de la mémoire partagée
+ * @param size Taille de la mémoire partagée
+ * @return L'adresse de la projection ou NULL si elle n'existe pas
+ * @details contrairement à open_named_sem, l'absence de la mémoire n'est pas une erreur fatale
+ */
+void *open_shm(char *name, size_t size) {
+    void *addr;
+    struct stat st;
+    int fd = shm_open(name, O_RDWR, 0666);
+    if(fd == -1) return NULL;
+    // Une mémoire plus petite vient d'une autre version du programme
+    if(fstat(fd, &st) == -1 || (size_t) st.st_size < size) {
+        close(fd);
+        return NULL;
+    }
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+/**
+ * @fn void close_shm(void *addr, size_t size);
+ * @brief Fonction qui supprime la projection d'une mémoire partagée
+ * @param addr L'adresse de la projection
+ * @param size Taille de la mémoire partagée
+ */
+void close_shm(void *addr, size_t size) {
+    CHECK(munmap(addr, size), "MUNMAP");
+}
+
+/**
+ * @fn void unlink_shm(char *name);
+ * @brief Fonction qui supprime une mémoire partagée nommée
+ * @param name Nom de la mémoire partagée
+ */
+void unlink_shm(char *name) {
+    CHECK(shm_unlink(name), "SHM_UNLINK");
+}
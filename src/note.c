@@ -2,6 +2,375 @@
 /*                   E N T Ê T E S    S T A N D A R D S                     */
 /* ------------------------------------------------------------------------ */
 #include "note.h"
+#include "plugin.h"
+
+// Fréquences à l'octave de référence, dans l'ordre de note_id_t
+static const double noteFrequencies[NB_NOTES] = {
+	NOTE_NA_FQ, NOTE_C_FQ, NOTE_CS_FQ, NOTE_D_FQ, NOTE_DS_FQ, NOTE_E_FQ, NOTE_F_FQ,
+	NOTE_FS_FQ, NOTE_G_FQ, NOTE_GS_FQ, NOTE_A_FQ, NOTE_AS_FQ, NOTE_B_FQ
+};
+
+/**
+ * \fn unsigned char pack_field(int value)
+ * \brief Ramène un champ de note sur un octet
+ * \param value la valeur
+ * \return la valeur, ou 0 si elle ne tient pas sur un octet
+ */
+static unsigned char pack_field(int value) {
+	return value >= 0 && value <= 255 ? (unsigned char) value : 0;
+}
+
+/**
+ * \fn note_chunk_t *channel_chunk(const channel_t *channel, int index)
+ * \brief Bloc contenant une ligne
+ * \param channel le channel
+ * \param index la ligne
+ * \return le bloc, ou NULL si toutes ses lignes sont vides
+ */
+static note_chunk_t *channel_chunk(const channel_t *channel, int index) {
+	// Publiés par set_channel_packed_note : une table et un bloc lus sont toujours initialisés
+	chunk_table_t *table = __atomic_load_n(&channel->table, __ATOMIC_ACQUIRE);
+	if (table == NULL) return NULL;
+	return __atomic_load_n(&table->chunks[index >> CHANNEL_CHUNK_BITS], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * \fn long long chunk_ticks(const channel_t *channel, int chunk, int count)
+ * \brief Durée des premières lignes d'un bloc
+ * \param channel le channel
+ * \param chunk le numéro du bloc
+ * \param count le nombre de lignes (au plus CHANNEL_CHUNK_NOTES)
+ * \return la durée en doubles croches
+ */
+static long long chunk_ticks(const channel_t *channel, int chunk, int count) {
+	note_chunk_t *notes = chunk < CHANNEL_MAX_CHUNKS ? channel_chunk(channel, chunk << CHANNEL_CHUNK_BITS) : NULL;
+	long long ticks = 0;
+	int i;
+	if (notes == NULL) return (long long) count * CHANNEL_EMPTY_TICKS;
+	for (i = 0; i < count; i++) ticks += notes->times[i];
+	return ticks;
+}
+
+/**
+ * \fn long long chunks_prefix(const channel_t *channel, int chunk)
+ * \brief Position du début d'un bloc
+ * \param channel le channel
+ * \param chunk le numéro du bloc
+ * \return la durée des blocs précédents en doubles croches
+ */
+static long long chunks_prefix(const channel_t *channel, int chunk) {
+	// L'arbre ne stocke que l'écart à des blocs vides : un channel neuf est tout à zéro
+	chunk_table_t *table = __atomic_load_n(&channel->table, __ATOMIC_ACQUIRE);
+	long long tick = (long long) chunk * CHANNEL_CHUNK_NOTES * CHANNEL_EMPTY_TICKS;
+	int i;
+	if (table == NULL) return tick;
+	for (i = chunk; i > 0; i -= i & -i) tick += table->timeIndex[i];
+	return tick;
+}
+
+/**
+ * \fn void release_chunk(note_chunk_t *chunk)
+ * \brief Retirer un channel des détenteurs d'un bloc, libéré après le dernier
+ * \param chunk le bloc (NULL est accepté)
+ */
+static void release_chunk(note_chunk_t *chunk) {
+	if (chunk != NULL && __atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0) free(chunk);
+}
+
+/**
+ * \fn void release_table(chunk_table_t *table)
+ * \brief Retirer un channel des détenteurs d'une table, libérée avec ses blocs après le dernier
+ * \param table la table (NULL est accepté)
+ */
+static void release_table(chunk_table_t *table) {
+	int i;
+	if (table == NULL || __atomic_sub_fetch(&table->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+	for (i = 0; i < CHANNEL_MAX_CHUNKS; i++) release_chunk(table->chunks[i]);
+	free(table);
+}
+
+/**
+ * \fn void set_bit(unsigned long long *words, int bit, int value)
+ * \brief Écrire un bit d'une table d'occupation
+ * \param words la table
+ * \param bit le numéro du bit
+ * \param value 1 pour le mettre, 0 pour l'effacer
+ */
+static void set_bit(unsigned long long *words, int bit, int value) {
+	unsigned long long mask = 1ULL << (bit % CHANNEL_WORD_BITS);
+	if (value) words[bit / CHANNEL_WORD_BITS] |= mask;
+	else words[bit / CHANNEL_WORD_BITS] &= ~mask;
+}
+
+/**
+ * \fn int next_bit(const unsigned long long *words, int count, int bit)
+ * \brief Premier bit mis d'une table d'occupation à partir d'un bit
+ * \param words la table
+ * \param count le nombre de mots de la table
+ * \param bit le bit de départ (compris)
+ * \return le numéro du bit, -1 s'il n'y en a plus
+ */
+static int next_bit(const unsigned long long *words, int count, int bit) {
+	int w = bit / CHANNEL_WORD_BITS;
+	unsigned long long word;
+	if (w >= count) return -1;
+	word = words[w] & (~0ULL << (bit % CHANNEL_WORD_BITS));
+	while (word == 0) {
+		if (++w == count) return -1;
+		word = words[w];
+	}
+	return w * CHANNEL_WORD_BITS + __builtin_ctzll(word);
+}
+
+/**
+ * \fn int last_bit(const unsigned long long *words, int count)
+ * \brief Dernier bit mis d'une table d'occupation
+ * \param words la table
+ * \param count le nombre de mots de la table
+ * \return le numéro du bit, -1 si aucun bit n'est mis
+ */
+static int last_bit(const unsigned long long *words, int count) {
+	int w;
+	for (w = count - 1; w >= 0; w--) {
+		if (words[w] != 0) return w * CHANNEL_WORD_BITS + CHANNEL_WORD_BITS - 1 - __builtin_clzll(words[w]);
+	}
+	return -1;
+}
+
+/**
+ * \fn int next_occupied(const channel_t *channel, int line, int notes)
+ * \brief Première ligne occupée à partir d'une ligne, bloc par bloc puis mot par mot
+ * \param channel le channel
+ * \param line la ligne de départ (comprise)
+ * \param notes 1 pour chercher une note, 0 pour chercher une ligne non vide
+ * \return la ligne, -1 s'il n'y en a plus
+ */
+static int next_occupied(const channel_t *channel, int line, int notes) {
+	const unsigned long long *summary = notes ? channel->chunkNotes : channel->chunkLines;
+	note_chunk_t *chunk;
+	int c, found;
+	if (line < 0) line = 0;
+	while (line < CHANNEL_MAX_NOTES) {
+		// Les blocs sans ligne occupée sont sautés sans être lus
+		c = next_bit(summary, CHANNEL_SUMMARY_WORDS, line >> CHANNEL_CHUNK_BITS);
+		if (c < 0) return -1;
+		if (c > line >> CHANNEL_CHUNK_BITS) line = c << CHANNEL_CHUNK_BITS;
+		chunk = channel_chunk(channel, line);
+		found = next_bit(notes ? chunk->notes : chunk->lines, CHANNEL_CHUNK_WORDS, line & (CHANNEL_CHUNK_NOTES - 1));
+		if (found >= 0) return (c << CHANNEL_CHUNK_BITS) + found;
+		line = (c + 1) << CHANNEL_CHUNK_BITS;
+	}
+	return -1;
+}
+
+/**
+ * \fn void clear_columns(note_chunk_t *chunk, int line, int count)
+ * \brief Remplir des lignes consécutives d'un bloc avec la ligne vide, colonne par colonne
+ * \param chunk le bloc
+ * \param line la première ligne dans le bloc
+ * \param count le nombre de lignes
+ * \note L'occupation n'est pas mise à jour (refresh_chunk_bits)
+ */
+static void clear_columns(note_chunk_t *chunk, int line, int count) {
+	memset(chunk->ids + line, NOTE_NA_ID, count);
+	memset(chunk->octaves + line, REF_OCTAVE, count);
+	memset(chunk->instruments + line, INSTRUMENT_NA, count);
+	memset(chunk->times + line, CHANNEL_EMPTY_TICKS, count);
+}
+
+/**
+ * \fn void refresh_chunk_bits(channel_t *channel, note_chunk_t *chunk, int c, int line, int count)
+ * \brief Recalculer l'occupation de lignes d'un bloc depuis ses colonnes, puis celle du bloc
+ * \param channel le channel
+ * \param chunk le bloc (non partagé)
+ * \param c le numéro du bloc
+ * \param line la première ligne modifiée dans le bloc
+ * \param count le nombre de lignes modifiées
+ */
+static void refresh_chunk_bits(channel_t *channel, note_chunk_t *chunk, int c, int line, int count) {
+	unsigned long long notes, lines;
+	int w, i, k;
+	// Mot par mot, sans branchement : la boucle intérieure se vectorise
+	for (w = line / CHANNEL_WORD_BITS; w <= (line + count - 1) / CHANNEL_WORD_BITS; w++) {
+		notes = 0;
+		lines = 0;
+		for (i = 0; i < CHANNEL_WORD_BITS; i++) {
+			k = w * CHANNEL_WORD_BITS + i;
+			notes |= (unsigned long long) (chunk->ids[k] != NOTE_NA_ID) << i;
+			lines |= (unsigned long long) (chunk->ids[k] != NOTE_NA_ID || chunk->octaves[k] != REF_OCTAVE
+				|| chunk->instruments[k] != INSTRUMENT_NA || chunk->times[k] != CHANNEL_EMPTY_TICKS) << i;
+		}
+		chunk->notes[w] = notes;
+		chunk->lines[w] = lines;
+	}
+	set_bit(channel->chunkNotes, c, last_bit(chunk->notes, CHANNEL_CHUNK_WORDS) >= 0);
+	set_bit(channel->chunkLines, c, last_bit(chunk->lines, CHANNEL_CHUNK_WORDS) >= 0);
+}
+
+/**
+ * \fn chunk_table_t *writable_table(channel_t *channel)
+ * \brief Table d'un channel prête à être modifiée : allouée si le channel est vide, copiée si elle est partagée
+ * \param channel le channel
+ * \return la table, NULL si elle n'a pas pu être allouée
+ */
+static chunk_table_t *writable_table(channel_t *channel) {
+	chunk_table_t *table = channel->table, *shared;
+	int i;
+	if (table == NULL) {
+		table = calloc(1, sizeof(chunk_table_t));
+		if (table == NULL) return NULL;
+		table->refs = 1;
+		__atomic_store_n(&channel->table, table, __ATOMIC_RELEASE);
+	}
+	else if (__atomic_load_n(&table->refs, __ATOMIC_ACQUIRE) > 1) {
+		// Table partagée avec un instantané : la copie partage à son tour chacun des blocs
+		shared = table;
+		table = malloc(sizeof(chunk_table_t));
+		if (table == NULL) return NULL;
+		memcpy(table, shared, sizeof(chunk_table_t));
+		for (i = 0; i < CHANNEL_MAX_CHUNKS; i++) {
+			if (table->chunks[i] != NULL) __atomic_add_fetch(&table->chunks[i]->refs, 1, __ATOMIC_RELAXED);
+		}
+		table->refs = 1;
+		__atomic_store_n(&channel->table, table, __ATOMIC_RELEASE);
+		release_table(shared);
+	}
+	return table;
+}
+
+/**
+ * \fn note_chunk_t *writable_chunk(chunk_table_t *table, int c)
+ * \brief Bloc d'une table prêt à être modifié : alloué vide s'il n'existe pas, copié s'il est partagé
+ * \param table la table (non partagée, writable_table)
+ * \param c le numéro du bloc
+ * \return le bloc, NULL s'il n'a pas pu être alloué
+ */
+static note_chunk_t *writable_chunk(chunk_table_t *table, int c) {
+	note_chunk_t *chunk = table->chunks[c], *shared;
+	if (chunk == NULL) {
+		chunk = malloc(sizeof(note_chunk_t));
+		if (chunk == NULL) return NULL;
+		clear_columns(chunk, 0, CHANNEL_CHUNK_NOTES);
+		memset(chunk->notes, 0, sizeof(chunk->notes));
+		memset(chunk->lines, 0, sizeof(chunk->lines));
+		chunk->refs = 1;
+		__atomic_store_n(&table->chunks[c], chunk, __ATOMIC_RELEASE);
+	}
+	else if (__atomic_load_n(&chunk->refs, __ATOMIC_ACQUIRE) > 1) {
+		// Bloc partagé avec un instantané
+		shared = chunk;
+		chunk = malloc(sizeof(note_chunk_t));
+		if (chunk == NULL) return NULL;
+		memcpy(chunk, shared, sizeof(note_chunk_t));
+		chunk->refs = 1;
+		__atomic_store_n(&table->chunks[c], chunk, __ATOMIC_RELEASE);
+		release_chunk(shared);
+	}
+	return chunk;
+}
+
+/**
+ * \fn int copy_lines(channel_t *dest, int to, const channel_t *src, int from, int count)
+ * \brief Copier des lignes colonne par colonne, un segment contenu dans un bloc de chaque côté à la fois
+ * \param dest le channel écrit
+ * \param to la première ligne écrite
+ * \param src le channel lu (dest est accepté, les lignes peuvent se recouvrir)
+ * \param from la première ligne lue
+ * \param count le nombre de lignes (from + count et to + count au plus CHANNEL_MAX_NOTES)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué
+ * \note L'occupation des blocs écrits est mise à jour, pas nbNotes ni l'index des durées
+ */
+static int copy_lines(channel_t *dest, int to, const channel_t *src, int from, int count) {
+	const int mask = CHANNEL_CHUNK_NOTES - 1;
+	// Vers le bas dans un même channel, la copie part de la fin pour ne pas écraser les lignes à lire
+	int backward = src == dest && to > from;
+	int done, n, s, d;
+	chunk_table_t *table;
+	note_chunk_t *target, *source;
+	for (done = 0; done < count; done += n) {
+		if (backward) {
+			s = from + count - done;
+			d = to + count - done;
+			n = count - done;
+			if (n > ((s - 1) & mask) + 1) n = ((s - 1) & mask) + 1;
+			if (n > ((d - 1) & mask) + 1) n = ((d - 1) & mask) + 1;
+			s -= n;
+			d -= n;
+		}
+		else {
+			s = from + done;
+			d = to + done;
+			n = count - done;
+			if (n > CHANNEL_CHUNK_NOTES - (s & mask)) n = CHANNEL_CHUNK_NOTES - (s & mask);
+			if (n > CHANNEL_CHUNK_NOTES - (d & mask)) n = CHANNEL_CHUNK_NOTES - (d & mask);
+		}
+		// Des lignes vides copiées sur des lignes vides n'allouent ni ne copient rien
+		if (channel_chunk(src, s) == NULL && channel_chunk(dest, d) == NULL) continue;
+		table = writable_table(dest);
+		if (table == NULL) return -1;
+		target = writable_chunk(table, d >> CHANNEL_CHUNK_BITS);
+		if (target == NULL) return -1;
+		// Lu après la copie de la table ou du bloc écrits, qui peuvent être ceux de la source
+		source = channel_chunk(src, s);
+		if (source == NULL) clear_columns(target, d & mask, n);
+		else {
+			memmove(target->ids + (d & mask), source->ids + (s & mask), n);
+			memmove(target->octaves + (d & mask), source->octaves + (s & mask), n);
+			memmove(target->instruments + (d & mask), source->instruments + (s & mask), n);
+			memmove(target->times + (d & mask), source->times + (s & mask), n);
+		}
+		refresh_chunk_bits(dest, target, d >> CHANNEL_CHUNK_BITS, d & mask, n);
+	}
+	return 0;
+}
+
+/**
+ * \fn int clear_lines(channel_t *channel, int from, int count)
+ * \brief Vider des lignes, seuls les blocs qui ont une ligne non vide dans l'intervalle sont lus
+ * \param channel le channel
+ * \param from la première ligne
+ * \param count le nombre de lignes (from + count au plus CHANNEL_MAX_NOTES)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être copié
+ * \note L'occupation des blocs écrits est mise à jour, pas nbNotes ni l'index des durées
+ */
+static int clear_lines(channel_t *channel, int from, int count) {
+	chunk_table_t *table;
+	note_chunk_t *chunk;
+	int line, n;
+	for (line = channel_next_line(channel, from); line >= 0 && line < from + count; line = channel_next_line(channel, line + n)) {
+		n = CHANNEL_CHUNK_NOTES - (line & (CHANNEL_CHUNK_NOTES - 1));
+		if (n > from + count - line) n = from + count - line;
+		table = writable_table(channel);
+		if (table == NULL) return -1;
+		chunk = writable_chunk(table, line >> CHANNEL_CHUNK_BITS);
+		if (chunk == NULL) return -1;
+		clear_columns(chunk, line & (CHANNEL_CHUNK_NOTES - 1), n);
+		refresh_chunk_bits(channel, chunk, line >> CHANNEL_CHUNK_BITS, line & (CHANNEL_CHUNK_NOTES - 1), n);
+	}
+	return 0;
+}
+
+/**
+ * \fn int move_lines(channel_t *dest, int to, const channel_t *src, int from, int count)
+ * \brief Copier des lignes en ne lisant la source que jusqu'à son dernier bloc non vide
+ * \param dest le channel écrit
+ * \param to la première ligne écrite
+ * \param src le channel lu (dest est accepté, les lignes peuvent se recouvrir)
+ * \param from la première ligne lue
+ * \param count le nombre de lignes (to + count au plus CHANNEL_MAX_NOTES, les lignes lues
+ * au delà de CHANNEL_MAX_NOTES sont vides)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué
+ * \note L'occupation des blocs écrits est mise à jour, pas nbNotes ni l'index des durées
+ */
+static int move_lines(channel_t *dest, int to, const channel_t *src, int from, int count) {
+	// Au delà du dernier bloc non vide, la source n'a que des lignes vides : la fin de la copie
+	// est un effacement, qui ne lit que les blocs non vides de la destination
+	int used = ((last_bit(src->chunkLines, CHANNEL_SUMMARY_WORDS) + 1) << CHANNEL_CHUNK_BITS) - from;
+	if (used > count) used = count;
+	if (used < 0) used = 0;
+	if (copy_lines(dest, to, src, from, used) < 0) return -1;
+	return clear_lines(dest, to + used, count - used);
+}
 
 
 /* ------------------------------------------------------------------------ */
@@ -123,6 +492,380 @@ note_t * cp_note(note_t * dest, note_t src){
 	return dest;
 }
 
+/**
+ * \fn double note_frequency(int id)
+ * \brief Fréquence d'une note à l'octave de référence
+ * \param id l'identifiant de la note (note_id_t)
+ * \return la fréquence en Hz (NOTE_NA_FQ si l'identifiant n'est pas une note)
+ */
+double note_frequency(int id) {
+	return id >= 0 && id < NB_NOTES ? noteFrequencies[id] : NOTE_NA_FQ;
+}
+
+/**
+ * \fn packed_note_t pack_note(note_t note)
+ * \brief Compacter une note sur 4 octets
+ * \param note la note
+ * \return la note compacte (sans la fréquence)
+ */
+packed_note_t pack_note(note_t note) {
+	packed_note_t packed;
+	packed.id = pack_field(note.id);
+	packed.octave = pack_field(note.octave);
+	packed.instrument = pack_field(note.instrument);
+	packed.time = pack_field(note.time);
+	return packed;
+}
+
+/**
+ * \fn note_t unpack_note(packed_note_t packed)
+ * \brief Décompacter une note
+ * \param packed la note compacte
+ * \return la note, avec la fréquence de son identifiant
+ */
+note_t unpack_note(packed_note_t packed) {
+	return create_note(packed.id, note_frequency(packed.id), packed.octave, packed.instrument, packed.time);
+}
+
+/**
+ * \fn packed_note_t channel_packed_note(const channel_t *channel, int index)
+ * \brief Lire une note compacte d'un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \return la note compacte
+ */
+packed_note_t channel_packed_note(const channel_t *channel, int index) {
+	note_chunk_t *chunk = channel_chunk(channel, index);
+	packed_note_t packed;
+	int line = index & (CHANNEL_CHUNK_NOTES - 1);
+	if (chunk == NULL) {
+		packed.id = NOTE_NA_ID;
+		packed.octave = REF_OCTAVE;
+		packed.instrument = INSTRUMENT_NA;
+		packed.time = CHANNEL_EMPTY_TICKS;
+		return packed;
+	}
+	packed.id = chunk->ids[line];
+	packed.octave = chunk->octaves[line];
+	packed.instrument = chunk->instruments[line];
+	packed.time = chunk->times[line];
+	return packed;
+}
+
+/**
+ * \fn note_t channel_note(const channel_t *channel, int index)
+ * \brief Lire une note d'un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \return une copie de la note
+ */
+note_t channel_note(const channel_t *channel, int index) {
+	return unpack_note(channel_packed_note(channel, index));
+}
+
+/**
+ * \fn int set_channel_packed_note(channel_t *channel, int index, packed_note_t packed)
+ * \brief Écrire une note compacte dans un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \param packed la note compacte
+ * \return 0 si succès, -1 si le bloc de la ligne n'a pas pu être alloué
+ */
+int set_channel_packed_note(channel_t *channel, int index, packed_note_t packed) {
+	chunk_table_t *table;
+	note_chunk_t *chunk = channel_chunk(channel, index);
+	int line = index & (CHANNEL_CHUNK_NOTES - 1);
+	// Une ligne vide écrite dans un bloc vide ne change rien, pas plus qu'une ligne inchangée :
+	// ni la table ni le bloc ne sont alloués ou copiés
+	if (chunk == NULL && packed.id == NOTE_NA_ID && packed.octave == REF_OCTAVE && packed.instrument == INSTRUMENT_NA && packed.time == CHANNEL_EMPTY_TICKS) return 0;
+	if (chunk != NULL && chunk->ids[line] == packed.id && chunk->octaves[line] == packed.octave && chunk->instruments[line] == packed.instrument && chunk->times[line] == packed.time) return 0;
+	table = writable_table(channel);
+	if (table == NULL) return -1;
+	chunk = writable_chunk(table, index >> CHANNEL_CHUNK_BITS);
+	if (chunk == NULL) return -1;
+	chunk->ids[line] = packed.id;
+	chunk->octaves[line] = packed.octave;
+	chunk->instruments[line] = packed.instrument;
+	chunk->times[line] = packed.time;
+	// Occupation de la ligne, puis du bloc
+	set_bit(chunk->notes, line, packed.id != NOTE_NA_ID);
+	set_bit(chunk->lines, line, packed.id != NOTE_NA_ID || packed.octave != REF_OCTAVE || packed.instrument != INSTRUMENT_NA || packed.time != CHANNEL_EMPTY_TICKS);
+	set_bit(channel->chunkNotes, index >> CHANNEL_CHUNK_BITS, last_bit(chunk->notes, CHANNEL_CHUNK_WORDS) >= 0);
+	set_bit(channel->chunkLines, index >> CHANNEL_CHUNK_BITS, last_bit(chunk->lines, CHANNEL_CHUNK_WORDS) >= 0);
+	return 0;
+}
+
+/**
+ * \fn int set_channel_note(channel_t *channel, int index, note_t note)
+ * \brief Écrire une note dans un channel
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \param note la note (sa fréquence n'est pas gardée)
+ * \return 0 si succès, -1 si le bloc de la ligne n'a pas pu être alloué
+ */
+int set_channel_note(channel_t *channel, int index, note_t note) {
+	return set_channel_packed_note(channel, index, pack_note(note));
+}
+
+/**
+ * \fn int channel_note_ticks(const channel_t *channel, int index)
+ * \brief Durée d'une note d'un channel, lue dans la seule colonne des durées
+ * \param channel le channel
+ * \param index la ligne (entre 0 et CHANNEL_MAX_NOTES - 1)
+ * \return la durée en doubles croches
+ */
+int channel_note_ticks(const channel_t *channel, int index) {
+	note_chunk_t *chunk = channel_chunk(channel, index);
+	return chunk != NULL ? chunk->times[index & (CHANNEL_CHUNK_NOTES - 1)] : CHANNEL_EMPTY_TICKS;
+}
+
+/**
+ * \fn int channel_next_note(const channel_t *channel, int line)
+ * \brief Première note (identifiant différent de NOTE_NA_ID) à partir d'une ligne
+ * \param channel le channel
+ * \param line la ligne de départ (comprise)
+ * \return la ligne de la note, -1 s'il n'y en a plus
+ */
+int channel_next_note(const channel_t *channel, int line) {
+	return next_occupied(channel, line, 1);
+}
+
+/**
+ * \fn int channel_next_line(const channel_t *channel, int line)
+ * \brief Première ligne non vide à partir d'une ligne
+ * \param channel le channel
+ * \param line la ligne de départ (comprise)
+ * \return la ligne, -1 s'il n'y en a plus
+ */
+int channel_next_line(const channel_t *channel, int line) {
+	return next_occupied(channel, line, 0);
+}
+
+/**
+ * \fn int channel_last_note(const channel_t *channel)
+ * \brief Dernière note d'un channel
+ * \param channel le channel
+ * \return la ligne de la dernière note, -1 si le channel n'a pas de note
+ */
+int channel_last_note(const channel_t *channel) {
+	int c = last_bit(channel->chunkNotes, CHANNEL_SUMMARY_WORDS);
+	if (c < 0) return -1;
+	return (c << CHANNEL_CHUNK_BITS) + last_bit(channel_chunk(channel, c << CHANNEL_CHUNK_BITS)->notes, CHANNEL_CHUNK_WORDS);
+}
+
+/**
+ * \fn int channel_count_notes(const channel_t *channel)
+ * \brief Nombre de notes d'un channel (lignes dont l'identifiant n'est pas NOTE_NA_ID)
+ * \param channel le channel
+ * \return le nombre de notes
+ */
+int channel_count_notes(const channel_t *channel) {
+	note_chunk_t *chunk;
+	int c, w, count = 0;
+	for (c = next_bit(channel->chunkNotes, CHANNEL_SUMMARY_WORDS, 0); c >= 0; c = next_bit(channel->chunkNotes, CHANNEL_SUMMARY_WORDS, c + 1)) {
+		chunk = channel_chunk(channel, c << CHANNEL_CHUNK_BITS);
+		for (w = 0; w < CHANNEL_CHUNK_WORDS; w++) count += __builtin_popcountll(chunk->notes[w]);
+	}
+	return count;
+}
+
+/**
+ * \fn long long channel_lines_ticks(const channel_t *channel, int from, int to)
+ * \brief Durée d'une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param to la ligne qui suit la dernière (from <= to <= CHANNEL_MAX_NOTES)
+ * \return la durée en doubles croches
+ */
+long long channel_lines_ticks(const channel_t *channel, int from, int to) {
+	int chunk = from >> CHANNEL_CHUNK_BITS;
+	long long ticks = 0;
+	// Dans un même bloc les durées sont lues une à une, sinon l'index donne les blocs entre les deux
+	if (to >> CHANNEL_CHUNK_BITS == chunk) {
+		while (from < to) ticks += channel_note_ticks(channel, from++);
+		return ticks;
+	}
+	return chunks_prefix(channel, to >> CHANNEL_CHUNK_BITS) + chunk_ticks(channel, to >> CHANNEL_CHUNK_BITS, to & (CHANNEL_CHUNK_NOTES - 1))
+		- chunks_prefix(channel, chunk) - chunk_ticks(channel, chunk, from & (CHANNEL_CHUNK_NOTES - 1));
+}
+
+/**
+ * \fn int copy_channel_lines(channel_t *dest, int to, const channel_t *src, int from, int count)
+ * \brief Copier une suite de lignes d'un channel dans un autre, ou ailleurs dans le même
+ * \param dest le channel écrit
+ * \param to la première ligne écrite
+ * \param src le channel lu (dest est accepté, les lignes peuvent se recouvrir)
+ * \param from la première ligne lue
+ * \param count le nombre de lignes (la copie s'arrête à la fin de dest, les lignes lues au delà
+ * de la fin de src sont vides)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué (les lignes peuvent être en partie copiées)
+ * \note Les colonnes sont copiées bloc par bloc et nbNotes et l'index des durées ne sont mis à jour
+ * qu'une fois, quel que soit le nombre de lignes
+ */
+int copy_channel_lines(channel_t *dest, int to, const channel_t *src, int from, int count) {
+	int status;
+	if (count > CHANNEL_MAX_NOTES - to) count = CHANNEL_MAX_NOTES - to;
+	if (count <= 0) return 0;
+	status = move_lines(dest, to, src, from, count);
+	update_channel_nbNotes(dest, 0);
+	build_channel_index(dest);
+	return status;
+}
+
+/**
+ * \fn int clear_channel_lines(channel_t *channel, int from, int count)
+ * \brief Vider une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param count le nombre de lignes (l'effacement s'arrête à la fin du channel)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être copié (les lignes peuvent être en partie vidées)
+ * \note nbNotes et l'index des durées sont mis à jour une fois
+ */
+int clear_channel_lines(channel_t *channel, int from, int count) {
+	int status;
+	if (count > CHANNEL_MAX_NOTES - from) count = CHANNEL_MAX_NOTES - from;
+	if (count <= 0) return 0;
+	status = clear_lines(channel, from, count);
+	update_channel_nbNotes(channel, 0);
+	build_channel_index(channel);
+	return status;
+}
+
+/**
+ * \fn int insert_channel_lines(channel_t *channel, int line, int count)
+ * \brief Insérer des lignes vides en décalant les suivantes vers la fin
+ * \param channel le channel
+ * \param line la ligne où insérer
+ * \param count le nombre de lignes insérées
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué (les lignes peuvent être en partie décalées)
+ * \note Les lignes poussées au delà de CHANNEL_MAX_NOTES sont perdues. Seuls les blocs jusqu'à la
+ * dernière ligne non vide sont déplacés
+ */
+int insert_channel_lines(channel_t *channel, int line, int count) {
+	int status;
+	if (count > CHANNEL_MAX_NOTES - line) count = CHANNEL_MAX_NOTES - line;
+	if (count <= 0) return 0;
+	status = move_lines(channel, line + count, channel, line, CHANNEL_MAX_NOTES - line - count);
+	if (status == 0) status = clear_lines(channel, line, count);
+	update_channel_nbNotes(channel, 0);
+	build_channel_index(channel);
+	return status;
+}
+
+/**
+ * \fn int delete_channel_lines(channel_t *channel, int line, int count)
+ * \brief Supprimer des lignes en remontant les suivantes
+ * \param channel le channel
+ * \param line la première ligne supprimée
+ * \param count le nombre de lignes supprimées
+ * \return 0 si succès, -1 si un bloc n'a pas pu être alloué (les lignes peuvent être en partie décalées)
+ * \note Les dernières lignes du channel deviennent vides
+ */
+int delete_channel_lines(channel_t *channel, int line, int count) {
+	int status;
+	if (count > CHANNEL_MAX_NOTES - line) count = CHANNEL_MAX_NOTES - line;
+	if (count <= 0) return 0;
+	// Les lignes lues au delà de la fin sont vides : la fin du channel est vidée par la même copie
+	status = move_lines(channel, line, channel, line + count, CHANNEL_MAX_NOTES - line);
+	update_channel_nbNotes(channel, 0);
+	build_channel_index(channel);
+	return status;
+}
+
+/**
+ * \fn int transposed_pitch(const note_chunk_t *chunk, int i, int semitones)
+ * \brief Hauteur d'une note d'un bloc après transposition
+ * \param chunk le bloc
+ * \param i la ligne dans le bloc (non vide)
+ * \param semitones le nombre de demi-tons
+ * \return la hauteur en demi-tons depuis le DO de l'octave 0, bornée au SI de l'octave NOTE_MAX_OCTAVE
+ */
+static int transposed_pitch(const note_chunk_t *chunk, int i, int semitones) {
+	const int highest = NOTE_MAX_OCTAVE * (NB_NOTES - 1) + NB_NOTES - 2;
+	int pitch = chunk->octaves[i] * (NB_NOTES - 1) + chunk->ids[i] - 1 + semitones;
+	if (pitch < 0) return 0;
+	return pitch > highest ? highest : pitch;
+}
+
+/**
+ * \fn int transpose_channel_lines(channel_t *channel, int from, int count, int semitones)
+ * \brief Transposer les notes d'une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param count le nombre de lignes
+ * \param semitones le nombre de demi-tons (négatif pour descendre)
+ * \return 0 si succès, -1 si un bloc n'a pas pu être copié (les notes peuvent être en partie transposées)
+ * \note Les notes sont bornées entre le DO de l'octave 0 et le SI de l'octave NOTE_MAX_OCTAVE.
+ * Un bloc dont aucune note ne change (toutes déjà à la borne) n'est pas copié : le channel
+ * garde alors sa table et l'édition n'est pas journalisée.
+ * Les durées et l'occupation ne changent pas : ni nbNotes ni l'index ne sont à recalculer
+ */
+int transpose_channel_lines(channel_t *channel, int from, int count, int semitones) {
+	chunk_table_t *table;
+	note_chunk_t *chunk;
+	int line, n, i, end, pitch;
+	if (count > CHANNEL_MAX_NOTES - from) count = CHANNEL_MAX_NOTES - from;
+	if (semitones == 0) return 0;
+	// Seuls les blocs qui ont une note dans l'intervalle sont lus, et copiés si une note change
+	for (line = channel_next_note(channel, from); line >= 0 && line < from + count; line = channel_next_note(channel, line + n)) {
+		n = CHANNEL_CHUNK_NOTES - (line & (CHANNEL_CHUNK_NOTES - 1));
+		if (n > from + count - line) n = from + count - line;
+		end = (line & (CHANNEL_CHUNK_NOTES - 1)) + n;
+		chunk = channel_chunk(channel, line);
+		for (i = line & (CHANNEL_CHUNK_NOTES - 1); i < end; i++) {
+			if (chunk->ids[i] != NOTE_NA_ID && transposed_pitch(chunk, i, semitones) != transposed_pitch(chunk, i, 0)) break;
+		}
+		if (i == end) continue;
+		table = writable_table(channel);
+		if (table == NULL) return -1;
+		chunk = writable_chunk(table, line >> CHANNEL_CHUNK_BITS);
+		if (chunk == NULL) return -1;
+		for (; i < end; i++) {
+			if (chunk->ids[i] == NOTE_NA_ID) continue;
+			pitch = transposed_pitch(chunk, i, semitones);
+			chunk->octaves[i] = pitch / (NB_NOTES - 1);
+			chunk->ids[i] = pitch % (NB_NOTES - 1) + 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * \fn int replace_channel_instrument(channel_t *channel, int from, int count, instrument_t instrument)
+ * \brief Changer l'instrument des notes d'une suite de lignes
+ * \param channel le channel
+ * \param from la première ligne
+ * \param count le nombre de lignes
+ * \param instrument le nouvel instrument
+ * \return 0 si succès, -1 si un bloc n'a pas pu être copié (les notes peuvent être en partie modifiées)
+ * \note Les lignes sans note gardent leur instrument. Un bloc dont toutes les notes ont déjà
+ * l'instrument n'est pas copié. L'occupation, nbNotes et l'index ne changent pas
+ */
+int replace_channel_instrument(channel_t *channel, int from, int count, instrument_t instrument) {
+	chunk_table_t *table;
+	note_chunk_t *chunk;
+	int line, n, i, end;
+	if (count > CHANNEL_MAX_NOTES - from) count = CHANNEL_MAX_NOTES - from;
+	for (line = channel_next_note(channel, from); line >= 0 && line < from + count; line = channel_next_note(channel, line + n)) {
+		n = CHANNEL_CHUNK_NOTES - (line & (CHANNEL_CHUNK_NOTES - 1));
+		if (n > from + count - line) n = from + count - line;
+		end = (line & (CHANNEL_CHUNK_NOTES - 1)) + n;
+		chunk = channel_chunk(channel, line);
+		for (i = line & (CHANNEL_CHUNK_NOTES - 1); i < end; i++) {
+			if (chunk->ids[i] != NOTE_NA_ID && chunk->instruments[i] != pack_field(instrument)) break;
+		}
+		if (i == end) continue;
+		table = writable_table(channel);
+		if (table == NULL) return -1;
+		chunk = writable_chunk(table, line >> CHANNEL_CHUNK_BITS);
+		if (chunk == NULL) return -1;
+		for (; i < end; i++) {
+			if (chunk->ids[i] != NOTE_NA_ID) chunk->instruments[i] = pack_field(instrument);
+		}
+	}
+	return 0;
+}
+
 /**
  * \fn void init_channel(channel_t *channel);
  * \brief Initialiser un channel avec des notes vides
@@ -131,13 +874,92 @@ note_t * cp_note(note_t * dest, note_t src){
  * \see channel_t
  */
 void init_channel(channel_t *channel, int id) {
-	note_t note = create_note(0, NOTE_NA_FQ, REF_OCTAVE, INSTRUMENT_NA, TIME_NOIRE);
-	int i;
-	for (i = 0; i < CHANNEL_MAX_NOTES; i++) channel->notes[i] = note;
-	channel->nbNotes = 0; // Aucune note non vide // TODO : voir si on peut sans passer
+	// Aucune table : toutes les lignes sont vides et l'index des durées est nul
+	channel->table = NULL;
+	memset(channel->chunkNotes, 0, sizeof(channel->chunkNotes));
+	memset(channel->chunkLines, 0, sizeof(channel->chunkLines));
+	channel->nbNotes = 0; // Aucune note non vide
 	channel->id  = id;
 }
 
+/**
+ * \fn void free_channel(channel_t *channel)
+ * \brief Libérer les blocs de notes d'un channel
+ * \param channel le channel (initialisé par init_channel)
+ */
+void free_channel(channel_t *channel) {
+	release_table(channel->table);
+	channel->table = NULL;
+	memset(channel->chunkNotes, 0, sizeof(channel->chunkNotes));
+	memset(channel->chunkLines, 0, sizeof(channel->chunkLines));
+}
+
+/**
+ * \fn void share_channel(channel_t *copy, const channel_t *channel)
+ * \brief Copier un channel en partageant sa table
+ * \param copy la copie (vide ou libérée par free_channel)
+ * \param channel le channel
+ * \note La table est copiée à la première écriture dans l'un ou l'autre : la copie coûte un
+ * détenteur de plus, quel que soit le nombre de lignes
+ */
+void share_channel(channel_t *copy, const channel_t *channel) {
+	memcpy(copy, channel, sizeof(channel_t));
+	if (copy->table != NULL) __atomic_add_fetch(&copy->table->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * \fn void free_music(music_t *music)
+ * \brief Libérer les notes d'une musique
+ * \param music la musique (initialisée par init_music)
+ */
+void free_music(music_t *music) {
+	int i;
+	// Les channels au delà de nbChannels n'ont jamais de table
+	for (i = 0; i < music->nbChannels; i++) free_channel(&music->channels[i]);
+}
+
+/**
+ * \fn music_t *music_snapshot(const music_t *music)
+ * \brief Instantané d'une musique : une version figée qui partage ses blocs de notes
+ * \param music la musique
+ * \return l'instantané (un détenteur), NULL si l'allocation a échoué
+ */
+music_t *music_snapshot(const music_t *music) {
+	music_t *snapshot = malloc(sizeof(music_t));
+	int i;
+	if (snapshot == NULL) return NULL;
+	memcpy(snapshot, music, sizeof(music_t));
+	// Chaque table gagne un détenteur : la musique la copiera avant de la modifier, sans
+	// parcourir ses blocs ici
+	for (i = 0; i < snapshot->nbChannels; i++) {
+		if (snapshot->channels[i].table != NULL) __atomic_add_fetch(&snapshot->channels[i].table->refs, 1, __ATOMIC_RELAXED);
+	}
+	snapshot->refs = 1;
+	return snapshot;
+}
+
+/**
+ * \fn music_t *retain_music(music_t *snapshot)
+ * \brief Ajouter un détenteur à un instantané
+ * \param snapshot l'instantané
+ * \return l'instantané
+ */
+music_t *retain_music(music_t *snapshot) {
+	__atomic_add_fetch(&snapshot->refs, 1, __ATOMIC_RELAXED);
+	return snapshot;
+}
+
+/**
+ * \fn void release_music(music_t *snapshot)
+ * \brief Retirer un détenteur d'un instantané, libéré avec ses blocs après le dernier
+ * \param snapshot l'instantané (NULL est accepté)
+ */
+void release_music(music_t *snapshot) {
+	if (snapshot == NULL || __atomic_sub_fetch(&snapshot->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+	free_music(snapshot);
+	free(snapshot);
+}
+
 /**
  * \fn init_music(music_t *music, short bpm);
  * \brief Initialiser une musique avec des channels vides
@@ -147,9 +969,31 @@ void init_channel(channel_t *channel, int id) {
 void init_music(music_t *music, short bpm) {
 	int i;
 	music->bpm = bpm;
+	music->nbTempos = 0;
+	music->refs = 0;
+	music->nbChannels = MUSIC_DEFAULT_CHANNELS;
 	for (i = 0; i < MUSIC_MAX_CHANNELS; i++) init_channel(&music->channels[i], i);
 }
 
+/**
+ * \fn int set_music_channels(music_t *music, int nbChannels)
+ * \brief Changer le nombre de channels d'une musique
+ * \param music la musique (initialisée par init_music)
+ * \param nbChannels le nouveau nombre de channels
+ * \return 0 si succès, -1 si nbChannels n'est pas entre MUSIC_MIN_CHANNELS et MUSIC_MAX_CHANNELS
+ */
+int set_music_channels(music_t *music, int nbChannels) {
+	int i;
+	if (nbChannels < MUSIC_MIN_CHANNELS || nbChannels > MUSIC_MAX_CHANNELS) return -1;
+	// Un channel retiré redevient vide : il ne coûte rien s'il est ajouté de nouveau
+	for (i = nbChannels; i < music->nbChannels; i++) {
+		free_channel(&music->channels[i]);
+		init_channel(&music->channels[i], i);
+	}
+	music->nbChannels = nbChannels;
+	return 0;
+}
+
 /**
  * \fn void instrument2str(instrument_t instrument, char *str);
  * \brief Convertir un instrument en chaine de caractère
@@ -182,13 +1026,27 @@ void instrument2str(instrument_t instrument, char *str) {
 		case INSTRUMENT_SINPHASER:
 			strcpy(str, INSTRUMENT_SINPHASER_NAME);
 			break;
+		case INSTRUMENT_STEPMOTOR:
+			strcpy(str, INSTRUMENT_STEPMOTOR_NAME);
+			break;
 		
 		default:
-			strcpy(str, INSTRUMENT_NA_NAME);
+			// Les plugins viennent après les instruments internes
+			if(instrument_plugin(instrument) != NULL) sprintf(str, "%-4.4s", instrument_plugin(instrument)->abi->name);
+			else strcpy(str, INSTRUMENT_NA_NAME);
 			break;
 	}
 }
 
+/**
+ * \fn int nb_instruments()
+ * \brief Nombre d'instruments disponibles, plugins compris
+ * \return INSTRUMENT_NB plus le nombre de plugins chargés (voir plugin.h)
+ */
+int nb_instruments() {
+	return INSTRUMENT_NB + nb_plugins();
+}
+
 /**
  * \fn note2str(note_t note, char *str);
  * \brief Convertir une note en chaine de caractère
@@ -252,16 +1110,178 @@ void note2str(note_t note, char *str) {
  * Pour cela il compare la note passée en paramètre avec la dernière note du channel
  */
 void update_channel_nbNotes(channel_t *channel, int noteIndex) {
-	note_t currentNote = channel->notes[noteIndex];
-	if(noteIndex >= channel->nbNotes) {
-		if(currentNote.id != NOTE_NA_ID) channel->nbNotes = noteIndex + 1;
-		return;
-	} 
-	if(noteIndex == channel->nbNotes - 1) {
-		while(channel->notes[channel->nbNotes - 1].id == NOTE_NA_ID && channel->nbNotes > 0) {
-			channel->nbNotes--;
+	// La table d'occupation donne directement la dernière note, quelle que soit la ligne modifiée
+	channel->nbNotes = channel_last_note(channel) + 1;
+}
+
+/**
+ * @fn void build_channel_index(channel_t *channel);
+ * @brief Reconstruire l'index des durées d'un channel
+ * @param channel le channel
+ * @note A appeler après avoir modifié les durées sans passer par update_channel_index
+ * (désérialisation par exemple)
+ */
+void build_channel_index(channel_t *channel) {
+	chunk_table_t *table = channel->table;
+	int timeIndex[CHANNEL_MAX_CHUNKS + 1];
+	int i, parent;
+	// Sans table, tous les blocs sont vides : l'index est nul
+	if (table == NULL) return;
+	timeIndex[0] = 0;
+	for (i = 1; i <= CHANNEL_MAX_CHUNKS; i++) {
+		timeIndex[i] = table->chunks[i - 1] != NULL ? (int) (chunk_ticks(channel, i - 1, CHANNEL_CHUNK_NOTES) - CHANNEL_CHUNK_NOTES * CHANNEL_EMPTY_TICKS) : 0;
+	}
+	// Construction en O(n) : chaque noeud ajoute sa somme à son parent
+	for (i = 1; i <= CHANNEL_MAX_CHUNKS; i++) {
+		parent = i + (i & -i);
+		if (parent <= CHANNEL_MAX_CHUNKS) timeIndex[parent] += timeIndex[i];
+	}
+	// Une table partagée avec un instantané n'a pas changé depuis : son index est déjà juste
+	if (memcmp(table->timeIndex, timeIndex, sizeof(timeIndex)) != 0) memcpy(table->timeIndex, timeIndex, sizeof(timeIndex));
+}
+
+/**
+ * @fn void update_channel_index(channel_t *channel, int noteIndex, int oldTime);
+ * @brief Mettre à jour l'index des durées après la modification d'une note
+ * @param channel le channel
+ * @param noteIndex l'index de la note modifiée
+ * @param oldTime la durée de la note avant la modification
+ * @note Complexité en O(log n)
+ */
+void update_channel_index(channel_t *channel, int noteIndex, int oldTime) {
+	int delta = channel_note_ticks(channel, noteIndex) - (oldTime > 0 ? oldTime : 0);
+	int i;
+	// Une durée modifiée a été écrite par set_channel_packed_note : la table existe et n'est pas partagée
+	if (delta == 0 || channel->table == NULL) return;
+	for (i = (noteIndex >> CHANNEL_CHUNK_BITS) + 1; i <= CHANNEL_MAX_CHUNKS; i += i & -i) channel->table->timeIndex[i] += delta;
+}
+
+/**
+ * @fn long long channel_line2tick(channel_t *channel, int line);
+ * @brief Position musicale du début d'une ligne d'un channel
+ * @param channel le channel
+ * @param line la ligne
+ * @return la position en doubles croches depuis le début de la musique
+ * @note Complexité en O(log n + CHANNEL_CHUNK_NOTES). Au delà de nbNotes, la position est celle de la fin du channel
+ */
+long long channel_line2tick(channel_t *channel, int line) {
+	int chunk;
+	if (line > channel->nbNotes) line = channel->nbNotes;
+	if (line <= 0) return 0;
+	chunk = line >> CHANNEL_CHUNK_BITS;
+	// Les blocs précédents par l'index, puis les lignes du bloc une à une
+	return chunks_prefix(channel, chunk) + chunk_ticks(channel, chunk, line & (CHANNEL_CHUNK_NOTES - 1));
+}
+
+/**
+ * @fn int channel_tick2line(channel_t *channel, long long tick);
+ * @brief Ligne d'un channel jouée à une position musicale
+ * @param channel le channel
+ * @param tick la position en doubles croches depuis le début de la musique
+ * @return la ligne jouée, ou nbNotes si le channel est terminé
+ * @note Complexité en O(log n + CHANNEL_CHUNK_NOTES)
+ */
+int channel_tick2line(channel_t *channel, long long tick) {
+	chunk_table_t *table = __atomic_load_n(&channel->table, __ATOMIC_ACQUIRE);
+	int chunk = 0, line, step;
+	long long size;
+	if (tick < 0) return 0;
+	// Descente dans l'arbre : on cherche le dernier bloc qui commence avant ou sur tick.
+	// Un noeud couvre step blocs : sa durée est celle de step blocs vides plus son écart
+	for (step = CHANNEL_MAX_CHUNKS; step > 0; step >>= 1) {
+		if (chunk + step > CHANNEL_MAX_CHUNKS) continue;
+		size = (table != NULL ? table->timeIndex[chunk + step] : 0) + (long long) step * CHANNEL_CHUNK_NOTES * CHANNEL_EMPTY_TICKS;
+		if (size <= tick) {
+			chunk += step;
+			tick -= size;
 		}
 	}
+	// Puis les lignes du bloc
+	line = chunk << CHANNEL_CHUNK_BITS;
+	while (line < CHANNEL_MAX_NOTES && line < channel->nbNotes && channel_note_ticks(channel, line) <= tick) {
+		tick -= channel_note_ticks(channel, line);
+		line++;
+	}
+	return line < channel->nbNotes ? line : channel->nbNotes;
+}
+
+/**
+ * @fn long long music_end_tick(music_t *music);
+ * @brief Position de la fin de la musique
+ * @param music la musique
+ * @return la fin du channel le plus long en doubles croches
+ */
+long long music_end_tick(music_t *music) {
+	long long tick, end = 0;
+	int i;
+	for (i = 0; i < music->nbChannels; i++) {
+		tick = channel_line2tick(&music->channels[i], music->channels[i].nbNotes);
+		if (tick > end) end = tick;
+	}
+	return end;
+}
+
+/**
+ * @fn short music_tempo_at(music_t *music, long long tick);
+ * @brief Tempo en vigueur à une position de la musique
+ * @param music la musique
+ * @param tick la position en doubles croches
+ * @return le bpm
+ */
+short music_tempo_at(music_t *music, long long tick) {
+	int i = music_tempo_index(music, tick);
+	return i > 0 ? music->tempos[i - 1].bpm : music->bpm;
+}
+
+/**
+ * @fn int music_tempo_index(music_t *music, long long tick);
+ * @brief Nombre de changements de tempo placés avant ou sur une position
+ * @param music la musique
+ * @param tick la position en doubles croches
+ * @return l'indice du prochain changement de tempo après tick
+ */
+int music_tempo_index(music_t *music, long long tick) {
+	int i = 0;
+	while (i < music->nbTempos && music->tempos[i].tick <= tick) i++;
+	return i;
+}
+
+/**
+ * @fn int set_music_tempo(music_t *music, long long tick, short bpm);
+ * @brief Ajouter ou modifier un changement de tempo
+ * @param music la musique
+ * @param tick la position du changement en doubles croches
+ * @param bpm le nouveau tempo (borné entre MUSIC_MIN_BPM et MUSIC_MAX_BPM)
+ * @return 0 si le changement est enregistré, -1 si la liste est pleine
+ */
+int set_music_tempo(music_t *music, long long tick, short bpm) {
+	int i = music_tempo_index(music, tick);
+	if (bpm < MUSIC_MIN_BPM) bpm = MUSIC_MIN_BPM;
+	if (bpm > MUSIC_MAX_BPM) bpm = MUSIC_MAX_BPM;
+	// Un changement existe déjà sur cette position : on le modifie
+	if (i > 0 && music->tempos[i - 1].tick == tick) {
+		music->tempos[i - 1].bpm = bpm;
+		return 0;
+	}
+	if (music->nbTempos >= MUSIC_MAX_TEMPOS) return -1;
+	memmove(&music->tempos[i + 1], &music->tempos[i], sizeof(tempo_event_t) * (music->nbTempos - i));
+	music->tempos[i].tick = tick;
+	music->tempos[i].bpm = bpm;
+	music->nbTempos++;
+	return 0;
+}
 
-	return;
-}
\ No newline at end of file
+/**
+ * @fn int remove_music_tempo(music_t *music, long long tick);
+ * @brief Supprimer le changement de tempo placé sur une position
+ * @param music la musique
+ * @param tick la position du changement en doubles croches
+ * @return 1 si un changement a été supprimé, 0 sinon
+ */
+int remove_music_tempo(music_t *music, long long tick) {
+	int i = music_tempo_index(music, tick);
+	if (i == 0 || music->tempos[i - 1].tick != tick) return 0;
+	memmove(&music->tempos[i - 1], &music->tempos[i], sizeof(tempo_event_t) * (music->nbTempos - i));
+	music->nbTempos--;
+	return 1;
+}
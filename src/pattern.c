@@ -0,0 +1,190 @@
+/**
+ * \file pattern.c
+ * \brief Patterns et arrangement d'une musique
+ */
+#include "pattern.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void clear_pattern(pattern_t *pattern)
+ * \brief Remplit un pattern de lignes vides
+ * \param pattern Le pattern
+ */
+static void clear_pattern(pattern_t *pattern) {
+    packed_note_t empty = pack_note(create_note(NOTE_NA_ID, 0, REF_OCTAVE, INSTRUMENT_NA, CHANNEL_EMPTY_TICKS));
+    int i;
+    for(i = 0; i < PATTERN_LINES; i++) pattern->lines[i] = empty;
+    pattern->hash = 0;
+}
+
+/**
+ * \fn unsigned long long hash_pattern(const pattern_t *pattern)
+ * \brief Empreinte FNV-1a des lignes d'un pattern
+ * \param pattern Le pattern
+ * \return L'empreinte
+ */
+static unsigned long long hash_pattern(const pattern_t *pattern) {
+    const unsigned char *bytes = (const unsigned char *) pattern->lines;
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t i;
+    for(i = 0; i < sizeof(pattern->lines); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * \fn int read_pattern(const channel_t *channel, int first, pattern_t *pattern)
+ * \brief Lit le bloc de lignes d'un channel qui commence à une ligne
+ * \param channel Le channel
+ * \param first La première ligne du bloc
+ * \param pattern Le pattern à remplir
+ * \return 1 si le bloc contient une ligne non vide, 0 sinon (le pattern n'est pas rempli)
+ */
+static int read_pattern(const channel_t *channel, int first, pattern_t *pattern) {
+    int last = first + PATTERN_LINES < channel->nbNotes ? first + PATTERN_LINES : channel->nbNotes;
+    int line = channel_next_line(channel, first);
+    if(line < 0 || line >= last) return 0;
+    clear_pattern(pattern);
+    // Les lignes vides sont sautées mot par mot dans la table d'occupation
+    for(; line >= 0 && line < last; line = channel_next_line(channel, line + 1)) {
+        pattern->lines[line - first] = channel_packed_note(channel, line);
+    }
+    pattern->hash = hash_pattern(pattern);
+    return 1;
+}
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_arrangement(arrangement_t *arrangement)
+ * \brief Initialise un arrangement sans channel, pattern ni rangée
+ * \param arrangement L'arrangement
+ */
+void init_arrangement(arrangement_t *arrangement) {
+    int i;
+    arrangement->nbChannels = 0;
+    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) {
+        arrangement->patterns[i] = NULL;
+        arrangement->nbPatterns[i] = 0;
+        arrangement->maxPatterns[i] = 0;
+    }
+    arrangement->nbOrders = 0;
+}
+
+/**
+ * \fn void free_arrangement(arrangement_t *arrangement)
+ * \brief Libère les patterns d'un arrangement
+ * \param arrangement L'arrangement (vide après l'appel)
+ */
+void free_arrangement(arrangement_t *arrangement) {
+    int i;
+    for(i = 0; i < MUSIC_MAX_CHANNELS; i++) free(arrangement->patterns[i]);
+    init_arrangement(arrangement);
+}
+
+/**
+ * \fn int arrangement_add_pattern(arrangement_t *arrangement, int channelId)
+ * \brief Ajoute un pattern vide à un channel
+ * \param arrangement L'arrangement
+ * \param channelId Le channel
+ * \return Le numéro du pattern, -1 si la mémoire manque
+ */
+int arrangement_add_pattern(arrangement_t *arrangement, int channelId) {
+    pattern_t *patterns;
+    int size;
+    if(arrangement->nbPatterns[channelId] == arrangement->maxPatterns[channelId]) {
+        size = arrangement->maxPatterns[channelId] > 0 ? arrangement->maxPatterns[channelId] * 2 : ARRANGEMENT_INITIAL_PATTERNS;
+        patterns = realloc(arrangement->patterns[channelId], sizeof(pattern_t) * size);
+        if(patterns == NULL) return -1;
+        arrangement->patterns[channelId] = patterns;
+        arrangement->maxPatterns[channelId] = size;
+    }
+    clear_pattern(&(arrangement->patterns[channelId][arrangement->nbPatterns[channelId]]));
+    return arrangement->nbPatterns[channelId]++;
+}
+
+/**
+ * \fn int arrange_music(const music_t *music, arrangement_t *arrangement)
+ * \brief Découpe les channels d'une musique en patterns
+ * \param music La musique
+ * \param arrangement L'arrangement (initialisé, remplacé par celui de la musique)
+ * \return 0 si succès, -1 si la mémoire manque
+ * \note Seules les lignes non vides sont lues. Les lignes au delà de nbNotes ne sont pas jouées
+ * et comptent comme vides
+ */
+int arrange_music(const music_t *music, arrangement_t *arrangement) {
+    // Table de hachage (adressage ouvert) des patterns du channel en cours : au plus une
+    // entrée par rangée, la table n'est jamais remplie à plus de moitié
+    static const int mask = 2 * ARRANGEMENT_MAX_ORDERS - 1;
+    int table[2 * ARRANGEMENT_MAX_ORDERS];
+    pattern_t block, *patterns;
+    int i, k, slot, id, rows;
+    free_arrangement(arrangement);
+    arrangement->nbChannels = music->nbChannels;
+    for(i = 0; i < music->nbChannels; i++) {
+        rows = (music->channels[i].nbNotes + PATTERN_LINES - 1) / PATTERN_LINES;
+        if(rows > arrangement->nbOrders) arrangement->nbOrders = rows;
+    }
+    for(i = 0; i < music->nbChannels; i++) {
+        const channel_t *channel = &(music->channels[i]);
+        memset(table, -1, sizeof(table));
+        for(k = 0; k < arrangement->nbOrders; k++) {
+            arrangement->orders[k][i] = PATTERN_NONE;
+            if(k * PATTERN_LINES >= channel->nbNotes || !read_pattern(channel, k * PATTERN_LINES, &block)) continue;
+            // Un bloc déjà vu dans ce channel reprend son pattern
+            for(slot = block.hash & mask; (id = table[slot]) >= 0; slot = (slot + 1) & mask) {
+                patterns = arrangement->patterns[i];
+                if(patterns[id].hash == block.hash && memcmp(patterns[id].lines, block.lines, sizeof(block.lines)) == 0) break;
+            }
+            if(id < 0) {
+                id = arrangement_add_pattern(arrangement, i);
+                if(id < 0) {
+                    free_arrangement(arrangement);
+                    return -1;
+                }
+                arrangement->patterns[i][id] = block;
+                table[slot] = id;
+            }
+            arrangement->orders[k][i] = id;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \fn int unroll_arrangement(const arrangement_t *arrangement, music_t *music)
+ * \brief Écrit les patterns d'un arrangement dans les channels d'une musique
+ * \param arrangement L'arrangement
+ * \param music La musique (ses lignes doivent être vides)
+ * \return 0 si succès, -1 si un bloc de notes n'a pas pu être alloué
+ * \note nbNotes et l'index des durées des channels sont mis à jour. Les channels de
+ * l'arrangement au delà de ceux de la musique sont ignorés
+ */
+int unroll_arrangement(const arrangement_t *arrangement, music_t *music) {
+    packed_note_t empty = pack_note(create_note(NOTE_NA_ID, 0, REF_OCTAVE, INSTRUMENT_NA, CHANNEL_EMPTY_TICKS));
+    const pattern_t *pattern;
+    int i, k, j, id, status = 0;
+    for(i = 0; i < music->nbChannels; i++) {
+        channel_t *channel = &(music->channels[i]);
+        for(k = 0; i < arrangement->nbChannels && k < arrangement->nbOrders && k < ARRANGEMENT_MAX_ORDERS && status == 0; k++) {
+            id = arrangement->orders[k][i];
+            if(id < 0 || id >= arrangement->nbPatterns[i]) continue;
+            pattern = &(arrangement->patterns[i][id]);
+            // Les lignes vides le sont déjà dans la musique : elles n'allouent pas de bloc
+            for(j = 0; j < PATTERN_LINES && status == 0; j++) {
+                if(memcmp(&(pattern->lines[j]), &empty, sizeof(packed_note_t)) == 0) continue;
+                status = set_channel_packed_note(channel, k * PATTERN_LINES + j, pattern->lines[j]);
+            }
+        }
+        update_channel_nbNotes(channel, 0);
+        build_channel_index(channel);
+    }
+    return status;
+}
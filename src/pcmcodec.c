@@ -0,0 +1,428 @@
+/**
+ * \file pcmcodec.c
+ * \brief Format compressé sans perte pour les rendus audio enregistrés sur disque
+ */
+#include "pcmcodec.h"
+
+/* ------------------------------------------------------------------------ */
+/*              D É F I N I T I O N S   D E   T Y P E S                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \struct bit_writer_t
+ * \brief Écriture d'un flux de bits (bit de poids fort en premier)
+ */
+typedef struct {
+    unsigned char *data; /*!< Flux */
+    size_t pos; /*!< Prochain octet écrit */
+    unsigned long long acc; /*!< Bits en attente */
+    int bits; /*!< Nombre de bits en attente */
+} bit_writer_t;
+
+/**
+ * \struct bit_reader_t
+ * \brief Lecture d'un flux de bits (bit de poids fort en premier)
+ */
+typedef struct {
+    const unsigned char *data; /*!< Flux */
+    size_t pos; /*!< Prochain octet chargé */
+    size_t size; /*!< Taille du flux */
+    unsigned long long acc; /*!< Bits chargés, alignés à gauche */
+    int bits; /*!< Nombre de bits chargés */
+} bit_reader_t;
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void put_bits(bit_writer_t *writer, unsigned int value, int n)
+ * \brief Écrit les n bits de poids faible de value (n <= 48)
+ */
+static void put_bits(bit_writer_t *writer, unsigned int value, int n) {
+    writer->acc = (writer->acc << n) | (value & ((1ULL << n) - 1));
+    writer->bits += n;
+    while(writer->bits >= 8) {
+        writer->bits -= 8;
+        writer->data[writer->pos++] = (unsigned char) (writer->acc >> writer->bits);
+    }
+}
+
+/**
+ * \fn void flush_bits(bit_writer_t *writer)
+ * \brief Complète le dernier octet avec des zéros
+ */
+static void flush_bits(bit_writer_t *writer) {
+    if(writer->bits > 0) put_bits(writer, 0, 8 - writer->bits);
+}
+
+/**
+ * \fn void refill_bits(bit_reader_t *reader)
+ * \brief Charge des octets jusqu'à avoir au moins 57 bits (des zéros après la fin du flux)
+ */
+static inline void refill_bits(bit_reader_t *reader) {
+    while(reader->bits <= 56) {
+        if(reader->pos < reader->size) reader->acc |= (unsigned long long) reader->data[reader->pos] << (56 - reader->bits);
+        reader->pos++;
+        reader->bits += 8;
+    }
+}
+
+/**
+ * \fn unsigned int get_bits(bit_reader_t *reader, int n)
+ * \brief Lit n bits (1 <= n <= 32)
+ */
+static inline unsigned int get_bits(bit_reader_t *reader, int n) {
+    unsigned int value;
+    if(reader->bits < n) refill_bits(reader);
+    value = (unsigned int) (reader->acc >> (64 - n));
+    reader->acc <<= n;
+    reader->bits -= n;
+    return value;
+}
+
+/**
+ * \fn size_t read_position(bit_reader_t *reader)
+ * \brief Position de l'octet qui suit le dernier bit lu
+ */
+static size_t read_position(bit_reader_t *reader) {
+    return reader->pos - reader->bits / 8;
+}
+
+/**
+ * \fn void put_le(unsigned char *data, unsigned long long value, int bytes)
+ * \brief Écrit un entier en petit boutiste
+ */
+static void put_le(unsigned char *data, unsigned long long value, int bytes) {
+    int i;
+    for(i = 0; i < bytes; i++) data[i] = (unsigned char) (value >> (8 * i));
+}
+
+/**
+ * \fn unsigned long long get_le(const unsigned char *data, int bytes)
+ * \brief Lit un entier en petit boutiste
+ */
+static unsigned long long get_le(const unsigned char *data, int bytes) {
+    unsigned long long value = 0;
+    int i;
+    for(i = bytes - 1; i >= 0; i--) value = (value << 8) | data[i];
+    return value;
+}
+
+/**
+ * \fn unsigned int zigzag(int residual)
+ * \brief Replie un résidu signé sur les entiers positifs (0, -1, 1, -2, ...)
+ */
+static inline unsigned int zigzag(int residual) {
+    return ((unsigned int) residual << 1) ^ (unsigned int) (residual >> 31);
+}
+
+/**
+ * \fn int predict(const short *pcm, int n, int order)
+ * \brief Prédiction fixe de l'échantillon n à partir des précédents
+ */
+static inline int predict(const short *pcm, int n, int order) {
+    switch(order) {
+        case 1: return pcm[n - 1];
+        case 2: return 2 * pcm[n - 1] - pcm[n - 2];
+        case 3: return 3 * pcm[n - 1] - 3 * pcm[n - 2] + pcm[n - 3];
+        default: return 0;
+    }
+}
+
+/**
+ * \fn void encode_block(bit_writer_t *writer, const short *pcm, int count)
+ * \brief Compresse un bloc : choix du prédicteur et du paramètre de Rice puis codage des résidus
+ * \param writer Le flux de sortie (aligné sur un octet)
+ * \param pcm Les échantillons du bloc
+ * \param count Le nombre d'échantillons
+ */
+static void encode_block(bit_writer_t *writer, const short *pcm, int count) {
+    unsigned long long cost[PCMCODEC_MAX_ORDER + 1] = {0}, sum = 0, bits, bestBits = 0;
+    unsigned int u;
+    int order, bestOrder = 0, k, kMin, bestK = 0, n, estimate;
+
+    // Le meilleur prédicteur minimise la somme des résidus
+    for(order = 0; order <= PCMCODEC_MAX_ORDER; order++) {
+        for(n = PCMCODEC_MAX_ORDER; n < count; n++) cost[order] += abs(pcm[n] - predict(pcm, n, order));
+        if(cost[order] < cost[bestOrder]) bestOrder = order;
+    }
+    if(bestOrder > count) bestOrder = count;
+    for(n = bestOrder; n < count; n++) sum += zigzag(pcm[n] - predict(pcm, n, bestOrder));
+    // Paramètre de Rice : autour du log2 de la moyenne, affiné sur le coût exact
+    estimate = 0;
+    if(count > bestOrder) while(estimate < PCMCODEC_MAX_RICE && (sum / (count - bestOrder)) >> (estimate + 1)) estimate++;
+    kMin = estimate > 0 ? estimate - 1 : 0;
+    for(k = kMin; k <= estimate + 1 && k <= PCMCODEC_MAX_RICE; k++) {
+        bits = 0;
+        for(n = bestOrder; n < count; n++) {
+            u = zigzag(pcm[n] - predict(pcm, n, bestOrder));
+            bits += (u >> k) < PCMCODEC_ESCAPE ? (u >> k) + 1 + k : PCMCODEC_ESCAPE + 1 + 32;
+        }
+        if(k == kMin || bits < bestBits) {
+            bestBits = bits;
+            bestK = k;
+        }
+    }
+
+    put_bits(writer, bestOrder, 8);
+    put_bits(writer, bestK, 8);
+    for(n = 0; n < bestOrder; n++) put_bits(writer, (unsigned short) pcm[n], 16);
+    for(n = bestOrder; n < count; n++) {
+        u = zigzag(pcm[n] - predict(pcm, n, bestOrder));
+        if((u >> bestK) < PCMCODEC_ESCAPE) {
+            // Quotient en unaire (des zéros terminés par un 1) puis reste sur k bits
+            put_bits(writer, 1, (u >> bestK) + 1);
+            if(bestK > 0) put_bits(writer, u, bestK);
+        }
+        else {
+            put_bits(writer, 1, PCMCODEC_ESCAPE + 1);
+            put_bits(writer, u, 32);
+        }
+    }
+    flush_bits(writer);
+}
+
+/**
+ * \fn int decode_block(pcm_reader_t *reader, long long index)
+ * \brief Décode un bloc dans reader->block
+ * \param reader Le lecteur
+ * \param index L'indice du bloc
+ * \return Le nombre d'échantillons du bloc, -1 si le bloc est corrompu
+ */
+static int decode_block(pcm_reader_t *reader, long long index) {
+    const unsigned char *table = reader->data + PCMCODEC_HEADER_SIZE;
+    size_t start = reader->dataStart + get_le(table + 4 * index, 4);
+    size_t end = reader->dataStart + get_le(table + 4 * (index + 1), 4);
+    long long first = index * reader->blockFrames;
+    int count = reader->frames - first < reader->blockFrames ? (int) (reader->frames - first) : (int) reader->blockFrames;
+    short *pcm = reader->block;
+    bit_reader_t bits;
+    unsigned int u, q;
+    int order, k, n, residual, zeros;
+
+    if(start + 2 > end || end > reader->size) return -1;
+    order = reader->data[start];
+    k = reader->data[start + 1];
+    if(order > PCMCODEC_MAX_ORDER || order > count || k > PCMCODEC_MAX_RICE) return -1;
+    bits.data = reader->data;
+    bits.pos = start + 2;
+    bits.size = end;
+    bits.acc = 0;
+    bits.bits = 0;
+    for(n = 0; n < order; n++) pcm[n] = (short) get_bits(&bits, 16);
+    for(n = order; n < count; n++) {
+        refill_bits(&bits);
+        // Au plus PCMCODEC_ESCAPE zéros avant le 1 : ils sont tous dans les 57 bits chargés
+        if(bits.acc == 0) return -1;
+        zeros = __builtin_clzll(bits.acc);
+        if(zeros > PCMCODEC_ESCAPE) return -1;
+        bits.acc <<= zeros + 1;
+        bits.bits -= zeros + 1;
+        q = zeros;
+        if(q < PCMCODEC_ESCAPE) u = k > 0 ? (q << k) | get_bits(&bits, k) : q;
+        else u = get_bits(&bits, 32);
+        residual = (int) (u >> 1) ^ -(int) (u & 1);
+        pcm[n] = (short) (residual + predict(pcm, n, order));
+    }
+    if(read_position(&bits) > end) return -1;
+    reader->cachedBlock = index;
+    return count;
+}
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn unsigned char *encode_pcm(short *pcm, long long frames, size_t *size)
+ * \brief Compresse des échantillons
+ * \param pcm Les échantillons
+ * \param frames Le nombre d'échantillons
+ * \param size La taille du flux compressé
+ * \return Le flux compressé (à libérer) ou NULL si l'allocation a échoué
+ */
+unsigned char *encode_pcm(short *pcm, long long frames, size_t *size) {
+    unsigned int nbBlocks = (unsigned int) ((frames + PCMCODEC_BLOCK_FRAMES - 1) / PCMCODEC_BLOCK_FRAMES);
+    size_t dataStart = PCMCODEC_HEADER_SIZE + 4 * ((size_t) nbBlocks + 1);
+    // Pire cas d'un bloc : en-tête, échantillons bruts et résidus tous échappés
+    size_t blockMax = 2 + 2 * PCMCODEC_MAX_ORDER + (size_t) PCMCODEC_BLOCK_FRAMES * (PCMCODEC_ESCAPE + 1 + 32) / 8 + 1;
+    size_t capacity = dataStart + blockMax + (size_t) frames * sizeof(short);
+    unsigned char *data = malloc(capacity), *grown;
+    bit_writer_t writer;
+    unsigned int i;
+    int count;
+
+    if(data == NULL) return NULL;
+    memcpy(data, PCMCODEC_MAGIC, 4);
+    put_le(data + 4, PCMCODEC_VERSION, 2);
+    put_le(data + 6, PCMCODEC_MAX_ORDER, 2);
+    put_le(data + 8, SAMPLE_RATE, 4);
+    put_le(data + 12, frames, 8);
+    put_le(data + 20, PCMCODEC_BLOCK_FRAMES, 4);
+    put_le(data + 24, nbBlocks, 4);
+
+    writer.data = data;
+    writer.pos = dataStart;
+    writer.acc = 0;
+    writer.bits = 0;
+    for(i = 0; i < nbBlocks; i++) {
+        // Un bloc compressé peut dépasser sa taille brute (bruit) : on agrandit si besoin
+        if(writer.pos + blockMax > capacity) {
+            capacity = capacity * 2 + blockMax;
+            grown = realloc(data, capacity);
+            if(grown == NULL) {
+                free(data);
+                return NULL;
+            }
+            data = writer.data = grown;
+        }
+        put_le(data + PCMCODEC_HEADER_SIZE + 4 * i, writer.pos - dataStart, 4);
+        count = frames - (long long) i * PCMCODEC_BLOCK_FRAMES < PCMCODEC_BLOCK_FRAMES ? (int) (frames - (long long) i * PCMCODEC_BLOCK_FRAMES) : PCMCODEC_BLOCK_FRAMES;
+        encode_block(&writer, pcm + (size_t) i * PCMCODEC_BLOCK_FRAMES, count);
+    }
+    put_le(data + PCMCODEC_HEADER_SIZE + 4 * nbBlocks, writer.pos - dataStart, 4);
+    *size = writer.pos;
+    return data;
+}
+
+/**
+ * \fn int save_pcm(char *path, short *pcm, long long frames)
+ * \brief Compresse des échantillons dans un fichier
+ * \param path Le chemin du fichier
+ * \param pcm Les échantillons
+ * \param frames Le nombre d'échantillons
+ * \return 0 si succès, -1 sinon
+ */
+int save_pcm(char *path, short *pcm, long long frames) {
+    size_t size;
+    unsigned char *data = encode_pcm(pcm, frames, &size);
+    FILE *file;
+    int ret = 0;
+    if(data == NULL) return -1;
+    file = fopen(path, "wb");
+    if(file == NULL || fwrite(data, 1, size, file) != size) ret = -1;
+    if(file != NULL) fclose(file);
+    free(data);
+    return ret;
+}
+
+/**
+ * \fn int init_pcm_reader(pcm_reader_t *reader, unsigned char *data, size_t size)
+ * \brief Prépare la lecture d'un flux compressé en mémoire
+ * \param reader Le lecteur
+ * \param data Le flux (le lecteur le libère avec end_pcm_reader)
+ * \param size La taille du flux
+ * \return 0 si succès, -1 si le flux n'est pas valide (data n'est alors pas libéré)
+ */
+int init_pcm_reader(pcm_reader_t *reader, unsigned char *data, size_t size) {
+    unsigned int i;
+    memset(reader, 0, sizeof(pcm_reader_t));
+    if(size < PCMCODEC_HEADER_SIZE || memcmp(data, PCMCODEC_MAGIC, 4) != 0) return -1;
+    if(get_le(data + 4, 2) != PCMCODEC_VERSION || get_le(data + 6, 2) > PCMCODEC_MAX_ORDER) return -1;
+    reader->sampleRate = (unsigned int) get_le(data + 8, 4);
+    reader->frames = (long long) get_le(data + 12, 8);
+    reader->blockFrames = (unsigned int) get_le(data + 20, 4);
+    reader->nbBlocks = (unsigned int) get_le(data + 24, 4);
+    reader->dataStart = PCMCODEC_HEADER_SIZE + 4 * ((size_t) reader->nbBlocks + 1);
+    // L'en-tête doit être cohérent avant de faire confiance à la table des blocs
+    if(reader->blockFrames == 0 || reader->frames < 0 || reader->dataStart > size) return -1;
+    if((reader->frames + reader->blockFrames - 1) / reader->blockFrames != reader->nbBlocks) return -1;
+    for(i = 0; i < reader->nbBlocks; i++) {
+        if(get_le(data + PCMCODEC_HEADER_SIZE + 4 * i, 4) > get_le(data + PCMCODEC_HEADER_SIZE + 4 * (i + 1), 4)) return -1;
+    }
+    if(reader->dataStart + get_le(data + PCMCODEC_HEADER_SIZE + 4 * reader->nbBlocks, 4) > size) return -1;
+    reader->block = malloc(sizeof(short) * reader->blockFrames);
+    if(reader->block == NULL) return -1;
+    reader->data = data;
+    reader->size = size;
+    reader->cachedBlock = -1;
+    return 0;
+}
+
+/**
+ * \fn int open_pcm_reader(pcm_reader_t *reader, char *path)
+ * \brief Prépare la lecture d'un fichier compressé
+ * \param reader Le lecteur
+ * \param path Le chemin du fichier
+ * \return 0 si succès, -1 si le fichier est absent ou invalide
+ */
+int open_pcm_reader(pcm_reader_t *reader, char *path) {
+    FILE *file = fopen(path, "rb");
+    unsigned char *data;
+    long size;
+    if(file == NULL) return -1;
+    // Le fichier entier est lu d'un coup : une seule lecture sur la carte SD
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = size > 0 ? malloc(size) : NULL;
+    if(data == NULL || fread(data, 1, size, file) != (size_t) size || init_pcm_reader(reader, data, size) < 0) {
+        free(data);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * \fn long long read_pcm_frames(pcm_reader_t *reader, long long frame, short *buffer, long long count)
+ * \brief Décode des échantillons à partir de n'importe quelle position
+ * \param reader Le lecteur
+ * \param frame La position du premier échantillon
+ * \param buffer Le buffer à remplir
+ * \param count Le nombre d'échantillons demandés
+ * \return Le nombre d'échantillons décodés (moins que count en fin de flux), -1 si un bloc est corrompu
+ * \note Seuls les blocs couvrant la plage demandée sont décodés
+ */
+long long read_pcm_frames(pcm_reader_t *reader, long long frame, short *buffer, long long count) {
+    long long done = 0, index, offset, n;
+    int blockCount;
+    if(frame < 0) return -1;
+    while(done < count && frame + done < reader->frames) {
+        index = (frame + done) / reader->blockFrames;
+        offset = (frame + done) - index * reader->blockFrames;
+        if(index != reader->cachedBlock) {
+            if(decode_block(reader, index) < 0) return -1;
+        }
+        blockCount = reader->frames - index * reader->blockFrames < reader->blockFrames ? (int) (reader->frames - index * reader->blockFrames) : (int) reader->blockFrames;
+        n = blockCount - offset < count - done ? blockCount - offset : count - done;
+        memcpy(buffer + done, reader->block + offset, sizeof(short) * n);
+        done += n;
+    }
+    return done;
+}
+
+/**
+ * \fn void end_pcm_reader(pcm_reader_t *reader)
+ * \brief Libère le lecteur et son flux
+ * \param reader Le lecteur
+ */
+void end_pcm_reader(pcm_reader_t *reader) {
+    free(reader->data);
+    free(reader->block);
+    reader->data = NULL;
+    reader->block = NULL;
+}
+
+/**
+ * \fn short *load_pcm(char *path, long long *frames)
+ * \brief Décode un fichier compressé en entier
+ * \param path Le chemin du fichier
+ * \param frames Le nombre d'échantillons décodés
+ * \return Les échantillons (à libérer) ou NULL si le fichier est absent ou invalide
+ */
+short *load_pcm(char *path, long long *frames) {
+    pcm_reader_t reader;
+    short *pcm;
+    if(open_pcm_reader(&reader, path) < 0) return NULL;
+    pcm = malloc(sizeof(short) * (reader.frames > 0 ? reader.frames : 1));
+    if(pcm != NULL && read_pcm_frames(&reader, 0, pcm, reader.frames) != reader.frames) {
+        free(pcm);
+        pcm = NULL;
+    }
+    *frames = reader.frames;
+    end_pcm_reader(&reader);
+    return pcm;
+}
@@ -0,0 +1,49 @@
+/**
+ * \file piaudiod.c
+ * \brief Démon audio : garde le flux ALSA ouvert et exécute les commandes du séquenceur
+ * \details À lancer avant pimusiic. Le séquenceur détecte le démon au démarrage et, s'il ne
+ * tourne pas, ouvre le moteur audio dans son propre processus.
+ */
+#include "audiod.h"
+#include "wiringseq.h"
+
+audiod_shm_t *shm = NULL; /*!< Mémoire partagée avec le séquenceur */
+audiod_output_t output; /*!< Moteur audio et moteur pas à pas */
+volatile sig_atomic_t running = 1; /*!< Le démon tourne */
+
+/**
+ * \fn void stop_daemon(int signalNumber)
+ * \brief Demande l'arrêt du démon
+ * \param signalNumber Le signal reçu
+ */
+void stop_daemon(int signalNumber) {
+    running = 0;
+}
+
+int main() {
+    install_signal_handler(SIGINT, stop_daemon, 0);
+    install_signal_handler(SIGTERM, stop_daemon, 0);
+    init_wiringpi();
+    // Même dossier et même ordre que le séquenceur : les numéros d'instruments correspondent
+    if(load_plugins(PLUGIN_DIR, SAMPLE_RATE, BASE_AMPLITUDE) > 0) fprintf(stderr, "[PIAUDIOD] %d plugin(s) chargé(s)\n", nb_plugins());
+
+    shm = create_audiod_shm();
+    if(init_audiod_output(&output, &(shm->stats)) < 0) {
+        fprintf(stderr, "[PIAUDIOD] Impossible d'ouvrir le flux audio\n");
+        destroy_audiod_shm(shm);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "[PIAUDIOD] Démon audio prêt (%s)\n", AUDIOD_SHM_NAME);
+
+    while(running) {
+        audiod_serve(shm, &(output.engine));
+        usleep(AUDIOD_POLL_TIME);
+    }
+
+    fprintf(stderr, "[PIAUDIOD] Fermeture du démon audio\n");
+    // La signature est effacée avant de fermer le flux : les clients repassent en local
+    destroy_audiod_shm(shm);
+    end_audiod_output(&output);
+    unload_plugins();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,649 @@
+/**
+ * \file pibench.c
+ * \brief Banc de mesure du coût des instruments et des effets
+ * \details Chaque instrument est calculé sur plusieurs octaves et durées, puis les effets,
+ * play_sample, les conversions de notes, le format compressé pcmcodec, les conversions de
+ * fréquence, les niveaux de qualité du régulateur de charge et le stockage des notes sont mesurés. Les résultats sont affichés et ajoutés
+ * au fichier donné en argument (BENCH_FILE par défaut) au format <clé>=<valeur>, comme les
+ * statistiques audio : les fichiers de la carte et du PC peuvent être comparés ligne à ligne.
+ * Les allocations sont comptées en enveloppant malloc, calloc et realloc à l'édition de liens
+ * (-Wl,--wrap, voir la règle bench du makefile).
+ */
+#include <sys/utsname.h>
+#include "sound.h"
+#include "audiostats.h"
+#include "pcmcodec.h"
+#include "resample.h"
+#include "engine.h"
+
+#define BENCH_FILE "ressources/bench.log" /*!< Fichier dans lequel les résultats sont ajoutés */
+#define BENCH_BPM 120 /*!< Tempo utilisé pour la durée des notes */
+#define BENCH_MUSIC_NOTES 4096 /*!< Nombre de lignes remplies du channel mesuré */
+#define BENCH_SPARSE_STEP 64 /*!< Écart entre deux notes du channel creux */
+#define BENCH_PATTERNS 4 /*!< Nombre de patterns de la musique en boucle */
+#define BENCH_PATTERN_REPEATS 4 /*!< Nombre de fois que la musique en boucle joue ses patterns */
+#define BENCH_MIN_NS 20000000LL /*!< Durée minimale de mesure d'un cas (20 ms) */
+#define BENCH_CALLS 1000000 /*!< Nombre d'appels pour les conversions de notes */
+#define BENCH_SAMPLE_CALLS 20 /*!< Nombre d'appels de play_sample */
+#define BENCH_NOTE_ID 9 /*!< Note jouée (la) */
+#define BENCH_NB_OCTAVES 5 /*!< Nombre d'octaves mesurées */
+#define BENCH_NB_TIMES 5 /*!< Nombre de durées mesurées */
+#define BENCH_CODEC_SECONDS 10 /*!< Durée du signal compressé par pcmcodec */
+#define BENCH_SEEK_FRAMES 256 /*!< Nombre d'échantillons lus à chaque accès direct */
+#define BENCH_RESAMPLE_RATE 44100 /*!< Autre fréquence des conversions mesurées */
+#define BENCH_RESAMPLE_LOW 997.0 /*!< Fréquence de la sinusoïde de mesure du bruit de conversion */
+#define BENCH_RESAMPLE_HIGH 15000.0 /*!< Fréquence aiguë (repliement de l'interpolation linéaire) */
+
+static const short benchOctaves[BENCH_NB_OCTAVES] = {0, 2, 4, 6, 8}; /*!< Octaves mesurées */
+static const time_duration_t benchTimes[BENCH_NB_TIMES] = {TIME_CROCHE_DOUBLE, TIME_CROCHE, TIME_NOIRE, TIME_BLANCHE, TIME_RONDE}; /*!< Durées mesurées */
+
+static unsigned long allocations = 0; /*!< Nombre d'allocations depuis le début du programme */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+/**
+ * \fn void *__wrap_malloc(size_t size)
+ * \brief Compte les appels à malloc
+ */
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+/**
+ * \fn void *__wrap_calloc(size_t nmemb, size_t size)
+ * \brief Compte les appels à calloc
+ */
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    allocations++;
+    return __real_calloc(nmemb, size);
+}
+
+/**
+ * \fn void *__wrap_realloc(void *ptr, size_t size)
+ * \brief Compte les appels à realloc
+ */
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+/**
+ * \fn void bench_report(FILE *file, const char *name, long long ns, long long samples, long long calls, unsigned long allocs)
+ * \brief Affiche et enregistre le résultat d'un cas
+ * \param file Le fichier de résultats (peut être NULL)
+ * \param name Le nom du cas
+ * \param ns Le temps total mesuré
+ * \param samples Le nombre d'échantillons calculés (0 si le cas ne calcule pas d'échantillons)
+ * \param calls Le nombre d'appels
+ * \param allocs Le nombre d'allocations pendant la mesure
+ */
+void bench_report(FILE *file, const char *name, long long ns, long long samples, long long calls, unsigned long allocs) {
+    double allocsPerCall = (double) allocs / calls;
+    if(samples > 0) {
+        // Facteur temps réel : secondes de son calculées par seconde de calcul
+        double nsPerSample = (double) ns / samples;
+        double rtf = ns > 0 ? (double) samples * NSEC_PER_SEC / SAMPLE_RATE / ns : 0;
+        printf("%-24s %10.2f ns/sample %10.1f x temps réel %8.2f alloc/appel\n", name, nsPerSample, rtf, allocsPerCall);
+        if(file == NULL) return;
+        fprintf(file, "%s.ns_per_sample=%.3f\n", name, nsPerSample);
+        fprintf(file, "%s.rtf=%.3f\n", name, rtf);
+    }
+    else {
+        printf("%-24s %10.2f ns/appel %23s %8.2f alloc/appel\n", name, (double) ns / calls, "", allocsPerCall);
+        if(file == NULL) return;
+        fprintf(file, "%s.ns_per_call=%.3f\n", name, (double) ns / calls);
+    }
+    fprintf(file, "%s.allocs_per_call=%.3f\n", name, allocsPerCall);
+}
+
+/**
+ * \fn void bench_instruments(FILE *file, short *buffer, scale_t *scale)
+ * \brief Mesure chaque instrument sur plusieurs octaves et durées
+ * \param file Le fichier de résultats
+ * \param buffer Un buffer d'au moins une ronde
+ * \param scale La gamme
+ */
+void bench_instruments(FILE *file, short *buffer, scale_t *scale) {
+    char instrument[5], name[32];
+    int i, o, t;
+    long long start, ns, calls;
+    unsigned long allocs;
+    size_t frames;
+    note_t note;
+
+    // Les plugins de PLUGIN_DIR sont mesurés comme les instruments internes
+    for(i = INSTRUMENT_NA; i < nb_instruments(); i++) {
+        if(i == INSTRUMENT_NA) strcpy(instrument, "NA");
+        else {
+            instrument2str(i, instrument);
+            instrument[strcspn(instrument, " ")] = '\0';
+        }
+        for(o = 0; o < BENCH_NB_OCTAVES; o++) {
+            for(t = 0; t < BENCH_NB_TIMES; t++) {
+                note = create_note(BENCH_NOTE_ID, scale->freqScale[BENCH_NOTE_ID], benchOctaves[o], i, benchTimes[t]);
+                frames = noteToTime(note, BENCH_BPM);
+                calls = 0;
+                allocs = allocations;
+                start = audio_clock_ns();
+                // Une note entière par appel, comme play_note, jusqu'à avoir une mesure stable
+                do {
+                    render_note(buffer, note, 0, frames, 0);
+                    calls++;
+                    ns = audio_clock_ns() - start;
+                } while(ns < BENCH_MIN_NS);
+                sprintf(name, "%s.o%d.t%d", instrument, benchOctaves[o], benchTimes[t]);
+                bench_report(file, name, ns, calls * frames, calls, allocations - allocs);
+            }
+        }
+    }
+}
+
+/**
+ * \fn void bench_effects(FILE *file, short *buffer, scale_t *scale)
+ * \brief Mesure fuzz_effect et compression_effect sur une ronde
+ * \param file Le fichier de résultats
+ * \param buffer Un buffer d'au moins une ronde
+ * \param scale La gamme
+ */
+void bench_effects(FILE *file, short *buffer, scale_t *scale) {
+    note_t note = create_note(BENCH_NOTE_ID, scale->freqScale[BENCH_NOTE_ID], 4, INSTRUMENT_SIN, TIME_RONDE);
+    size_t frames = noteToTime(note, BENCH_BPM);
+    long long start, ns, calls;
+    unsigned long allocs;
+    int effect;
+
+    for(effect = 1; effect <= 2; effect++) {
+        calls = 0;
+        ns = 0;
+        allocs = allocations;
+        do {
+            // Le signal est recalculé hors mesure : l'effet s'applique toujours sur une sinusoïde
+            render_note(buffer, note, 0, frames, 0);
+            start = audio_clock_ns();
+            if(effect == 1) fuzz_effect(buffer, frames);
+            else compression_effect(buffer, frames);
+            ns += audio_clock_ns() - start;
+            calls++;
+        } while(ns < BENCH_MIN_NS);
+        bench_report(file, effect == 1 ? "fuzz_effect" : "compression_effect", ns, calls * frames, calls, allocations - allocs);
+    }
+}
+
+/**
+ * \fn void bench_conversions(FILE *file, scale_t *scale)
+ * \brief Mesure noteToFreq et noteToTime sur toutes les octaves et durées
+ * \param file Le fichier de résultats
+ * \param scale La gamme
+ */
+void bench_conversions(FILE *file, scale_t *scale) {
+    volatile double freq = 0;
+    volatile size_t frames = 0;
+    note_t notes[BENCH_NB_OCTAVES * BENCH_NB_TIMES];
+    int nbNotes = BENCH_NB_OCTAVES * BENCH_NB_TIMES;
+    long long start;
+    unsigned long allocs;
+    int i;
+
+    for(i = 0; i < nbNotes; i++) {
+        notes[i] = create_note(i % NB_NOTES, scale->freqScale[i % NB_NOTES], benchOctaves[i % BENCH_NB_OCTAVES], INSTRUMENT_SIN, benchTimes[i / BENCH_NB_OCTAVES]);
+    }
+    allocs = allocations;
+    start = audio_clock_ns();
+    for(i = 0; i < BENCH_CALLS; i++) freq += noteToFreq(notes[i % nbNotes]);
+    bench_report(file, "noteToFreq", audio_clock_ns() - start, 0, BENCH_CALLS, allocations - allocs);
+
+    allocs = allocations;
+    start = audio_clock_ns();
+    for(i = 0; i < BENCH_CALLS; i++) frames += noteToTime(notes[i % nbNotes], BENCH_BPM);
+    bench_report(file, "noteToTime", audio_clock_ns() - start, 0, BENCH_CALLS, allocations - allocs);
+}
+
+/**
+ * \fn void bench_music(FILE *file, scale_t *scale)
+ * \brief Mesure la taille d'une musique, le parcours des notes d'un channel plein et d'un channel creux
+ * et le rendu d'une musique qui répète ses patterns
+ * \param file Le fichier de résultats
+ * \param scale La gamme
+ */
+void bench_music(FILE *file, scale_t *scale) {
+    static music_t music;
+    channel_t *channel = &music.channels[0];
+    volatile long long sum = 0;
+    long long start, ns, calls;
+    unsigned long allocs;
+    long long frames;
+    note_t note;
+    int i;
+
+    init_music(&music, BENCH_BPM);
+    for(i = 0; i < BENCH_MUSIC_NOTES; i++) {
+        set_channel_note(channel, i, create_note(1 + i % (NB_NOTES - 1), scale->freqScale[1 + i % (NB_NOTES - 1)], benchOctaves[i % BENCH_NB_OCTAVES], INSTRUMENT_SIN, benchTimes[i % BENCH_NB_TIMES]));
+        update_channel_nbNotes(channel, i);
+    }
+    build_channel_index(channel);
+    printf("%-24s %10lu octets (%lu par channel, %lu par note)\n", "music_t", (unsigned long) sizeof(music_t), (unsigned long) sizeof(channel_t), (unsigned long) sizeof(packed_note_t));
+    // Les lignes sont dans des blocs alloués à la première écriture, listés par une table
+    // allouée à la première note du channel : un channel vide ne coûte que channel_t
+    printf("%-24s %10lu octets (par channel non vide)\n", "chunk_table_t", (unsigned long) sizeof(chunk_table_t));
+    printf("%-24s %10lu octets (%d lignes)\n", "note_chunk_t", (unsigned long) (sizeof(note_chunk_t) * (BENCH_MUSIC_NOTES / CHANNEL_CHUNK_NOTES)), BENCH_MUSIC_NOTES);
+    if(file != NULL) {
+        fprintf(file, "music.bytes=%lu\n", (unsigned long) sizeof(music_t));
+        fprintf(file, "channel.bytes=%lu\n", (unsigned long) sizeof(channel_t));
+        fprintf(file, "table.bytes=%lu\n", (unsigned long) sizeof(chunk_table_t));
+        fprintf(file, "chunks.bytes=%lu\n", (unsigned long) (sizeof(note_chunk_t) * (BENCH_MUSIC_NOTES / CHANNEL_CHUNK_NOTES)));
+    }
+
+    // Recherche de la ligne jouée (lecture, parcours par le séquenceur)
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        sum += channel_tick2line(channel, channel_line2tick(channel, (int) (calls * 997 % BENCH_MUSIC_NOTES)));
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "channel_tick2line", ns, 0, calls, allocations - allocs);
+
+    // Parcours des durées seules (index, recherche de la note jouée)
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        build_channel_index(channel);
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "build_channel_index", ns, 0, calls, allocations - allocs);
+
+    // Parcours de toutes les notes complètes (rendu, sérialisation)
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        for(i = 0; i < channel->nbNotes; i++) {
+            note = channel_note(channel, i);
+            sum += note.id + note.octave + note.instrument + note.time;
+        }
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "channel_note.scan", ns, 0, calls, allocations - allocs);
+
+    // Channel creux sur toutes les lignes : une note toutes les BENCH_SPARSE_STEP lignes
+    channel = &music.channels[1];
+    for(i = 0; i < CHANNEL_MAX_NOTES; i += BENCH_SPARSE_STEP) {
+        set_channel_note(channel, i, create_note(BENCH_NOTE_ID, scale->freqScale[BENCH_NOTE_ID], REF_OCTAVE, INSTRUMENT_SIN, TIME_NOIRE));
+    }
+    update_channel_nbNotes(channel, CHANNEL_MAX_NOTES - BENCH_SPARSE_STEP);
+    build_channel_index(channel);
+
+    // Parcours des seules notes par la table d'occupation
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        for(i = channel_next_note(channel, 0); i >= 0; i = channel_next_note(channel, i + 1)) sum += i;
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "channel_next_note.sparse", ns, 0, calls, allocations - allocs);
+
+    // Effacement puis remise de la dernière note : nbNotes recule jusqu'à la note précédente
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        note = channel_note(channel, CHANNEL_MAX_NOTES - BENCH_SPARSE_STEP);
+        set_channel_note(channel, CHANNEL_MAX_NOTES - BENCH_SPARSE_STEP, create_note(NOTE_NA_ID, 0, REF_OCTAVE, INSTRUMENT_NA, TIME_NOIRE));
+        update_channel_nbNotes(channel, CHANNEL_MAX_NOTES - BENCH_SPARSE_STEP);
+        set_channel_note(channel, CHANNEL_MAX_NOTES - BENCH_SPARSE_STEP, note);
+        update_channel_nbNotes(channel, CHANNEL_MAX_NOTES - BENCH_SPARSE_STEP);
+        sum += channel->nbNotes;
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "update_channel_nbNotes", ns, 0, calls, allocations - allocs);
+
+    // Instantané (lecture, démon) : la structure est copiée, les tables de blocs sont partagées
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        release_music(music_snapshot(&music));
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "music_snapshot", ns, 0, calls, allocations - allocs);
+
+    // Insertion puis suppression d'une ligne en tête : toutes les lignes du channel sont décalées
+    // colonne par colonne, nbNotes et l'index ne sont recalculés qu'une fois par opération
+    channel = &music.channels[0];
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        insert_channel_lines(channel, 0, 1);
+        delete_channel_lines(channel, 0, 1);
+        sum += channel->nbNotes;
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "insert_delete_lines", ns, 0, calls, allocations - allocs);
+
+    // Transposition aller-retour de tout le channel
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        transpose_channel_lines(channel, 0, BENCH_MUSIC_NOTES, 1);
+        transpose_channel_lines(channel, 0, BENCH_MUSIC_NOTES, -1);
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "transpose_lines", ns, 0, calls, allocations - allocs);
+    free_music(&music);
+
+    // Musique en boucle : BENCH_PATTERNS patterns joués BENCH_PATTERN_REPEATS fois. Chaque
+    // pattern n'est calculé qu'une fois par rendu
+    init_music(&music, BENCH_BPM);
+    channel = &music.channels[0];
+    for(i = 0; i < BENCH_PATTERNS * BENCH_PATTERN_REPEATS * PATTERN_LINES; i++) {
+        int line = i % PATTERN_LINES, pattern = i / PATTERN_LINES % BENCH_PATTERNS;
+        set_channel_note(channel, i, create_note(1 + (line + pattern) % (NB_NOTES - 1), 0, benchOctaves[line % BENCH_NB_OCTAVES], 1 + pattern, TIME_CROCHE_DOUBLE));
+    }
+    update_channel_nbNotes(channel, i - 1);
+    build_channel_index(channel);
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        free(render_music(&music, 0, music_end_tick(&music), &frames));
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "render_music.patterns", ns, frames * calls, calls, allocations - allocs);
+    free_music(&music);
+}
+
+/**
+ * \fn void bench_play_sample(FILE *file, short *buffer, scale_t *scale)
+ * \brief Mesure play_sample (lecture du fichier et écriture dans le flux)
+ * \param file Le fichier de résultats
+ * \param buffer Un buffer d'au moins une seconde
+ * \param scale La gamme
+ * \note Le flux est non bloquant et vidé entre deux appels : seul le coût CPU est mesuré.
+ * Sans carte son, le cas est marqué skipped.
+ */
+void bench_play_sample(FILE *file, short *buffer, scale_t *scale) {
+    char path[] = "/tmp/pibench-XXXXXX";
+    note_t note = create_note(BENCH_NOTE_ID, scale->freqScale[BENCH_NOTE_ID], 4, INSTRUMENT_SIN, TIME_RONDE);
+    snd_pcm_t *pcm = NULL;
+    long long start, ns = 0;
+    unsigned long allocs;
+    FILE *sample;
+    int i, fd;
+
+    if(init_sound_period(&pcm, SOUND_PERIOD_FRAMES, 10) < 0 || (fd = mkstemp(path)) < 0) {
+        printf("%-24s skipped (pas de flux audio)\n", "play_sample");
+        if(file != NULL) fprintf(file, "play_sample.skipped=1\n");
+        if(pcm != NULL) end_sound(pcm);
+        return;
+    }
+    // Une seconde de sinusoïde au format attendu par play_sample
+    render_note(buffer, note, 0, SAMPLE_RATE, 0);
+    sample = fdopen(fd, "wb");
+    fwrite(buffer, sizeof(short), SAMPLE_RATE, sample);
+    fclose(sample);
+
+    snd_pcm_nonblock(pcm, 1);
+    allocs = allocations;
+    for(i = 0; i < BENCH_SAMPLE_CALLS; i++) {
+        start = audio_clock_ns();
+        play_sample(path, pcm);
+        ns += audio_clock_ns() - start;
+        snd_pcm_drop(pcm);
+        snd_pcm_prepare(pcm);
+    }
+    bench_report(file, "play_sample", ns, 0, BENCH_SAMPLE_CALLS, allocations - allocs);
+    unlink(path);
+    snd_pcm_close(pcm);
+}
+
+/**
+ * \fn void bench_codec(FILE *file, scale_t *scale)
+ * \brief Mesure le taux de compression et la vitesse de pcmcodec
+ * \details Le signal enchaîne des noires de chaque instrument sur plusieurs octaves, comme une
+ * musique rendue. Le décodage complet et la lecture à des positions aléatoires sont mesurés.
+ * \param file Le fichier de résultats
+ * \param scale La gamme
+ */
+void bench_codec(FILE *file, scale_t *scale) {
+    long long frames = (long long) BENCH_CODEC_SECONDS * SAMPLE_RATE, pos, length, decoded;
+    long long start, ns, calls;
+    unsigned long allocs;
+    short *pcm, *decodedPcm;
+    unsigned char *data = NULL;
+    size_t size = 0;
+    pcm_reader_t reader;
+    note_t note;
+    int i = 0;
+
+    pcm = malloc(sizeof(short) * frames);
+    decodedPcm = malloc(sizeof(short) * frames);
+    if(pcm == NULL || decodedPcm == NULL) {
+        free(pcm);
+        free(decodedPcm);
+        return;
+    }
+    for(pos = 0; pos < frames; pos += length, i++) {
+        note = create_note(1 + i % (NB_NOTES - 1), scale->freqScale[1 + i % (NB_NOTES - 1)], benchOctaves[i % BENCH_NB_OCTAVES], INSTRUMENT_NA + 1 + i % (INSTRUMENT_NB - INSTRUMENT_NA - 1), TIME_NOIRE);
+        length = noteToTime(note, BENCH_BPM);
+        if(length > frames - pos) length = frames - pos;
+        render_note(pcm + pos, note, 0, length, 0);
+    }
+
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        free(data);
+        data = encode_pcm(pcm, frames, &size);
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(data != NULL && ns < BENCH_MIN_NS);
+    if(data == NULL || init_pcm_reader(&reader, data, size) < 0) {
+        free(data);
+        free(pcm);
+        free(decodedPcm);
+        return;
+    }
+    bench_report(file, "pcmcodec.encode", ns, calls * frames, calls, allocations - allocs);
+    printf("%-24s %10.3f\n", "pcmcodec.ratio", (double) frames * sizeof(short) / size);
+    if(file != NULL) fprintf(file, "pcmcodec.ratio=%.3f\n", (double) frames * sizeof(short) / size);
+
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        decoded = read_pcm_frames(&reader, 0, decodedPcm, frames);
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "pcmcodec.decode", ns, calls * frames, calls, allocations - allocs);
+    if(decoded != frames || memcmp(pcm, decodedPcm, sizeof(short) * frames) != 0) fprintf(stderr, "[PIBENCH] pcmcodec : le décodage diffère du signal\n");
+
+    // Accès direct : chaque lecture tombe en général dans un autre bloc
+    srand(1);
+    calls = 0;
+    allocs = allocations;
+    start = audio_clock_ns();
+    do {
+        read_pcm_frames(&reader, rand() % (frames - BENCH_SEEK_FRAMES), decodedPcm, BENCH_SEEK_FRAMES);
+        calls++;
+        ns = audio_clock_ns() - start;
+    } while(ns < BENCH_MIN_NS);
+    bench_report(file, "pcmcodec.seek", ns, 0, calls, allocations - allocs);
+
+    end_pcm_reader(&reader);
+    free(pcm);
+    free(decodedPcm);
+}
+
+/**
+ * \fn double bench_resample_snr(unsigned int inRate, unsigned int outRate, resample_quality_t quality, double freq)
+ * \brief Rapport signal sur bruit de la conversion d'une sinusoïde
+ * \param inRate La fréquence d'entrée
+ * \param outRate La fréquence de sortie
+ * \param quality La qualité de conversion
+ * \param freq La fréquence de la sinusoïde
+ * \return Le rapport en dB entre la sinusoïde exacte à outRate et l'erreur de conversion
+ */
+double bench_resample_snr(unsigned int inRate, unsigned int outRate, resample_quality_t quality, double freq) {
+    short *in, *out;
+    size_t i, frames;
+    double signal = 0, noise = 0, exact;
+
+    in = malloc(sizeof(short) * inRate);
+    if(in == NULL) return 0;
+    for(i = 0; i < inRate; i++) in[i] = (short) lrint(BASE_AMPLITUDE * sin(2 * M_PI * freq * i / inRate));
+    out = resample_buffer(in, inRate, inRate, outRate, quality, &frames);
+    free(in);
+    if(out == NULL) return 0;
+    // Les bords (silence avant et après le signal) sont exclus
+    for(i = frames / 10; i < frames - frames / 10; i++) {
+        exact = BASE_AMPLITUDE * sin(2 * M_PI * freq * i / outRate);
+        signal += exact * exact;
+        noise += (out[i] - exact) * (out[i] - exact);
+    }
+    free(out);
+    return noise > 0 ? 10 * log10(signal / noise) : HUGE_VAL;
+}
+
+/**
+ * \fn void bench_resample(FILE *file)
+ * \brief Mesure le coût et la fidélité de chaque qualité de conversion de fréquence
+ * \details Les deux sens sont mesurés entre SAMPLE_RATE et BENCH_RESAMPLE_RATE, période par
+ * période comme en sortie du moteur. Les échantillons sont comptés du côté SAMPLE_RATE.
+ * \param file Le fichier de résultats
+ */
+void bench_resample(FILE *file) {
+    unsigned int rates[2][2] = {{BENCH_RESAMPLE_RATE, SAMPLE_RATE}, {SAMPLE_RATE, BENCH_RESAMPLE_RATE}};
+    short in[ENGINE_PERIOD_FRAMES * 2], *out;
+    long long start, ns, calls;
+    unsigned long allocs;
+    resampler_t resampler;
+    size_t i, periodFrames, produced;
+    char name[48];
+    double snr;
+    int q, r;
+
+    for(q = RESAMPLE_LINEAR; q < RESAMPLE_NB_QUALITIES; q++) {
+        for(r = 0; r < 2; r++) {
+            if(init_resampler(&resampler, rates[r][0], rates[r][1], q) < 0) continue;
+            // Une période du moteur (5 ms) à la fréquence d'entrée
+            periodFrames = (size_t) ENGINE_PERIOD_FRAMES * rates[r][0] / SAMPLE_RATE;
+            for(i = 0; i < periodFrames; i++) in[i] = (short) (BASE_AMPLITUDE * sin(2 * M_PI * BENCH_RESAMPLE_LOW * i / rates[r][0]));
+            out = malloc(sizeof(short) * resample_max_frames(&resampler, periodFrames));
+            if(out == NULL) {
+                end_resampler(&resampler);
+                continue;
+            }
+            calls = 0;
+            produced = 0;
+            allocs = allocations;
+            start = audio_clock_ns();
+            do {
+                produced += resample(&resampler, in, periodFrames, out);
+                calls++;
+                ns = audio_clock_ns() - start;
+            } while(ns < BENCH_MIN_NS);
+            sprintf(name, "resample.%s.%u_%u", resample_quality_name(q), rates[r][0], rates[r][1]);
+            bench_report(file, name, ns, rates[r][0] == SAMPLE_RATE ? calls * periodFrames : (long long) produced, calls, allocations - allocs);
+            free(out);
+            end_resampler(&resampler);
+
+            snr = bench_resample_snr(rates[r][0], rates[r][1], q, BENCH_RESAMPLE_LOW);
+            printf("%-24s %10.1f dB à %.0f Hz", "", snr, BENCH_RESAMPLE_LOW);
+            if(file != NULL) fprintf(file, "%s.snr_db=%.1f\n", name, snr);
+            snr = bench_resample_snr(rates[r][0], rates[r][1], q, BENCH_RESAMPLE_HIGH);
+            printf(", %.1f dB à %.0f Hz\n", snr, BENCH_RESAMPLE_HIGH);
+            if(file != NULL) fprintf(file, "%s.snr_hf_db=%.1f\n", name, snr);
+        }
+    }
+}
+
+/**
+ * \fn void bench_quality(FILE *file, short *buffer, scale_t *scale)
+ * \brief Mesure les instruments additifs (avec fuzz) à chaque niveau de qualité du régulateur
+ * \param file Le fichier de résultats
+ * \param buffer Un buffer d'au moins une ronde
+ * \param scale La gamme
+ */
+void bench_quality(FILE *file, short *buffer, scale_t *scale) {
+    int instruments[] = {INSTRUMENT_ORGAN, INSTRUMENT_PIANO, INSTRUMENT_SAWTOOTH};
+    char instrument[5], name[48];
+    long long start, ns, calls;
+    unsigned long allocs;
+    size_t frames;
+    note_t note;
+    int i, q;
+
+    for(q = SOUND_QUALITY_FULL; q < SOUND_NB_QUALITIES; q++) {
+        for(i = 0; i < 3; i++) {
+            note = create_note(BENCH_NOTE_ID, scale->freqScale[BENCH_NOTE_ID], 4, instruments[i], TIME_NOIRE);
+            frames = noteToTime(note, BENCH_BPM);
+            instrument2str(instruments[i], instrument);
+            instrument[strcspn(instrument, " ")] = '\0';
+            calls = 0;
+            allocs = allocations;
+            start = audio_clock_ns();
+            do {
+                render_note_quality(buffer, note, 0, frames, 1, q);
+                calls++;
+                ns = audio_clock_ns() - start;
+            } while(ns < BENCH_MIN_NS);
+            sprintf(name, "quality.%s.%s", sound_quality_name(q), instrument);
+            bench_report(file, name, ns, calls * frames, calls, allocations - allocs);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    char *path = argc > 1 ? argv[1] : BENCH_FILE;
+    scale_t scale = init_scale();
+    struct utsname host;
+    short *buffer;
+    FILE *file;
+    size_t frames = noteToTime(create_note(0, 0, 0, INSTRUMENT_SIN, TIME_RONDE), BENCH_BPM);
+
+    buffer = malloc(sizeof(short) * (frames > SAMPLE_RATE ? frames : SAMPLE_RATE));
+    if(buffer == NULL) return EXIT_FAILURE;
+    file = fopen(path, "a");
+    if(file == NULL) fprintf(stderr, "[PIBENCH] Impossible d'ouvrir %s, résultats affichés uniquement\n", path);
+    else {
+        uname(&host);
+        fprintf(file, "# %ld\n", (long) time(NULL));
+        fprintf(file, "arch=%s\n", host.machine);
+        fprintf(file, "host=%s\n", host.nodename);
+        fprintf(file, "sample_rate=%d\n", SAMPLE_RATE);
+        fprintf(file, "bpm=%d\n", BENCH_BPM);
+    }
+
+    load_plugins(PLUGIN_DIR, SAMPLE_RATE, BASE_AMPLITUDE);
+    bench_instruments(file, buffer, &scale);
+    bench_effects(file, buffer, &scale);
+    bench_conversions(file, &scale);
+    bench_music(file, &scale);
+    bench_play_sample(file, buffer, &scale);
+    bench_codec(file, &scale);
+    bench_resample(file);
+    bench_quality(file, buffer, &scale);
+
+    if(file != NULL) fclose(file);
+    free(buffer);
+    unload_plugins();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+/**
+ * \file pigolden.c
+ * \brief Non-régression du rendu : compare le rendu des musiques de référence aux fichiers golden
+ * \details Chaque musique <nom>.mipi du corpus est calculée hors ligne (render_music). Le PCM
+ * obtenu est comparé à <nom>.pimc (compressé sans perte, cf. pcmcodec.h) : l'égalité exacte est vérifiée par une empreinte FNV-1a, sinon
+ * le rapport signal sur bruit doit dépasser un seuil (les libm de la carte et du PC ne donnent
+ * pas exactement les mêmes échantillons). Le temps de calcul doit rester sous un budget exprimé
+ * en millièmes de la durée de la musique, et ne doit pas régresser de plus d'un pourcentage
+ * donné par rapport au temps enregistré dans <nom>.golden sur la même architecture.
+ *
+ * En rendu déterministe (-d, voir detmath.h), les fichiers sont <nom>.det.golden et <nom>.det.pimc
+ * et le PCM doit être identique au bit près sur toutes les machines : aucun seuil de SNR.
+ *
+ * Utilisation : pigolden [-u] [-d] [-b budget] [-s snr] [-r regression] [dossier]
+ *  - -u : enregistre les fichiers golden au lieu de les vérifier
+ *  - -d : rendu déterministe
+ *  - -b : budget en millièmes de la durée de la musique (GOLDEN_BUDGET par défaut)
+ *  - -s : rapport signal sur bruit minimal en dB (GOLDEN_SNR par défaut)
+ *  - -r : régression maximale du temps de calcul en pourcents (0 pour ne pas la vérifier)
+ */
+#include <dirent.h>
+#include <sys/utsname.h>
+#include "mpp.h"
+#include "render.h"
+#include "audiostats.h"
+#include "pcmcodec.h"
+#include "detmath.h"
+
+#define GOLDEN_DIR "ressources/golden" /*!< Dossier du corpus de référence */
+#define GOLDEN_BUDGET 250 /*!< Temps de calcul maximal en millièmes de la durée de la musique */
+#define GOLDEN_SNR 90.0 /*!< Rapport signal sur bruit minimal en dB quand le rendu n'est pas identique */
+#define GOLDEN_REGRESSION 0 /*!< Régression maximale du temps de calcul en pourcents (0 : non vérifiée) */
+#define GOLDEN_RUNS 3 /*!< Nombre de rendus : le meilleur temps est retenu */
+#define GOLDEN_DET_SUFFIX ".det" /*!< Suffixe des fichiers golden du rendu déterministe */
+#define GOLDEN_PATH_LENGTH 512 /*!< Longueur maximale d'un chemin */
+
+/**
+ * \struct golden_t
+ * \brief Résultat de référence d'une musique (<nom>.golden)
+ */
+typedef struct {
+    long long frames; /*!< Nombre d'échantillons */
+    unsigned long long hash; /*!< Empreinte FNV-1a des échantillons */
+    long long renderNs; /*!< Temps de calcul enregistré */
+    char arch[65]; /*!< Architecture sur laquelle le temps a été enregistré */
+} golden_t;
+
+/**
+ * \fn double golden_snr(short *buffer, short *reference, long long frames)
+ * \brief Rapport signal sur bruit du rendu par rapport à la référence
+ * \param buffer Le rendu
+ * \param reference La référence
+ * \param frames Le nombre d'échantillons
+ * \return Le rapport en dB (HUGE_VAL si identiques)
+ */
+double golden_snr(short *buffer, short *reference, long long frames) {
+    double signal = 0, noise = 0, diff;
+    long long i;
+    for(i = 0; i < frames; i++) {
+        signal += (double) reference[i] * reference[i];
+        diff = (double) buffer[i] - reference[i];
+        noise += diff * diff;
+    }
+    if(noise == 0) return HUGE_VAL;
+    // Une référence silencieuse ne tolère aucune différence
+    if(signal == 0) return -HUGE_VAL;
+    return 10.0 * log10(signal / noise);
+}
+
+/**
+ * \fn short *golden_render(music_t *music, long long *frames, long long *renderNs)
+ * \brief Calcule la musique entière et mesure le meilleur temps de calcul
+ * \param music La musique
+ * \param frames Le nombre d'échantillons calculés
+ * \param renderNs Le meilleur temps sur GOLDEN_RUNS rendus
+ * \return Le rendu (à libérer) ou NULL
+ */
+short *golden_render(music_t *music, long long *frames, long long *renderNs) {
+    long long end = music_end_tick(music), start, ns;
+    short *buffer = NULL;
+    int i;
+    *renderNs = -1;
+    for(i = 0; i < GOLDEN_RUNS; i++) {
+        free(buffer);
+        start = audio_clock_ns();
+        buffer = render_music(music, 0, end, frames);
+        ns = audio_clock_ns() - start;
+        if(buffer == NULL) return NULL;
+        if(*renderNs < 0 || ns < *renderNs) *renderNs = ns;
+    }
+    return buffer;
+}
+
+/**
+ * \fn int read_golden(char *path, golden_t *golden)
+ * \brief Lit un fichier <nom>.golden (format <clé>=<valeur>)
+ * \param path Le chemin du fichier
+ * \param golden Le résultat de référence
+ * \return 0 si succès, -1 si le fichier n'existe pas ou est incomplet
+ */
+int read_golden(char *path, golden_t *golden) {
+    FILE *file = fopen(path, "r");
+    char line[128];
+    int found = 0;
+    if(file == NULL) return -1;
+    memset(golden, 0, sizeof(golden_t));
+    while(fgets(line, sizeof(line), file) != NULL) {
+        if(sscanf(line, "frames=%lld", &golden->frames) == 1) found |= 1;
+        else if(sscanf(line, "hash=%llx", &golden->hash) == 1) found |= 2;
+        else if(sscanf(line, "render_ns=%lld", &golden->renderNs) == 1) found |= 4;
+        else sscanf(line, "arch=%64s", golden->arch);
+    }
+    fclose(file);
+    return (found & 3) == 3 ? 0 : -1;
+}
+
+/**
+ * \fn int write_golden(char *path, golden_t *golden)
+ * \brief Écrit un fichier <nom>.golden
+ * \param path Le chemin du fichier
+ * \param golden Le résultat de référence
+ * \return 0 si succès, -1 sinon
+ */
+int write_golden(char *path, golden_t *golden) {
+    FILE *file = fopen(path, "w");
+    if(file == NULL) return -1;
+    fprintf(file, "frames=%lld\n", golden->frames);
+    fprintf(file, "hash=%016llx\n", golden->hash);
+    fprintf(file, "render_ns=%lld\n", golden->renderNs);
+    fprintf(file, "arch=%s\n", golden->arch);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * \fn int golden_song(char *dir, char *name, int update, int det, int budget, double minSnr, int regression, char *arch)
+ * \brief Vérifie (ou enregistre) une musique du corpus
+ * \param dir Le dossier du corpus
+ * \param name Le nom de la musique (sans extension)
+ * \param update 1 pour enregistrer les fichiers golden
+ * \param det 1 pour le rendu déterministe (PCM identique exigé)
+ * \param budget Le budget en millièmes de la durée de la musique
+ * \param minSnr Le rapport signal sur bruit minimal
+ * \param regression La régression maximale en pourcents (0 : non vérifiée)
+ * \param arch L'architecture de la machine
+ * \return 0 si la musique passe, -1 sinon
+ */
+int golden_song(char *dir, char *name, int update, int det, int budget, double minSnr, int regression, char *arch) {
+    char path[GOLDEN_PATH_LENGTH], pcmPath[GOLDEN_PATH_LENGTH], goldenPath[GOLDEN_PATH_LENGTH];
+    static music_t music;
+    golden_t golden, result;
+    long long budgetNs, frames;
+    short *buffer, *reference;
+    double snr;
+    int ret = 0;
+
+    snprintf(path, sizeof(path), "%s/%s.mipi", dir, name);
+    snprintf(pcmPath, sizeof(pcmPath), "%s/%s%s" PCMCODEC_EXTENSION, dir, name, det ? GOLDEN_DET_SUFFIX : "");
+    snprintf(goldenPath, sizeof(goldenPath), "%s/%s%s.golden", dir, name, det ? GOLDEN_DET_SUFFIX : "");
+    if(load_music_file(&music, path) < 0) {
+        printf("FAIL %-20s musique illisible\n", name);
+        return -1;
+    }
+    buffer = golden_render(&music, &result.frames, &result.renderNs);
+    // Les notes ne servent plus : la musique suivante est chargée dans la même structure
+    free_music(&music);
+    if(buffer == NULL) {
+        printf("FAIL %-20s rendu impossible\n", name);
+        return -1;
+    }
+    result.hash = det_hash(buffer, result.frames);
+    strcpy(result.arch, arch);
+    // Durée de la musique en nanosecondes multipliée par le budget en millièmes
+    budgetNs = result.frames * (NSEC_PER_SEC / 1000) / SAMPLE_RATE * budget;
+
+    if(update) {
+        if(save_pcm(pcmPath, buffer, result.frames) < 0 || write_golden(goldenPath, &result) < 0) ret = -1;
+        printf("%s %-20s %lld échantillons hash=%016llx %.2f ms\n", ret == 0 ? "SAVE" : "FAIL", name, result.frames, result.hash, result.renderNs / 1e6);
+        free(buffer);
+        return ret;
+    }
+
+    if(read_golden(goldenPath, &golden) < 0) {
+        printf("FAIL %-20s pas de fichier golden (pigolden -u)\n", name);
+        free(buffer);
+        return -1;
+    }
+    if(golden.frames != result.frames) {
+        printf("FAIL %-20s %lld échantillons au lieu de %lld\n", name, result.frames, golden.frames);
+        free(buffer);
+        return -1;
+    }
+    // Empreinte identique : inutile de relire le PCM de référence
+    if(golden.hash == result.hash) snr = HUGE_VAL;
+    // Rendu déterministe : toute différence est une erreur, quelle que soit la machine
+    else if(det) snr = -HUGE_VAL;
+    else if((reference = load_pcm(pcmPath, &frames)) == NULL || frames != golden.frames) {
+        free(reference);
+        printf("FAIL %-20s empreinte différente et PCM de référence absent\n", name);
+        free(buffer);
+        return -1;
+    }
+    else {
+        snr = golden_snr(buffer, reference, result.frames);
+        free(reference);
+    }
+    if(snr < minSnr) ret = -1;
+    if(result.renderNs > budgetNs) ret = -1;
+    if(regression > 0 && golden.renderNs > 0 && strcmp(golden.arch, arch) == 0 && result.renderNs * 100 > golden.renderNs * (100 + regression)) ret = -1;
+
+    printf("%s %-20s %s", ret == 0 ? "OK  " : "FAIL", name, snr == HUGE_VAL ? "identique" : "");
+    if(snr != HUGE_VAL && det) printf("PCM différent");
+    else if(snr != HUGE_VAL) printf("SNR %.1f dB", snr);
+    printf(" %.2f ms (budget %.2f ms", result.renderNs / 1e6, budgetNs / 1e6);
+    if(golden.renderNs > 0 && strcmp(golden.arch, arch) == 0) printf(", référence %.2f ms", golden.renderNs / 1e6);
+    printf(")\n");
+    free(buffer);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    char *dir = GOLDEN_DIR, name[GOLDEN_PATH_LENGTH];
+    int update = 0, det = 0, budget = GOLDEN_BUDGET, regression = GOLDEN_REGRESSION;
+    int songs = 0, failures = 0, opt;
+    double minSnr = GOLDEN_SNR;
+    struct utsname host;
+    struct dirent *entry;
+    size_t length;
+    DIR *corpus;
+
+    while((opt = getopt(argc, argv, "udb:s:r:")) != -1) {
+        switch(opt) {
+            case 'u': update = 1; break;
+            case 'd': det = 1; break;
+            case 'b': budget = atoi(optarg); break;
+            case 's': minSnr = atof(optarg); break;
+            case 'r': regression = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Utilisation : %s [-u] [-d] [-b budget] [-s snr] [-r regression] [dossier]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if(optind < argc) dir = argv[optind];
+    uname(&host);
+    set_sound_deterministic(det);
+
+    corpus = opendir(dir);
+    if(corpus == NULL) {
+        fprintf(stderr, "[PIGOLDEN] Impossible d'ouvrir %s\n", dir);
+        return EXIT_FAILURE;
+    }
+    while((entry = readdir(corpus)) != NULL) {
+        length = strlen(entry->d_name);
+        if(length <= 5 || length >= sizeof(name) || strcmp(entry->d_name + length - 5, ".mipi") != 0) continue;
+        strcpy(name, entry->d_name);
+        name[length - 5] = '\0';
+        songs++;
+        if(golden_song(dir, name, update, det, budget, minSnr, regression, host.machine) < 0) failures++;
+    }
+    closedir(corpus);
+
+    printf("%d musique(s), %d échec(s)\n", songs, failures);
+    return failures == 0 && songs > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -31,6 +31,8 @@ int main() {
     music_t music;
     init_music(&music, 120);
     choices_t choice = CHOICE_MAIN_MENU;
+    // Les plugins sont chargés avant l'interface : leurs erreurs restent lisibles
+    load_plugins(PLUGIN_DIR, SAMPLE_RATE, BASE_AMPLITUDE);
     // Initialisation de la bibliothèque graphique
     init_ncurses();
     // Initialisation de la bibliothèque wiringpi
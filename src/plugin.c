@@ -0,0 +1,231 @@
+/**
+ * \file plugin.c
+ * \brief Chargement des instruments en plugins (voir piplugin.h)
+ */
+#include "plugin.h"
+#include "note.h"
+
+static plugin_t plugins[PLUGIN_MAX]; /*!< Plugins chargés, dans l'ordre des instruments */
+static int nbPlugins = 0; /*!< Nombre de plugins chargés */
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int plugin_filter(const struct dirent *entry)
+ * \brief Garde les fichiers PLUGIN_EXTENSION d'un dossier
+ * \param entry L'entrée du dossier
+ * \return 1 si l'entrée est un plugin
+ */
+static int plugin_filter(const struct dirent *entry) {
+    size_t length = strlen(entry->d_name), extension = strlen(PLUGIN_EXTENSION);
+    return length > extension && strcmp(entry->d_name + length - extension, PLUGIN_EXTENSION) == 0;
+}
+
+/**
+ * \fn int open_plugin(plugin_t *plugin, const char *path, unsigned int sampleRate, int amplitude)
+ * \brief Ouvre un plugin et vérifie sa description
+ * \param plugin Le plugin à remplir
+ * \param path Le chemin du fichier
+ * \param sampleRate La fréquence d'échantillonnage du rendu
+ * \param amplitude L'amplitude d'une note des instruments internes
+ * \return 0 si le plugin est utilisable, -1 sinon
+ */
+static int open_plugin(plugin_t *plugin, const char *path, unsigned int sampleRate, int amplitude) {
+    piplugin_entry_t entry;
+    memset(plugin, 0, sizeof(plugin_t));
+    plugin->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(plugin->handle == NULL) {
+        fprintf(stderr, "[PLUGIN] %s\n", dlerror());
+        return -1;
+    }
+    // Conversion d'un void * en pointeur de fonction : seule forme admise par dlsym
+    *(void **) (&entry) = dlsym(plugin->handle, PIPLUGIN_ENTRY);
+    if(entry != NULL) plugin->abi = entry();
+    if(plugin->abi == NULL || plugin->abi->abiVersion != PIPLUGIN_ABI_VERSION || plugin->abi->render == NULL
+        || plugin->abi->note_on == NULL || plugin->abi->voiceSize > PIPLUGIN_MAX_VOICE_SIZE) {
+        fprintf(stderr, "[PLUGIN] %s : ABI incompatible (version %d attendue)\n", path, PIPLUGIN_ABI_VERSION);
+        dlclose(plugin->handle);
+        return -1;
+    }
+    if(plugin->abi->init != NULL && plugin->abi->init(&plugin->state, sampleRate, amplitude) != 0) {
+        fprintf(stderr, "[PLUGIN] %s : échec de l'initialisation\n", path);
+        dlclose(plugin->handle);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \fn void plugin_voice_off(plugin_voice_t *voice)
+ * \brief Termine la note d'une voix
+ * \param voice La voix
+ * \note Sans note_off, la voix est libérée tout de suite : il n'y a pas de fin de note
+ */
+static void plugin_voice_off(plugin_voice_t *voice) {
+    if(voice->plugin == NULL || voice->released) return;
+    if(voice->plugin->abi->note_off == NULL) {
+        voice->plugin = NULL;
+        return;
+    }
+    voice->plugin->abi->note_off(voice->plugin->state, voice->state);
+    voice->released = 1;
+    voice->releaseFrames = 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int load_plugins(const char *dir, unsigned int sampleRate, int amplitude)
+ * \brief Charge les plugins d'un dossier
+ * \param dir Le dossier (PLUGIN_DIR)
+ * \param sampleRate La fréquence d'échantillonnage du rendu
+ * \param amplitude L'amplitude d'une note des instruments internes
+ * \return Le nombre de plugins chargés, -1 si le dossier n'a pas pu être lu
+ */
+int load_plugins(const char *dir, unsigned int sampleRate, int amplitude) {
+    struct dirent **entries;
+    char path[512];
+    int i, n;
+
+    // L'ordre alphabétique donne le même numéro d'instrument à chaque démarrage
+    n = scandir(dir, &entries, plugin_filter, alphasort);
+    if(n < 0) return -1;
+    for(i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, entries[i]->d_name);
+        if(nbPlugins < PLUGIN_MAX && open_plugin(&plugins[nbPlugins], path, sampleRate, amplitude) == 0) nbPlugins++;
+        free(entries[i]);
+    }
+    free(entries);
+    return nbPlugins;
+}
+
+/**
+ * \fn void unload_plugins()
+ * \brief Libère et ferme tous les plugins
+ */
+void unload_plugins() {
+    int i;
+    for(i = 0; i < nbPlugins; i++) {
+        if(plugins[i].abi->free != NULL) plugins[i].abi->free(plugins[i].state);
+        dlclose(plugins[i].handle);
+    }
+    nbPlugins = 0;
+}
+
+/**
+ * \fn int nb_plugins()
+ * \brief Nombre de plugins chargés
+ * \return Le nombre de plugins
+ */
+int nb_plugins() {
+    return nbPlugins;
+}
+
+/**
+ * \fn const plugin_t *instrument_plugin(int instrument)
+ * \brief Plugin d'un instrument
+ * \param instrument L'instrument (instrument_t)
+ * \return Le plugin ou NULL si l'instrument est interne ou n'est pas chargé
+ */
+const plugin_t *instrument_plugin(int instrument) {
+    if(instrument < INSTRUMENT_NB || instrument >= INSTRUMENT_NB + nbPlugins) return NULL;
+    return &plugins[instrument - INSTRUMENT_NB];
+}
+
+/**
+ * \fn void plugin_render(const plugin_t *plugin, short *buffer, double freq, size_t offset, size_t frames)
+ * \brief Calcule un bloc d'une note jouée par un plugin
+ * \param plugin Le plugin
+ * \param buffer Le buffer à remplir
+ * \param freq La fréquence de la note
+ * \param offset La position du premier échantillon depuis le début de la note
+ * \param frames Le nombre d'échantillons
+ */
+void plugin_render(const plugin_t *plugin, short *buffer, double freq, size_t offset, size_t frames) {
+    // Aligné pour n'importe quel type de l'état de la voix
+    long double voice[PIPLUGIN_MAX_VOICE_SIZE / sizeof(long double) + 1];
+    plugin->abi->note_on(plugin->state, voice, freq, offset);
+    plugin->abi->render(plugin->state, voice, buffer, frames);
+    if(plugin->abi->note_off != NULL) plugin->abi->note_off(plugin->state, voice);
+}
+
+/**
+ * \fn void plugin_voices_start(plugin_voices_t *voices, const plugin_t *plugin, double freq, size_t offset)
+ * \brief Commence une note sur les voix d'un channel
+ * \param voices Les voix du channel
+ * \param plugin Le plugin de la note (NULL pour un instrument interne ou une ligne vide)
+ * \param freq La fréquence de la note
+ * \param offset La position du premier échantillon calculé depuis le début de la note
+ */
+void plugin_voices_start(plugin_voices_t *voices, const plugin_t *plugin, double freq, size_t offset) {
+    plugin_voice_t *voice = &(voices->slots[voices->current]);
+    plugin_voice_off(voice);
+    // La note qui se termine garde sa voix pour sa fin de note : la nouvelle prend l'autre
+    if(voice->plugin != NULL) {
+        voices->current ^= 1;
+        voice = &(voices->slots[voices->current]);
+    }
+    voice->plugin = plugin;
+    voice->released = 0;
+    if(plugin != NULL) plugin->abi->note_on(plugin->state, voice->state, freq, offset);
+}
+
+/**
+ * \fn void plugin_voices_render(plugin_voices_t *voices, short *buffer, size_t frames)
+ * \brief Calcule le bloc suivant de la note courante
+ * \param voices Les voix du channel
+ * \param buffer Le buffer à remplir (silence si aucun plugin ne joue la note)
+ * \param frames Le nombre d'échantillons
+ */
+void plugin_voices_render(plugin_voices_t *voices, short *buffer, size_t frames) {
+    plugin_voice_t *voice = &(voices->slots[voices->current]);
+    if(voice->plugin == NULL || voice->released) memset(buffer, 0, frames * sizeof(short));
+    else voice->plugin->abi->render(voice->plugin->state, voice->state, buffer, frames);
+}
+
+/**
+ * \fn void plugin_voices_mix_release(plugin_voices_t *voices, short *buffer, size_t frames)
+ * \brief Ajoute le bloc suivant de la fin de note précédente
+ * \param voices Les voix du channel
+ * \param buffer Le buffer auquel ajouter la fin de note (saturé)
+ * \param frames Le nombre d'échantillons
+ */
+void plugin_voices_mix_release(plugin_voices_t *voices, short *buffer, size_t frames) {
+    plugin_voice_t *voice;
+    short block[PLUGIN_RELEASE_BLOCK];
+    size_t i, n, done;
+    int k, sample, sounding;
+    for(k = 0; k < 2; k++) {
+        voice = &(voices->slots[k]);
+        if(voice->plugin == NULL || !voice->released) continue;
+        sounding = 1;
+        for(done = 0; done < frames && sounding && voice->releaseFrames < PIPLUGIN_MAX_RELEASE_FRAMES; done += n) {
+            n = frames - done < PLUGIN_RELEASE_BLOCK ? frames - done : PLUGIN_RELEASE_BLOCK;
+            if((long long) n > PIPLUGIN_MAX_RELEASE_FRAMES - voice->releaseFrames) n = (size_t) (PIPLUGIN_MAX_RELEASE_FRAMES - voice->releaseFrames);
+            sounding = voice->plugin->abi->render(voice->plugin->state, voice->state, block, n);
+            for(i = 0; i < n; i++) {
+                sample = buffer[done + i] + block[i];
+                buffer[done + i] = sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample;
+            }
+            voice->releaseFrames += n;
+        }
+        if(!sounding || voice->releaseFrames >= PIPLUGIN_MAX_RELEASE_FRAMES) voice->plugin = NULL;
+    }
+}
+
+/**
+ * \fn void plugin_voices_cut(plugin_voices_t *voices)
+ * \brief Coupe les voix d'un channel (arrêt ou déplacement de la lecture, fin du channel)
+ * \param voices Les voix du channel
+ */
+void plugin_voices_cut(plugin_voices_t *voices) {
+    int k;
+    for(k = 0; k < 2; k++) {
+        plugin_voice_off(&(voices->slots[k]));
+        voices->slots[k].plugin = NULL;
+    }
+}
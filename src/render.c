@@ -0,0 +1,328 @@
+/**
+ * \file render.c
+ * \brief Rendu hors temps réel d'une partie de la musique
+ */
+#include "render.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void render_lines(music_t *music, channel_t *channel, int first, int last, long long tickStart, long long tickEnd, int *mix, short *block)
+ * \brief Ajoute des lignes d'un channel au mélange, note par note
+ * \param music La musique (pour les changements de tempo)
+ * \param channel Le channel
+ * \param first La première ligne
+ * \param last La ligne qui suit la dernière (au plus nbNotes)
+ * \param tickStart La position de début du rendu (en doubles croches)
+ * \param tickEnd La position de fin du rendu (en doubles croches)
+ * \param mix Le mélange
+ * \param block Un buffer de RENDER_BLOCK_FRAMES échantillons
+ */
+void render_lines(music_t *music, channel_t *channel, int first, int last, long long tickStart, long long tickEnd, int *mix, short *block);
+
+/**
+ * \fn void render_channel(music_t *music, arrangement_t *arrangement, int channelId, long long tickStart, long long tickEnd, int *mix, short *block)
+ * \brief Ajoute la partie d'un channel au mélange, pattern par pattern
+ * \param music La musique
+ * \param arrangement L'arrangement de la musique
+ * \param channelId Le channel
+ * \param tickStart La position de début (en doubles croches)
+ * \param tickEnd La position de fin (en doubles croches)
+ * \param mix Le mélange
+ * \param block Un buffer de RENDER_BLOCK_FRAMES échantillons
+ */
+void render_channel(music_t *music, arrangement_t *arrangement, int channelId, long long tickStart, long long tickEnd, int *mix, short *block);
+
+/**
+ * \fn long long render_tempo_at(music_t *music, long long tick, long long *frame, long long *residue, short *bpm)
+ * \brief Transport de la musique à une position (même calcul que tempoTicksToFrames)
+ * \param music La musique
+ * \param tick La position (en doubles croches)
+ * \param frame L'échantillon qui joue la position
+ * \param residue L'écart de phase entre cet échantillon et la position
+ * \param bpm Le tempo en vigueur à la position
+ * \return La position du changement de tempo suivant, -1 s'il n'y en a plus
+ */
+long long render_tempo_at(music_t *music, long long tick, long long *frame, long long *residue, short *bpm);
+
+/**
+ * \fn int render_pattern(const pattern_t *pattern, short bpm, long long residue, render_pattern_t *cached, short *block)
+ * \brief Calcule l'audio d'un pattern joué sans changement de tempo
+ * \param pattern Le pattern
+ * \param bpm Le tempo
+ * \param residue L'écart de phase entre le premier échantillon et le début du pattern
+ * \param cached L'audio calculé
+ * \param block Un buffer de RENDER_BLOCK_FRAMES échantillons
+ * \return 0 si succès, -1 si la mémoire manque
+ */
+int render_pattern(const pattern_t *pattern, short bpm, long long residue, render_pattern_t *cached, short *block);
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn long long render_frames(music_t *music, long long tickStart, long long tickEnd)
+ * \brief Nombre d'échantillons entre deux positions musicales
+ * \param music La musique
+ * \param tickStart La position de début (en doubles croches)
+ * \param tickEnd La position de fin (en doubles croches)
+ * \return Le nombre d'échantillons du rendu
+ */
+long long render_frames(music_t *music, long long tickStart, long long tickEnd) {
+    if(tickEnd <= tickStart) return 0;
+    return tempoTicksToFrames(music, tickEnd) - tempoTicksToFrames(music, tickStart);
+}
+
+/**
+ * \fn short *render_music(music_t *music, long long tickStart, long long tickEnd, long long *frames)
+ * \brief Calcule le mélange de tous les channels entre deux positions musicales
+ * \param music La musique
+ * \param tickStart La position de début (en doubles croches)
+ * \param tickEnd La position de fin (en doubles croches)
+ * \param frames Le nombre d'échantillons calculés
+ * \return Le buffer alloué (à libérer avec free) ou NULL si la partie est vide
+ * \note Aucun effet n'est appliqué
+ */
+short *render_music(music_t *music, long long tickStart, long long tickEnd, long long *frames) {
+    short *buffer, *block;
+    arrangement_t *arrangement;
+    int *mix;
+    int i;
+    *frames = render_frames(music, tickStart, tickEnd);
+    if(*frames <= 0) return NULL;
+    buffer = malloc(sizeof(short) * *frames);
+    mix = calloc(*frames, sizeof(int));
+    block = malloc(sizeof(short) * RENDER_BLOCK_FRAMES);
+    if(buffer == NULL || mix == NULL || block == NULL) {
+        free(buffer);
+        free(mix);
+        free(block);
+        *frames = 0;
+        return NULL;
+    }
+    // Les patterns répétés ne sont calculés qu'une fois ; sans arrangement, les channels
+    // sont calculés note par note
+    arrangement = malloc(sizeof(arrangement_t));
+    if(arrangement != NULL) {
+        init_arrangement(arrangement);
+        if(arrange_music(music, arrangement) < 0) {
+            free(arrangement);
+            arrangement = NULL;
+        }
+    }
+    for(i = 0; i < music->nbChannels; i++) {
+        if(arrangement != NULL) render_channel(music, arrangement, i, tickStart, tickEnd, mix, block);
+        else render_lines(music, &(music->channels[i]), channel_tick2line(&(music->channels[i]), tickStart), music->channels[i].nbNotes, tickStart, tickEnd, mix, block);
+    }
+    if(arrangement != NULL) free_arrangement(arrangement);
+    free(arrangement);
+    mix2pcm(mix, buffer, *frames);
+    free(mix);
+    free(block);
+    return buffer;
+}
+
+/**
+ * \fn void mix2pcm(int *mix, short *buffer, size_t frames)
+ * \brief Ramène un mélange dans la plage d'un short
+ * \param mix Le mélange (somme des voix)
+ * \param buffer Le buffer de sortie
+ * \param frames Le nombre d'échantillons
+ */
+void mix2pcm(int *mix, short *buffer, size_t frames) {
+    size_t i;
+    int sample;
+    for(i = 0; i < frames; i++) {
+        sample = mix[i];
+        if(sample > RENDER_MAX_AMPLITUDE) sample = RENDER_MAX_AMPLITUDE;
+        if(sample < -RENDER_MAX_AMPLITUDE) sample = -RENDER_MAX_AMPLITUDE;
+        buffer[i] = sample;
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void render_lines(music_t *music, channel_t *channel, int first, int last, long long tickStart, long long tickEnd, int *mix, short *block)
+ * \brief Ajoute des lignes d'un channel au mélange, note par note
+ * \param music La musique (pour les changements de tempo)
+ * \param channel Le channel
+ * \param first La première ligne
+ * \param last La ligne qui suit la dernière (au plus nbNotes)
+ * \param tickStart La position de début du rendu (en doubles croches)
+ * \param tickEnd La position de fin du rendu (en doubles croches)
+ * \param mix Le mélange
+ * \param block Un buffer de RENDER_BLOCK_FRAMES échantillons
+ */
+void render_lines(music_t *music, channel_t *channel, int first, int last, long long tickStart, long long tickEnd, int *mix, short *block) {
+    long long tick, noteStart, noteFrame, from, to, origin = tempoTicksToFrames(music, tickStart);
+    size_t count, j;
+    note_t note;
+    int i = first, next;
+    // L'index des durées donne directement la position de la première ligne
+    for(tick = channel_line2tick(channel, i); i < last && tick < tickEnd; i++) {
+        // Les lignes vides sont muettes : on saute à la suivante qui ne l'est pas
+        next = channel_next_line(channel, i);
+        if(next < 0 || next >= last) break;
+        tick += channel_lines_ticks(channel, i, next);
+        i = next;
+        if(tick >= tickEnd) break;
+        // Seule la colonne des durées est lue tant que la note n'est pas jouée
+        if(channel_note_ticks(channel, i) <= 0) continue;
+        noteStart = tick;
+        tick += channel_note_ticks(channel, i);
+        if(tick <= tickStart) continue;
+        note = channel_note(channel, i);
+        // On ne garde que la partie de la note comprise dans [tickStart, tickEnd[
+        noteFrame = tempoTicksToFrames(music, noteStart);
+        from = noteStart > tickStart ? noteFrame : origin;
+        to = tempoTicksToFrames(music, tick < tickEnd ? tick : tickEnd);
+        while(from < to) {
+            count = to - from > RENDER_BLOCK_FRAMES ? RENDER_BLOCK_FRAMES : to - from;
+            render_note(block, note, from - noteFrame, count, 0);
+            for(j = 0; j < count; j++) mix[from - origin + j] += block[j];
+            from += count;
+        }
+    }
+}
+
+/**
+ * \fn void render_channel(music_t *music, arrangement_t *arrangement, int channelId, long long tickStart, long long tickEnd, int *mix, short *block)
+ * \brief Ajoute la partie d'un channel au mélange, pattern par pattern
+ * \param music La musique
+ * \param arrangement L'arrangement de la musique
+ * \param channelId Le channel
+ * \param tickStart La position de début (en doubles croches)
+ * \param tickEnd La position de fin (en doubles croches)
+ * \param mix Le mélange
+ * \param block Un buffer de RENDER_BLOCK_FRAMES échantillons
+ */
+void render_channel(music_t *music, arrangement_t *arrangement, int channelId, long long tickStart, long long tickEnd, int *mix, short *block) {
+    channel_t *channel = &(music->channels[channelId]);
+    long long origin = tempoTicksToFrames(music, tickStart), t0, t1, frame, residue, next;
+    render_pattern_t *cache = calloc(arrangement->nbPatterns[channelId] + 1, sizeof(render_pattern_t)), *cached;
+    int k, id, first, last, played;
+    long long j;
+    short bpm;
+    if(cache == NULL) {
+        render_lines(music, channel, channel_tick2line(channel, tickStart), channel->nbNotes, tickStart, tickEnd, mix, block);
+        return;
+    }
+    // Seules les rangées entièrement comprises dans le rendu peuvent reprendre un audio calculé
+    for(k = 0; k < arrangement->nbOrders; k++) {
+        id = arrangement->orders[k][channelId];
+        first = k * PATTERN_LINES;
+        if(id < 0 || first >= channel->nbNotes) continue;
+        last = first + PATTERN_LINES < channel->nbNotes ? first + PATTERN_LINES : channel->nbNotes;
+        if(channel_line2tick(channel, first) >= tickStart && channel_line2tick(channel, last) <= tickEnd) cache[id].uses++;
+    }
+    for(k = 0; k < arrangement->nbOrders; k++) {
+        id = arrangement->orders[k][channelId];
+        first = k * PATTERN_LINES;
+        if(id < 0 || first >= channel->nbNotes) continue;
+        last = first + PATTERN_LINES < channel->nbNotes ? first + PATTERN_LINES : channel->nbNotes;
+        t0 = channel_line2tick(channel, first);
+        t1 = channel_line2tick(channel, last);
+        if(t1 <= tickStart) continue;
+        if(t0 >= tickEnd) break;
+        cached = &(cache[id]);
+        played = 0;
+        if(t0 >= tickStart && t1 <= tickEnd) {
+            next = render_tempo_at(music, t0, &frame, &residue, &bpm);
+            // Le pattern n'est calculé à part que s'il sera rejoué : sinon il l'est note par note
+            if((next < 0 || next >= t1) && bpm >= MUSIC_MIN_BPM) {
+                if(cached->pcm == NULL && cached->uses > 1) render_pattern(&(arrangement->patterns[channelId][id]), bpm, residue, cached, block);
+                if(cached->pcm != NULL && cached->bpm == bpm && cached->residue == residue) {
+                    for(j = 0; j < cached->frames; j++) mix[frame - origin + j] += cached->pcm[j];
+                    played = 1;
+                }
+            }
+            // Dernière rangée du rendu qui joue le pattern : son audio n'est plus utile
+            if(--cached->uses == 0) {
+                free(cached->pcm);
+                cached->pcm = NULL;
+            }
+        }
+        if(!played) render_lines(music, channel, first, last, tickStart, tickEnd, mix, block);
+    }
+    for(id = 0; id < arrangement->nbPatterns[channelId]; id++) free(cache[id].pcm);
+    free(cache);
+}
+
+/**
+ * \fn long long render_tempo_at(music_t *music, long long tick, long long *frame, long long *residue, short *bpm)
+ * \brief Transport de la musique à une position (même calcul que tempoTicksToFrames)
+ * \param music La musique
+ * \param tick La position (en doubles croches)
+ * \param frame L'échantillon qui joue la position
+ * \param residue L'écart de phase entre cet échantillon et la position
+ * \param bpm Le tempo en vigueur à la position
+ * \return La position du changement de tempo suivant, -1 s'il n'y en a plus
+ */
+long long render_tempo_at(music_t *music, long long tick, long long *frame, long long *residue, short *bpm) {
+    long long frames = 0, phase = 0, n;
+    int i;
+    *bpm = music->bpm;
+    for(i = 0; i < music->nbTempos && music->tempos[i].tick <= tick; i++) {
+        n = phaseToFrames(phase, music->tempos[i].tick * SOUND_TICK_PHASE, *bpm);
+        frames += n;
+        phase += n * *bpm;
+        *bpm = music->tempos[i].bpm;
+    }
+    n = phaseToFrames(phase, tick * SOUND_TICK_PHASE, *bpm);
+    *frame = frames + n;
+    // Jusqu'au prochain changement de tempo, la ligne jouée par un échantillon ne dépend que
+    // de cet écart : deux positions de même écart donnent les mêmes échantillons
+    *residue = phase + n * *bpm - tick * SOUND_TICK_PHASE;
+    return i < music->nbTempos ? music->tempos[i].tick : -1;
+}
+
+/**
+ * \fn int render_pattern(const pattern_t *pattern, short bpm, long long residue, render_pattern_t *cached, short *block)
+ * \brief Calcule l'audio d'un pattern joué sans changement de tempo
+ * \param pattern Le pattern
+ * \param bpm Le tempo
+ * \param residue L'écart de phase entre le premier échantillon et le début du pattern
+ * \param cached L'audio calculé
+ * \param block Un buffer de RENDER_BLOCK_FRAMES échantillons
+ * \return 0 si succès, -1 si la mémoire manque
+ */
+int render_pattern(const pattern_t *pattern, short bpm, long long residue, render_pattern_t *cached, short *block) {
+    packed_note_t empty = pack_note(create_note(NOTE_NA_ID, 0, REF_OCTAVE, INSTRUMENT_NA, CHANNEL_EMPTY_TICKS));
+    long long tick = 0, noteStart, noteFrame, from, to;
+    size_t count;
+    note_t note;
+    int i, last = -1;
+    // L'audio s'arrête à la fin de la dernière ligne non vide
+    for(i = 0; i < PATTERN_LINES; i++) {
+        if(memcmp(&(pattern->lines[i]), &empty, sizeof(packed_note_t)) != 0) last = i;
+    }
+    for(i = 0; i <= last; i++) tick += pattern->lines[i].time;
+    cached->frames = phaseToFrames(residue, tick * SOUND_TICK_PHASE, bpm);
+    cached->pcm = cached->frames > 0 ? calloc(cached->frames, sizeof(short)) : NULL;
+    if(cached->pcm == NULL) return -1;
+    cached->bpm = bpm;
+    cached->residue = residue;
+    // Mêmes notes, mêmes positions et mêmes blocs de calcul que render_lines : les notes
+    // d'un channel ne se chevauchent pas
+    for(tick = 0, i = 0; i <= last; i++) {
+        noteStart = tick;
+        tick += pattern->lines[i].time;
+        if(pattern->lines[i].time == 0 || memcmp(&(pattern->lines[i]), &empty, sizeof(packed_note_t)) == 0) continue;
+        note = unpack_note(pattern->lines[i]);
+        noteFrame = from = phaseToFrames(residue, noteStart * SOUND_TICK_PHASE, bpm);
+        to = phaseToFrames(residue, tick * SOUND_TICK_PHASE, bpm);
+        while(from < to) {
+            count = to - from > RENDER_BLOCK_FRAMES ? RENDER_BLOCK_FRAMES : to - from;
+            render_note(block, note, from - noteFrame, count, 0);
+            memcpy(cached->pcm + from, block, sizeof(short) * count);
+            from += count;
+        }
+    }
+    return 0;
+}
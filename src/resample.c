@@ -0,0 +1,279 @@
+/**
+ * \file resample.c
+ * \brief Conversion de fréquence d'échantillonnage
+ */
+#include "resample.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn unsigned int gcd(unsigned int a, unsigned int b)
+ * \brief Plus grand commun diviseur
+ */
+static unsigned int gcd(unsigned int a, unsigned int b) {
+    unsigned int r;
+    while(b != 0) {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/**
+ * \fn double bessel_i0(double x)
+ * \brief Fonction de Bessel modifiée d'ordre 0 (fenêtre de Kaiser)
+ */
+static double bessel_i0(double x) {
+    double sum = 1, term = 1, y = x * x / 4;
+    int k;
+    for(k = 1; k < 50 && term > sum * 1e-12; k++) {
+        term *= y / ((double) k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * \fn void compute_filters(resampler_t *resampler, double cutoff, double beta)
+ * \brief Calcule chaque phase du filtre, normalisée pour un gain continu de 1
+ * \details Le coefficient k de la phase p est appliqué à l'échantillon situé à
+ * k - (taps / 2 - 1) - p / phases de la position de sortie.
+ */
+static void compute_filters(resampler_t *resampler, double cutoff, double beta) {
+    int half = resampler->taps / 2, k;
+    unsigned int p;
+    double d, x, sum, i0Beta = bessel_i0(beta);
+    float *filter;
+
+    for(p = 0; p < resampler->phases; p++) {
+        filter = resampler->filters + (size_t) p * resampler->taps;
+        if(resampler->quality == RESAMPLE_LINEAR) {
+            filter[1] = (float) p / resampler->phases;
+            filter[0] = 1 - filter[1];
+            continue;
+        }
+        sum = 0;
+        for(k = 0; k < resampler->taps; k++) {
+            d = k - (half - 1) - (double) p / resampler->phases;
+            x = d / half;
+            filter[k] = 0;
+            if(x <= -1 || x >= 1) continue;
+            filter[k] = (d == 0 ? cutoff : sin(M_PI * cutoff * d) / (M_PI * d)) * bessel_i0(beta * sqrt(1 - x * x)) / i0Beta;
+            sum += filter[k];
+        }
+        for(k = 0; k < resampler->taps; k++) filter[k] /= sum;
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_resampler(resampler_t *resampler, unsigned int inRate, unsigned int outRate, resample_quality_t quality)
+ * \brief Calcule les phases du filtre d'un convertisseur
+ * \param resampler Le convertisseur
+ * \param inRate La fréquence d'entrée
+ * \param outRate La fréquence de sortie
+ * \param quality La qualité de conversion
+ * \return 0 si succès, -1 si les paramètres sont invalides ou si l'allocation a échoué
+ */
+int init_resampler(resampler_t *resampler, unsigned int inRate, unsigned int outRate, resample_quality_t quality) {
+    unsigned int g, step;
+    double ratio, beta = quality == RESAMPLE_SINC_BEST ? RESAMPLE_BEST_BETA : RESAMPLE_FAST_BETA;
+    int half;
+
+    memset(resampler, 0, sizeof(resampler_t));
+    if(inRate == 0 || outRate == 0 || quality < RESAMPLE_LINEAR || quality >= RESAMPLE_NB_QUALITIES) return -1;
+    resampler->inRate = inRate;
+    resampler->outRate = outRate;
+    resampler->quality = quality;
+    // Une sortie avance de M/L entrées, avec L/M le rapport des fréquences réduit
+    g = gcd(inRate, outRate);
+    resampler->denominator = outRate / g;
+    step = inRate / g;
+    resampler->stepInt = step / resampler->denominator;
+    resampler->stepFrac = step % resampler->denominator;
+    resampler->phases = resampler->denominator > RESAMPLE_MAX_PHASES ? RESAMPLE_MAX_PHASES : resampler->denominator;
+
+    // En sous-échantillonnage la coupure descend sous la Nyquist de sortie : le filtre
+    // s'allonge d'autant pour garder la même raideur
+    ratio = outRate < inRate ? (double) outRate / inRate : 1;
+    if(quality == RESAMPLE_LINEAR) half = 1;
+    else half = (int) ceil((quality == RESAMPLE_SINC_BEST ? RESAMPLE_BEST_TAPS : RESAMPLE_FAST_TAPS) / 2 / ratio);
+    if(half > RESAMPLE_MAX_TAPS / 2) half = RESAMPLE_MAX_TAPS / 2;
+    resampler->taps = 2 * half;
+
+    resampler->filters = malloc(sizeof(float) * resampler->phases * resampler->taps);
+    resampler->work = malloc(sizeof(float) * (resampler->taps - 1 + RESAMPLE_CHUNK));
+    if(resampler->filters == NULL || resampler->work == NULL) {
+        end_resampler(resampler);
+        return -1;
+    }
+    compute_filters(resampler, RESAMPLE_ROLLOFF * ratio, beta);
+    reset_resampler(resampler);
+    return 0;
+}
+
+/**
+ * \fn void reset_resampler(resampler_t *resampler)
+ * \brief Vide l'historique du convertisseur (début d'un nouveau flux)
+ * \param resampler Le convertisseur
+ */
+void reset_resampler(resampler_t *resampler) {
+    memset(resampler->work, 0, sizeof(float) * (resampler->taps - 1));
+    // La première sortie tombe sur le premier échantillon d'entrée : l'historique de
+    // silence ne sert qu'à la moitié gauche du filtre
+    resampler->index = resampler->taps / 2;
+    resampler->frac = 0;
+}
+
+/**
+ * \fn void end_resampler(resampler_t *resampler)
+ * \brief Libère le convertisseur
+ * \param resampler Le convertisseur
+ */
+void end_resampler(resampler_t *resampler) {
+    free(resampler->filters);
+    free(resampler->work);
+    resampler->filters = NULL;
+    resampler->work = NULL;
+}
+
+/**
+ * \fn void resample_set_linear(resampler_t *resampler, int linear)
+ * \brief Remplace le filtre par une interpolation linéaire (ou le rétablit)
+ * \param resampler Le convertisseur
+ * \param linear 1 pour l'interpolation linéaire
+ */
+void resample_set_linear(resampler_t *resampler, int linear) {
+    resampler->linear = linear;
+}
+
+/**
+ * \fn size_t resample_max_frames(resampler_t *resampler, size_t frames)
+ * \brief Nombre maximal d'échantillons produits pour un nombre d'échantillons d'entrée
+ * \param resampler Le convertisseur
+ * \param frames Le nombre d'échantillons d'entrée
+ * \return La taille minimale du buffer de sortie de resample
+ */
+size_t resample_max_frames(resampler_t *resampler, size_t frames) {
+    return (size_t) ((unsigned long long) frames * resampler->outRate / resampler->inRate) + 2;
+}
+
+/**
+ * \fn int resample_latency(resampler_t *resampler)
+ * \brief Retard du flux converti
+ * \param resampler Le convertisseur
+ * \return Le nombre d'échantillons d'entrée gardés avant de pouvoir produire une sortie
+ */
+int resample_latency(resampler_t *resampler) {
+    return resampler->taps / 2;
+}
+
+/**
+ * \fn size_t resample(resampler_t *resampler, const short *in, size_t frames, short *out)
+ * \brief Convertit un morceau du flux
+ * \param resampler Le convertisseur
+ * \param in Les échantillons d'entrée
+ * \param frames Le nombre d'échantillons d'entrée (tous sont consommés)
+ * \param out Le buffer de sortie (au moins resample_max_frames échantillons)
+ * \return Le nombre d'échantillons produits
+ * \note Ne fait aucune allocation : peut être appelé depuis le thread de mixage
+ */
+size_t resample(resampler_t *resampler, const short *in, size_t frames, short *out) {
+    int taps = resampler->taps, half = taps / 2, k;
+    size_t produced = 0, chunk, available, i;
+    unsigned int phase;
+    const float *filter, *x;
+    float acc, scale = 1.0f / resampler->denominator;
+    long sample;
+
+    while(frames > 0) {
+        chunk = frames > RESAMPLE_CHUNK ? RESAMPLE_CHUNK : frames;
+        for(i = 0; i < chunk; i++) resampler->work[taps - 1 + i] = in[i];
+        available = taps - 1 + chunk;
+        while(resampler->index + taps <= (long long) available) {
+            x = resampler->work + resampler->index;
+            if(resampler->linear) {
+                // Les deux échantillons qui encadrent la position, au centre du filtre
+                acc = x[half - 1] + (x[half] - x[half - 1]) * (resampler->frac * scale);
+            }
+            else {
+                phase = resampler->phases == resampler->denominator ? resampler->frac
+                    : (unsigned int) ((unsigned long long) resampler->frac * resampler->phases / resampler->denominator);
+                filter = resampler->filters + (size_t) phase * taps;
+                acc = 0;
+                for(k = 0; k < taps; k++) acc += x[k] * filter[k];
+            }
+            sample = lrintf(acc);
+            if(sample > 32767) sample = 32767;
+            if(sample < -32768) sample = -32768;
+            out[produced++] = (short) sample;
+            resampler->index += resampler->stepInt;
+            resampler->frac += resampler->stepFrac;
+            if(resampler->frac >= resampler->denominator) {
+                resampler->frac -= resampler->denominator;
+                resampler->index++;
+            }
+        }
+        // Les taps - 1 derniers échantillons deviennent l'historique du morceau suivant
+        memmove(resampler->work, resampler->work + chunk, sizeof(float) * (taps - 1));
+        resampler->index -= chunk;
+        in += chunk;
+        frames -= chunk;
+    }
+    return produced;
+}
+
+/**
+ * \fn short *resample_buffer(const short *in, size_t frames, unsigned int inRate, unsigned int outRate, resample_quality_t quality, size_t *outFrames)
+ * \brief Convertit un signal entier, sans retard
+ * \param in Les échantillons d'entrée
+ * \param frames Le nombre d'échantillons d'entrée
+ * \param inRate La fréquence d'entrée
+ * \param outRate La fréquence de sortie
+ * \param quality La qualité de conversion
+ * \param outFrames Le nombre d'échantillons produits
+ * \return Les échantillons convertis (à libérer) ou NULL en cas d'erreur
+ */
+short *resample_buffer(const short *in, size_t frames, unsigned int inRate, unsigned int outRate, resample_quality_t quality, size_t *outFrames) {
+    static const short silence[RESAMPLE_MAX_TAPS];
+    resampler_t resampler;
+    size_t produced;
+    short *out;
+
+    if(init_resampler(&resampler, inRate, outRate, quality) < 0) return NULL;
+    out = malloc(sizeof(short) * (resample_max_frames(&resampler, frames) + resample_max_frames(&resampler, resampler.taps)));
+    if(out == NULL) {
+        end_resampler(&resampler);
+        return NULL;
+    }
+    produced = resample(&resampler, in, frames, out);
+    // Le silence ajouté à la fin fait sortir les derniers échantillons retenus par le filtre
+    produced += resample(&resampler, silence, resampler.taps, out + produced);
+    // Seules les sorties tombant avant la fin de l'entrée sont gardées
+    *outFrames = (size_t) (((unsigned long long) frames * resampler.denominator + resampler.stepInt * resampler.denominator + resampler.stepFrac - 1)
+        / (resampler.stepInt * resampler.denominator + resampler.stepFrac));
+    if(*outFrames > produced) *outFrames = produced;
+    end_resampler(&resampler);
+    return out;
+}
+
+/**
+ * \fn const char *resample_quality_name(resample_quality_t quality)
+ * \brief Nom d'une qualité de conversion (benchmarks)
+ * \param quality La qualité
+ * \return "linear", "sinc_fast" ou "sinc_best"
+ */
+const char *resample_quality_name(resample_quality_t quality) {
+    switch(quality) {
+        case RESAMPLE_LINEAR: return "linear";
+        case RESAMPLE_SINC_FAST: return "sinc_fast";
+        case RESAMPLE_SINC_BEST: return "sinc_best";
+        default: return "unknown";
+    }
+}
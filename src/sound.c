@@ -1,4 +1,5 @@
 #include "sound.h"
+#include "detmath.h"
 
 #define CHECK(sts, msg) \
     if ((sts) != 0)    \
@@ -16,6 +17,7 @@
  * \fn short sine_sound(int time, int amplitude , int phase, double freq ) 
  * \brief retourne la valeur de sin 
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
@@ -25,55 +27,63 @@ double sine_sound(double time, double amplitude , double phase, double freq );
  * \fn short *sine_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *sine_wave(short *buffer, size_t sample_count, double freq);
+short *sine_wave(short *buffer, size_t offset, size_t sample_count, double freq);
 
 /**
  * \fn short *square_wave()
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *square_wave(short *buffer, size_t sample_count, double freq);
+short *square_wave(short *buffer, size_t offset, size_t sample_count, double freq);
 
 /**
  * \fn short *sawtooth_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *sawtooth_wave(short *buffer, size_t sample_count, double freq);
+short *sawtooth_wave(short *buffer, size_t offset, size_t sample_count, double freq);
 
 /**
  * \fn short *triangle_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *triangle_wave(short *buffer, size_t sample_count, double freq);
+short *triangle_wave(short *buffer, size_t offset, size_t sample_count, double freq);
 
 /**
  * \fn short **warm_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
+ * \param int partials nombre maximal de partiels calculés
  */
-short *warm_wave(short *buffer, size_t sample_count, double freq);
+short *warm_wave(short *buffer, size_t offset, size_t sample_count, double freq, int partials);
 
 /**
  * \fn short **organ_wave() 
  * \brief joue une note en orgue 
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
+ * \param int partials nombre maximal de partiels calculés
  */
-short *organ_wave(short *buffer, size_t sample_count, double freq);
+short *organ_wave(short *buffer, size_t offset, size_t sample_count, double freq, int partials);
 
 
 /**
@@ -82,52 +92,40 @@ short *organ_wave(short *buffer, size_t sample_count, double freq);
  * \param note_t note note à jouer
  * \return frequence de la note en double
  */
-short *sinphaser_wave(short *buffer,size_t sample_count, double freq);
+short *sinphaser_wave(short *buffer, size_t offset, size_t sample_count, double freq);
 
 /**
  * @fn piano_wave()
  * @brief joue une note en piano
  * @param short *buffer buffer de short pour la note
+ * @param size_t offset position du premier échantillon dans la note
  * @param size_t sample_count nb d'échantillonage
  * @param double freq fréquence d'échantillonage
+ * @param int partials nombre maximal de partiels calculés
  * @return short *buffer
  */
-short *piano_wave(short *buffer, size_t sample_count, double freq);
+short *piano_wave(short *buffer, size_t offset, size_t sample_count, double freq, int partials);
 
 /**
  * \fn short **silent_wave() 
  * \brief joue une note en silence (lol)
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *silent_wave(short *buffer, size_t sample_count,double freq);
+short *silent_wave(short *buffer, size_t offset, size_t sample_count, double freq);
 
 /**
  * \fn switch_instrument()
  * \brief joue une note sur un instrument
  * \param note_t note note à jouer
  * \param double freq frequence réelle de la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param double time durée du temps
+ * \param voices les voix des plugins du channel (NULL : bloc isolé, voir plugin_render)
  */
-void switch_instrument(short * buffer,note_t note,double freq,size_t time,short effect);
-
-/**
- * \fn  noteToTime()
- * \brief transforme une note en temps
- * \param note_t note note à jouer
- * \param short bpm bpm de la musique
- * \return time temps de la note en double
- */
-size_t noteToTime(note_t note, short bpm);
-
-/**
- * \fn  noteToFreq()
- * \brief transforme une note en fréquence
- * \param note_t note note à jouer
- * \return frequence de la note en double
- */
-double noteToFreq(note_t note);
+void switch_instrument(short * buffer,note_t note,double freq,size_t offset,size_t time,short effect,sound_quality_t quality,plugin_voices_t *voices);
 
 /**
  * \fn  pdt_convolution()
@@ -141,10 +139,12 @@ short * pdt_convolution(short * buffer1,short * buffer2,size_t time);
  * \fn short **organ_wave() 
  * \brief joue une note en orgue 
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
+ * \param int partials nombre maximal de partiels calculés
  */
-short *organ_wave(short *buffer, size_t sample_count, double freq);
+short *organ_wave(short *buffer, size_t offset, size_t sample_count, double freq, int partials);
 
 
 /**
@@ -153,23 +153,8 @@ short *organ_wave(short *buffer, size_t sample_count, double freq);
  * \param note_t note note à jouer
  * \return frequence de la note en double
  */
-short *sinphaser_wave(short *buffer,size_t sample_count, double freq);
-
-/**
- * \fn  fuzz_effect()
- * \brief transforme une note en fréquence
- * \param note_t note note à jouer
- * \return frequence de la note en double
- */
-short *fuzz_effect(short *buffer,size_t sample_count);
+short *sinphaser_wave(short *buffer, size_t offset, size_t sample_count, double freq);
 
-/**
- * \fn  compression_effect()
- * \brief transforme une note en fréquence
- * \param note_t note note à jouer
- * \return frequence de la note en double
- */
-short * compression_effect(short *buffer,size_t time);
 /* ------------------------------------------------------------------------ */
 /*                  C O D E    D E S    F O N C T I O N S                   */
 /* ------------------------------------------------------------------------ */
@@ -180,9 +165,41 @@ short * compression_effect(short *buffer,size_t time);
  * \brief initialise la bibliothèque 
  */
 void init_sound(snd_pcm_t **pcm){
+    init_sound_period(pcm, SOUND_PERIOD_FRAMES, 10); // 10 périodes de 0.1 seconde
+}
+
+/**
+ * \fn int init_sound_period(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods)
+ * \brief initialise le flux avec une taille de période donnée
+ * \param pcm le flux à ouvrir
+ * \param periodFrames le nombre d'échantillons par période
+ * \param periods le nombre de périodes dans le tampon
+ * \return 0 si le flux est ouvert, un code d'erreur ALSA négatif sinon
+ */
+int init_sound_period(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods){
+    return init_sound_rate(pcm, periodFrames, periods, NULL);
+}
+
+/**
+ * \fn int init_sound_rate(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods, unsigned int *rate)
+ * \brief initialise le flux à la fréquence la plus proche de SAMPLE_RATE acceptée par le périphérique
+ * \param pcm le flux à ouvrir
+ * \param periodFrames le nombre d'échantillons par période à SAMPLE_RATE
+ * \param periods le nombre de périodes dans le tampon
+ * \param rate la fréquence obtenue (NULL pour exiger SAMPLE_RATE)
+ * \return 0 si le flux est ouvert, un code d'erreur ALSA négatif sinon
+ */
+int init_sound_rate(snd_pcm_t **pcm, snd_pcm_uframes_t periodFrames, unsigned int periods, unsigned int *rate){
+    int err;
+    unsigned int deviceRate = SAMPLE_RATE;
+    snd_pcm_uframes_t bufferFrames;
 
     // On utilise le device par défaut
-    snd_pcm_open(pcm, "default", SND_PCM_STREAM_PLAYBACK, 0);
+    err = snd_pcm_open(pcm, "default", SND_PCM_STREAM_PLAYBACK, 0);
+    if(err < 0) {
+        *pcm = NULL;
+        return err;
+    }
     // On créer une structure pour les paramètres du son
     snd_pcm_hw_params_t *hw_params;
     snd_pcm_hw_params_alloca(&hw_params);
@@ -191,12 +208,30 @@ void init_sound(snd_pcm_t **pcm){
     snd_pcm_hw_params_set_access(*pcm, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED); // On utilise un accès RW
     snd_pcm_hw_params_set_format(*pcm, hw_params, SND_PCM_FORMAT_S16_LE); // On utilise un format 16 bits
     snd_pcm_hw_params_set_channels(*pcm, hw_params, 1); // On utilise un seul canal
-    snd_pcm_hw_params_set_rate(*pcm, hw_params, SAMPLE_RATE, 0); // On utilise un taux d'échantillonnage de 48000 Hz
-    snd_pcm_hw_params_set_periods(*pcm, hw_params, 10, 0); // On utilise 10 périodes
-    snd_pcm_hw_params_set_period_time(*pcm, hw_params, 100000, 0); // 0.1 seconds
-    snd_pcm_hw_params(*pcm, hw_params);
+    // Un périphérique qui refuse 48000 Hz ne doit pas être ouvert à une autre fréquence
+    // sans que l'appelant le sache : la hauteur des notes serait fausse
+    if(rate == NULL) err = snd_pcm_hw_params_set_rate(*pcm, hw_params, SAMPLE_RATE, 0);
+    else err = snd_pcm_hw_params_set_rate_near(*pcm, hw_params, &deviceRate, 0);
+    if(err < 0) {
+        snd_pcm_close(*pcm);
+        *pcm = NULL;
+        return err;
+    }
+    // La période garde la même durée à la fréquence du périphérique
+    periodFrames = periodFrames * deviceRate / SAMPLE_RATE;
+    bufferFrames = periodFrames * periods;
+    snd_pcm_hw_params_set_period_size_near(*pcm, hw_params, &periodFrames, 0); // Taille d'une période
+    snd_pcm_hw_params_set_buffer_size_near(*pcm, hw_params, &bufferFrames); // Taille du tampon
+    err = snd_pcm_hw_params(*pcm, hw_params);
+    if(err < 0) {
+        snd_pcm_close(*pcm);
+        *pcm = NULL;
+        return err;
+    }
     snd_pcm_nonblock(*pcm, 0); // On met le flux en mode bloquant
     snd_pcm_prepare(*pcm); // On prépare le flux
+    if(rate != NULL) *rate = deviceRate;
+    return 0;
 }
 
 /**
@@ -214,39 +249,84 @@ void end_sound(snd_pcm_t *pcm){
  * \brief joue une note 
  * \param bpm le bpm de la musique 
  * \param note la note à jouer 
+ * \param stats les statistiques audio à mettre à jour (peut être NULL)
  */
-void play_note(note_t note,short bpm,snd_pcm_t *pcm,short effect) {;
-    //snd_pcm_prepare(pcm); // On prépare le flux
+void play_note(note_t note,short bpm,snd_pcm_t *pcm,short effect,audio_stats_t *stats) {
 	//fonction qui transforme un note_t en freq ( réelle )
 	double freq = noteToFreq(note);
 	//calculer la durée de la note en fonction du bpm
 	size_t time = noteToTime(note,bpm);
+	size_t written = 0, frames;
+	long long start, renderNs;
+	snd_pcm_sframes_t delay;
     // On alloue un buffer pour stocker le sample de la note
 	short * buffer = (short*)malloc(sizeof(short)*time);
 
-    // On joue la note
-	switch_instrument(buffer,note,freq,time,effect);//on joue la note 
-	
-    // On écrit le buffer dans le flux
-    snd_pcm_writei(pcm, buffer, time);
-    // On attends autant de temps que la note dure
-    //snd_pcm_drain(pcm); // On vide le tampon
+    // On joue la note en mesurant le temps de rendu
+	start = audio_clock_ns();
+	switch_instrument(buffer,note,freq,0,time,effect,SOUND_QUALITY_FULL,NULL);//on joue la note 
+	renderNs = audio_clock_ns() - start;
+
+    // On écrit le buffer dans le flux période par période
+    while(written < time) {
+        frames = time - written > SOUND_PERIOD_FRAMES ? SOUND_PERIOD_FRAMES : time - written;
+        if(write_pcm(pcm, buffer + written, frames, stats) < 0) break;
+        written += frames;
+        if(snd_pcm_delay(pcm, &delay) < 0) delay = -1;
+        // Le coût du rendu de la note est réparti sur ses périodes
+        record_audio_period(stats, renderNs * frames / time, (long long) frames * NSEC_PER_SEC / SAMPLE_RATE, delay);
+    }
 
     free(buffer); // On libère la mémoire allouée pour le buffer
 }
 
+/**
+ * \fn int write_pcm(snd_pcm_t *pcm, short *buffer, size_t frames, audio_stats_t *stats)
+ * \brief écrit un buffer dans le flux en récupérant les xruns
+ * \param pcm le flux
+ * \param buffer les échantillons à écrire
+ * \param frames le nombre d'échantillons
+ * \param stats les statistiques audio à mettre à jour (peut être NULL)
+ * \return le nombre d'échantillons écrits, ou un code d'erreur ALSA négatif si le flux est perdu
+ */
+long write_pcm(snd_pcm_t *pcm, short *buffer, size_t frames, audio_stats_t *stats) {
+    size_t written = 0;
+    snd_pcm_sframes_t ret;
+    while(written < frames) {
+        ret = snd_pcm_writei(pcm, buffer + written, frames - written);
+        if(ret == -EAGAIN) {
+            // Flux non bloquant plein : on attend qu'il accepte des échantillons au lieu de boucler
+            ret = snd_pcm_wait(pcm, -1);
+            if(ret < 0) return ret;
+            continue;
+        }
+        if(ret == -EPIPE || ret == -ESTRPIPE) {
+            // Underrun (-EPIPE) ou suspension (-ESTRPIPE) : on relance le flux
+            int err = snd_pcm_recover(pcm, ret, 1);
+            record_audio_xrun(stats, err == 0);
+            if(err < 0) return err;
+            continue;
+        }
+        // Toute autre erreur (périphérique perdu, flux dans un mauvais état) n'est pas un xrun
+        if(ret < 0) return ret;
+        written += ret;
+    }
+    return written;
+}
+
 /**
  * \fn short *sine_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *sine_wave(short *buffer, size_t sample_count, double freq) {
+short *sine_wave(short *buffer, size_t offset, size_t sample_count, double freq) {
 	int i;
     double t; // Temps en secondes
     for (i = 0; i < sample_count; i++) {
-        t = ((double)i) / SAMPLE_RATE; // On calcule le temps en secondes
+        t = ((double)(offset + i)) / SAMPLE_RATE; // On calcule le temps en secondes
         // On le multiplie par BASE_AMPLITUDE pour le mettre à l'échelle
         buffer[i] = BASE_AMPLITUDE * sine_sound(t, 1, 0, freq); // Création du signal sinusoïdal
     }
@@ -254,13 +334,13 @@ short *sine_wave(short *buffer, size_t sample_count, double freq) {
 }
 
 
-short *sinphaser_wave(short *buffer,size_t sample_count,double freq){
+short *sinphaser_wave(short *buffer, size_t offset, size_t sample_count, double freq){
 	int i;
     double t;
 	for(i=0;i<sample_count;i++){
-        t = ((double)i) / SAMPLE_RATE; // On calcule le temps en secondes
+        t = ((double)(offset + i)) / SAMPLE_RATE; // On calcule le temps en secondes
         double sine1 = sine_sound(t, 1, 0, freq);
-        double sine2 = sine_sound(i, 1, 1/(freq*2), freq); // pk 1/(freq*2) t inaudible la 
+        double sine2 = sine_sound(offset + i, 1, 1/(freq*2), freq); // pk 1/(freq*2) t inaudible la 
         //double sine2 = sine_sound(t, 1, M_PI/4,freq); // on tente avec une phase de pi/4 
 		buffer[i] = BASE_AMPLITUDE * (sine1 + sine2);
 	
@@ -285,37 +365,27 @@ double sine_sound(double time, double amplitude , double phase, double freq ){
  * \fn short *sine_chelou_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
+ * \param int partials nombre maximal de partiels calculés
  */
-short *organ_wave(short *buffer, size_t sample_count, double freq){
-	int i;
-    double sinus1, sinus2, sinus3, sinus4, sinus5, sinus6, sinus7, sinus8, sinus9;
-    double drawbar16 = freq / 2.0;
-    double drawbar5N1T3 = drawbar16 * 3.0;
-    double drawbar8 = freq;
-    double drawbar4 = freq * 2.0;
-    double drawbar2N2T3 = freq * 3.0;
-    double drawbar2 = freq * 4.0;
-    double drawbar1N3 = freq * 5.0;
-    double drawbar1N1T3 = freq * 6.0;
-    double drawbar1 = freq * 8.0;
-    double t;
-    //  {0, 8, 4, 0, 0, 0, 0, 4, 0};
+short *organ_wave(short *buffer, size_t offset, size_t sample_count, double freq, int partials){
+	int i, j;
+    // Tirettes {0, 8, 4, 0, 0, 0, 0, 4, 0} : seules 5 1/3', 8' et 1 1/3' sonnent, de la plus
+    // forte à la plus faible (les tirettes à 0 ne changent pas la somme)
+    double drawbars[] = {1.5, 1.0, 6.0};
+    double amplitude[] = {1.0, 0.5, 0.5};
+    double t, result;
 
+    if(partials > 3) partials = 3;
 	for (i = 0; i < sample_count; i++) {
-        t = (double)i / SAMPLE_RATE;
-        sinus1 = sine_sound(t, 0, 0.0, drawbar16) * (0)/8;
-        sinus2 = sine_sound(t, 1, 0.0, drawbar5N1T3);
-        sinus3 = sine_sound(t, 0.5, 0.0, drawbar8);
-        sinus4 = sine_sound(t, 0, 0.0, drawbar4);
-        sinus5 = sine_sound(t, 0, 0.0, drawbar2N2T3);
-        sinus6 = sine_sound(t, 0, 0.0, drawbar2);
-        sinus7 = sine_sound(t, 0, 0.0, drawbar1N3);
-        sinus8 = sine_sound(t, 0.5, 0.0, drawbar1N1T3);
-        sinus9 = sine_sound(t, 0, 0.0, drawbar1);
-
-        buffer[i]= BASE_AMPLITUDE * (sinus1 + sinus2 + sinus3 + sinus4 + sinus5 + sinus6 + sinus7 + sinus8 + sinus9);
+        t = (double)(offset + i) / SAMPLE_RATE;
+        result = 0.0;
+        for (j = 0; j < partials; j++) {
+            result += sine_sound(t, amplitude[j], 0.0, freq * drawbars[j]);
+        }
+        buffer[i]= BASE_AMPLITUDE * result;
     }
 
 	/*	
@@ -335,14 +405,17 @@ short *organ_wave(short *buffer, size_t sample_count, double freq){
  * \fn short *square_wave()
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *square_wave(short *buffer, size_t sample_count, double freq) {
-	int samples_full_cycle = (double)SAMPLE_RATE / (double)freq;
-	int samples_half_cycle = samples_full_cycle / 2.0f;
-	int cycle_index = 0;
+short *square_wave(short *buffer, size_t offset, size_t sample_count, double freq) {
+	int samples_full_cycle, samples_half_cycle, cycle_index;
 	int i = 0;
+	if(freq <= 0) return silent_wave(buffer, offset, sample_count, freq);
+	samples_full_cycle = (double)SAMPLE_RATE / (double)freq;
+	samples_half_cycle = samples_full_cycle / 2.0f;
+	cycle_index = offset % samples_full_cycle; // On reprend le cycle là où il en était
 	for (i = 0; i < sample_count; i++) {
 		buffer[i] = cycle_index < samples_half_cycle ? BASE_AMPLITUDE : -BASE_AMPLITUDE;
 		cycle_index = (cycle_index + 1) % samples_full_cycle;
@@ -354,13 +427,14 @@ short *square_wave(short *buffer, size_t sample_count, double freq) {
  * \fn short *sawtooth_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *sawtooth_wave(short *buffer, size_t sample_count, double freq) {
+short *sawtooth_wave(short *buffer, size_t offset, size_t sample_count, double freq) {
 	int i = 0;
     for (i = 0; i < sample_count; i++) {
-        double t = ((double)i / SAMPLE_RATE);
+        double t = ((double)(offset + i) / SAMPLE_RATE);
         double frac = t - floor(t); // Partie fractionnaire de t
         buffer[i] = BASE_AMPLITUDE * (2 * frac - 1); // Création du signal de scie
     }
@@ -372,13 +446,14 @@ short *sawtooth_wave(short *buffer, size_t sample_count, double freq) {
  * \fn short *triangle_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *triangle_wave(short *buffer, size_t sample_count, double freq) {
+short *triangle_wave(short *buffer, size_t offset, size_t sample_count, double freq) {
 	int i = 0;	
     for (i = 0; i < sample_count; i++) {
-        double t = ((double)i / SAMPLE_RATE) * freq;
+        double t = ((double)(offset + i) / SAMPLE_RATE) * freq;
         double frac = t - (int)t; // Partie fractionnaire de t
         buffer[i] = BASE_AMPLITUDE * (2 * fabs(frac) - 1); // Utilisation de la fonction valeur absolue pour obtenir le signal triangulaire
     }
@@ -390,17 +465,19 @@ short *triangle_wave(short *buffer, size_t sample_count, double freq) {
  * \fn short **warm_wave() 
  * \brief joue une note en sinus
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
+ * \param int partials nombre maximal de partiels calculés
  */
-short *warm_wave(short *buffer, size_t sample_count, double freq) {
+short *warm_wave(short *buffer, size_t offset, size_t sample_count, double freq, int partials) {
     int i = 0;
     for (i = 0; i < sample_count; i++) {
-        float t = ((float)i / SAMPLE_RATE);
+        float t = ((float)(offset + i) / SAMPLE_RATE);
         float value = 0.0;
         // Somme des sinus harmoniques
         int harmonics = 1;
-        for (harmonics = 1; harmonics <= 10; harmonics++) {
+        for (harmonics = 1; harmonics <= 10 && harmonics <= partials; harmonics++) {
             value += sin(2 * M_PI * freq * harmonics * t) / harmonics;
         }
 
@@ -418,37 +495,44 @@ double random_uniform() {
  * @fn piano_wave()
  * @brief joue une note en piano
  * @param short *buffer buffer de short pour la note
+ * @param size_t offset position du premier échantillon dans la note
  * @param size_t sample_count nb d'échantillonage
  * @param double freq fréquence d'échantillonage
+ * @param int partials nombre maximal de partiels calculés
  * @return short *buffer
  */
-short *piano_wave(short *buffer, size_t sample_count, double freq) {
+short *piano_wave(short *buffer, size_t offset, size_t sample_count, double freq, int partials) {
     // Tentative de piano par synthèse additive
     // PS : c'est foireux
     double amplitude[] = {1.0, 0.5, 0.3, 0.2, 0.1};
     double phase[] = {0.0, 0.0, 0.0, 0.0, 0.0};
     double harmonics[] = {1.0, 2.5, 3.5, 1.5, 5.5};
     double t, result;
-    size_t i, j;
+    size_t i;
+    int j;
 
+    if(partials > 5) partials = 5;
     for (i = 0; i < sample_count; i++) {
-        t = (double)i / SAMPLE_RATE;
+        t = (double)(offset + i) / SAMPLE_RATE;
         result = 0.0;
-        for (j = 0; j < 5; j++) {
+        // Les partiels sont rangés du plus fort au plus faible
+        for (j = 0; j < partials; j++) {
             result += sine_sound(t, amplitude[j], phase[j], freq * harmonics[j]);
         }
         buffer[i] = BASE_AMPLITUDE * result;
     }
+    return buffer;
 }
 
 /**
  * \fn short **silent_wave() 
  * \brief joue une note en silence (lol)
  * \param short *buffer buffer de short pour la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param size_t sample_count nb d'échantillonage
  * \param double freq fréquence d'échantillonage
  */
-short *silent_wave(short *buffer, size_t sample_count,double freq){
+short *silent_wave(short *buffer, size_t offset, size_t sample_count, double freq){
 	int i = 0;	
     for (i = 0; i < sample_count; i++) {
         buffer[i] = 0; // on met rien
@@ -490,52 +574,228 @@ int i;
 return buffer;
 }
 
+static int deterministic = SOUND_DETERMINISTIC; /*!< Rendu en virgule fixe (lu par les threads audio) */
+
+/**
+ * \fn short *det_partials_wave(short *buffer, size_t offset, size_t sample_count, double freq, const double *ratios, const int *weights, int partials, int total)
+ * \brief somme de sinus en virgule fixe (rendu déterministe)
+ * \param buffer buffer de short pour la note
+ * \param offset position du premier échantillon dans la note
+ * \param sample_count nb d'échantillonage
+ * \param freq fréquence de la note
+ * \param ratios rapport de fréquence de chaque partiel
+ * \param weights poids entier de chaque partiel
+ * \param partials nombre de partiels calculés
+ * \param total poids correspondant à BASE_AMPLITUDE
+ */
+static short *det_partials_wave(short *buffer, size_t offset, size_t sample_count, double freq, const double *ratios, const int *weights, int partials, int total) {
+    unsigned int inc[10];
+    long long result;
+    size_t i;
+    int j;
+    for(j = 0; j < partials; j++) inc[j] = det_phase(freq * ratios[j] / SAMPLE_RATE);
+    for(i = 0; i < sample_count; i++) {
+        result = 0;
+        // La phase de l'échantillon n vaut n * inc modulo 2^32 : elle ne dépend pas du découpage
+        for(j = 0; j < partials; j++) result += (long long) weights[j] * det_sin((unsigned int) (offset + i) * inc[j]);
+        buffer[i] = (short) (result * BASE_AMPLITUDE / ((long long) total * DETMATH_ONE));
+    }
+    return buffer;
+}
+
+/**
+ * \fn short *det_sinphaser_wave(short *buffer, size_t offset, size_t sample_count, double freq)
+ * \brief sinphaser en virgule fixe (rendu déterministe)
+ * \param buffer buffer de short pour la note
+ * \param offset position du premier échantillon dans la note
+ * \param sample_count nb d'échantillonage
+ * \param freq fréquence de la note
+ */
+static short *det_sinphaser_wave(short *buffer, size_t offset, size_t sample_count, double freq) {
+    unsigned int inc1 = det_phase(freq / SAMPLE_RATE), inc2 = det_phase(freq), phase2 = 0;
+    long long result;
+    size_t i;
+    // Même signal que sinphaser_wave : le second sinus avance de freq périodes par échantillon,
+    // déphasé de 1/(2 freq) radians
+    if(freq > 0) phase2 = det_phase(1 / (4 * M_PI * freq));
+    for(i = 0; i < sample_count; i++) {
+        result = det_sin((unsigned int) (offset + i) * inc1) + det_sin((unsigned int) (offset + i) * inc2 + phase2);
+        buffer[i] = (short) (result * BASE_AMPLITUDE / DETMATH_ONE);
+    }
+    return buffer;
+}
+
+/**
+ * \fn short *det_triangle_wave(short *buffer, size_t offset, size_t sample_count, double freq)
+ * \brief triangle_wave en virgule fixe (rendu déterministe)
+ * \param buffer buffer de short pour la note
+ * \param offset position du premier échantillon dans la note
+ * \param sample_count nb d'échantillonage
+ * \param freq fréquence de la note
+ */
+static short *det_triangle_wave(short *buffer, size_t offset, size_t sample_count, double freq) {
+    long long phase;
+    size_t i;
+    for(i = 0; i < sample_count; i++) {
+        // Phase recalculée à chaque échantillon (et non incrémentée) : comme triangle_wave, le saut
+        // tombe exactement sur les fins de période entières
+        phase = det_phase((double) (offset + i) / SAMPLE_RATE * freq);
+        buffer[i] = (short) (BASE_AMPLITUDE * (phase - 2147483648LL) / 2147483648LL);
+    }
+    return buffer;
+}
+
+/**
+ * \fn short *det_switch_instrument(short *buffer, note_t note, double freq, size_t offset, size_t time, short effect, sound_quality_t quality)
+ * \brief joue une note sur un instrument en virgule fixe (rendu déterministe)
+ * \param buffer buffer de short pour la note
+ * \param note note à jouer
+ * \param freq frequence réelle de la note
+ * \param offset position du premier échantillon dans la note
+ * \param time nombre d'échantillons
+ * \param effect l'effet à appliquer
+ * \param quality le niveau de qualité
+ * \return 1 si l'instrument a été calculé, 0 s'il n'a pas de version déterministe
+ */
+static int det_switch_instrument(short *buffer, note_t note, double freq, size_t offset, size_t time, short effect, sound_quality_t quality) {
+    // Mêmes partiels et mêmes proportions que les instruments flottants, poids entiers
+    static const double one[] = {1.0};
+    static const int oneWeight[] = {1};
+    static const double organ[] = {1.5, 1.0, 6.0};
+    static const int organWeights[] = {2, 1, 1};
+    static const double piano[] = {1.0, 2.5, 3.5, 1.5, 5.5};
+    static const int pianoWeights[] = {10, 5, 3, 2, 1};
+    static const double warm[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    static const int warmWeights[] = {2520, 1260, 840, 630, 504, 420, 360, 315, 280, 252};
+    int reduced = quality >= SOUND_QUALITY_PARTIALS;
+    size_t i;
+    int b;
+
+    init_detmath();
+    switch(note.instrument) {
+        case INSTRUMENT_SIN:
+            det_partials_wave(buffer, offset, time, freq, one, oneWeight, 1, 1);
+        break;
+        case INSTRUMENT_SAWTOOTH:
+            det_partials_wave(buffer, offset, time, freq, warm, warmWeights, reduced ? SOUND_WARM_REDUCED_PARTIALS : 10, 2520);
+        break;
+        case INSTRUMENT_TRIANGLE:
+            det_triangle_wave(buffer, offset, time, freq);
+        break;
+        // Déjà calculé en entiers
+        case INSTRUMENT_SQUARE:
+            square_wave(buffer, offset, time, freq);
+        break;
+        case INSTRUMENT_ORGAN:
+            det_partials_wave(buffer, offset, time, freq, organ, organWeights, reduced ? SOUND_ORGAN_REDUCED_PARTIALS : 3, 2);
+        break;
+        case INSTRUMENT_SINPHASER:
+            det_sinphaser_wave(buffer, offset, time, freq);
+        break;
+        case INSTRUMENT_PIANO:
+            det_partials_wave(buffer, offset, time, freq, piano, pianoWeights, reduced ? SOUND_PIANO_REDUCED_PARTIALS : 5, 10);
+        break;
+        case INSTRUMENT_STEPMOTOR:
+            silent_wave(buffer, offset, time, freq);
+        break;
+        default:
+            return 0;
+    }
+
+    if(quality >= SOUND_QUALITY_NO_EFFECTS) return 1;
+    for(i = 0; i < time && effect == 1; i++) buffer[i] = (short) det_fuzz(buffer[i]);
+    // compression_effect en entiers : au-delà de BASE_AMPLITUDE / 2, (b + 3/2 BASE_AMPLITUDE) / 4
+    for(i = 0; i < time && effect == 2; i++) {
+        b = buffer[i];
+        if(b > BASE_AMPLITUDE / 2) buffer[i] = (short) ((b + 3 * BASE_AMPLITUDE / 2) / 4);
+        else if(b < -BASE_AMPLITUDE / 2) buffer[i] = (short) (-(b + 3 * BASE_AMPLITUDE / 2) / 4);
+    }
+    return 1;
+}
+
+/**
+ * \fn void set_sound_deterministic(int enabled)
+ * \brief active ou coupe le rendu déterministe
+ * \param enabled 1 pour calculer les instruments internes et les effets en virgule fixe (detmath.h)
+ */
+void set_sound_deterministic(int enabled) {
+    if(enabled) init_detmath();
+    __atomic_store_n(&deterministic, enabled != 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * \fn int sound_deterministic()
+ * \brief indique si le rendu déterministe est actif
+ * \return 1 si actif, 0 sinon
+ */
+int sound_deterministic() {
+    return __atomic_load_n(&deterministic, __ATOMIC_RELAXED);
+}
+
 /**
  * \fn switch_instrument()
  * \brief joue une note sur un instrument
  * \param note_t note note à jouer
  * \param double freq frequence réelle de la note
+ * \param size_t offset position du premier échantillon dans la note
  * \param double time durée du temps
+ * \param voices les voix des plugins du channel (NULL : bloc isolé, voir plugin_render)
  */
  //sample rate x la durée = sample_count
-void switch_instrument(short *buffer,note_t note,double freq,size_t time,short effect){
+void switch_instrument(short *buffer,note_t note,double freq,size_t offset,size_t time,short effect,sound_quality_t quality,plugin_voices_t *voices){
+	int reduced = quality >= SOUND_QUALITY_PARTIALS;
+	const plugin_t *plugin;
+
+	// Rendu déterministe : les instruments internes passent par detmath.h
+	if(sound_deterministic() && det_switch_instrument(buffer,note,freq,offset,time,effect,quality)) return;
 	
 	switch(note.instrument){
 		
 		case INSTRUMENT_SIN:
-			sine_wave(buffer,time,freq);
+			sine_wave(buffer,offset,time,freq);
 		break;
 		
 		case INSTRUMENT_SAWTOOTH:
-			warm_wave(buffer,time,freq);
+			warm_wave(buffer,offset,time,freq,reduced ? SOUND_WARM_REDUCED_PARTIALS : SOUND_ALL_PARTIALS);
 		break;
 		
 		case INSTRUMENT_TRIANGLE:
-			triangle_wave(buffer,time,freq);
+			triangle_wave(buffer,offset,time,freq);
 		break;
 		
 		case INSTRUMENT_SQUARE:
-			square_wave(buffer,time,freq);
+			square_wave(buffer,offset,time,freq);
 		break;
 		
 		case INSTRUMENT_ORGAN:
-			organ_wave(buffer,time,freq);
+			organ_wave(buffer,offset,time,freq,reduced ? SOUND_ORGAN_REDUCED_PARTIALS : SOUND_ALL_PARTIALS);
 		break;
 		
 		case INSTRUMENT_SINPHASER:
-			sinphaser_wave(buffer,time,freq);
+			sinphaser_wave(buffer,offset,time,freq);
 		break;
 
         case INSTRUMENT_PIANO:
-            piano_wave(buffer, time, freq);
+            piano_wave(buffer, offset, time, freq, reduced ? SOUND_PIANO_REDUCED_PARTIALS : SOUND_ALL_PARTIALS);
         break;
-		
+
+		// Le moteur pas à pas joue la note lui-même : rien sur la carte son
+		case INSTRUMENT_STEPMOTOR:
+			silent_wave(buffer,offset,time,freq);
+		break;
+
+		// Instrument en plugin : un appel pour tout le morceau, la voix du channel garde son état
 		default : 
-			silent_wave(buffer,time,freq);
+			plugin = instrument_plugin(note.instrument);
+			if(plugin != NULL && voices != NULL) plugin_voices_render(voices,buffer,time);
+			else if(plugin != NULL) plugin_render(plugin,buffer,freq,offset,time);
+			else silent_wave(buffer,offset,time,freq);
 		break;
 		
 	}
 	
+	// Sous forte charge les effets sont coupés : la note reste jouée sans distorsion
+	if(quality >= SOUND_QUALITY_NO_EFFECTS) return;
 	if(effect == 1 ){
 		fuzz_effect(buffer,time);
 	}
@@ -553,7 +813,8 @@ void switch_instrument(short *buffer,note_t note,double freq,size_t time,short e
  * \return frequence de la note en double
  */
 double noteToFreq(note_t note){
-	return note.frequency * pow(2,(double)note.octave-3);
+	// ldexp est exact (une puissance de deux) : même fréquence sur toutes les machines
+	return ldexp(note.frequency, note.octave - 3);
 	//return note.frequency;
 }
 
@@ -569,6 +830,133 @@ size_t noteToTime(note_t note, short bpm){
 	return round(SAMPLE_RATE*(60.0/bpm)*(note.time/4.0));
 }
 
+/**
+ * \fn long long ticksToFrames(long long ticks, short bpm)
+ * \brief transforme une position musicale en nombre d'échantillons
+ * \param ticks la position en doubles croches (unité de time_duration_t)
+ * \param bpm bpm de la musique
+ * \return le nombre d'échantillons depuis le début de la musique
+ * \note la conversion se fait depuis la position cumulée et non note par note :
+ * les arrondis ne s'accumulent pas et tous les channels tombent sur les mêmes échantillons
+ */
+long long ticksToFrames(long long ticks, short bpm){
+	return phaseToFrames(0, ticks * SOUND_TICK_PHASE, bpm);
+}
+
+/**
+ * \fn long long framesToTicks(long long frames, short bpm)
+ * \brief transforme un nombre d'échantillons en position musicale
+ * \param frames le nombre d'échantillons depuis le début de la musique
+ * \param bpm bpm de la musique
+ * \return la dernière double croche commencée (réciproque exacte de ticksToFrames)
+ */
+long long framesToTicks(long long frames, short bpm) {
+	if(frames <= 0) return 0;
+	return frames * bpm / SOUND_TICK_PHASE;
+}
+
+/**
+ * \fn long long phaseToFrames(long long phase, long long target, short bpm)
+ * \brief nombre d'échantillons pour amener la phase du transport jusqu'à une cible
+ * \param phase la phase actuelle (en 1/SOUND_TICK_PHASE de double croche)
+ * \param target la phase à atteindre
+ * \param bpm le tempo : la phase avance de bpm à chaque échantillon
+ * \return le nombre d'échantillons (0 si la cible est déjà atteinte)
+ */
+long long phaseToFrames(long long phase, long long target, short bpm) {
+	if(target <= phase) return 0;
+	if(bpm < MUSIC_MIN_BPM) bpm = MUSIC_MIN_BPM;
+	return (target - phase + bpm - 1) / bpm;
+}
+
+/**
+ * \fn long long tempoTicksToFrames(music_t *music, long long ticks)
+ * \brief transforme une position musicale en nombre d'échantillons en suivant les changements de tempo
+ * \param music la musique
+ * \param ticks la position en doubles croches
+ * \return le nombre d'échantillons depuis le début de la musique
+ * \note donne exactement les mêmes échantillons que le transport du moteur audio
+ * (sans tempo modifié en direct) : un rendu hors temps réel est identique à la lecture
+ */
+long long tempoTicksToFrames(music_t *music, long long ticks){
+	long long frames = 0, phase = 0, n;
+	short bpm = music->bpm;
+	int i;
+	// Chaque changement de tempo s'applique au premier échantillon qui atteint sa position
+	for(i = 0; i < music->nbTempos && music->tempos[i].tick <= ticks; i++) {
+		n = phaseToFrames(phase, music->tempos[i].tick * SOUND_TICK_PHASE, bpm);
+		frames += n;
+		phase += n * bpm;
+		bpm = music->tempos[i].bpm;
+	}
+	return frames + phaseToFrames(phase, ticks * SOUND_TICK_PHASE, bpm);
+}
+
+/**
+ * \fn void render_note(short *buffer, note_t note, size_t offset, size_t count, short effect)
+ * \brief calcule un morceau d'une note
+ * \param buffer le buffer à remplir
+ * \param note la note à jouer
+ * \param offset position du premier échantillon à calculer depuis le début de la note
+ * \param count nombre d'échantillons à calculer
+ * \param effect l'effet à appliquer
+ */
+void render_note(short *buffer, note_t note, size_t offset, size_t count, short effect){
+	switch_instrument(buffer, note, noteToFreq(note), offset, count, effect, SOUND_QUALITY_FULL, NULL);
+}
+
+/**
+ * \fn void render_note_quality(short *buffer, note_t note, size_t offset, size_t count, short effect, sound_quality_t quality)
+ * \brief calcule un morceau d'une note à un niveau de qualité donné
+ * \param buffer le buffer à remplir
+ * \param note la note à jouer
+ * \param offset position du premier échantillon à calculer depuis le début de la note
+ * \param count nombre d'échantillons à calculer
+ * \param effect l'effet à appliquer (ignoré à partir de SOUND_QUALITY_NO_EFFECTS)
+ * \param quality le niveau de qualité (voir governor.h)
+ */
+void render_note_quality(short *buffer, note_t note, size_t offset, size_t count, short effect, sound_quality_t quality){
+	switch_instrument(buffer, note, noteToFreq(note), offset, count, effect, quality, NULL);
+}
+
+/**
+ * \fn void render_note_voice(short *buffer, note_t note, plugin_voices_t *voices, int start, size_t offset, size_t count, short effect, sound_quality_t quality)
+ * \brief calcule le morceau suivant de la note d'un channel, voix des plugins comprises
+ * \param buffer le buffer à remplir
+ * \param note la note à jouer
+ * \param voices les voix des plugins du channel
+ * \param start 1 si le morceau est le premier calculé de la note (note_on)
+ * \param offset position du premier échantillon à calculer depuis le début de la note
+ * \param count nombre d'échantillons à calculer
+ * \param effect l'effet à appliquer (ignoré à partir de SOUND_QUALITY_NO_EFFECTS)
+ * \param quality le niveau de qualité (voir governor.h)
+ * \note Les morceaux d'une note sont calculés dans l'ordre : un plugin reçoit note_on au début
+ * de la note et note_off au début de la suivante. La fin de la note précédente est ajoutée
+ * sans effet
+ */
+void render_note_voice(short *buffer, note_t note, plugin_voices_t *voices, int start, size_t offset, size_t count, short effect, sound_quality_t quality){
+	double freq = noteToFreq(note);
+	if(start) plugin_voices_start(voices, note.id != NOTE_NA_ID ? instrument_plugin(note.instrument) : NULL, freq, offset);
+	switch_instrument(buffer, note, freq, offset, count, effect, quality, voices);
+	plugin_voices_mix_release(voices, buffer, count);
+}
+
+/**
+ * \fn const char *sound_quality_name(sound_quality_t quality)
+ * \brief nom d'un niveau de qualité
+ * \param quality le niveau
+ * \return "full", "partials", "linear" ou "no_effects"
+ */
+const char *sound_quality_name(sound_quality_t quality){
+	switch(quality){
+		case SOUND_QUALITY_FULL: return "full";
+		case SOUND_QUALITY_PARTIALS: return "partials";
+		case SOUND_QUALITY_LINEAR: return "linear";
+		case SOUND_QUALITY_NO_EFFECTS: return "no_effects";
+		default: return "unknown";
+	}
+}
+
 /**
  * \fn  pdt_convolution()
  * \brief fait un pdt de convolution entre buffer1 et 2 et écrase le buffer 1
@@ -595,22 +983,102 @@ short * pdt_convolution(short * buffer1, short * buffer2, size_t time) {
 }
 
 
+/**
+ * \fn unsigned int read_le(const unsigned char *data, int bytes)
+ * \brief lit un entier petit boutiste d'un en-tête WAV
+ */
+static unsigned int read_le(const unsigned char *data, int bytes){
+    unsigned int value = 0;
+    while(bytes-- > 0) value = (value << 8) | data[bytes];
+    return value;
+}
+
+/**
+ * \fn short *load_sample(char *path, size_t *frames)
+ * \brief charge un sample et le convertit à SAMPLE_RATE
+ * \param path le fichier : WAV PCM 16 bits (mono ou stéréo, à n'importe quelle fréquence)
+ * ou échantillons bruts 16 bits mono à SAMPLE_RATE
+ * \param frames le nombre d'échantillons chargés
+ * \return les échantillons (à libérer) ou NULL si le fichier est absent ou invalide
+ */
+short *load_sample(char *path, size_t *frames){
+    FILE *f = fopen(path, "rb");
+    unsigned char *data, *samples = NULL;
+    unsigned int rate = SAMPLE_RATE, channels = 1, bits = 16, format = 1, length;
+    size_t size, pos, dataSize = 0, i, c;
+    short *buffer, *converted;
+    int sum;
+
+    if(f == NULL) return NULL;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(size > 0 ? size : 1);
+    if(data == NULL || fread(data, 1, size, f) != size) {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+
+    if(size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0) {
+        // On parcourt les blocs du fichier : seuls "fmt " et "data" sont utilisés
+        for(pos = 12; pos + 8 <= size; pos += 8 + length + (length & 1)) {
+            length = read_le(data + pos + 4, 4);
+            if(length > size - pos - 8) length = size - pos - 8;
+            if(memcmp(data + pos, "fmt ", 4) == 0 && length >= 16) {
+                format = read_le(data + pos + 8, 2);
+                channels = read_le(data + pos + 10, 2);
+                rate = read_le(data + pos + 12, 4);
+                bits = read_le(data + pos + 22, 2);
+            }
+            else if(memcmp(data + pos, "data", 4) == 0) {
+                samples = data + pos + 8;
+                dataSize = length;
+            }
+        }
+        if(samples == NULL || format != 1 || bits != 16 || channels == 0 || rate == 0) {
+            free(data);
+            return NULL;
+        }
+    }
+    else {
+        samples = data;
+        dataSize = size;
+    }
+
+    // Les canaux sont mélangés : le flux de sortie est mono
+    *frames = dataSize / (2 * channels);
+    buffer = malloc(sizeof(short) * (*frames > 0 ? *frames : 1));
+    if(buffer == NULL) {
+        free(data);
+        return NULL;
+    }
+    for(i = 0; i < *frames; i++) {
+        sum = 0;
+        for(c = 0; c < channels; c++) sum += (short) read_le(samples + 2 * (i * channels + c), 2);
+        buffer[i] = sum / (int) channels;
+    }
+    free(data);
+    if(rate == SAMPLE_RATE) return buffer;
+
+    // Un sample enregistré à une autre fréquence serait joué trop haut ou trop bas
+    converted = resample_buffer(buffer, *frames, rate, SAMPLE_RATE, SOUND_SAMPLE_QUALITY, frames);
+    free(buffer);
+    return converted;
+}
+
 void play_sample(char * fic,snd_pcm_t *pcm){
-    FILE *f = fopen(fic, "rb");
-    if(f==NULL)	{
+    size_t frames;
+    short *samples = load_sample(fic, &frames);
+    if(samples == NULL)	{
         printf("erreur fic");
         return;
     }
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    short *samples = (short*)malloc(file_size);
-    fread(samples, 1, file_size, f);
-    fclose(f);
 
-    snd_pcm_writei(pcm, samples, SAMPLE_RATE);
+    // Écritures partielles et xruns sont repris, un flux perdu arrête la lecture
+    if(write_pcm(pcm, samples, frames, NULL) < 0) printf("erreur pcm");
 
     free(samples);
 
 }
-
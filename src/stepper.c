@@ -0,0 +1,478 @@
+/**
+ * \file stepper.c
+ * \brief Channel moteur pas à pas : les notes sont jouées par des trains de pas
+ */
+#include <wiringPi.h>
+#include "stepper.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void *stepper_thread(void *args)
+ * \brief Thread temps réel : joue les morceaux en file pas par pas
+ * \param args Le moteur pas à pas
+ */
+void *stepper_thread(void *args);
+
+/**
+ * \fn void stepper_play_segment(stepper_t *stepper, stepper_segment_t *segment)
+ * \brief Joue les pas d'un morceau de note à leur date absolue
+ * \param stepper Le moteur pas à pas
+ * \param segment Le morceau à jouer
+ */
+void stepper_play_segment(stepper_t *stepper, stepper_segment_t *segment);
+
+/**
+ * \fn int stepper_frame2ns(stepper_t *stepper, double frame, long long *ns)
+ * \brief Convertit une position du transport en date absolue
+ * \param stepper Le moteur pas à pas
+ * \param frame La position du transport (fractionnaire)
+ * \param ns La date correspondante
+ * \return 0 si succès, -1 si le moteur audio n'a encore rien publié
+ */
+int stepper_frame2ns(stepper_t *stepper, double frame, long long *ns);
+
+/**
+ * \fn void stepper_record(stepper_t *stepper, long long jitter)
+ * \brief Enregistre la gigue d'un pas
+ * \param stepper Le moteur pas à pas
+ * \param jitter L'écart entre la date réelle et la date prévue du pas
+ */
+void stepper_record(stepper_t *stepper, long long jitter);
+
+/**
+ * \fn void ns2timespec(long long ns, struct timespec *ts)
+ * \brief Convertit une date en nanosecondes en timespec
+ * \param ns La date
+ * \param ts Le timespec à remplir
+ */
+void ns2timespec(long long ns, struct timespec *ts);
+
+// Implémentations de stepper_gpio_t (documentées avec leur code)
+int stepper_wiringpi_setup(stepper_gpio_t *gpio);
+void stepper_wiringpi_write(stepper_gpio_t *gpio, int pattern, long long targetNs);
+void stepper_wiringpi_release(stepper_gpio_t *gpio);
+int stepper_sim_setup(stepper_gpio_t *gpio);
+void stepper_sim_write(stepper_gpio_t *gpio, int pattern, long long targetNs);
+void stepper_sim_release(stepper_gpio_t *gpio);
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void init_stepper_gpio_wiringpi(stepper_gpio_t *gpio)
+ * \brief Prépare la couche GPIO qui pilote les bobines avec wiringPi
+ * \param gpio La couche GPIO à initialiser
+ * \warning wiringPiSetup doit avoir été appelé (init_wiringpi)
+ */
+void init_stepper_gpio_wiringpi(stepper_gpio_t *gpio) {
+    memset(gpio, 0, sizeof(stepper_gpio_t));
+    gpio->setup = stepper_wiringpi_setup;
+    gpio->write = stepper_wiringpi_write;
+    gpio->release = stepper_wiringpi_release;
+}
+
+/**
+ * \fn int init_stepper_gpio_sim(stepper_gpio_t *gpio, int maxPulses)
+ * \brief Prépare une couche GPIO simulée qui enregistre la date des pas
+ * \param gpio La couche GPIO à initialiser
+ * \param maxPulses Le nombre de pas à enregistrer (les suivants ne sont que comptés)
+ * \return 0 si succès, -1 si l'allocation a échoué
+ */
+int init_stepper_gpio_sim(stepper_gpio_t *gpio, int maxPulses) {
+    memset(gpio, 0, sizeof(stepper_gpio_t));
+    gpio->setup = stepper_sim_setup;
+    gpio->write = stepper_sim_write;
+    gpio->release = stepper_sim_release;
+    gpio->targets = malloc(maxPulses * sizeof(long long));
+    gpio->pulses = malloc(maxPulses * sizeof(long long));
+    if(gpio->targets == NULL || gpio->pulses == NULL) {
+        end_stepper_gpio(gpio);
+        return -1;
+    }
+    gpio->maxPulses = maxPulses;
+    return 0;
+}
+
+/**
+ * \fn void end_stepper_gpio(stepper_gpio_t *gpio)
+ * \brief Libère la couche GPIO
+ * \param gpio La couche GPIO
+ */
+void end_stepper_gpio(stepper_gpio_t *gpio) {
+    free(gpio->targets);
+    free(gpio->pulses);
+    gpio->targets = NULL;
+    gpio->pulses = NULL;
+    gpio->maxPulses = 0;
+}
+
+/**
+ * \fn int init_stepper(stepper_t *stepper, stepper_gpio_t *gpio)
+ * \brief Démarre le thread temps réel du moteur
+ * \param stepper Le moteur pas à pas
+ * \param gpio La couche GPIO à utiliser
+ * \return 0 si le thread est démarré, -1 sinon
+ * \note Les GPIO ne sont préparés qu'au premier morceau de note INSTRUMENT_STEPMOTOR : une
+ * musique sans moteur pas à pas ne touche pas aux broches
+ */
+int init_stepper(stepper_t *stepper, stepper_gpio_t *gpio) {
+    struct sched_param param;
+    memset(stepper, 0, sizeof(stepper_t));
+    stepper->gpio = gpio;
+    pthread_mutex_init(&stepper->lock, NULL);
+    stepper->running = 1;
+    if(pthread_create(&stepper->thread, NULL, stepper_thread, (void *) stepper) != 0) {
+        pthread_mutex_destroy(&stepper->lock);
+        stepper->gpio = NULL;
+        return -1;
+    }
+    // Un pas en retard s'entend : le thread passe avant l'interface, comme le mixage
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    pthread_setschedparam(stepper->thread, SCHED_FIFO, &param);
+    return 0;
+}
+
+/**
+ * \fn void end_stepper(stepper_t *stepper)
+ * \brief Arrête le thread et coupe les bobines
+ * \param stepper Le moteur pas à pas
+ */
+void end_stepper(stepper_t *stepper) {
+    if(stepper->gpio == NULL) return;
+    __atomic_store_n(&stepper->running, 0, __ATOMIC_RELEASE);
+    pthread_join(stepper->thread, NULL);
+    if(stepper->claimed > 0) stepper->gpio->release(stepper->gpio);
+    stepper->gpio = NULL;
+    pthread_mutex_destroy(&stepper->lock);
+}
+
+/**
+ * \fn int stepper_push(stepper_t *stepper, long long frame, long long frames, double freq, int restart)
+ * \brief Ajoute un morceau de note à jouer
+ * \param stepper Le moteur pas à pas
+ * \param frame La position du transport du premier échantillon
+ * \param frames Le nombre d'échantillons
+ * \param freq La fréquence de la note (ramenée par octaves entre STEPPER_MIN_FREQ et STEPPER_MAX_FREQ)
+ * \param restart 1 si le morceau commence une nouvelle note
+ * \return 0 si le morceau est en file, -1 si la file est pleine
+ * \note N'attend jamais : appelé par le thread de mixage
+ */
+int stepper_push(stepper_t *stepper, long long frame, long long frames, double freq, int restart) {
+    unsigned int head = stepper->head;
+    stepper_segment_t *segment;
+    if(head - __atomic_load_n(&stepper->tail, __ATOMIC_ACQUIRE) >= STEPPER_RING_SIZE) {
+        __atomic_add_fetch(&stepper->overruns, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    segment = &(stepper->ring[head & (STEPPER_RING_SIZE - 1)]);
+    segment->frame = frame;
+    segment->frames = frames;
+    segment->freq = stepperFreq(freq);
+    segment->restart = restart;
+    __atomic_store_n(&stepper->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * \fn void stepper_sync(stepper_t *stepper, long long frame, long long ns)
+ * \brief Publie la position du transport audible à une date
+ * \param stepper Le moteur pas à pas
+ * \param frame La position du transport qui sort du haut-parleur
+ * \param ns La date correspondante (audio_clock_ns)
+ * \note N'attend jamais : appelé par le thread de mixage après chaque période
+ */
+void stepper_sync(stepper_t *stepper, long long frame, long long ns) {
+    // Le compteur est impair pendant l'écriture : le lecteur recommence s'il tombe dessus
+    __atomic_add_fetch(&stepper->clockSeq, 1, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&stepper->clockFrame, frame, __ATOMIC_RELAXED);
+    __atomic_store_n(&stepper->clockNs, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stepper->clockSeq, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * \fn void stepper_flush(stepper_t *stepper)
+ * \brief Abandonne les morceaux en file et le morceau en cours (arrêt ou déplacement de la lecture)
+ * \param stepper Le moteur pas à pas
+ * \note N'attend jamais. Le thread saute les morceaux abandonnés à son prochain pas
+ */
+void stepper_flush(stepper_t *stepper) {
+    // Seul le thread avance tail : on lui indique jusqu'où, il garde seul la file cohérente
+    __atomic_store_n(&stepper->flush, __atomic_load_n(&stepper->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+/**
+ * \fn double stepperFreq(double freq)
+ * \brief Ramène une fréquence de note dans la plage jouable par le moteur
+ * \param freq La fréquence de la note
+ * \return La fréquence transposée par octaves entre STEPPER_MIN_FREQ et STEPPER_MAX_FREQ
+ */
+double stepperFreq(double freq) {
+    if(freq <= 0) return 0;
+    while(freq < STEPPER_MIN_FREQ) freq *= 2;
+    while(freq > STEPPER_MAX_FREQ) freq /= 2;
+    return freq;
+}
+
+/**
+ * \fn void reset_stepper_stats(stepper_t *stepper)
+ * \brief Remet les compteurs de pas et de gigue à zéro
+ * \param stepper Le moteur pas à pas
+ */
+void reset_stepper_stats(stepper_t *stepper) {
+    pthread_mutex_lock(&stepper->lock);
+    stepper->steps = 0;
+    stepper->skipped = 0;
+    __atomic_store_n(&stepper->overruns, 0, __ATOMIC_RELAXED);
+    stepper->jitterNs = 0;
+    stepper->maxJitterNs = 0;
+    memset(stepper->histogram, 0, sizeof(stepper->histogram));
+    pthread_mutex_unlock(&stepper->lock);
+}
+
+/**
+ * \fn void dump_stepper_stats(stepper_t *stepper, FILE *file)
+ * \brief Écrit les statistiques de gigue dans un fichier
+ * \param stepper Le moteur pas à pas
+ * \param file Le fichier de sortie
+ * \note Même format que dump_audio_stats, avec le préfixe stepper_
+ */
+void dump_stepper_stats(stepper_t *stepper, FILE *file) {
+    int i;
+    pthread_mutex_lock(&stepper->lock);
+    fprintf(file, "stepper_steps=%lu\n", stepper->steps);
+    fprintf(file, "stepper_skipped=%lu\n", stepper->skipped);
+    fprintf(file, "stepper_overruns=%lu\n", __atomic_load_n(&stepper->overruns, __ATOMIC_RELAXED));
+    fprintf(file, "stepper_jitter_avg_ns=%lld\n", stepper->steps > 0 ? stepper->jitterNs / (long long) stepper->steps : 0);
+    fprintf(file, "stepper_jitter_max_ns=%lld\n", stepper->maxJitterNs);
+    for(i = 0; i < STEPPER_JITTER_BUCKETS; i++) {
+        // La dernière case contient tous les pas qui ont dépassé 100 µs
+        if(i == STEPPER_JITTER_BUCKETS - 1) fprintf(file, "stepper_jitter_%dus+=%lu\n", i * 10, stepper->histogram[i]);
+        else fprintf(file, "stepper_jitter_%d-%dus=%lu\n", i * 10, (i + 1) * 10, stepper->histogram[i]);
+    }
+    pthread_mutex_unlock(&stepper->lock);
+}
+
+/**
+ * \fn void save_stepper_stats(stepper_t *stepper)
+ * \brief Ajoute les statistiques de gigue à la fin du fichier AUDIO_STATS_FILE
+ * \param stepper Le moteur pas à pas
+ */
+void save_stepper_stats(stepper_t *stepper) {
+    FILE *file = fopen(AUDIO_STATS_FILE, "a");
+    if(file == NULL) return;
+    dump_stepper_stats(stepper, file);
+    fclose(file);
+}
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn void *stepper_thread(void *args)
+ * \brief Thread temps réel : joue les morceaux en file pas par pas
+ * \param args Le moteur pas à pas
+ */
+void *stepper_thread(void *args) {
+    stepper_t *stepper = (stepper_t *) args;
+    struct timespec ts;
+    unsigned int tail, flush;
+    int energized = 0;
+
+    while(__atomic_load_n(&stepper->running, __ATOMIC_ACQUIRE)) {
+        tail = stepper->tail;
+        flush = __atomic_load_n(&stepper->flush, __ATOMIC_ACQUIRE);
+        if((int) (flush - tail) > 0) {
+            // Lecture arrêtée ou déplacée : les morceaux en file ne sont pas joués, la note suivante repart de zéro
+            stepper->phase = 0;
+            __atomic_store_n(&stepper->tail, flush, __ATOMIC_RELEASE);
+            continue;
+        }
+        if(tail == __atomic_load_n(&stepper->head, __ATOMIC_ACQUIRE)) {
+            // Plus rien à jouer : on coupe les bobines pour que le moteur ne chauffe pas
+            if(energized) {
+                stepper->gpio->write(stepper->gpio, 0, audio_clock_ns());
+                energized = 0;
+            }
+            ns2timespec(audio_clock_ns() + STEPPER_IDLE_NS, &ts);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            continue;
+        }
+        // Première note du moteur : les broches ne sont prises qu'à ce moment
+        if(stepper->claimed == 0) stepper->claimed = stepper->gpio->setup(stepper->gpio) < 0 ? -1 : 1;
+        if(stepper->claimed > 0) {
+            stepper_play_segment(stepper, &(stepper->ring[tail & (STEPPER_RING_SIZE - 1)]));
+            energized = 1;
+        }
+        __atomic_store_n(&stepper->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * \fn void stepper_play_segment(stepper_t *stepper, stepper_segment_t *segment)
+ * \brief Joue les pas d'un morceau de note à leur date absolue
+ * \param stepper Le moteur pas à pas
+ * \param segment Le morceau à jouer
+ */
+void stepper_play_segment(stepper_t *stepper, stepper_segment_t *segment) {
+    static const int sequence[STEPPER_SEQUENCE_LENGTH] = STEPPER_SEQUENCE;
+    double framesPerStep, offset;
+    long long target, now;
+    struct timespec ts;
+    int k;
+
+    if(segment->restart) stepper->phase = 0;
+    if(segment->freq <= 0) return;
+    framesPerStep = (double) SAMPLE_RATE / segment->freq;
+    // Un pas tombe à chaque pas entier franchi depuis le début de la note
+    for(k = stepper->phase > 0 ? 1 : 0; (offset = (k - stepper->phase) * framesPerStep) < segment->frames; k++) {
+        if(!__atomic_load_n(&stepper->running, __ATOMIC_ACQUIRE)) return;
+        // Morceau abandonné par stepper_flush pendant qu'il était joué
+        if((int) (__atomic_load_n(&stepper->flush, __ATOMIC_ACQUIRE) - stepper->tail) > 0) return;
+        // L'horloge est relue à chaque pas : le moteur suit la dérive de la carte son
+        if(stepper_frame2ns(stepper, segment->frame + offset, &target) < 0) break;
+        now = audio_clock_ns();
+        if(target < now - STEPPER_LATE_NS) {
+            // Morceau d'une lecture arrêtée ou période perdue : rattraper ferait un glissando
+            pthread_mutex_lock(&stepper->lock);
+            stepper->skipped++;
+            pthread_mutex_unlock(&stepper->lock);
+            continue;
+        }
+        // Attente en temps absolu : le temps passé à écrire les GPIO ne décale pas les pas suivants
+        ns2timespec(target, &ts);
+        // Seule une interruption par un signal relance l'attente : une autre erreur ne doit pas bloquer le thread
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+        stepper->step = (stepper->step + 1) % STEPPER_SEQUENCE_LENGTH;
+        stepper->gpio->write(stepper->gpio, sequence[stepper->step], target);
+        stepper_record(stepper, audio_clock_ns() - target);
+    }
+    stepper->phase = fmod(stepper->phase + segment->frames / framesPerStep, 1.0);
+}
+
+/**
+ * \fn int stepper_frame2ns(stepper_t *stepper, double frame, long long *ns)
+ * \brief Convertit une position du transport en date absolue
+ * \param stepper Le moteur pas à pas
+ * \param frame La position du transport (fractionnaire)
+ * \param ns La date correspondante
+ * \return 0 si succès, -1 si le moteur audio n'a encore rien publié
+ */
+int stepper_frame2ns(stepper_t *stepper, double frame, long long *ns) {
+    unsigned int seq;
+    long long clockFrame, clockNs;
+    do {
+        seq = __atomic_load_n(&stepper->clockSeq, __ATOMIC_ACQUIRE);
+        clockFrame = __atomic_load_n(&stepper->clockFrame, __ATOMIC_RELAXED);
+        clockNs = __atomic_load_n(&stepper->clockNs, __ATOMIC_RELAXED);
+    } while((seq & 1) || seq != __atomic_load_n(&stepper->clockSeq, __ATOMIC_ACQUIRE));
+    if(seq == 0) return -1;
+    *ns = clockNs + (long long) ((frame - clockFrame) * NSEC_PER_SEC / SAMPLE_RATE);
+    return 0;
+}
+
+/**
+ * \fn void stepper_record(stepper_t *stepper, long long jitter)
+ * \brief Enregistre la gigue d'un pas
+ * \param stepper Le moteur pas à pas
+ * \param jitter L'écart entre la date réelle et la date prévue du pas
+ */
+void stepper_record(stepper_t *stepper, long long jitter) {
+    int bucket;
+    if(jitter < 0) jitter = -jitter;
+    bucket = (int) (jitter / STEPPER_JITTER_BUCKET_NS);
+    if(bucket >= STEPPER_JITTER_BUCKETS) bucket = STEPPER_JITTER_BUCKETS - 1;
+    pthread_mutex_lock(&stepper->lock);
+    stepper->steps++;
+    stepper->jitterNs += jitter;
+    if(jitter > stepper->maxJitterNs) stepper->maxJitterNs = jitter;
+    stepper->histogram[bucket]++;
+    pthread_mutex_unlock(&stepper->lock);
+}
+
+/**
+ * \fn void ns2timespec(long long ns, struct timespec *ts)
+ * \brief Convertit une date en nanosecondes en timespec
+ * \param ns La date
+ * \param ts Le timespec à remplir
+ */
+void ns2timespec(long long ns, struct timespec *ts) {
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+/**
+ * \fn int stepper_wiringpi_setup(stepper_gpio_t *gpio)
+ * \brief Passe les broches des bobines en sortie
+ * \param gpio La couche GPIO
+ * \return 0
+ */
+int stepper_wiringpi_setup(stepper_gpio_t *gpio) {
+    int pins[STEPPER_NB_PINS] = STEPPER_PINS;
+    int i;
+    for(i = 0; i < STEPPER_NB_PINS; i++) {
+        pinMode(pins[i], OUTPUT);
+        digitalWrite(pins[i], LOW);
+    }
+    return 0;
+}
+
+/**
+ * \fn void stepper_wiringpi_write(stepper_gpio_t *gpio, int pattern, long long targetNs)
+ * \brief Alimente les bobines d'un masque
+ * \param gpio La couche GPIO
+ * \param pattern Le masque des bobines (bit i : broche i de STEPPER_PINS)
+ * \param targetNs La date prévue du pas (inutilisée)
+ */
+void stepper_wiringpi_write(stepper_gpio_t *gpio, int pattern, long long targetNs) {
+    int pins[STEPPER_NB_PINS] = STEPPER_PINS;
+    int i;
+    for(i = 0; i < STEPPER_NB_PINS; i++) digitalWrite(pins[i], (pattern >> i) & 1 ? HIGH : LOW);
+}
+
+/**
+ * \fn void stepper_wiringpi_release(stepper_gpio_t *gpio)
+ * \brief Coupe toutes les bobines
+ * \param gpio La couche GPIO
+ */
+void stepper_wiringpi_release(stepper_gpio_t *gpio) {
+    stepper_wiringpi_write(gpio, 0, 0);
+}
+
+/**
+ * \fn int stepper_sim_setup(stepper_gpio_t *gpio)
+ * \brief Vide l'enregistrement de la simulation
+ * \param gpio La couche GPIO simulée
+ * \return 0 si l'enregistrement est alloué, -1 sinon
+ */
+int stepper_sim_setup(stepper_gpio_t *gpio) {
+    gpio->nbPulses = 0;
+    return gpio->pulses != NULL ? 0 : -1;
+}
+
+/**
+ * \fn void stepper_sim_write(stepper_gpio_t *gpio, int pattern, long long targetNs)
+ * \brief Enregistre la date prévue et la date réelle d'un pas
+ * \param gpio La couche GPIO simulée
+ * \param pattern Le masque des bobines (0 : bobines coupées, non enregistré)
+ * \param targetNs La date prévue du pas
+ */
+void stepper_sim_write(stepper_gpio_t *gpio, int pattern, long long targetNs) {
+    if(pattern == 0 || gpio->nbPulses >= gpio->maxPulses) return;
+    gpio->targets[gpio->nbPulses] = targetNs;
+    gpio->pulses[gpio->nbPulses] = audio_clock_ns();
+    gpio->nbPulses++;
+}
+
+/**
+ * \fn void stepper_sim_release(stepper_gpio_t *gpio)
+ * \brief Rien à couper dans la simulation
+ * \param gpio La couche GPIO simulée
+ */
+void stepper_sim_release(stepper_gpio_t *gpio) {
+}
@@ -0,0 +1,172 @@
+/**
+ * \file workers.c
+ * \brief Pool de threads temps réel pour calculer les voix d'une période en parallèle
+ */
+#include "workers.h"
+
+/* ------------------------------------------------------------------------ */
+/*                   F O N C T I O N S   P R I V É E S                      */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int run_claimed_jobs(job_t *jobs, int nbJobs, int first)
+ * \brief Prend et calcule des tâches jusqu'à ce qu'il n'en reste plus de publiée
+ * \param jobs Les tâches
+ * \param nbJobs Le nombre de tâches
+ * \param first La première tâche de la part du thread : les suivantes sont volées aux autres
+ * \return Le nombre de tâches calculées
+ */
+static int run_claimed_jobs(job_t *jobs, int nbJobs, int first) {
+    int i, k, expected, count = 0;
+    for(k = 0; k < nbJobs; k++) {
+        i = (first + k) % nbJobs;
+        expected = JOB_READY;
+        // Une tâche n'est prise qu'une fois : les autres threads passent à la suivante
+        if(!__atomic_compare_exchange_n(&jobs[i].state, &expected, JOB_RUNNING, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) continue;
+        jobs[i].run(jobs[i].arg);
+        __atomic_store_n(&jobs[i].state, JOB_DONE, __ATOMIC_RELEASE);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * \fn void *worker_thread(void *args)
+ * \brief Thread d'un worker : attend chaque lot et en calcule sa part
+ * \param args Le worker
+ */
+static void *worker_thread(void *args) {
+    worker_t *worker = (worker_t *) args;
+    worker_pool_t *pool = worker->pool;
+    unsigned long seen = 0;
+    job_t *jobs;
+    int nbJobs;
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->running) {
+        if(pool->generation == seen) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            continue;
+        }
+        seen = pool->generation;
+        jobs = pool->jobs;
+        nbJobs = pool->nbJobs;
+        pthread_mutex_unlock(&pool->lock);
+        // Les tâches ne sont prises qu'à l'état JOB_READY : un worker réveillé en retard
+        // ne touche pas à un lot déjà terminé ou en préparation
+        run_claimed_jobs(jobs, nbJobs, worker->index * nbJobs / (pool->nbWorkers + 1));
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_exit(NULL);
+}
+
+/* ------------------------------------------------------------------------ */
+/*                  C O D E    D E S    F O N C T I O N S                   */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * \fn int init_worker_pool(worker_pool_t *pool, int nbWorkers, int priority)
+ * \brief Démarre les workers d'un pool
+ * \param pool Le pool
+ * \param nbWorkers Le nombre de workers (borné à WORKERS_MAX)
+ * \param priority La priorité SCHED_FIFO des workers (ignorée sans les droits)
+ * \return Le nombre de workers démarrés
+ */
+int init_worker_pool(worker_pool_t *pool, int nbWorkers, int priority) {
+    struct sched_param param;
+    int i;
+    memset(pool, 0, sizeof(worker_pool_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pool->running = 1;
+    if(nbWorkers > WORKERS_MAX) nbWorkers = WORKERS_MAX;
+    // Le rang d'un worker sert à répartir les lots : il est fixé avant le démarrage
+    pool->nbWorkers = nbWorkers < 0 ? 0 : nbWorkers;
+    param.sched_priority = priority;
+    for(i = 0; i < pool->nbWorkers; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i + 1;
+        if(pthread_create(&pool->workers[i].thread, NULL, worker_thread, (void *) &pool->workers[i]) != 0) break;
+        pthread_setschedparam(pool->workers[i].thread, SCHED_FIFO, &param);
+    }
+    if(i < pool->nbWorkers) {
+        // Les workers démarrés gardent leur rang : seule la répartition est moins régulière
+        pthread_mutex_lock(&pool->lock);
+        pool->nbWorkers = i;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return pool->nbWorkers;
+}
+
+/**
+ * \fn void end_worker_pool(worker_pool_t *pool)
+ * \brief Arrête les workers d'un pool
+ * \param pool Le pool
+ */
+void end_worker_pool(worker_pool_t *pool) {
+    int i;
+    pthread_mutex_lock(&pool->lock);
+    pool->running = 0;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for(i = 0; i < pool->nbWorkers; i++) pthread_join(pool->workers[i].thread, NULL);
+    pool->nbWorkers = 0;
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+/**
+ * \fn int jobs_idle(job_t *jobs, int nbJobs)
+ * \brief Indique si les tâches d'un lot peuvent être réutilisées
+ * \param jobs Les tâches
+ * \param nbJobs Le nombre de tâches
+ * \return 1 si aucun worker ne calcule encore une de ces tâches (lot précédent abandonné)
+ */
+int jobs_idle(job_t *jobs, int nbJobs) {
+    int i;
+    for(i = 0; i < nbJobs; i++) {
+        if(__atomic_load_n(&jobs[i].state, __ATOMIC_ACQUIRE) == JOB_RUNNING) return 0;
+    }
+    return 1;
+}
+
+/**
+ * \fn int run_jobs(worker_pool_t *pool, job_t *jobs, int nbJobs, long long deadline)
+ * \brief Calcule un lot de tâches avec les workers et le thread appelant
+ * \param pool Le pool
+ * \param jobs Les tâches (run et arg remplis, toutes à l'état JOB_IDLE)
+ * \param nbJobs Le nombre de tâches
+ * \param deadline La date (audio_clock_ns) après laquelle le lot n'est plus attendu
+ * \return Le nombre de tâches encore en cours à l'échéance
+ */
+int run_jobs(worker_pool_t *pool, job_t *jobs, int nbJobs, long long deadline) {
+    int i, late;
+    if(nbJobs <= 0) return 0;
+    // Une seule tâche ou aucun worker : réveiller un thread coûterait plus que la tâche
+    if(pool->nbWorkers == 0 || nbJobs == 1) {
+        for(i = 0; i < nbJobs; i++) __atomic_store_n(&jobs[i].state, JOB_READY, __ATOMIC_RELAXED);
+        run_claimed_jobs(jobs, nbJobs, 0);
+        return 0;
+    }
+    for(i = 0; i < nbJobs; i++) __atomic_store_n(&jobs[i].state, JOB_READY, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&pool->lock);
+    pool->jobs = jobs;
+    pool->nbJobs = nbJobs;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    // L'appelant prend sa part comme un worker, puis vole ce que les autres n'ont pas commencé
+    run_claimed_jobs(jobs, nbJobs, 0);
+    // Il ne reste que des tâches en cours sur les workers : on les attend jusqu'à l'échéance
+    do {
+        late = 0;
+        for(i = 0; i < nbJobs; i++) {
+            if(__atomic_load_n(&jobs[i].state, __ATOMIC_ACQUIRE) != JOB_DONE) late++;
+        }
+        if(late == 0 || audio_clock_ns() >= deadline) break;
+        sched_yield();
+    } while(1);
+    return late;
+}